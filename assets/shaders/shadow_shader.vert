@@ -1,26 +1,89 @@
 #version 450
 
+#ifdef SINGLE_PASS
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+#ifdef PACKED_VERTEX
+// snorm16 relative to the mesh bounds, the dequantization is folded into push.modelMatrix
+layout(location = 0) in vec4 position;
+#else
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 layout(location = 4) in vec4 tangent; // xyz + w(sign)
+#endif
 
+#ifdef LOCAL_SHADOW
+// Point and spot light atlas tiles, the tile's view projection is folded into the matrix on the CPU
+layout(push_constant) uniform Push {
+    mat4 modelViewProjection;
+} push;
+#else
 const int NUM_CASCADES = 4;
 
 layout(set = 0, binding = 0) uniform lightUbo {
     mat4 lightProjectionMatrix[NUM_CASCADES];
     mat4 lightViewMatrix[NUM_CASCADES];
-    float splitDepths[NUM_CASCADES];
+    vec4 splitDepths;   // one per cascade, a float array would have a 16 byte stride in std140
+    vec4 atlasRects[NUM_CASCADES];  // xy = atlas uv offset, zw = uv scale
 } ubo;
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
+#ifdef SINGLE_PASS
+    uint cascadeMask;   // one instance per set bit, each goes to its cascade's viewport
+#else
     int cascadeIndex;
+#endif
 } push;
+#endif
+
+#ifdef INDIRECT_DRAW
+// Same buffer as the main pass, only the cascade index comes from the push constant
+struct DrawData {
+    mat4 modelMatrix;
+    vec4 quantOffset;
+    vec4 quantScale;
+    ivec4 material;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 command;
+    uvec4 cull;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+} gDraws;
+#endif
 
 void main() {
+#ifdef LOCAL_SHADOW
+    gl_Position = push.modelViewProjection * vec4(position.xyz, 1.0);
+#else
+#ifdef SINGLE_PASS
+    // gl_InstanceIndex-th set bit of the mask
+    uint mask = push.cascadeMask;
+    for (int i = 0; i < gl_InstanceIndex; i++) {
+        mask &= mask - 1u;
+    }
+    int cascade_index = findLSB(mask);
+    gl_ViewportIndex = cascade_index;
+#else
     int cascade_index = push.cascadeIndex;
+#endif
     mat4 viewProj = ubo.lightProjectionMatrix[cascade_index] * ubo.lightViewMatrix[cascade_index];
-    gl_Position = viewProj * push.modelMatrix * vec4(position, 1.0);
+#ifdef INDIRECT_DRAW
+    DrawData draw = gDraws.draws[gl_InstanceIndex];
+#ifdef PACKED_VERTEX
+    vec3 objectPosition = draw.quantOffset.xyz + position.xyz * draw.quantScale.xyz;
+#else
+    vec3 objectPosition = position.xyz;
+#endif
+    gl_Position = viewProj * draw.modelMatrix * vec4(objectPosition, 1.0);
+#else
+    gl_Position = viewProj * push.modelMatrix * vec4(position.xyz, 1.0);
+#endif
+#endif
 }
\ No newline at end of file
@@ -30,15 +30,48 @@ layout(std430, set = 2, binding = 0) buffer LightBuffer {
     Light lights[];
 } gLights;
 
+// GPUClusterInfo, see light_cluster.comp
+layout(std140, set = 2, binding = 1) uniform ClusterInfo {
+    uvec4 grid;        // xyz = cluster counts, w = max lights per cluster
+    vec4 tileSize;     // xy = pixels per tile, fractional, the clusters split the screen exactly
+    vec4 depth;        // x = near, y = far, z = slice scale, w = slice bias
+    vec4 projection;   // x = P[0][0], y = P[1][1], z = enabled
+    mat4 view;
+} gClusters;
+
+layout(std430, set = 2, binding = 2) readonly buffer ClusterLights {
+    uint data[];
+} gClusterLights;
+
 const int NUM_CASCADES = 4;
 
 layout(set = 3, binding = 0) uniform lightUbo {
     mat4 lightProjectionMatrix[NUM_CASCADES];
     mat4 lightViewMatrix[NUM_CASCADES];
-    float splitDepths[NUM_CASCADES];
+    vec4 splitDepths;   // one per cascade, a float array would have a 16 byte stride in std140
+    vec4 atlasRects[NUM_CASCADES];  // xy = atlas uv offset, zw = uv scale
 } sUbo;
 
-layout(set = 3, binding = 1) uniform sampler2DArrayShadow shadowMap;
+// Every cascade is a rect of one atlas, see XEShadowSystem::layoutAtlas
+layout(set = 3, binding = 1) uniform sampler2DShadow shadowMap;
+
+// Point and spot light shadows, see XELocalShadowSystem
+const uint MAX_LOCAL_SHADOW_TILES = 192u;
+const uint MAX_LOCAL_SHADOW_SLOTS = 4096u;
+
+struct LocalShadowTile {
+    mat4 viewProjection;
+    vec4 rect;     // xy = atlas uv offset, zw = uv scale
+    vec4 params;   // x = world texel size per unit of distance, y = half texel in tile uv
+};
+
+layout(std430, set = 5, binding = 0) readonly buffer LocalShadows {
+    uvec4 header;  // x = tile count
+    LocalShadowTile tiles[MAX_LOCAL_SHADOW_TILES];
+    uint slotTiles[MAX_LOCAL_SHADOW_SLOTS];  // first tile + 1 per light slot, 0 = not shadowed
+} gLocalShadows;
+
+layout(set = 5, binding = 1) uniform sampler2DShadow localShadowAtlas;
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
@@ -48,6 +81,16 @@ layout(push_constant) uniform Push {
     int pad2;
 } push;
 
+#ifdef INDIRECT_DRAW
+// Material of the draw, read from the draw data buffer by the vertex shader
+layout(location = 6) flat in ivec2 fragMaterial;
+#define TEXTURE_INDEX fragMaterial.x
+#define NORMAL_INDEX fragMaterial.y
+#else
+#define TEXTURE_INDEX push.textureIndex
+#define NORMAL_INDEX push.normalIndex
+#endif
+
 vec3 lambert(vec3 n, vec3 l, vec3 lightRgb, float intensity, float ndotl, vec3 albedo) {
     return lightRgb * intensity * ndotl * albedo;
 }
@@ -124,8 +167,40 @@ float sampleShadowCSM(vec3 worldPos, int cascade) {
         return 1.0;
     }
 
+    // Half a texel inside the cascade's rect, so the filter never reads a neighbouring cascade
+    vec4 rect = sUbo.atlasRects[cascade];
+    vec2 halfTexel = 0.5 / (rect.zw * vec2(textureSize(shadowMap, 0)));
+    uv = clamp(uv, halfTexel, 1.0 - halfTexel);
+
     float ref = posLS.z;
-    return texture(shadowMap, vec4(uv, float(cascade), ref));
+    return texture(shadowMap, vec3(rect.xy + uv * rect.zw, ref));
+}
+
+float sampleLocalShadow(uint slot, in Light L, vec3 worldPos, vec3 geomNormal) {
+    if (slot >= MAX_LOCAL_SHADOW_SLOTS || int(L.position.w + 0.5) == 0) return 1.0;
+    uint first = gLocalShadows.slotTiles[slot];
+    if (first == 0u) return 1.0;
+
+    uint tileIndex = first - 1u;
+    vec3 fromLight = worldPos - L.position.xyz;
+    if (int(L.position.w + 0.5) == 1) {
+        // Cube faces in +X, -X, +Y, -Y, +Z, -Z order
+        vec3 a = abs(fromLight);
+        if (a.x >= a.y && a.x >= a.z) tileIndex += fromLight.x >= 0.0 ? 0u : 1u;
+        else if (a.y >= a.z)          tileIndex += fromLight.y >= 0.0 ? 2u : 3u;
+        else                          tileIndex += fromLight.z >= 0.0 ? 4u : 5u;
+    }
+    LocalShadowTile tile = gLocalShadows.tiles[tileIndex];
+
+    // Normal offset of about one and a half texels at this distance
+    vec3 offsetPos = worldPos + geomNormal * (tile.params.x * length(fromLight) * 1.5);
+    vec4 posLS = tile.viewProjection * vec4(offsetPos, 1.0);
+    if (posLS.w <= 0.0) return 1.0;
+    posLS.xyz /= posLS.w;
+
+    // Clamped half a texel inside the tile so the filter never reads a neighbour
+    vec2 tileUV = clamp(posLS.xy * 0.5 + 0.5, vec2(tile.params.y), vec2(1.0 - tile.params.y));
+    return texture(localShadowAtlas, vec3(tile.rect.xy + tileUV * tile.rect.zw, posLS.z));
 }
 
 // Optional: flip green if your normal maps are in "DirectX" convention
@@ -133,7 +208,9 @@ const bool FLIP_GREEN = false;
 
 vec3 sampleWorldNormal() {
     // Sample tangent-space normal from texture (UNORM)
-    vec3 n_ts = texture(texSamplers[push.normalIndex], fragUV).xyz * 2.0 - 1.0;
+    // BC5 normal maps only store xy, z is rebuilt the same way for the RGBA8 ones
+    vec2 n_xy = texture(texSamplers[NORMAL_INDEX], fragUV).xy * 2.0 - 1.0;
+    vec3 n_ts = vec3(n_xy, sqrt(max(1.0 - dot(n_xy, n_xy), 0.0)));
     if (FLIP_GREEN) n_ts.g = -n_ts.g;
 
     // Build TBN (bitangent from cross * handedness)
@@ -150,10 +227,11 @@ void main() {
     float shadow = sampleShadowCSM(fragPosWorld, cascade_index);
     shadow = mix(0.3, 1.0, shadow);
 
-    vec3 texColor = texture(texSamplers[push.textureIndex], fragUV).rgb;
+    vec3 texColor = texture(texSamplers[TEXTURE_INDEX], fragUV).rgb;
     vec3 albedo = texColor * color;
 
     vec3 N = sampleWorldNormal(); // fetch normal from normal map
+    vec3 geomNormal = normalize(fragNormalWorld);
     vec3 cameraPosWorld = ubo.inverseViewMatrix[3].xyz;
     vec3 V = normalize(cameraPosWorld - fragPosWorld); // View Direction
 
@@ -161,16 +239,40 @@ void main() {
     vec3 diffuseLight = ubo.ambientLightColor.rgb * ubo.ambientLightColor.a * albedo;
     vec3 specularLight = vec3(0.0);
 
-   // Loop over lights from SSBO
-   uint numLights = gLights.lightCount;
-   // (Optional) clamp to a sane upper bound to avoid pathological CPU bugs.
-   numLights = min(numLights, 1024u);
-
-   for (uint i = 0u; i < numLights; ++i) {
-       vec3 dC, sC;
-       evalLight(gLights.lights[i], fragPosWorld, N, V, albedo, dC, sC);
-       diffuseLight += dC;
-       specularLight += sC;
+   if (gClusters.projection.z != 0.0) {
+       // Only the lights assigned to this fragment's cluster
+       uvec2 tile = min(uvec2(gl_FragCoord.xy / gClusters.tileSize.xy), gClusters.grid.xy - 1u);
+       float slice = log(max(vViewZ, gClusters.depth.x)) * gClusters.depth.z + gClusters.depth.w;
+       uint z = min(uint(max(slice, 0.0)), gClusters.grid.z - 1u);
+       uint cluster = (z * gClusters.grid.y + tile.y) * gClusters.grid.x + tile.x;
+       uint base = cluster * (gClusters.grid.w + 1u);
+
+       uint clusterLights = gClusterLights.data[base];
+       for (uint i = 0u; i < clusterLights; ++i) {
+           uint slot = gClusterLights.data[base + 1u + i];
+           vec3 dC, sC;
+           evalLight(gLights.lights[slot], fragPosWorld, N, V, albedo, dC, sC);
+           if (any(greaterThan(dC + sC, vec3(0.0)))) {
+               float localShadow = sampleLocalShadow(slot, gLights.lights[slot], fragPosWorld, geomNormal);
+               diffuseLight += dC * localShadow;
+               specularLight += sC * localShadow;
+           }
+       }
+   } else {
+       // Loop over lights from SSBO
+       uint numLights = gLights.lightCount;
+       // (Optional) clamp to a sane upper bound to avoid pathological CPU bugs.
+       numLights = min(numLights, 1024u);
+
+       for (uint i = 0u; i < numLights; ++i) {
+           vec3 dC, sC;
+           evalLight(gLights.lights[i], fragPosWorld, N, V, albedo, dC, sC);
+           if (any(greaterThan(dC + sC, vec3(0.0)))) {
+               float localShadow = sampleLocalShadow(i, gLights.lights[i], fragPosWorld, geomNormal);
+               diffuseLight += dC * localShadow;
+               specularLight += sC * localShadow;
+           }
+       }
    }
 
    outColor = shadow * vec4(diffuseLight + specularLight, 1.0);
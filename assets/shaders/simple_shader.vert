@@ -1,10 +1,25 @@
 #version 450
 
+#ifdef PACKED_VERTEX
+// XEModel::PackedVertex, decoded into the same names the fp32 path uses
+layout(location = 0) in vec4 inPosition; // snorm16 relative to mesh bounds, w = tangent sign
+layout(location = 1) in vec4 inColor;    // unorm8
+layout(location = 2) in vec2 inNormal;   // octahedral snorm16
+layout(location = 3) in vec2 inUV;       // half
+layout(location = 4) in vec2 inTangent;  // octahedral snorm16
+
+vec3 position;
+vec3 color;
+vec3 normal;
+vec2 uv;
+vec4 tangent;
+#else
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 layout(location = 4) in vec4 tangent; // xyz + w(sign)
+#endif
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
@@ -38,8 +53,48 @@ layout(push_constant) uniform Push {
     int normalIndex;
     int pad1;
     int pad2;
+    vec4 quantOffset; // packed vertices: objectPos = quantOffset + position * quantScale
+    vec4 quantScale;
 } push;
 
+#ifdef INDIRECT_DRAW
+// GPUDrawData, one per mesh, the indirect command's firstInstance selects it
+struct DrawData {
+    mat4 modelMatrix;
+    vec4 quantOffset;
+    vec4 quantScale;
+    ivec4 material; // x = albedo texture, y = normal texture
+    vec4 boundsMin; // the rest is only read by cull.comp
+    vec4 boundsMax;
+    uvec4 command;
+    uvec4 cull;
+};
+
+layout(std430, set = 4, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+} gDraws;
+
+layout(location = 6) flat out ivec2 fragMaterial;
+#endif
+
+mat4 modelMatrix;
+vec3 quantOffset;
+vec3 quantScale;
+
+void loadDrawData() {
+#ifdef INDIRECT_DRAW
+    DrawData draw = gDraws.draws[gl_InstanceIndex];
+    modelMatrix = draw.modelMatrix;
+    quantOffset = draw.quantOffset.xyz;
+    quantScale = draw.quantScale.xyz;
+    fragMaterial = draw.material.xy;
+#else
+    modelMatrix = push.modelMatrix;
+    quantOffset = push.quantOffset.xyz;
+    quantScale = push.quantScale.xyz;
+#endif
+}
+
 const float AMBIENT = 0.09;
 
 const mat4 biasMat = mat4(
@@ -48,11 +103,35 @@ const mat4 biasMat = mat4(
 	0.0, 0.0, 1.0, 0.0,
 	0.5, 0.5, 0.0, 1.0 );
 
+#ifdef PACKED_VERTEX
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+void unpackVertex() {
+    position = quantOffset + inPosition.xyz * quantScale;
+    color = inColor.rgb;
+    normal = octDecode(inNormal);
+    uv = inUV;
+    tangent = vec4(octDecode(inTangent), inPosition.w < 0.0 ? -1.0 : 1.0);
+}
+#endif
+
 void main() {
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    loadDrawData();
+
+#ifdef PACKED_VERTEX
+    unpackVertex();
+#endif
+
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
     fragPosWorld = positionWorld.xyz;
 
-    mat3 normalMatrix = transpose(inverse(mat3(push.modelMatrix)));
+    mat3 normalMatrix = transpose(inverse(mat3(modelMatrix)));
 
     vec3 N = normalize(normalMatrix * normal);
 
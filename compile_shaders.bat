@@ -1,10 +1,28 @@
 echo "Compiling Model Shaders..."
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\simple_shader.vert -o assets\shaders\simple_shader.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DPACKED_VERTEX assets\shaders\simple_shader.vert -o assets\shaders\simple_shader_packed.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DINDIRECT_DRAW assets\shaders\simple_shader.vert -o assets\shaders\simple_shader_indirect.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DINDIRECT_DRAW -DPACKED_VERTEX assets\shaders\simple_shader.vert -o assets\shaders\simple_shader_packed_indirect.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\simple_fragment.frag -o assets\shaders\simple_fragment.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DINDIRECT_DRAW assets\shaders\simple_fragment.frag -o assets\shaders\simple_fragment_indirect.spv
 
 echo "Compiling Point Light Shaders..."
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\point_light_shader.vert -o assets\shaders\point_light_shader.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\point_light_fragment.frag -o assets\shaders\point_light_fragment.spv
 
 echo "Compiling shadow Shaders..."
-C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader.spv
\ No newline at end of file
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DPACKED_VERTEX assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_packed.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DINDIRECT_DRAW assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_indirect.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DINDIRECT_DRAW -DPACKED_VERTEX assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_packed_indirect.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe --target-env=vulkan1.2 -DSINGLE_PASS assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_single_pass.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe --target-env=vulkan1.2 -DSINGLE_PASS -DPACKED_VERTEX assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_packed_single_pass.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DLOCAL_SHADOW assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_local.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DLOCAL_SHADOW -DPACKED_VERTEX assets\shaders\shadow_shader.vert -o assets\shaders\shadow_shader_packed_local.spv
+
+echo "Compiling culling Shaders..."
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\cull.comp -o assets\shaders\cull.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\depth_reduce.comp -o assets\shaders\depth_reduce.spv
+
+echo "Compiling lighting Shaders..."
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe assets\shaders\light_cluster.comp -o assets\shaders\light_cluster.spv
\ No newline at end of file
@@ -10,11 +10,17 @@
 #include "systems/xe_simple_render_system.h"
 #include "systems/xe_point_light_system.h"
 #include "systems/xe_shadow_system.h"
+#include "systems/xe_local_shadow_system.h"
+#include "systems/xe_gpu_culling_system.h"
+#include "systems/xe_light_cluster_system.h"
+#include "renderer/lighting/xe_light_binner.h"
 
 #include <stdexcept>
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <iostream>
+#include <random>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -36,6 +42,30 @@ namespace xe {
         glm::vec4 ambientLightColor{1.f, 1.f, 1.f, 0.2f}; // w is intensity
     };
 
+    // Light counts of the clustered lighting sweep, each measured brute force and clustered
+    static constexpr std::array<uint32_t, 6> LIGHT_SWEEP_COUNTS{0, 64, 128, 256, 512, 1000};
+    static constexpr int LIGHT_SWEEP_WARMUP_FRAMES = 30;
+    static constexpr int LIGHT_SWEEP_FRAMES = 120;
+
+    // Small coloured point lights scattered through the Sponza atrium, same layout for a given count
+    static std::vector<GPULight> createStressLights(uint32_t count) {
+        std::mt19937 rng{1234u};
+        std::uniform_real_distribution<float> x(-12.f, 12.f);
+        std::uniform_real_distribution<float> y(0.3f, 10.f);
+        std::uniform_real_distribution<float> z(-5.f, 5.f);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+        std::vector<GPULight> lights(count);
+        for (auto& light: lights) {
+            light.color = glm::vec4(0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng),
+                1.f + 2.f * unit(rng));
+            light.position = glm::vec4(x(rng), y(rng), z(rng), 1.f);
+            light.direction = glm::vec4(0.f);
+            light.param = {2.f + 2.f * unit(rng), 0.f, 0.f, 32.f};
+        }
+        return lights;
+    }
+
     Application::Application() {
         globalPool = XEDescriptorPool::Builder(xe_device)
         .setMaxSets(XESwapChain::MAX_FRAMES_IN_FLIGHT)
@@ -45,6 +75,7 @@ namespace xe {
         createImguiDescriptorPool();
 
         loadGameObjects();
+        sceneBVH.build(gameObjects);
 
         // ImGUI init
         IMGUI_CHECKVERSION();
@@ -113,10 +144,22 @@ namespace xe {
 
         XELightManager lightManager{xe_device, XESwapChain::MAX_FRAMES_IN_FLIGHT, 128};
 
-        XEShadowSystem shadowSystem{xe_device, lightManager};
+        // View 0 is the camera, views 1..SHADOW_MAP_CASCADE_COUNT the shadow cascades
+        XEDrawManager drawManager{xe_device, materialManager, XESwapChain::MAX_FRAMES_IN_FLIGHT,
+            1 + SHADOW_MAP_CASCADE_COUNT, 1024};
+
+        XEDepthPyramid depthPyramid{xe_device, XESwapChain::MAX_FRAMES_IN_FLIGHT, xe_renderer.getSwapChainExtent()};
+        XELightClusterSystem lightClusterSystem{xe_device, lightManager};
+
+        XEGPUCullingSystem gpuCulling{xe_device, drawManager, depthPyramid, XESwapChain::MAX_FRAMES_IN_FLIGHT,
+            1 + SHADOW_MAP_CASCADE_COUNT};
+
+        XEShadowSystem shadowSystem{xe_device, lightManager, drawManager};
+        XELocalShadowSystem localShadowSystem{xe_device, lightManager};
         XESimpleRenderSystem simpleRenderSystem{xe_device, xe_renderer.getSwapChainRenderPass(),
             globalSetLayout->getDescriptorSetLayout(), textureManager, materialManager,
-            shadowSystem.getDescriptorSetLayout(), lightManager};
+            shadowSystem.getDescriptorSetLayout(), localShadowSystem.getDescriptorSetLayout(), lightManager,
+            drawManager};
         XEPointLightSystem pointLightSystem{xe_device, xe_renderer.getSwapChainRenderPass(),
             globalSetLayout->getDescriptorSetLayout(), lightManager};
         XECamera camera{};
@@ -156,6 +199,44 @@ namespace xe {
         vmaGetHeapBudgets(xe_device.vmaAllocator(), budgets);
 
 
+        bool useSceneBVH = true;
+        bool indirectDraws = false;
+        bool gpuCullingOn = false;
+        bool occlusionCulling = false;
+        // Smoothed CPU recording time of both passes, [0] per-mesh draws, [1] indirect, [2] GPU culled
+        std::array<float, 3> recordTimeMs{};
+        // Smoothed shadow pass recording time and draw calls, [0] a pass per cascade, [1] single pass
+        std::array<float, 2> shadowRecordMs{};
+        std::array<float, 2> shadowDrawCalls{};
+        std::vector<XESceneBVH::BenchmarkResult> bvhBenchmarks{};
+
+        // Created once, updated in place so only changed lights are uploaded. The sun takes slot 0 and the
+        // point lights the slots after it, the point light billboards rely on that.
+        const LightHandle sunHandle = lightManager.createLight(sunLight);
+        std::vector<LightHandle> pointLightHandles{};
+        for (auto& pl : pointLights) pointLightHandles.push_back(lightManager.createLight(pl));
+        for (LightHandle handle : pointLightHandles) localShadowSystem.setShadowed(handle, true);
+
+        bool clusteredLighting = true;
+        int stressLightCount = 0;
+        std::vector<LightHandle> stressLightHandles{};
+        int shadowedStressLights = 0;
+        float frameTimeMs = 0.0f;
+
+        // Frame time per light count, brute force then clustered
+        struct LightSweepResult {
+            uint32_t lights;
+            float bruteForceMs;
+            float clusteredMs;
+        };
+        bool lightSweepRunning = false;
+        size_t lightSweepStep = 0;      // 2 per count, even = brute force
+        int lightSweepFrame = 0;
+        float lightSweepAccumMs = 0.0f;
+        std::vector<LightSweepResult> lightSweepResults{};
+        std::vector<XELightBinner::BenchmarkResult> binnerBenchmarks{};
+        std::vector<XETextureManager::LoadBenchmarkResult> textureLoadBenchmarks{};
+
         auto currentTime = std::chrono::high_resolution_clock::now();
 
         while (!xe_window.shouldClose()) {
@@ -165,6 +246,33 @@ namespace xe {
             float frameTime =
                 std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
+            frameTimeMs = frameTimeMs == 0.0f ? frameTime * 1000.f : frameTimeMs * 0.95f + frameTime * 50.f;
+
+            if (lightSweepRunning) {
+                // Every step waits for the new light count to settle, then averages the frame time
+                lightSweepFrame++;
+                if (lightSweepFrame > LIGHT_SWEEP_WARMUP_FRAMES) {
+                    lightSweepAccumMs += frameTime * 1000.f;
+                }
+                if (lightSweepFrame == LIGHT_SWEEP_WARMUP_FRAMES + LIGHT_SWEEP_FRAMES) {
+                    const float average = lightSweepAccumMs / LIGHT_SWEEP_FRAMES;
+                    if (lightSweepStep % 2 == 0) {
+                        lightSweepResults.push_back({LIGHT_SWEEP_COUNTS[lightSweepStep / 2], average, 0.0f});
+                    } else {
+                        lightSweepResults.back().clusteredMs = average;
+                        std::cout << "[Lighting] " << lightSweepResults.back().lights << " stress lights: brute force "
+                            << lightSweepResults.back().bruteForceMs << " ms, clustered " << average << " ms" << std::endl;
+                    }
+                    lightSweepStep++;
+                    lightSweepFrame = 0;
+                    lightSweepAccumMs = 0.0f;
+                    lightSweepRunning = lightSweepStep < 2 * LIGHT_SWEEP_COUNTS.size();
+                }
+                if (lightSweepRunning) {
+                    stressLightCount = static_cast<int>(LIGHT_SWEEP_COUNTS[lightSweepStep / 2]);
+                    clusteredLighting = lightSweepStep % 2 == 1;
+                }
+            }
 
             cameraController.moveInPlaneXZ(xe_window.getGLFWwindow(), frameTime, viewerObject);
             camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
@@ -194,9 +302,270 @@ namespace xe {
             ImGui::Separator();
             ImGui::Text("Current coordinates: X: %.3f, Y: %.3f, Z: %.3f", viewerObject.transform.translation.x, viewerObject.transform.translation.y, viewerObject.transform.translation.z);
 
+            // ------------------ Clustered lighting ----------------------
+            ImGui::Separator();
+            ImGui::Checkbox("Clustered lighting", &clusteredLighting);
+            ImGui::SliderInt("Stress point lights", &stressLightCount, 0, 1000);
+            ImGui::Text("Frame %.2f ms with %u lights (%s)", frameTimeMs, lightManager.getLightCount(),
+                clusteredLighting ? "clustered" : "brute force");
+            ImGui::Text("Light upload: %llu bytes in %u ranges",
+                static_cast<unsigned long long>(lightManager.getLastUploadBytes()), lightManager.getLastUploadRanges());
+            if (!lightSweepRunning && ImGui::Button("Measure frame time vs. light count")) {
+                lightSweepRunning = true;
+                lightSweepStep = 0;
+                lightSweepFrame = 0;
+                lightSweepAccumMs = 0.0f;
+                lightSweepResults.clear();
+            }
+            for (const auto& result: lightSweepResults) {
+                ImGui::Text("%4u lights: brute force %.2f ms, clustered %.2f ms", result.lights, result.bruteForceMs,
+                    result.clusteredMs);
+            }
+            if (ImGui::Button("Run CPU light binning benchmark")) {
+                XEThreadPool binningPool{};
+                binnerBenchmarks.clear();
+                for (uint32_t lights: {1024u, 4096u, 16384u}) {
+                    binnerBenchmarks.push_back(XELightBinner::benchmark(lights, binningPool));
+                }
+            }
+            for (const auto& result: binnerBenchmarks) {
+                ImGui::Text("%5u lights: scalar %.2f ms, SSE %.2f ms, SSE threaded %.2f ms (%.1f per cluster, %u mismatches)",
+                    result.lightCount, result.scalarMs, result.simdMs, result.simdThreadedMs,
+                    result.averageLightsPerCluster, result.mismatchedClusters);
+            }
+
+            // ------------------ Texture streaming -----------------------
+            ImGui::Separator();
+            const auto& streamingStats = textureManager.getStreamingStats();
+            ImGui::Text("Textures: %u resident, %u pending, %u uploaded last frame (%u decode threads)",
+                streamingStats.resident, streamingStats.pending, streamingStats.lastFrameUploads,
+                streamingStats.decodeThreads);
+            ImGui::Text("Last load: %u textures resident after %.1f ms", streamingStats.lastBatchTextures,
+                streamingStats.lastBatchMs);
+            ImGui::Text("Cooked (BC7/BC5): %u, cooked on load: %u, raw RGBA8: %u, %.1f MB resident",
+                streamingStats.cookedLoads, streamingStats.cookedOnLoad, streamingStats.rawLoads,
+                streamingStats.residentBytes / (1024.f * 1024.f));
+            bool cookedTextures = textureManager.getUseCookedTextures();
+            if (ImGui::Checkbox("Load cooked textures (next loads)", &cookedTextures)) {
+                textureManager.setUseCookedTextures(cookedTextures);
+            }
+            bool cookMissing = textureManager.getCookMissingTextures();
+            if (ImGui::Checkbox("Cook missing textures on load", &cookMissing)) {
+                textureManager.setCookMissingTextures(cookMissing);
+            }
+            ImGui::Text("Residency: %.1f of %.1f MB budget (device heaps %.1f of %.1f MB), %u evicted",
+                streamingStats.residentBytes / (1024.f * 1024.f), streamingStats.budgetBytes / (1024.f * 1024.f),
+                streamingStats.heapUsage / (1024.f * 1024.f), streamingStats.heapBudget / (1024.f * 1024.f),
+                streamingStats.evicted);
+            ImGui::Text("Evictions: %u (%.1f MB freed), streamed back: %u", streamingStats.evictions,
+                streamingStats.evictedBytes / (1024.f * 1024.f), streamingStats.restores);
+            ImGui::Text("Mip streaming: %u uploads (%.1f MB) last frame, %u promotions, %u below wanted mip",
+                streamingStats.lastFrameMipUploads, streamingStats.lastFrameMipBytes / (1024.f * 1024.f),
+                streamingStats.mipPromotions, streamingStats.mipsOutstanding);
+            ImGui::Text("Last load: every drawn texture at its wanted mip after %.1f ms", streamingStats.lastSettleMs);
+            bool mipStreaming = textureManager.getMipStreaming();
+            if (ImGui::Checkbox("Mip streaming (next loads)", &mipStreaming)) {
+                textureManager.setMipStreaming(mipStreaming);
+            }
+            int mipBudgetMB = static_cast<int>(textureManager.getMipUploadBudget() / (1024 * 1024));
+            if (ImGui::SliderInt("Mip upload budget MB/frame", &mipBudgetMB, 1, 128)) {
+                textureManager.setMipUploadBudget(static_cast<uint64_t>(mipBudgetMB) * 1024 * 1024);
+            }
+            int mipBias = static_cast<int>(textureManager.getMipBias());
+            if (ImGui::SliderInt("Mip bias", &mipBias, -3, 3)) {
+                textureManager.setMipBias(static_cast<float>(mipBias));
+            }
+            int textureBudgetMB = static_cast<int>(textureManager.getTextureBudget() / (1024 * 1024));
+            if (ImGui::SliderInt("Texture budget MB (0 = VMA heap budget)", &textureBudgetMB, 0, 4096)) {
+                textureManager.setTextureBudget(static_cast<uint64_t>(textureBudgetMB) * 1024 * 1024);
+            }
+            int graceFrames = static_cast<int>(textureManager.getEvictionGraceFrames());
+            if (ImGui::SliderInt("Eviction grace frames", &graceFrames, 2, 600)) {
+                textureManager.setEvictionGraceFrames(static_cast<uint32_t>(graceFrames));
+            }
+            int maxUploads = static_cast<int>(textureManager.getMaxUploadsPerFrame());
+            if (ImGui::SliderInt("Texture uploads per frame", &maxUploads, 1, 32)) {
+                textureManager.setMaxUploadsPerFrame(static_cast<uint32_t>(maxUploads));
+            }
+            if (streamingStats.pending == 0 && ImGui::Button("Benchmark texture loading (1 vs N decode threads)")) {
+                textureLoadBenchmarks.clear();
+                textureLoadBenchmarks.push_back(textureManager.benchmarkLoad(1));
+                textureLoadBenchmarks.push_back(textureManager.benchmarkLoad(0));
+            }
+            for (const auto& result: textureLoadBenchmarks) {
+                ImGui::Text("%2u decode threads: %u textures in %.1f ms (decode %.1f ms summed over workers)",
+                    result.threads, result.textures, result.totalMs, result.decodeMs);
+            }
+            if (textureLoadBenchmarks.size() == 2 && textureLoadBenchmarks[1].totalMs > 0.0) {
+                ImGui::Text("Speedup: %.2fx", textureLoadBenchmarks[0].totalMs / textureLoadBenchmarks[1].totalMs);
+            }
+
+            // ------------------ Culling ---------------------------------
+            ImGui::Separator();
+            bool frustumCulling = simpleRenderSystem.getFrustumCulling();
+            if (ImGui::Checkbox("Frustum culling", &frustumCulling)) {
+                simpleRenderSystem.setFrustumCulling(frustumCulling);
+            }
+            ImGui::Checkbox("Scene BVH", &useSceneBVH);
+            const CullingStats& cullingStats = simpleRenderSystem.getCullingStats();
+            ImGui::Text("Meshes tested: %u, visible: %u (objects culled: %u, BVH nodes: %u)", cullingStats.testedMeshes,
+                cullingStats.visibleMeshes, cullingStats.culledObjects, cullingStats.nodesVisited);
+            if (ImGui::Button("Run BVH benchmark")) {
+                const XEFrustum frustum{camera.getProjection() * camera.getView()};
+                bvhBenchmarks.clear();
+                for (uint32_t tiles: {1u, 8u, 32u}) {
+                    bvhBenchmarks.push_back(XESceneBVH::benchmark(sceneBVH.getPrimitiveBounds(), tiles, frustum,
+                        viewerObject.transform.translation));
+                }
+            }
+            for (const auto& result: bvhBenchmarks) {
+                ImGui::Text("%u meshes: build %.2f ms, frustum q/s %.0f vs %.0f linear, rays/s %.0f vs %.0f linear",
+                    result.primitiveCount, result.buildMs, result.bvhFrustumQueriesPerSec,
+                    result.linearFrustumQueriesPerSec, result.bvhRaysPerSec, result.linearRaysPerSec);
+            }
+
+            // ------------------ Shadow pass -----------------------------
+            ImGui::Separator();
+            bool usePositionStreams = shadowSystem.getUsePositionStreams();
+            if (ImGui::Checkbox("Shadow pass: position-only stream", &usePositionStreams)) {
+                shadowSystem.setUsePositionStreams(usePositionStreams);
+            }
+            bool casterCulling = shadowSystem.getCasterCulling();
+            if (ImGui::Checkbox("Shadow caster culling", &casterCulling)) {
+                shadowSystem.setCasterCulling(casterCulling);
+            }
+            bool cascadeCaching = shadowSystem.getCaching();
+            if (ImGui::Checkbox("Cache shadow cascades (static layer, not with GPU culling)", &cascadeCaching)) {
+                shadowSystem.setCaching(cascadeCaching);
+            }
+            int cascadeIntervals[SHADOW_MAP_CASCADE_COUNT];
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                cascadeIntervals[cascade] = static_cast<int>(shadowSystem.getCascadeUpdateInterval(cascade));
+            }
+            if (ImGui::SliderInt4("Dynamic caster update interval", cascadeIntervals, 1, 16)) {
+                for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                    shadowSystem.setCascadeUpdateInterval(cascade, static_cast<uint32_t>(cascadeIntervals[cascade]));
+                }
+            }
+            if (ImGui::Button("Invalidate static shadow cache")) {
+                shadowSystem.invalidateStaticCache();
+            }
+            // Applied right away, the UI is built outside of the frame's recording
+            std::array<int, SHADOW_MAP_CASCADE_COUNT> cascadeResolutions = shadowSystem.getCascadeResolutions();
+            bool resolutionChanged = false;
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                static const int resolutionOptions[] = {512, 1024, 2048, 4096};
+                static const char* resolutionNames[] = {"512", "1024", "2048", "4096"};
+                int selected = 0;
+                for (int option = 0; option < 4; option++) {
+                    if (resolutionOptions[option] == cascadeResolutions[cascade]) {
+                        selected = option;
+                    }
+                }
+                ImGui::PushID(cascade);
+                ImGui::SetNextItemWidth(80.0f);
+                if (ImGui::Combo("##cascadeResolution", &selected, resolutionNames, 4)) {
+                    cascadeResolutions[cascade] = resolutionOptions[selected];
+                    resolutionChanged = true;
+                }
+                ImGui::PopID();
+                ImGui::SameLine();
+            }
+            ImGui::Text("Cascade resolutions");
+            if (resolutionChanged) {
+                try {
+                    shadowSystem.setCascadeResolutions(cascadeResolutions);
+                } catch (const std::runtime_error& e) {
+                    std::cerr << "[Shadow] " << e.what() << std::endl;
+                }
+            }
+            const ShadowMemoryFootprint shadowFootprint = shadowSystem.getMemoryFootprint();
+            ImGui::Text("Cascade atlas %ux%u: %.1f MB per frame, %.1f MB static cache",
+                shadowSystem.getAtlasExtent().width, shadowSystem.getAtlasExtent().height,
+                shadowFootprint.frameAtlasBytes / (1024.f * 1024.f) / XESwapChain::MAX_FRAMES_IN_FLIGHT,
+                shadowFootprint.staticAtlasBytes / (1024.f * 1024.f));
+            const auto& cascadeStats = shadowSystem.getCascadeCullingStats();
+            const auto& cascadeCacheStats = shadowSystem.getCascadeCacheStats();
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                const CascadeCacheStats& cache = cascadeCacheStats[cascade];
+                ImGui::Text("Cascade %d casters: %u / %u meshes, %s%s%s (%u dynamic)", cascade,
+                    cascadeStats[cascade].visibleMeshes, cascadeStats[cascade].testedMeshes,
+                    cache.rendered ? "rendered" : "cached", cache.staticRendered ? ", static rendered" : "",
+                    cache.refit ? ", refit" : "", cache.dynamicCasters);
+            }
+            if (shadowSystem.isSinglePassSupported()) {
+                bool singlePassShadows = shadowSystem.getSinglePass();
+                if (ImGui::Checkbox("Single pass cascades (multi-viewport)", &singlePassShadows)) {
+                    shadowSystem.setSinglePass(singlePassShadows);
+                }
+            } else {
+                ImGui::Text("Single pass cascades: not supported (multiViewport / shaderOutputViewportIndex)");
+            }
+            const ShadowPassStats& shadowPassStats = shadowSystem.getPassStats();
+            ImGui::Text("Shadow pass (%s): %u render passes, %u draw calls, %u instances",
+                shadowPassStats.singlePass ? "single" : "per cascade", shadowPassStats.renderPasses,
+                shadowPassStats.drawCalls, shadowPassStats.instances);
+            ImGui::Text("Shadow CPU record: per cascade %.3f ms / %.0f draws, single pass %.3f ms / %.0f draws",
+                shadowRecordMs[0], shadowDrawCalls[0], shadowRecordMs[1], shadowDrawCalls[1]);
+            if (shadowRecordMs[0] > 0.0f && shadowRecordMs[1] > 0.0f && shadowDrawCalls[0] > 0.0f) {
+                ImGui::Text("Single pass saves %.0f%% CPU time, %.0f%% draw calls",
+                    (1.0f - shadowRecordMs[1] / shadowRecordMs[0]) * 100.0f,
+                    (1.0f - shadowDrawCalls[1] / shadowDrawCalls[0]) * 100.0f);
+            }
+            ImGui::Text("Shadow pass GPU time: %.3f ms", shadowSystem.getLastPassTimeMs());
+
+            bool localShadows = localShadowSystem.isEnabled();
+            if (ImGui::Checkbox("Point/spot light shadows (atlas)", &localShadows)) {
+                localShadowSystem.setEnabled(localShadows);
+            }
+            bool localShadowCaching = localShadowSystem.getCaching();
+            if (ImGui::Checkbox("Cache unchanged shadow tiles", &localShadowCaching)) {
+                localShadowSystem.setCaching(localShadowCaching);
+            }
+            ImGui::SliderInt("Shadowed stress lights", &shadowedStressLights, 0,
+                static_cast<int>(MAX_SHADOWED_LOCAL_LIGHTS - pointLightHandles.size()));
+            const auto& localShadowStats = localShadowSystem.getStats();
+            ImGui::Text("Shadow atlas: %u lights, %u tiles (%.0f%% used), %u re-rendered, %u caster draws, %u not placed",
+                localShadowStats.shadowedLights, localShadowStats.tiles, localShadowStats.atlasUsage * 100.0f,
+                localShadowStats.renderedTiles, localShadowStats.casterDraws, localShadowStats.unallocatedLights);
+
+            // ------------------ Draw submission -------------------------
+            ImGui::Separator();
+            if (!drawManager.isSupported()) {
+                ImGui::Text("Indirect draws not supported on this device");
+            } else if (ImGui::Checkbox("Indirect draws (multi-draw indirect)", &indirectDraws)) {
+                simpleRenderSystem.setIndirectDraws(indirectDraws);
+                shadowSystem.setIndirectDraws(indirectDraws);
+            }
+            if (!gpuCulling.isSupported()) {
+                ImGui::Text("GPU culling not supported on this device");
+            } else {
+                ImGui::Checkbox("GPU culling (compute + draw indirect count)", &gpuCullingOn);
+                if (gpuCullingOn && ImGui::Button("Validate GPU culling against CPU")) {
+                    gpuCulling.requestValidation();
+                }
+                const GPUCullValidation& validation = gpuCulling.getLastValidation();
+                if (validation.done) {
+                    ImGui::Text("Last validation: %u mismatches (camera GPU %u / CPU %u)", validation.mismatches,
+                        validation.gpuVisible[0], validation.cpuVisible[0]);
+                }
+                if (gpuCullingOn) {
+                    ImGui::Checkbox("Hi-Z occlusion culling (two-phase)", &occlusionCulling);
+                    if (occlusionCulling) {
+                        const GPUOcclusionStats& occlusionStats = gpuCulling.getOcclusionStats();
+                        ImGui::Text("Camera draws: early %u, late %u, occluded %u (pyramid %ux%u, %u levels)",
+                            occlusionStats.earlyDraws, occlusionStats.lateDraws, occlusionStats.occluded,
+                            depthPyramid.getWidth(), depthPyramid.getHeight(), depthPyramid.getLevelCount());
+                    }
+                }
+            }
+            ImGui::Text("CPU recording, main + shadow: per-mesh %.3f ms, indirect %.3f ms, GPU culled %.3f ms (%u draws)",
+                recordTimeMs[0], recordTimeMs[1], recordTimeMs[2], drawManager.getDrawCount());
+
             // ------------------ VMA statistics --------------------------
             ImGui::Separator();
             ImGui::Text("Memory Details");
+            vmaGetHeapBudgets(xe_device.vmaAllocator(), budgets);
             for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
                 if (memoryProperties.memoryHeaps[i].flags && VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
                     const auto& budget = budgets[i];
@@ -215,6 +584,8 @@ namespace xe {
 
             if (auto commandBuffer = xe_renderer.beginFrame()) {
                 int frameIndex = xe_renderer.getFrameIndex();
+                // Textures decoded since the last frame, then this frame's texture set if a slot changed
+                textureManager.update(frameIndex);
                 FrameInfo frameInfo{
                     frameIndex,
                     frameTime,
@@ -222,8 +593,18 @@ namespace xe {
                     camera,
                     globalDescriptorSets[frameIndex],
                     lightManager.descriptorSet(frameIndex),
-                    gameObjects
+                    gameObjects,
+                    useSceneBVH ? &sceneBVH : nullptr
                 };
+                frameInfo.viewportHeight = static_cast<float>(xe_renderer.getSwapChainExtent().height);
+
+                // Picks up transforms changed since the last frame
+                sceneBVH.update(gameObjects);
+                // Before beginFrame, the validation reads the draw data the last cull of this slot saw
+                gpuCulling.readResults(frameIndex);
+                if (indirectDraws || gpuCullingOn) {
+                    drawManager.beginFrame(frameIndex, gameObjects);
+                }
 
                 // Update
                 GlobalUbo ubo{};
@@ -255,18 +636,105 @@ namespace xe {
                 pointLights[0].color.z = lightColor[2];
 
                 // Frame light settings
-                lightManager.clear();
-                lightManager.addLight(sunLight);
-                for (auto& pl : pointLights) lightManager.addLight(pl);
+                lightManager.updateLight(sunHandle, sunLight);
+                for (size_t i = 0; i < pointLights.size(); i++) {
+                    lightManager.updateLight(pointLightHandles[i], pointLights[i]);
+                }
+                // The stress layout only depends on the count, so growing keeps the existing lights
+                const size_t stressCount = static_cast<size_t>(stressLightCount);
+                if (stressLightHandles.size() < stressCount) {
+                    const std::vector<GPULight> stressLights = createStressLights(static_cast<uint32_t>(stressCount));
+                    for (size_t i = stressLightHandles.size(); i < stressCount; i++) {
+                        stressLightHandles.push_back(lightManager.createLight(stressLights[i]));
+                    }
+                }
+                while (stressLightHandles.size() > stressCount) {
+                    localShadowSystem.setShadowed(stressLightHandles.back(), false);
+                    lightManager.destroyLight(stressLightHandles.back());
+                    stressLightHandles.pop_back();
+                }
+                for (size_t i = 0; i < stressLightHandles.size(); i++) {
+                    localShadowSystem.setShadowed(stressLightHandles[i], i < static_cast<size_t>(shadowedStressLights));
+                }
                 lightManager.upload(frameIndex);
+                localShadowSystem.update(frameInfo);
+
+                lightClusterSystem.setEnabled(clusteredLighting);
+                lightClusterSystem.assignLights(commandBuffer, frameIndex, camera.getProjection(), camera.getView(),
+                    camera.getNearClip(), camera.getFarClip(), xe_renderer.getSwapChainExtent());
+
+                shadowSystem.updateCascades(frameInfo, sunLight);
+
+                const bool occlusion = gpuCullingOn && occlusionCulling;
+                if (gpuCullingOn) {
+                    // Same views as the CPU paths, a disabled toggle keeps every plane off
+                    XEFrustum cameraFrustum{camera.getProjection() * camera.getView()};
+                    if (!simpleRenderSystem.getFrustumCulling()) {
+                        for (int plane = 0; plane < XEFrustum::PlaneCount; plane++) {
+                            cameraFrustum.disablePlane(static_cast<XEFrustum::Plane>(plane));
+                        }
+                    }
+                    gpuCulling.setView(0, cameraFrustum, false);
+
+                    for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                        XEFrustum cascadeFrustum = shadowSystem.getCascadeFrustum(cascade);
+                        if (!shadowSystem.getCasterCulling()) {
+                            for (int plane = 0; plane < XEFrustum::PlaneCount; plane++) {
+                                cascadeFrustum.disablePlane(static_cast<XEFrustum::Plane>(plane));
+                            }
+                        }
+                        gpuCulling.setView(1 + cascade, cascadeFrustum, true);
+                    }
+
+                    gpuCulling.setOcclusion(occlusion, camera.getProjection() * camera.getView());
+
+                    // The cull set binds the pyramid, so it has to be recreated before the cull is recorded
+                    depthPyramid.resize(xe_renderer.getSwapChainExtent());
+                    gpuCulling.cull(commandBuffer, frameIndex);
+                    frameInfo.gpuCulling = &gpuCulling;
+                }
 
                 // Shadow Pass
-                shadowSystem.renderGameObjects(frameInfo, sunLight);
+                shadowSystem.renderGameObjects(frameInfo);
+                {
+                    const ShadowPassStats& passStats = shadowSystem.getPassStats();
+                    const int mode = passStats.singlePass ? 1 : 0;
+                    float& shadowMs = shadowRecordMs[mode];
+                    float& draws = shadowDrawCalls[mode];
+                    const float recordMs = shadowSystem.getLastRecordTimeMs();
+                    shadowMs = shadowMs == 0.0f ? recordMs : shadowMs * 0.95f + recordMs * 0.05f;
+                    draws = draws == 0.0f ? passStats.drawCalls : draws * 0.95f + passStats.drawCalls * 0.05f;
+                }
+                localShadowSystem.render(frameInfo);
 
                 // Render items
-                xe_renderer.beginSwapChainRenderPass(commandBuffer);
-                simpleRenderSystem.renderGameObjects(frameInfo,
-                    shadowSystem.getDescriptorSet(frameIndex));
+                if (occlusion) {
+                    // Draws visible last frame, then the pyramid of their depth decides what else is visible
+                    xe_renderer.beginSwapChainRenderPass(commandBuffer, SwapChainPass::Early);
+                    simpleRenderSystem.renderGameObjects(frameInfo,
+                        shadowSystem.getDescriptorSet(frameIndex), localShadowSystem.getDescriptorSet(frameIndex));
+                    xe_renderer.endSwapChainRenderPass(commandBuffer);
+
+                    depthPyramid.build(commandBuffer, frameIndex, xe_renderer.getCurrentDepthImageView(),
+                        xe_renderer.getSwapChainExtent());
+                    gpuCulling.cullLate(commandBuffer, frameIndex);
+
+                    xe_renderer.beginSwapChainRenderPass(commandBuffer, SwapChainPass::Late);
+                    simpleRenderSystem.renderGameObjects(frameInfo,
+                        shadowSystem.getDescriptorSet(frameIndex), localShadowSystem.getDescriptorSet(frameIndex),
+                        gpuCulling.getLateView());
+                } else {
+                    xe_renderer.beginSwapChainRenderPass(commandBuffer);
+                    simpleRenderSystem.renderGameObjects(frameInfo,
+                        shadowSystem.getDescriptorSet(frameIndex), localShadowSystem.getDescriptorSet(frameIndex));
+                }
+
+                float frameRecordMs = simpleRenderSystem.getLastRecordTimeMs() + shadowSystem.getLastRecordTimeMs();
+                if (indirectDraws || gpuCullingOn) {
+                    frameRecordMs += drawManager.getLastBuildTimeMs();
+                }
+                float& average = recordTimeMs[gpuCullingOn ? 2 : (indirectDraws ? 1 : 0)];
+                average = average == 0.0f ? frameRecordMs : average * 0.95f + frameRecordMs * 0.05f;
                 pointLightSystem.render(frameInfo, pointLights.size());
                 // ImGui draw
                 ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
@@ -282,12 +750,18 @@ namespace xe {
         // std::shared_ptr<XEModel> xe_model = XEModel::createModelFromFile(xe_device, materialManager,
         //     "assets\\niagara_bistro\\bistrox.gltf");
 
+        // Returns once the meshes are in, the textures keep decoding on the texture manager's pool
+        auto modelStart = std::chrono::high_resolution_clock::now();
         std::shared_ptr<XEModel> xe_model = XEModel::createModelFromFile(xe_device, materialManager,
             "assets\\sponza-gltf-pbr\\sponza.glb");
+        std::cout << "[Model] Sponza ready in " << std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - modelStart).count() << " ms, "
+            << textureManager.getStreamingStats().pending << " textures streaming" << std::endl;
 
         auto gameObj1 = XEGameObject::createGameObject();
         gameObj1.model = xe_model;
         gameObj1.canCastShadow = true;
+        gameObj1.isStatic = true;
         gameObj1.transform.translation = {0.0f, 0.0f, 0.0f};
         gameObj1.transform.rotation = {0.0f, 0.0f, 0.0f};
         gameObj1.transform.scale = {1.0f, 1.0f, 1.0f};
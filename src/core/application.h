@@ -8,6 +8,7 @@
 #include "renderer/xe_device.h"
 #include "renderer/xe_renderer.h"
 #include "scene/xe_game_object.h"
+#include "scene/xe_scene_bvh.h"
 #include "renderer/xe_descriptors.h"
 #include "renderer/gfx_resource_managers/xe_texture_manager.h"
 #include "renderer/gfx_resource_managers/xe_material_manager.h"
@@ -38,11 +39,12 @@ namespace xe {
         XERenderer xe_renderer{xe_window, xe_device};
         std::unique_ptr<XEDescriptorPool> globalPool{};
         XEGameObject::Map gameObjects;
+        XESceneBVH sceneBVH;
 
         //ImGui specific descriptor pool
         VkDescriptorPool imGuiDescriptorPool;
 
-        XETextureManager textureManager{xe_device, 1000};
+        XETextureManager textureManager{xe_device, 1000, XESwapChain::MAX_FRAMES_IN_FLIGHT};
         XEMaterialManager materialManager{textureManager};
     };
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/gfx_resource_managers/xe_draw_manager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+
+namespace xe {
+    XEDrawManager::XEDrawManager(XEDevice &device, XEMaterialManager &materialManager, uint32_t framesInFlight,
+        uint32_t viewCount, uint32_t initialCapacity): device(device), materialManager(materialManager),
+        viewCount(viewCount) {
+
+        supported = device.enabledFeatures.drawIndirectFirstInstance == VK_TRUE;
+        multiDraw = device.enabledFeatures.multiDrawIndirect == VK_TRUE;
+        if (!supported) {
+            std::cout << "[DrawManager] drawIndirectFirstInstance not supported, indirect drawing disabled" << std::endl;
+        }
+
+        drawDataPool = XEDescriptorPool::Builder(device)
+        .setMaxSets(framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight)
+        .build();
+
+        drawDataSetLayout = XEDescriptorSetLayout::Builder(device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .build();
+
+        perFrame.resize(framesInFlight);
+        drawDataDescriptorSets.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            createBuffers(perFrame[i], std::max(64u, initialCapacity));
+            writeDescriptorSet(i, false);
+        }
+    }
+
+    XEDrawManager::~XEDrawManager() {}
+
+    void XEDrawManager::createBuffers(PerFrame &frame, uint32_t capacityDraws) {
+        frame.capacity = capacityDraws;
+
+        frame.drawDataBuffer = std::make_unique<XEBuffer>(
+            device,
+            sizeof(GPUDrawData),
+            capacityDraws,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        frame.indirectBuffer = std::make_unique<XEBuffer>(
+            device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            capacityDraws * viewCount,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        VkResult result = frame.drawDataBuffer->map();
+        assert(result == VK_SUCCESS && "Failed to map draw data buffer");
+        result = frame.indirectBuffer->map();
+        assert(result == VK_SUCCESS && "Failed to map indirect buffer");
+    }
+
+    void XEDrawManager::writeDescriptorSet(uint32_t frameIndex, bool overwrite) {
+        auto bufferInfo = perFrame[frameIndex].drawDataBuffer->descriptorInfo();
+        XEDescriptorWriter writer{*drawDataSetLayout, *drawDataPool};
+        writer.writeBuffer(0, &bufferInfo);
+        if (overwrite) {
+            writer.overwrite(drawDataDescriptorSets[frameIndex]);
+        } else {
+            writer.build(drawDataDescriptorSets[frameIndex]);
+        }
+    }
+
+    void XEDrawManager::beginFrame(uint32_t frameIndex, XEGameObject::Map &gameObjects) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        objectDraws.clear();
+        objectBatches.clear();
+        drawCount = 0;
+        for (auto& kv: gameObjects) {
+            auto& obj = kv.second;
+            if (!obj.model) {
+                continue;
+            }
+            const uint32_t meshCount = static_cast<uint32_t>(obj.model->getMeshes().size());
+            objectDraws[obj.getId()] = {obj.model.get(), drawCount, static_cast<uint32_t>(objectBatches.size())};
+            objectBatches.push_back({obj.model.get(), drawCount, meshCount, obj.canCastShadow});
+            drawCount += meshCount;
+        }
+
+        // The fence of this frame slot was waited on, so its buffers are free to be replaced
+        PerFrame& frame = perFrame[frameIndex];
+        if (drawCount > frame.capacity) {
+            createBuffers(frame, std::max(drawCount, frame.capacity + frame.capacity / 2));
+            writeDescriptorSet(frameIndex, true);
+        }
+
+        auto* drawData = static_cast<GPUDrawData*>(frame.drawDataBuffer->getMappedMemory());
+        for (auto& kv: gameObjects) {
+            auto& obj = kv.second;
+            if (!obj.model) {
+                continue;
+            }
+
+            const glm::mat4 modelMatrix = obj.transform.mat4();
+            const ObjectDraws& draws = objectDraws[obj.getId()];
+            const bool indexed = obj.model->isIndexed();
+            const uint32_t cullFlags = (obj.canCastShadow ? DRAW_CULL_CASTS_SHADOW : 0u) |
+                (indexed ? 0u : DRAW_CULL_NOT_INDEXED);
+
+            GPUDrawData* out = drawData + draws.firstDraw;
+            for (const auto& mesh: obj.model->getMeshes()) {
+                const XEMaterial& material = materialManager.getMaterial(mesh.materialIndex);
+
+                GPUDrawData data{};
+                data.modelMatrix = modelMatrix;
+                data.quantOffset = glm::vec4(mesh.quantOffset, 0.f);
+                data.quantScale = glm::vec4(mesh.quantScale, 0.f);
+                data.textureIndex = material.albedoIndex;
+                data.normalIndex = material.normalIndex;
+                data.boundsMin = glm::vec4(mesh.bounds.minX, mesh.bounds.minY, mesh.bounds.minZ, 1.f);
+                data.boundsMax = glm::vec4(mesh.bounds.maxX, mesh.bounds.maxY, mesh.bounds.maxZ, 1.f);
+                data.indexCount = indexed ? mesh.indexCount : mesh.vertexCount;
+                data.firstIndex = indexed ? mesh.firstIndex : 0;
+                data.vertexOffset = mesh.vertexOffset;
+                data.batchFirstDraw = draws.firstDraw;
+                data.batchIndex = draws.batchIndex;
+                data.cullFlags = cullFlags;
+                *out++ = data;
+            }
+        }
+
+        lastBuildTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    const std::vector<DrawBatch>& XEDrawManager::writeView(uint32_t frameIndex, uint32_t view,
+        const std::vector<BVHItem> &items) {
+        batches.clear();
+
+        PerFrame& frame = perFrame[frameIndex];
+        const uint32_t regionStart = view * frame.capacity;
+        auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectBuffer->getMappedMemory()) +
+            regionStart;
+
+        uint32_t commandCount = 0;
+        XEGameObject::id_t currentId = ~0u;
+        const ObjectDraws* current = nullptr;
+
+        for (const auto& item: items) {
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = objectDraws.find(item.objectId);
+                current = it != objectDraws.end() ? &it->second : nullptr;
+
+                // Objects sharing a model keep extending the same batch
+                if (current && (batches.empty() || batches.back().model != current->model)) {
+                    batches.push_back({current->model, regionStart + commandCount, 0});
+                }
+            }
+            if (!current || commandCount >= frame.capacity) {
+                continue;
+            }
+
+            const auto& mesh = current->model->getMeshes()[item.meshIndex];
+            VkDrawIndexedIndirectCommand& command = commands[commandCount++];
+            if (current->model->isIndexed()) {
+                command.indexCount = mesh.indexCount;
+                command.firstIndex = mesh.firstIndex;
+            } else {
+                // drawBatch issues these as vkCmdDraw(indexCount, 1, vertexOffset, firstInstance)
+                command.indexCount = mesh.vertexCount;
+                command.firstIndex = 0;
+            }
+            command.instanceCount = 1;
+            command.vertexOffset = static_cast<int32_t>(mesh.vertexOffset);
+            command.firstInstance = current->firstDraw + item.meshIndex;
+            batches.back().commandCount++;
+        }
+        return batches;
+    }
+
+    void XEDrawManager::drawBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, const DrawBatch &batch) const {
+        const PerFrame& frame = perFrame[frameIndex];
+        constexpr VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+
+        if (!batch.model->isIndexed()) {
+            const auto* commands = static_cast<const VkDrawIndexedIndirectCommand*>(frame.indirectBuffer->getMappedMemory());
+            for (uint32_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++) {
+                vkCmdDraw(commandBuffer, commands[i].indexCount, 1, static_cast<uint32_t>(commands[i].vertexOffset),
+                    commands[i].firstInstance);
+            }
+            return;
+        }
+
+        if (multiDraw) {
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.indirectBuffer->getBuffer(), batch.firstCommand * stride,
+                batch.commandCount, stride);
+        } else {
+            for (uint32_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++) {
+                vkCmdDrawIndexedIndirect(commandBuffer, frame.indirectBuffer->getBuffer(), i * stride, 1, stride);
+            }
+        }
+    }
+}
@@ -0,0 +1,134 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_device.h"
+#include "renderer/xe_buffer.h"
+#include "renderer/xe_descriptors.h"
+#include "renderer/xe_model.h"
+#include "renderer/gfx_resource_managers/xe_material_manager.h"
+#include "scene/xe_game_object.h"
+#include "scene/xe_scene_bvh.h"
+#include "vulkan/vulkan.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xe {
+
+    // GPUDrawData::cullFlags
+    enum DrawCullFlags : uint32_t {
+        DRAW_CULL_CASTS_SHADOW = 1u << 0,
+        DRAW_CULL_NOT_INDEXED  = 1u << 1,
+    };
+
+    // std430 layout of DrawData in simple_shader.vert / shadow_shader.vert / cull.comp
+    struct alignas(16) GPUDrawData {
+        glm::mat4 modelMatrix{1.f};
+        glm::vec4 quantOffset{0.f};
+        glm::vec4 quantScale{1.f};
+        int32_t textureIndex{0};
+        int32_t normalIndex{0};
+        int32_t pad1{0}, pad2{0};
+
+        // Read by the GPU culling pass only
+        glm::vec4 boundsMin{0.f};       // local space mesh bounds
+        glm::vec4 boundsMax{0.f};
+        uint32_t indexCount{0};         // vertexCount for non-indexed models
+        uint32_t firstIndex{0};
+        int32_t vertexOffset{0};
+        uint32_t batchFirstDraw{0};     // first draw of the object, start of its compacted command range
+        uint32_t batchIndex{0};
+        uint32_t cullFlags{0};          // DrawCullFlags
+        uint32_t pad3{0}, pad4{0};
+    };
+    static_assert(sizeof(GPUDrawData) == 176, "must match the std430 DrawData struct");
+
+    // Consecutive indirect commands that share a model's vertex and index buffers
+    struct DrawBatch {
+        XEModel* model;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    // All meshes of one object, in draw data order. The GPU culling pass compacts the visible ones of each
+    // view into [firstDraw, firstDraw + drawCount) of that view's command region.
+    struct ObjectBatch {
+        XEModel* model;
+        uint32_t firstDraw;
+        uint32_t drawCount;
+        bool castsShadow;
+    };
+
+    // Per-frame draw data (one GPUDrawData per mesh of the scene) and indirect commands for every view.
+    // The draw data is written once per frame and shared by all views, each view (camera, shadow cascades)
+    // owns a region of the indirect buffer that holds the commands of its visible meshes. A command's
+    // firstInstance is the draw data index, so shaders read their draw through gl_InstanceIndex.
+    class XEDrawManager {
+    public:
+        XEDrawManager(XEDevice& device, XEMaterialManager& materialManager, uint32_t framesInFlight,
+            uint32_t viewCount, uint32_t initialCapacity);
+        ~XEDrawManager();
+
+        XEDrawManager(const XEDrawManager&) = delete;
+        XEDrawManager& operator=(const XEDrawManager&) = delete;
+
+        // Needs drawIndirectFirstInstance, without multiDrawIndirect every command is its own draw call
+        bool isSupported() const { return supported; }
+
+        // Call once per frame after the frame fence wait, before recording any view
+        void beginFrame(uint32_t frameIndex, XEGameObject::Map& gameObjects);
+
+        // Writes the commands of a view. Items must be grouped by object (sorted by objectId).
+        const std::vector<DrawBatch>& writeView(uint32_t frameIndex, uint32_t view, const std::vector<BVHItem>& items);
+
+        void drawBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, const DrawBatch& batch) const;
+
+        VkDescriptorSet descriptorSet(uint32_t frameIndex) const { return drawDataDescriptorSets[frameIndex]; }
+        VkDescriptorSetLayout getDescriptorLayout() const { return drawDataSetLayout->getDescriptorSetLayout(); }
+
+        // Every object written by the last beginFrame, indexed by GPUDrawData::batchIndex
+        const std::vector<ObjectBatch>& getObjectBatches() const { return objectBatches; }
+        XEBuffer& getDrawDataBuffer(uint32_t frameIndex) const { return *perFrame[frameIndex].drawDataBuffer; }
+        uint32_t getCapacity(uint32_t frameIndex) const { return perFrame[frameIndex].capacity; }
+
+        uint32_t getDrawCount() const { return drawCount; }
+        float getLastBuildTimeMs() const { return lastBuildTimeMs; }
+
+    private:
+        struct PerFrame {
+            std::unique_ptr<XEBuffer> drawDataBuffer;
+            std::unique_ptr<XEBuffer> indirectBuffer;   // viewCount regions of `capacity` commands
+            uint32_t capacity{0};
+        };
+
+        struct ObjectDraws {
+            XEModel* model;
+            uint32_t firstDraw;
+            uint32_t batchIndex;
+        };
+
+        void createBuffers(PerFrame& frame, uint32_t capacityDraws);
+        void writeDescriptorSet(uint32_t frameIndex, bool overwrite);
+
+        XEDevice& device;
+        XEMaterialManager& materialManager;
+        uint32_t viewCount;
+        bool supported{false};
+        bool multiDraw{false};
+
+        std::vector<PerFrame> perFrame;
+        std::unordered_map<XEGameObject::id_t, ObjectDraws> objectDraws;
+        std::vector<ObjectBatch> objectBatches;
+        std::vector<DrawBatch> batches;
+        uint32_t drawCount{0};
+        float lastBuildTimeMs{0.0f};
+
+        std::unique_ptr<XEDescriptorPool> drawDataPool{};
+        std::unique_ptr<XEDescriptorSetLayout> drawDataSetLayout{};
+        std::vector<VkDescriptorSet> drawDataDescriptorSets{};
+    };
+}
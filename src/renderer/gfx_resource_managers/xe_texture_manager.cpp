@@ -4,22 +4,38 @@
 
 #include "renderer/gfx_resource_managers/xe_texture_manager.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <__msvc_ostream.hpp>
 
 namespace xe {
-    XETextureManager::XETextureManager(XEDevice &device, uint32_t maxTextures): device(device), maxTextures(maxTextures) {
+    XETextureManager::XETextureManager(XEDevice &device, uint32_t maxTextures, uint32_t framesInFlight,
+        uint32_t decodeThreads): device(device), maxTextures(maxTextures) {
         texturePool = XEDescriptorPool::Builder(device)
-        .setMaxSets(1)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures)
+        .setMaxSets(framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures * framesInFlight)
         .build();
 
         textureSetLayout = XEDescriptorSetLayout::Builder(device)
         .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, maxTextures)
         .build();
 
-        XEDescriptorWriter(*textureSetLayout, *texturePool)
-        .build(textureDescriptorSet);
+        textureDescriptorSets.resize(framesInFlight);
+        uploadedVersions.resize(framesInFlight, 0);
+        for (auto& set: textureDescriptorSets) {
+            XEDescriptorWriter(*textureSetLayout, *texturePool)
+            .build(set);
+        }
+
+        decodePool = std::make_unique<XEThreadPool>(decodeThreads);
+        stats.decodeThreads = decodePool->threadCount();
+
+        compressionSupported = device.enabledFeatures.textureCompressionBC == VK_TRUE;
+        useCookedTextures = compressionSupported;
+        if (!compressionSupported) {
+            std::cout << "[Texture] BC formats not supported, cooked textures disabled" << std::endl;
+        }
 
         createDefaultAlbedoTexture();
         createDefaultNormalTexture();
@@ -28,13 +44,87 @@ namespace xe {
 
     XETextureManager::~XETextureManager() { }
 
+    VkFormat XETextureManager::formatFor(TextureSemantic semantic) {
+        if (semantic == TextureSemantic::BaseColor) { return VK_FORMAT_R8G8B8A8_SRGB; }
+        if (semantic == TextureSemantic::Normal) { return VK_FORMAT_R8G8B8A8_UNORM; }
+        std::cerr << "Unknown semantic" << std::endl;
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    bool XETextureManager::cookedFormatFor(TextureSemantic semantic, XETextureCache::Format &format) {
+        if (semantic == TextureSemantic::BaseColor) { format = XETextureCache::Format::BC7_SRGB; return true; }
+        if (semantic == TextureSemantic::Normal) { format = XETextureCache::Format::BC5_UNORM; return true; }
+        return false;
+    }
+
+    MipFilter XETextureManager::mipFilterFor(TextureSemantic semantic) {
+        if (semantic == TextureSemantic::BaseColor) { return MipFilter::SRGB; }
+        if (semantic == TextureSemantic::Normal) { return MipFilter::Normal; }
+        return MipFilter::Linear;
+    }
+
+    void XETextureManager::loadImage(const std::string &path, TextureSemantic semantic, bool useCooked,
+        bool cookMissing, StreamedImage &image) {
+        XETextureCache::Format cookedFormat{};
+        XETextureCache::Key key{};
+        if (useCooked && cookedFormatFor(semantic, cookedFormat) &&
+            XETextureCache::computeKey(path, cookedFormat, key)) {
+            const std::string cachePath = XETextureCache::cachePathFor(path, cookedFormat);
+            auto cooked = std::make_unique<XETextureCache>();
+            if (cooked->open(cachePath, key)) {
+                image.cooked = std::move(cooked);
+                return;
+            }
+            // Already on a worker, the block rows are not split any further
+            if (cookMissing && XETextureCache::cook(path, key, cachePath) && cooked->open(cachePath, key)) {
+                image.cooked = std::move(cooked);
+                image.cookedOnLoad = true;
+                return;
+            }
+        }
+
+        const XETexture::DecodedImage decoded = XETexture::decode(path);
+        image.mips = buildMipChain(decoded.pixels.get(), static_cast<uint32_t>(decoded.width),
+            static_cast<uint32_t>(decoded.height), mipFilterFor(semantic));
+    }
+
+    std::shared_ptr<XETexture> XETextureManager::createTexture(StreamedImage &image, VkFormat format,
+        uint32_t firstMip) {
+        if (image.cooked) {
+            return std::make_shared<XETexture>(*image.cooked, device, firstMip);
+        }
+        return std::make_shared<XETexture>(image.mips, device, format, firstMip);
+    }
+
+    uint32_t XETextureManager::tailMipOf(const StreamedImage &image) {
+        const uint32_t mipCount = image.cooked
+            ? image.cooked->mipCount()
+            : static_cast<uint32_t>(image.mips.levels.size());
+        for (uint32_t mip = 0; mip < mipCount; mip++) {
+            const uint32_t width = image.cooked ? image.cooked->level(mip).width : image.mips.levels[mip].width;
+            const uint32_t height = image.cooked ? image.cooked->level(mip).height : image.mips.levels[mip].height;
+            if (std::max(width, height) <= TAIL_EXTENT) {
+                return mip;
+            }
+        }
+        return mipCount - 1;
+    }
+
+    uint64_t XETextureManager::bytesOf(const StreamedImage &image, uint32_t firstMip) {
+        if (image.cooked) {
+            return image.cooked->dataSize() - image.cooked->level(firstMip).offset;
+        }
+        return image.mips.rgba.size() - image.mips.levels[firstMip].offset;
+    }
+
     void XETextureManager::createDefaultAlbedoTexture() {
         const std::string path = "assets\\models\\checkerboard\\tiles_0059_color_1k.jpg";
         std::string key = path;
         std::replace(key.begin(), key.end(), '\\', '/');
 
-        defaultAlbedoTexture = std::make_shared<XETexture>(key, device, VK_FORMAT_R8G8B8A8_SRGB);
+        defaultAlbedoTexture = std::make_shared<XETexture>(key, device, VK_FORMAT_R8G8B8A8_SRGB, MipFilter::SRGB);
         textures.push_back(defaultAlbedoTexture);
+        slots.push_back(TextureSlot{key, TextureSemantic::BaseColor});
         defaultAlbedoTextureIndex = static_cast<int>(textures.size()) - 1;
 
         texturesIndexMap[key] = defaultAlbedoTextureIndex;
@@ -45,8 +135,9 @@ namespace xe {
         std::string key = path;
         std::replace(key.begin(), key.end(), '\\', '/');
 
-        defaultNormalTexture = std::make_shared<XETexture>(key, device, VK_FORMAT_R8G8B8A8_UNORM);
+        defaultNormalTexture = std::make_shared<XETexture>(key, device, VK_FORMAT_R8G8B8A8_UNORM, MipFilter::Normal);
         textures.push_back(defaultNormalTexture);
+        slots.push_back(TextureSlot{key, TextureSemantic::Normal});
         defaultNormalTextureIndex = static_cast<int>(textures.size()) - 1;
 
         texturesIndexMap[key] = defaultNormalTextureIndex;
@@ -62,7 +153,10 @@ namespace xe {
         imageInfos[defaultAlbedoTextureIndex] = defaultAlbedoTexture->getImageInfo();
         imageInfos[defaultNormalTextureIndex] = defaultNormalTexture->getImageInfo();
 
-        updateDescriptorSet();
+        // Nothing is in flight yet
+        for (int frameIndex = 0; frameIndex < static_cast<int>(textureDescriptorSets.size()); frameIndex++) {
+            updateDescriptorSet(frameIndex);
+        }
     }
 
     int XETextureManager::getOrLoadTexture(const std::string &path, TextureSemantic semantic) {
@@ -71,29 +165,389 @@ namespace xe {
         std::replace(key.begin(), key.end(), '\\', '/');
         auto it = texturesIndexMap.find(key);
         if (it != texturesIndexMap.end()) {
-            return it->second; // Texture has already been loaded
+            return it->second; // Texture has already been requested
         }
 
-        VkFormat imgFormat{};
+        if (textures.size() >= maxTextures) {
+            throw std::runtime_error("Texture array is full");
+        }
 
-        if (semantic == TextureSemantic::BaseColor) { imgFormat = VK_FORMAT_R8G8B8A8_SRGB; }
-        else if (semantic == TextureSemantic::Normal) { imgFormat = VK_FORMAT_R8G8B8A8_UNORM; }
-        else { std::cerr << "Unknown semantic" << std::endl; }
+        // The slot holds the default of its semantic until the upload
+        int index = static_cast<int>(textures.size());
+        textures.push_back(nullptr);
+        TextureSlot slot{key, semantic, Residency::Pending};
+        slot.lastUsedFrame = frameNumber;
+        slots.push_back(std::move(slot));
+        texturesIndexMap[key] = index;
+        imageInfos[index] = semantic == TextureSemantic::Normal
+            ? defaultNormalTexture->getImageInfo()
+            : defaultAlbedoTexture->getImageInfo();
+        imageInfoVersion++;
 
-        auto tex = std::make_shared<XETexture>(key, device, imgFormat);
-        textures.push_back(tex);
+        if (!settling) {
+            settling = true;
+            settleStart = std::chrono::high_resolution_clock::now();
+        }
+        requestLoad(index, false);
+        streamedPaths.push_back(key);
+        streamedSemantics.push_back(semantic);
+        return index;
+    }
 
-        int index = static_cast<int>(textures.size()) - 1;
-        texturesIndexMap[key] = index;
+    void XETextureManager::requestLoad(int index, bool reload) {
+        const TextureSlot& slot = slots[index];
+        // Reloads neither start nor end a batch, so they do not show up in its timing
+        if (!reload) {
+            if (batchPending == 0) {
+                batchStart = std::chrono::high_resolution_clock::now();
+                batchTextures = 0;
+            }
+            batchTextures++;
+            batchPending++;
+        }
+
+        PendingLoad load{};
+        load.index = index;
+        load.reload = reload;
+        load.format = formatFor(slot.semantic);
+        load.image = std::make_shared<StreamedImage>();
+        load.decoded = decodePool->submit([image = load.image, key = slot.path, semantic = slot.semantic,
+            useCooked = useCookedTextures, cookMissing = cookMissingTextures] {
+            loadImage(key, semantic, useCooked, cookMissing, *image);
+        });
+        pendingLoads.push_back(std::move(load));
+        stats.pending = static_cast<uint32_t>(pendingLoads.size());
+    }
+
+    void XETextureManager::markUsed(int index, float screenExtent) {
+        if (index < 0 || static_cast<size_t>(index) >= slots.size()) {
+            return;
+        }
+
+        TextureSlot& slot = slots[index];
+        // Unknown size (not uploaded yet, or no estimate) asks for everything
+        uint32_t mip = 0;
+        if (mipStreaming && slot.extent > 0 && screenExtent > 0.0f) {
+            const float lod = std::floor(std::log2(static_cast<float>(slot.extent) / screenExtent)) + mipBias;
+            mip = static_cast<uint32_t>(std::clamp(lod, 0.0f, static_cast<float>(slot.tailMip)));
+        }
+
+        // The finest mip any draw of the frame asks for
+        slot.wantedMip = slot.lastUsedFrame == frameNumber ? std::min(slot.wantedMip, mip) : mip;
+        slot.lastUsedFrame = frameNumber;
+    }
+
+    void XETextureManager::uploadPending(PendingLoad &load) {
+        // Rethrows a failed decode here, on the render thread
+        load.decoded.get();
+
+        TextureSlot& slot = slots[load.index];
+        slot.loading = false;
+        if (slot.residency != Residency::Pending) {
+            // Reloaded for the streamer, what is bound stays until it promotes the slot
+            slot.source = std::move(load.image);
+            return;
+        }
+
+        StreamedImage& image = *load.image;
+        if (image.cooked) {
+            stats.cookedLoads++;
+            stats.cookedOnLoad += image.cookedOnLoad ? 1 : 0;
+            slot.extent = std::max(image.cooked->width(), image.cooked->height());
+        } else {
+            stats.rawLoads++;
+            slot.extent = std::max(image.mips.levels[0].width, image.mips.levels[0].height);
+        }
+
+        // Built once from the same mips, the slot starts on it with mip streaming and falls back to it when evicted
+        slot.tailMip = tailMipOf(image);
+        if (slot.tailMip > 0) {
+            slot.tail = createTexture(image, load.format, slot.tailMip);
+            slot.tailBytes = bytesOf(image, slot.tailMip);
+            stats.residentBytes += slot.tailBytes;
+        }
+
+        if (mipStreaming && slot.tail) {
+            slot.residentMip = slot.tailMip;
+            slot.source = std::move(load.image);
+            imageInfos[load.index] = slot.tail->getImageInfo();
+        } else {
+            auto tex = createTexture(image, load.format, 0);
+            slot.residentMip = 0;
+            slot.bytes = bytesOf(image, 0);
+            stats.residentBytes += slot.bytes;
+            textures[load.index] = tex;
+            imageInfos[load.index] = tex->getImageInfo();
+            load.image.reset();
+        }
+
+        slot.residency = Residency::Resident;
+        imageInfoVersion++;
+        stats.resident++;
+    }
+
+    void XETextureManager::streamMips() {
+        stats.lastFrameMipUploads = 0;
+        stats.lastFrameMipBytes = 0;
+        stats.mipsOutstanding = 0;
+
+        std::vector<int> candidates;
+        for (size_t i = 0; i < slots.size(); i++) {
+            TextureSlot& slot = slots[i];
+            if (slot.residency != Residency::Resident && slot.residency != Residency::Evicted) {
+                continue;
+            }
+
+            // Sources of textures nobody draws are not worth the memory, they are loaded again when needed
+            if (slot.lastUsedFrame + evictionGraceFrames < frameNumber) {
+                slot.source.reset();
+                continue;
+            }
+            // Only what the last frame drew with
+            if (slot.lastUsedFrame + 1 < frameNumber || slot.wantedMip >= slot.residentMip) {
+                continue;
+            }
+
+            stats.mipsOutstanding++;
+            if (!slot.source) {
+                if (!slot.loading) {
+                    slot.loading = true;
+                    requestLoad(static_cast<int>(i), true);
+                }
+                continue;
+            }
+            candidates.push_back(static_cast<int>(i));
+        }
+
+        // Furthest below what the screen asks for first
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+            return slots[a].residentMip - slots[a].wantedMip > slots[b].residentMip - slots[b].wantedMip;
+        });
+
+        for (int index: candidates) {
+            TextureSlot& slot = slots[index];
+            // A mip at a time while streaming, so the budget is spread over the frames
+            const uint32_t mip = mipStreaming ? slot.residentMip - 1 : slot.wantedMip;
+            const uint64_t bytes = bytesOf(*slot.source, mip);
+            // At least one upload per frame, even a level larger than the whole budget
+            if (stats.lastFrameMipUploads > 0 && stats.lastFrameMipBytes + bytes > mipUploadBudget) {
+                continue;
+            }
+            promote(index, mip);
+            stats.lastFrameMipUploads++;
+            stats.lastFrameMipBytes += bytes;
+        }
+    }
+
+    void XETextureManager::promote(int index, uint32_t mip) {
+        TextureSlot& slot = slots[index];
+        // The image has no room for finer levels, the new one is uploaded from mip down to 1x1
+        auto tex = createTexture(*slot.source, formatFor(slot.semantic), mip);
+        const uint64_t bytes = bytesOf(*slot.source, mip);
+        if (textures[index]) {
+            retiredTextures.push_back({std::move(textures[index]), frameNumber + textureDescriptorSets.size()});
+        }
+        textures[index] = tex;
         imageInfos[index] = tex->getImageInfo();
+        imageInfoVersion++;
 
-        updateDescriptorSet();
-        return index;
+        stats.residentBytes = stats.residentBytes - slot.bytes + bytes;
+        slot.bytes = bytes;
+        slot.residentMip = mip;
+        if (mip == 0) {
+            slot.source.reset();
+        }
+        if (slot.residency == Residency::Evicted) {
+            slot.residency = Residency::Resident;
+            stats.evicted--;
+            stats.resident++;
+            stats.restores++;
+        }
+        stats.mipPromotions++;
+    }
+
+    void XETextureManager::enforceBudget() {
+        const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+        vmaGetMemoryProperties(device.vmaAllocator(), &memoryProperties);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(device.vmaAllocator(), budgets);
+
+        stats.heapUsage = 0;
+        stats.heapBudget = 0;
+        for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+            if (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                stats.heapUsage += budgets[i].usage;
+                stats.heapBudget += budgets[i].budget;
+            }
+        }
+
+        // The textures get what everything else leaves of 90% of the heap budget
+        const uint64_t heapLimit = stats.heapBudget / 10 * 9;
+        const uint64_t otherUsage = stats.heapUsage > stats.residentBytes ? stats.heapUsage - stats.residentBytes : 0;
+        const uint64_t heapTextureLimit = heapLimit > otherUsage ? heapLimit - otherUsage : 0;
+        stats.budgetBytes = textureBudget > 0 ? std::min(textureBudget, heapTextureLimit) : heapTextureLimit;
+        if (stats.residentBytes <= stats.budgetBytes) {
+            return;
+        }
+
+        std::vector<int> candidates;
+        for (size_t i = 0; i < slots.size(); i++) {
+            const TextureSlot& slot = slots[i];
+            if (slot.residency == Residency::Resident && textures[i] && slot.tail &&
+                slot.lastUsedFrame + evictionGraceFrames < frameNumber) {
+                candidates.push_back(static_cast<int>(i));
+            }
+        }
+        // Least recently used first
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+            return slots[a].lastUsedFrame < slots[b].lastUsedFrame;
+        });
+
+        for (int index: candidates) {
+            if (stats.residentBytes <= stats.budgetBytes) {
+                break;
+            }
+            evict(index);
+        }
+    }
+
+    void XETextureManager::evict(int index) {
+        TextureSlot& slot = slots[index];
+        // The sets of the other frames in flight still point at it until their next update rewrites them
+        retiredTextures.push_back({std::move(textures[index]), frameNumber + textureDescriptorSets.size()});
+        imageInfos[index] = slot.tail->getImageInfo();
+        imageInfoVersion++;
+
+        slot.residency = Residency::Evicted;
+        slot.residentMip = slot.tailMip;
+        slot.source.reset();
+        stats.residentBytes -= slot.bytes;
+        stats.evictedBytes += slot.bytes;
+        slot.bytes = 0;
+        stats.resident--;
+        stats.evicted++;
+        stats.evictions++;
+    }
+
+    void XETextureManager::update(int frameIndex) {
+        frameNumber++;
+        retiredTextures.erase(std::remove_if(retiredTextures.begin(), retiredTextures.end(),
+            [this](const RetiredTexture& retired) { return frameNumber >= retired.releaseFrame; }),
+            retiredTextures.end());
+
+        stats.lastFrameUploads = 0;
+        uint32_t batchUploads = 0;
+
+        // Oldest requests first, a decode that is not done yet does not hold back the ones behind it
+        for (auto it = pendingLoads.begin(); it != pendingLoads.end() && stats.lastFrameUploads < maxUploadsPerFrame;) {
+            if (it->decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            uploadPending(*it);
+            if (!it->reload) {
+                batchPending--;
+                batchUploads++;
+            }
+            it = pendingLoads.erase(it);
+            stats.lastFrameUploads++;
+        }
+
+        if (stats.lastFrameUploads > 0) {
+            stats.pending = static_cast<uint32_t>(pendingLoads.size());
+        }
+        if (batchUploads > 0 && batchPending == 0) {
+            onLoadsDrained();
+        }
+
+        streamMips();
+        if (settling && pendingLoads.empty() && stats.mipsOutstanding == 0) {
+            stats.lastSettleMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - settleStart).count();
+            settling = false;
+            std::cout << "[Texture] Drawn textures at their wanted mips after " << stats.lastSettleMs << " ms"
+                << std::endl;
+        }
+        enforceBudget();
+
+        // This frame's fence was waited on, so its set is no longer read
+        if (uploadedVersions[frameIndex] != imageInfoVersion) {
+            updateDescriptorSet(frameIndex);
+            uploadedVersions[frameIndex] = imageInfoVersion;
+        }
+    }
+
+    void XETextureManager::finishPendingLoads() {
+        if (pendingLoads.empty()) {
+            return;
+        }
+
+        for (PendingLoad& load: pendingLoads) {
+            uploadPending(load);
+        }
+        pendingLoads.clear();
+        stats.pending = 0;
+        if (batchPending > 0) {
+            batchPending = 0;
+            onLoadsDrained();
+        }
+    }
+
+    void XETextureManager::onLoadsDrained() {
+        stats.lastBatchMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - batchStart).count();
+        stats.lastBatchTextures = batchTextures;
+        std::cout << "[Texture] " << batchTextures << " textures resident after " << stats.lastBatchMs << " ms ("
+            << stats.decodeThreads << " decode threads)" << std::endl;
+    }
+
+    void XETextureManager::setDecodeThreads(uint32_t threadCount) {
+        // The old pool finishes its queue in its destructor, the pending futures stay valid
+        decodePool = std::make_unique<XEThreadPool>(threadCount);
+        stats.decodeThreads = decodePool->threadCount();
+    }
+
+    XETextureManager::LoadBenchmarkResult XETextureManager::benchmarkLoad(uint32_t threadCount) {
+        const size_t count = streamedPaths.size();
+        std::vector<StreamedImage> images(count);
+        std::vector<std::future<void>> futures;
+        futures.reserve(count);
+        std::atomic<int64_t> decodeNs{0};
+        // After what the jobs write to, so a failed upload still lets the queued decodes finish first
+        XEThreadPool pool{threadCount};
+
+        LoadBenchmarkResult result{};
+        result.threads = pool.threadCount();
+        result.textures = static_cast<uint32_t>(count);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            futures.push_back(pool.submit([this, &images, &decodeNs, i] {
+                auto decodeStart = std::chrono::high_resolution_clock::now();
+                loadImage(streamedPaths[i], streamedSemantics[i], useCookedTextures, false, images[i]);
+                decodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - decodeStart).count();
+            }));
+        }
+        // Uploads in request order while the later files are still decoding, the same overlap as update()
+        for (size_t i = 0; i < count; i++) {
+            futures[i].get();
+            if (images[i].cooked) {
+                XETexture texture{*images[i].cooked, device};
+            } else {
+                XETexture texture{images[i].mips, device, formatFor(streamedSemantics[i])};
+            }
+            images[i] = StreamedImage{};
+        }
+        result.totalMs = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        result.decodeMs = decodeNs.load() / 1.0e6;
+        return result;
     }
 
-    void XETextureManager::updateDescriptorSet() {
+    void XETextureManager::updateDescriptorSet(int frameIndex) {
         XEDescriptorWriter(*textureSetLayout, *texturePool)
         .writeImageArray(0, imageInfos)
-        .overwrite(textureDescriptorSet);
+        .overwrite(textureDescriptorSets[frameIndex]);
     }
 }
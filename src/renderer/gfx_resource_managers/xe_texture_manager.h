@@ -7,9 +7,13 @@
 #include "vulkan/vulkan.h"
 
 #include "renderer/xe_texture.h"
+#include "renderer/xe_texture_cache.h"
 #include "renderer/xe_descriptors.h"
 #include "renderer/xe_device.h"
+#include "utils/xe_thread_pool.h"
 
+#include <chrono>
+#include <future>
 #include <memory>
 #include <vector>
 #include <unordered_map>
@@ -18,38 +22,191 @@
 namespace xe {
     enum class TextureSemantic { BaseColor, Normal, ORM, Emissive };
 
+    // Texture streaming: getOrLoadTexture reserves a slot and returns at once, the file is decoded on a worker
+    // pool and uploaded by update() on the render thread. Until then the slot samples the default albedo/normal.
+    // The texture set exists once per frame in flight so a slot is only rewritten once its frame has retired.
+    // Colour and normal maps come from the cooked cache (BC7 / BC5 with precomputed mips) when the device samples
+    // BC formats; a missing or stale cache is cooked on the worker, or the raw image is used with its mip chain
+    // built on the worker too, so the upload is a single copy either way.
+    // Residency: the render systems mark the slots they draw with, and once the textures outgrow the budget (set
+    // explicitly or derived from the VMA device local heap budget) the least recently used ones are evicted down
+    // to a low resolution tail kept since their upload.
+    // Mip streaming: a texture is first bound with just its tail. The render systems estimate the mip each draw
+    // needs from its size on screen, and the finer levels are uploaded a mip at a time over the next frames
+    // within a per-frame byte budget. An evicted tail that is drawn again streams back the same way.
     class XETextureManager {
     public:
+        struct StreamingStats {
+            uint32_t pending = 0;           // requested, not resident yet
+            uint32_t resident = 0;          // streamed textures uploaded, without the defaults
+            uint32_t decodeThreads = 0;
+            uint32_t lastFrameUploads = 0;
+            float lastBatchMs = 0.0f;       // first request to last upload of the last batch that drained
+            uint32_t lastBatchTextures = 0;
+            uint32_t cookedLoads = 0;       // uploaded from the cooked cache
+            uint32_t cookedOnLoad = 0;      // of those, cooked by the streaming workers
+            uint32_t rawLoads = 0;          // RGBA8, mips built on the workers
+            uint64_t residentBytes = 0;     // texel storage of the streamed textures, mips and tails included
+            uint32_t evicted = 0;           // down to their tail right now
+            uint32_t evictions = 0;         // since start
+            uint32_t restores = 0;          // evicted textures streamed back in, since start
+            uint64_t evictedBytes = 0;      // freed by the evictions, since start
+            uint64_t budgetBytes = 0;       // for the textures, as enforced by the last update
+            uint64_t heapUsage = 0;         // device local heaps, from vmaGetHeapBudgets
+            uint64_t heapBudget = 0;
+            uint32_t lastFrameMipUploads = 0;
+            uint64_t lastFrameMipBytes = 0;
+            uint32_t mipPromotions = 0;     // since start
+            uint32_t mipsOutstanding = 0;   // drawn last frame at a coarser mip than wanted
+            float lastSettleMs = 0.0f;      // first new request to every drawn texture at its wanted mip
+        };
+
+        struct LoadBenchmarkResult {
+            uint32_t threads = 0;
+            uint32_t textures = 0;
+            double totalMs = 0.0;           // decode on the pool + upload on the calling thread
+            double decodeMs = 0.0;          // decode and mips (or cache read) time summed over the workers
+        };
+
+        // Mips of the tail an evicted texture keeps, the levels up to this size
+        static constexpr uint32_t TAIL_EXTENT = 64;
+
         XETextureManager(
             XEDevice& device,
-            uint32_t maxTextures);
+            uint32_t maxTextures,
+            uint32_t framesInFlight,
+            uint32_t decodeThreads = 0);
 
         ~XETextureManager();
 
         XETextureManager(const XETextureManager&) = delete;
         XETextureManager& operator=(const XETextureManager&) = delete;
 
+        // Slot of the texture, resident or not. Never blocks on the file.
         int getOrLoadTexture(const std::string& path, TextureSemantic semantic);
         int getDefaultAlbedoTextureIndex() const { return defaultAlbedoTextureIndex; }
         int getDefaultNormalTextureIndex() const { return defaultNormalTextureIndex; }
-        VkDescriptorSet getDescriptorSet() const {return textureDescriptorSet; }
+
+        // Records that the slot is drawn with in the frame being recorded, cheap enough to call per draw.
+        // screenExtent is the estimated size of the surface on screen in pixels, 0 asks for full resolution.
+        void markUsed(int index, float screenExtent = 0.0f);
+
+        // Uploads up to maxUploadsPerFrame decoded textures, streams finer mips of the textures drawn last frame,
+        // evicts to the budget and rewrites this frame's set if any slot changed.
+        // After the frame's fence was waited on, before its commands bind the set.
+        void update(int frameIndex);
+        // Blocks until every requested texture is resident, only its tail with mip streaming (the sets are patched
+        // by the next update calls)
+        void finishPendingLoads();
+
+        // Waits for the queued decodes, then swaps the pool
+        void setDecodeThreads(uint32_t threadCount);
+        void setMaxUploadsPerFrame(uint32_t count) { maxUploadsPerFrame = count; }
+        uint32_t getMaxUploadsPerFrame() const { return maxUploadsPerFrame; }
+        // Affect the loads requested afterwards
+        void setUseCookedTextures(bool enable) { useCookedTextures = enable && compressionSupported; }
+        bool getUseCookedTextures() const { return useCookedTextures; }
+        void setCookMissingTextures(bool enable) { cookMissingTextures = enable; }
+        bool getCookMissingTextures() const { return cookMissingTextures; }
+        // 0 leaves it to the VMA heap budget, otherwise the lower of the two
+        void setTextureBudget(uint64_t bytes) { textureBudget = bytes; }
+        uint64_t getTextureBudget() const { return textureBudget; }
+        // A texture drawn within this many frames is never evicted
+        void setEvictionGraceFrames(uint32_t frames) { evictionGraceFrames = frames; }
+        uint32_t getEvictionGraceFrames() const { return evictionGraceFrames; }
+        // Affects the loads requested afterwards, off uploads every texture at full resolution
+        void setMipStreaming(bool enable) { mipStreaming = enable; }
+        bool getMipStreaming() const { return mipStreaming; }
+        void setMipUploadBudget(uint64_t bytesPerFrame) { mipUploadBudget = bytesPerFrame; }
+        uint64_t getMipUploadBudget() const { return mipUploadBudget; }
+        // Added to the estimated mip, negative for sharper textures on surfaces that repeat their UVs
+        void setMipBias(float bias) { mipBias = bias; }
+        float getMipBias() const { return mipBias; }
+        const StreamingStats& getStreamingStats() const { return stats; }
+
+        // Loads every streamed texture again into throwaway images, decoding on threadCount workers. Uses the
+        // cooked cache when enabled but never cooks. Nothing that is bound changes.
+        LoadBenchmarkResult benchmarkLoad(uint32_t threadCount);
+
+        VkDescriptorSet getDescriptorSet(int frameIndex) const { return textureDescriptorSets[frameIndex]; }
         VkDescriptorSetLayout getDescriptorLayout() const { return textureSetLayout->getDescriptorSetLayout(); }
 
     private:
-        void updateDescriptorSet();
+        // What a worker hands to the upload, either the cooked mapping or the RGBA8 mip chain
+        struct StreamedImage {
+            std::unique_ptr<XETextureCache> cooked;
+            bool cookedOnLoad = false;
+            XEMipChain mips;
+        };
+
+        struct PendingLoad {
+            int index = 0;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            std::shared_ptr<StreamedImage> image;  // written by the worker
+            std::future<void> decoded;
+            bool reload = false;                   // source for mip streaming, not part of a load batch
+        };
+
+        enum class Residency { Default, Pending, Resident, Evicted };
+
+        // Per slot, parallel to textures
+        struct TextureSlot {
+            std::string path;
+            TextureSemantic semantic = TextureSemantic::BaseColor;
+            Residency residency = Residency::Default;
+            uint64_t lastUsedFrame = 0;
+            uint32_t extent = 0;                // larger side of mip 0, once uploaded
+            uint32_t tailMip = 0;
+            uint32_t residentMip = 0;           // finest level bound
+            uint32_t wantedMip = 0;             // finest level the draws of lastUsedFrame asked for
+            uint64_t bytes = 0;                 // of the image above the tail, if one is bound
+            std::shared_ptr<XETexture> tail;    // bound while evicted, none for textures no larger than the tail
+            uint64_t tailBytes = 0;
+            std::shared_ptr<StreamedImage> source;  // every level, kept while finer ones may still be streamed
+            bool loading = false;               // source requested again
+        };
+
+        // Evicted, still sampled by the frames in flight until frameNumber reaches releaseFrame
+        struct RetiredTexture {
+            std::shared_ptr<XETexture> texture;
+            uint64_t releaseFrame = 0;
+        };
+
+        static VkFormat formatFor(TextureSemantic semantic);
+        static bool cookedFormatFor(TextureSemantic semantic, XETextureCache::Format& format);
+        static MipFilter mipFilterFor(TextureSemantic semantic);
+        static uint32_t tailMipOf(const StreamedImage& image);
+        static uint64_t bytesOf(const StreamedImage& image, uint32_t firstMip);
+        // Runs on the workers, only reads its arguments
+        static void loadImage(const std::string& path, TextureSemantic semantic, bool useCooked, bool cookMissing,
+            StreamedImage& image);
+        std::shared_ptr<XETexture> createTexture(StreamedImage& image, VkFormat format, uint32_t firstMip);
+        void requestLoad(int index, bool reload);
+        void streamMips();
+        void promote(int index, uint32_t mip);
+        void enforceBudget();
+        void evict(int index);
+        void updateDescriptorSet(int frameIndex);
         void createDefaultAlbedoTexture();
         void createDefaultNormalTexture();
         void initializeDescriptorSet();
+        void uploadPending(PendingLoad& load);
+        void onLoadsDrained();
 
         XEDevice& device;
 
         std::unique_ptr<XEDescriptorPool> texturePool{};
         std::unique_ptr<XEDescriptorSetLayout> textureSetLayout{};
-        VkDescriptorSet textureDescriptorSet{VK_NULL_HANDLE};
+        std::vector<VkDescriptorSet> textureDescriptorSets;
+        std::vector<uint64_t> uploadedVersions;  // per frame in flight, imageInfoVersion of the last write
+        uint64_t imageInfoVersion = 1;
 
-        std::vector<std::shared_ptr<XETexture>> textures;
+        std::vector<std::shared_ptr<XETexture>> textures;  // null while at most the tail is bound
+        std::vector<TextureSlot> slots;
         std::unordered_map<std::string, int> texturesIndexMap;
         std::vector<VkDescriptorImageInfo> imageInfos;
+        std::vector<std::string> streamedPaths;       // every streamed key, for the benchmark
+        std::vector<TextureSemantic> streamedSemantics;
 
         std::shared_ptr<XETexture> defaultAlbedoTexture;
         std::shared_ptr<XETexture> defaultNormalTexture;
@@ -57,5 +214,27 @@ namespace xe {
         int defaultNormalTextureIndex = 0;
 
         uint32_t maxTextures{0};
+
+        std::vector<PendingLoad> pendingLoads;
+        std::vector<RetiredTexture> retiredTextures;
+        uint64_t frameNumber = 0;           // update calls so far
+        uint64_t textureBudget = 0;
+        uint32_t evictionGraceFrames = 120;
+        bool mipStreaming = true;
+        uint64_t mipUploadBudget = 16ull * 1024 * 1024;
+        float mipBias = 0.0f;
+        bool settling = false;
+        std::chrono::high_resolution_clock::time_point settleStart{};
+        std::chrono::high_resolution_clock::time_point batchStart{};
+        uint32_t batchTextures = 0;
+        uint32_t batchPending = 0;          // loads of the batch not uploaded yet, reloads not counted
+        uint32_t maxUploadsPerFrame = 4;
+        bool compressionSupported = false;
+        bool useCookedTextures = false;
+        bool cookMissingTextures = true;
+        StreamingStats stats{};
+
+        // Last member, its destructor drains the queued decodes before anything else goes away
+        std::unique_ptr<XEThreadPool> decodePool;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,314 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/lighting/xe_light_binner.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// XE_LIGHT_BINNER_NO_SSE forces the plain lane loop, the tests build it both ways
+#if !defined(XE_LIGHT_BINNER_NO_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define XE_LIGHT_BINNER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace xe {
+
+    void XELightBinner::LightSoA::clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        radiusSq.clear();
+        index.clear();
+        count = 0;
+    }
+
+    void XELightBinner::LightSoA::push(float px, float py, float pz, float rSq, uint32_t lightIndex) {
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        radiusSq.push_back(rSq);
+        index.push_back(lightIndex);
+        count++;
+    }
+
+    void XELightBinner::LightSoA::pad() {
+        // A negative squared radius never passes the distance test
+        while (x.size() % 4 != 0) {
+            x.push_back(0.0f);
+            y.push_back(0.0f);
+            z.push_back(0.0f);
+            radiusSq.push_back(-1.0f);
+            index.push_back(0);
+        }
+    }
+
+    void XELightBinner::prepare(const GPULight *lights, uint32_t lightCount, const glm::mat4 &projection,
+        const glm::mat4 &view, float nearClip, float farClip) {
+
+        // Same bounds as light_cluster.comp: the tile's NDC rectangle swept between its slice depths
+        auto sliceDepth = [&](uint32_t slice) {
+            return nearClip * std::pow(farClip / nearClip,
+                static_cast<float>(slice) / static_cast<float>(LIGHT_CLUSTER_Z));
+        };
+        const glm::vec2 scale{1.0f / projection[0][0], 1.0f / projection[1][1]};
+
+        clusterBounds.resize(LIGHT_CLUSTER_COUNT);
+        sliceBounds.resize(LIGHT_CLUSTER_Z);
+        rowBounds.resize(LIGHT_CLUSTER_Z * LIGHT_CLUSTER_Y);
+        for (uint32_t z = 0; z < LIGHT_CLUSTER_Z; z++) {
+            const float zNear = sliceDepth(z);
+            const float zFar = sliceDepth(z + 1);
+            Box& slice = sliceBounds[z];
+            slice = {glm::vec3{FLT_MAX}, glm::vec3{-FLT_MAX}};
+
+            for (uint32_t y = 0; y < LIGHT_CLUSTER_Y; y++) {
+                Box& row = rowBounds[z * LIGHT_CLUSTER_Y + y];
+                row = {glm::vec3{FLT_MAX}, glm::vec3{-FLT_MAX}};
+
+                for (uint32_t x = 0; x < LIGHT_CLUSTER_X; x++) {
+                    const glm::vec2 ndcMin = glm::vec2(x, y) / glm::vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y) * 2.0f - 1.0f;
+                    const glm::vec2 ndcMax = glm::vec2(x + 1, y + 1) / glm::vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y) *
+                        2.0f - 1.0f;
+                    const glm::vec2 a = ndcMin * scale;
+                    const glm::vec2 b = ndcMax * scale;
+                    const glm::vec2 xyMin = glm::min(glm::min(a * zNear, a * zFar), glm::min(b * zNear, b * zFar));
+                    const glm::vec2 xyMax = glm::max(glm::max(a * zNear, a * zFar), glm::max(b * zNear, b * zFar));
+
+                    Box& cluster = clusterBounds[clusterIndex(x, y, z)];
+                    cluster = {glm::vec3{xyMin, zNear}, glm::vec3{xyMax, zFar}};
+                    row.min = glm::min(row.min, cluster.min);
+                    row.max = glm::max(row.max, cluster.max);
+                }
+                slice.min = glm::min(slice.min, row.min);
+                slice.max = glm::max(slice.max, row.max);
+            }
+        }
+
+        viewLights.clear();
+        for (uint32_t i = 0; i < lightCount; i++) {
+            const GPULight& light = lights[i];
+            if (static_cast<int>(light.position.w + 0.5f) == 0) {
+                // Directional lights touch every cluster
+                viewLights.push(0.0f, 0.0f, 0.0f, FLT_MAX, i);
+                continue;
+            }
+            const glm::vec3 p = glm::vec3(view * glm::vec4(glm::vec3(light.position), 1.0f));
+            const float range = std::max(light.param.x, 1e-4f);
+            viewLights.push(p.x, p.y, p.z, range * range, i);
+        }
+        viewLights.pad();
+
+        clusterData.assign(static_cast<size_t>(LIGHT_CLUSTER_COUNT) * CLUSTER_STRIDE, 0u);
+    }
+
+    void XELightBinner::bin(const GPULight *lights, uint32_t lightCount, const glm::mat4 &projection,
+        const glm::mat4 &view, float nearClip, float farClip) {
+        prepare(lights, lightCount, projection, view, nearClip, farClip);
+
+        auto binSlices = [&](uint32_t begin, uint32_t end) {
+            LightSoA sliceLights;
+            LightSoA rowLights;
+            for (uint32_t slice = begin; slice < end; slice++) {
+                binSlice(slice, sliceLights, rowLights);
+            }
+        };
+
+        // Slices write disjoint cluster ranges
+        if (pool) {
+            pool->parallelFor(LIGHT_CLUSTER_Z, binSlices);
+        } else {
+            binSlices(0, LIGHT_CLUSTER_Z);
+        }
+    }
+
+    void XELightBinner::binSlice(uint32_t slice, LightSoA &sliceLights, LightSoA &rowLights) {
+        sliceLights.clear();
+        cullLights(viewLights, sliceBounds[slice], sliceLights);
+        sliceLights.pad();
+
+        for (uint32_t y = 0; y < LIGHT_CLUSTER_Y; y++) {
+            rowLights.clear();
+            cullLights(sliceLights, rowBounds[slice * LIGHT_CLUSTER_Y + y], rowLights);
+            rowLights.pad();
+
+            for (uint32_t x = 0; x < LIGHT_CLUSTER_X; x++) {
+                const uint32_t cluster = clusterIndex(x, y, slice);
+                writeCluster(rowLights, clusterBounds[cluster], &clusterData[cluster * CLUSTER_STRIDE]);
+            }
+        }
+    }
+
+    void XELightBinner::binScalar(const GPULight *lights, uint32_t lightCount, const glm::mat4 &projection,
+        const glm::mat4 &view, float nearClip, float farClip) {
+        prepare(lights, lightCount, projection, view, nearClip, farClip);
+
+        for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+            const Box& box = clusterBounds[cluster];
+            uint32_t* out = &clusterData[cluster * CLUSTER_STRIDE];
+            uint32_t count = 0;
+            for (uint32_t i = 0; i < viewLights.count; i++) {
+                const glm::vec3 center{viewLights.x[i], viewLights.y[i], viewLights.z[i]};
+                const glm::vec3 d = glm::clamp(center, box.min, box.max) - center;
+                if (glm::dot(d, d) <= viewLights.radiusSq[i] && count < MAX_LIGHTS_PER_CLUSTER) {
+                    out[1 + count++] = viewLights.index[i];
+                }
+            }
+            out[0] = count;
+        }
+    }
+
+#ifdef XE_LIGHT_BINNER_SSE
+    // Lane mask of the four spheres at `i` touching the box
+    static int touchMask(const float* x, const float* y, const float* z, const float* radiusSq, uint32_t i,
+        __m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ) {
+        const __m128 cx = _mm_loadu_ps(x + i);
+        const __m128 cy = _mm_loadu_ps(y + i);
+        const __m128 cz = _mm_loadu_ps(z + i);
+        const __m128 dx = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cx, minX), maxX), cx);
+        const __m128 dy = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cy, minY), maxY), cy);
+        const __m128 dz = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cz, minZ), maxZ), cz);
+        const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_loadu_ps(radiusSq + i)));
+    }
+#else
+    static int touchMask(const float* x, const float* y, const float* z, const float* radiusSq, uint32_t i,
+        const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        int mask = 0;
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            const glm::vec3 center{x[i + lane], y[i + lane], z[i + lane]};
+            const glm::vec3 d = glm::clamp(center, boxMin, boxMax) - center;
+            if (glm::dot(d, d) <= radiusSq[i + lane]) {
+                mask |= 1 << lane;
+            }
+        }
+        return mask;
+    }
+#endif
+
+    void XELightBinner::cullLights(const LightSoA &in, const Box &box, LightSoA &out) {
+#ifdef XE_LIGHT_BINNER_SSE
+        const __m128 minX = _mm_set1_ps(box.min.x), minY = _mm_set1_ps(box.min.y), minZ = _mm_set1_ps(box.min.z);
+        const __m128 maxX = _mm_set1_ps(box.max.x), maxY = _mm_set1_ps(box.max.y), maxZ = _mm_set1_ps(box.max.z);
+#endif
+        for (uint32_t i = 0; i < in.count; i += 4) {
+#ifdef XE_LIGHT_BINNER_SSE
+            int mask = touchMask(in.x.data(), in.y.data(), in.z.data(), in.radiusSq.data(), i,
+                minX, minY, minZ, maxX, maxY, maxZ);
+#else
+            int mask = touchMask(in.x.data(), in.y.data(), in.z.data(), in.radiusSq.data(), i, box.min, box.max);
+#endif
+            // Lanes in order keep the light order of the input
+            for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    const uint32_t j = i + lane;
+                    out.push(in.x[j], in.y[j], in.z[j], in.radiusSq[j], in.index[j]);
+                }
+            }
+        }
+    }
+
+    void XELightBinner::writeCluster(const LightSoA &in, const Box &box, uint32_t *cluster) {
+#ifdef XE_LIGHT_BINNER_SSE
+        const __m128 minX = _mm_set1_ps(box.min.x), minY = _mm_set1_ps(box.min.y), minZ = _mm_set1_ps(box.min.z);
+        const __m128 maxX = _mm_set1_ps(box.max.x), maxY = _mm_set1_ps(box.max.y), maxZ = _mm_set1_ps(box.max.z);
+#endif
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < in.count && count < MAX_LIGHTS_PER_CLUSTER; i += 4) {
+#ifdef XE_LIGHT_BINNER_SSE
+            int mask = touchMask(in.x.data(), in.y.data(), in.z.data(), in.radiusSq.data(), i,
+                minX, minY, minZ, maxX, maxY, maxZ);
+#else
+            int mask = touchMask(in.x.data(), in.y.data(), in.z.data(), in.radiusSq.data(), i, box.min, box.max);
+#endif
+            for (uint32_t lane = 0; mask != 0 && count < MAX_LIGHTS_PER_CLUSTER; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    cluster[1 + count++] = in.index[i + lane];
+                }
+            }
+        }
+        cluster[0] = count;
+    }
+
+    XELightBinner::BenchmarkResult XELightBinner::benchmark(uint32_t lightCount, XEThreadPool &pool) {
+        BenchmarkResult result{};
+        result.lightCount = lightCount;
+
+        // XECamera::setPerspectiveProjection at 60 degrees, 16:9, looking down +z from the origin
+        const float nearClip = 0.1f;
+        const float farClip = 200.0f;
+        const float tanHalfFovy = std::tan(glm::radians(60.0f) * 0.5f);
+        glm::mat4 projection{0.0f};
+        projection[0][0] = 1.0f / ((16.0f / 9.0f) * tanHalfFovy);
+        projection[1][1] = 1.0f / tanHalfFovy;
+        projection[2][2] = farClip / (farClip - nearClip);
+        projection[2][3] = 1.0f;
+        projection[3][2] = -(farClip * nearClip) / (farClip - nearClip);
+        const glm::mat4 view{1.0f};
+
+        std::mt19937 rng{1234};
+        std::uniform_real_distribution<float> lateral{-60.0f, 60.0f};
+        std::uniform_real_distribution<float> depth{0.5f, 120.0f};
+        std::uniform_real_distribution<float> range{1.0f, 6.0f};
+        std::vector<GPULight> lights(lightCount);
+        for (auto& light: lights) {
+            light.color = glm::vec4(1.0f);
+            light.position = glm::vec4(lateral(rng), lateral(rng) * 0.5f, depth(rng), 1.0f);
+            light.direction = glm::vec4(0.0f);
+            light.param = glm::vec4(range(rng), 0.0f, 0.0f, 32.0f);
+        }
+
+        using clock = std::chrono::steady_clock;
+        auto milliseconds = [](clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+
+        constexpr uint32_t scalarIterations = 3;
+        constexpr uint32_t simdIterations = 20;
+
+        XELightBinner reference{};
+        auto start = clock::now();
+        for (uint32_t i = 0; i < scalarIterations; i++) {
+            reference.binScalar(lights.data(), lightCount, projection, view, nearClip, farClip);
+        }
+        result.scalarMs = milliseconds(start) / scalarIterations;
+
+        XELightBinner binner{};
+        start = clock::now();
+        for (uint32_t i = 0; i < simdIterations; i++) {
+            binner.bin(lights.data(), lightCount, projection, view, nearClip, farClip);
+        }
+        result.simdMs = milliseconds(start) / simdIterations;
+
+        binner.setThreadPool(&pool);
+        start = clock::now();
+        for (uint32_t i = 0; i < simdIterations; i++) {
+            binner.bin(lights.data(), lightCount, projection, view, nearClip, farClip);
+        }
+        result.simdThreadedMs = milliseconds(start) / simdIterations;
+
+        uint64_t totalLights = 0;
+        for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+            const uint32_t count = reference.getClusterLightCount(cluster);
+            totalLights += count;
+            if (binner.getClusterLightCount(cluster) != count ||
+                !std::equal(reference.getClusterLights(cluster), reference.getClusterLights(cluster) + count,
+                    binner.getClusterLights(cluster))) {
+                result.mismatchedClusters++;
+            }
+        }
+        result.averageLightsPerCluster = static_cast<float>(totalLights) / LIGHT_CLUSTER_COUNT;
+
+        if (result.mismatchedClusters > 0) {
+            std::cerr << "[LightBinner] " << result.mismatchedClusters << " clusters differ from the scalar reference"
+                << std::endl;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,93 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/lighting/xe_lights.h"
+#include "utils/xe_thread_pool.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+
+    // CPU reference of light_cluster.comp. Bins lights into the same LIGHT_CLUSTER_X x Y x Z clusters, with the
+    // same bounds, light order and MAX_LIGHTS_PER_CLUSTER cap, into the layout of the GPU cluster light buffer.
+    // Lights are culled per depth slice, then per tile row, before the per-cluster test, each level testing
+    // four spheres against a box at a time with SSE. Slices run in parallel on an optional thread pool.
+    // Needs no device, so it can be checked and timed without a GPU.
+    class XELightBinner {
+    public:
+        struct BenchmarkResult {
+            uint32_t lightCount = 0;
+            double scalarMs = 0.0;          // every light against every cluster, one thread
+            double simdMs = 0.0;            // hierarchical SSE, one thread
+            double simdThreadedMs = 0.0;    // hierarchical SSE on the pool
+            float averageLightsPerCluster = 0.0f;
+            uint32_t mismatchedClusters = 0; // SSE results that differ from the scalar reference
+        };
+
+        // pool may be null, slices are then binned on the calling thread
+        explicit XELightBinner(XEThreadPool* pool = nullptr) : pool(pool) {}
+
+        // Camera conventions of XECamera: view space +z forward, projection as built by setPerspectiveProjection
+        void bin(const GPULight* lights, uint32_t lightCount, const glm::mat4& projection, const glm::mat4& view,
+            float nearClip, float farClip);
+
+        // The straightforward version, kept as the reference the fast path is compared against
+        void binScalar(const GPULight* lights, uint32_t lightCount, const glm::mat4& projection,
+            const glm::mat4& view, float nearClip, float farClip);
+
+        void setThreadPool(XEThreadPool* threadPool) { pool = threadPool; }
+
+        // LIGHT_CLUSTER_COUNT x (count, MAX_LIGHTS_PER_CLUSTER indices), same as the GPU buffer
+        const std::vector<uint32_t>& getClusterData() const { return clusterData; }
+        uint32_t getClusterLightCount(uint32_t cluster) const { return clusterData[cluster * CLUSTER_STRIDE]; }
+        const uint32_t* getClusterLights(uint32_t cluster) const { return &clusterData[cluster * CLUSTER_STRIDE + 1]; }
+        static uint32_t clusterIndex(uint32_t x, uint32_t y, uint32_t z) {
+            return (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + x;
+        }
+
+        // Random point lights in front of a fixed camera, scalar vs SSE vs SSE on the pool
+        static BenchmarkResult benchmark(uint32_t lightCount, XEThreadPool& pool);
+
+    private:
+        static constexpr uint32_t CLUSTER_STRIDE = 1 + MAX_LIGHTS_PER_CLUSTER;
+
+        struct Box {
+            glm::vec3 min;
+            glm::vec3 max;
+        };
+
+        // View space spheres, structure of arrays padded to a multiple of 4 with spheres that touch nothing
+        struct LightSoA {
+            std::vector<float> x, y, z, radiusSq;
+            std::vector<uint32_t> index;
+            uint32_t count = 0;
+
+            void clear();
+            void push(float px, float py, float pz, float rSq, uint32_t lightIndex);
+            void pad();
+        };
+
+        void prepare(const GPULight* lights, uint32_t lightCount, const glm::mat4& projection,
+            const glm::mat4& view, float nearClip, float farClip);
+        void binSlice(uint32_t slice, LightSoA& sliceLights, LightSoA& rowLights);
+
+        // Appends the lights of `in` whose sphere touches box, in order
+        static void cullLights(const LightSoA& in, const Box& box, LightSoA& out);
+        // Writes the count and up to MAX_LIGHTS_PER_CLUSTER indices of the lights touching box
+        static void writeCluster(const LightSoA& in, const Box& box, uint32_t* cluster);
+
+        XEThreadPool* pool = nullptr;
+
+        std::vector<Box> clusterBounds;     // clusterIndex order
+        std::vector<Box> sliceBounds;
+        std::vector<Box> rowBounds;         // slice * LIGHT_CLUSTER_Y + y
+        LightSoA viewLights;
+        std::vector<uint32_t> clusterData;
+    };
+}
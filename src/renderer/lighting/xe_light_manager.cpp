@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
 
 namespace xe {
@@ -14,100 +15,179 @@ namespace xe {
 
         LightSSBOPool = XEDescriptorPool::Builder(device)
         .setMaxSets(framesInFlight)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight)
         .build();
 
+        // The cluster assignment compute pass binds the same set
         LightSSBOSetLayout = XEDescriptorSetLayout::Builder(device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
         .build();
 
         LightSSBODescriptorSets.resize(framesInFlight);
 
-        createBuffers_(std::max(16u, initialCapacity));
+        capacity = std::max(16u, initialCapacity);
+        perFrameLightBuffers.resize(framesInFlight);
+        for (PerFrame& pf: perFrameLightBuffers) {
+            createBuffers_(pf, capacity);
+        }
+        createClusterBuffers_();
 
         allocateDescriptorSets_();
     }
 
-    XELightManager::~XELightManager() {
-        destroyBuffers_();
-    }
+    XELightManager::~XELightManager() { }
 
     void XELightManager::allocateDescriptorSets_() {
         for (int i=0; i<LightSSBODescriptorSets.size(); i++) {
             auto bufferInfo = perFrameLightBuffers[i].buffer->descriptorInfo();
+            auto clusterInfo = perFrameLightBuffers[i].clusterInfo->descriptorInfo();
+            auto clusterLightsInfo = perFrameLightBuffers[i].clusterLights->descriptorInfo();
             XEDescriptorWriter(*LightSSBOSetLayout, *LightSSBOPool)
             .writeBuffer(0, &bufferInfo)
+            .writeBuffer(1, &clusterInfo)
+            .writeBuffer(2, &clusterLightsInfo)
             .build(LightSSBODescriptorSets[i]);
         }
     }
 
-    void XELightManager::rewriteDescriptorSets_() {
-        for (int i=0; i<LightSSBODescriptorSets.size(); i++) {
-            auto bufferInfo = perFrameLightBuffers[i].buffer->descriptorInfo();
-            XEDescriptorWriter(*LightSSBOSetLayout, *LightSSBOPool)
-            .writeBuffer(0, &bufferInfo)
-            .overwrite(LightSSBODescriptorSets[i]);
-        }
+    void XELightManager::rewriteDescriptorSet_(uint32_t frameIndex) {
+        auto bufferInfo = perFrameLightBuffers[frameIndex].buffer->descriptorInfo();
+        auto clusterInfo = perFrameLightBuffers[frameIndex].clusterInfo->descriptorInfo();
+        auto clusterLightsInfo = perFrameLightBuffers[frameIndex].clusterLights->descriptorInfo();
+        XEDescriptorWriter(*LightSSBOSetLayout, *LightSSBOPool)
+        .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &clusterInfo)
+        .writeBuffer(2, &clusterLightsInfo)
+        .overwrite(LightSSBODescriptorSets[frameIndex]);
     }
 
 
-    void XELightManager::createBuffers_(uint32_t capacityLights) {
-        destroyBuffers_();
+    void XELightManager::createBuffers_(PerFrame& frame, uint32_t capacityLights) {
+        const VkDeviceSize totalSize = sizeof(LightSSBOHeader) + sizeof(GPULight) * static_cast<VkDeviceSize>(capacityLights);
 
-        capacity = capacityLights;
-        perFrameLightBuffers.resize(framesInFlight);
+        frame.buffer = std::make_unique<XEBuffer>(
+            device,
+            totalSize,
+            1,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        const VkDeviceSize totalSize = sizeof(LightSSBOHeader) + sizeof(GPULight) * static_cast<VkDeviceSize>(capacityLights);
+        VkResult result = frame.buffer->map();
+        assert(result == VK_SUCCESS && "Failed to map LightManager buffer");
+
+        frame.totalSize = totalSize;
+        frame.capacity = capacityLights;
+    }
 
+    void XELightManager::createClusterBuffers_() {
         for (PerFrame& pf: perFrameLightBuffers) {
-            pf.buffer = std::make_unique<XEBuffer>(
+            pf.clusterInfo = std::make_unique<XEBuffer>(
                 device,
-                totalSize,
+                sizeof(GPUClusterInfo),
                 1,
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-            VkResult result = pf.buffer->map();
-            assert(result == VK_SUCCESS && "Failed to map LightManager buffer");
+            VkResult result = pf.clusterInfo->map();
+            assert(result == VK_SUCCESS && "Failed to map cluster info buffer");
 
-            pf.totalSize = totalSize;
+            // Clustering off until the first setClusterInfo
+            GPUClusterInfo info{};
+            pf.clusterInfo->writeToBuffer(&info);
+
+            pf.clusterLights = std::make_unique<XEBuffer>(
+                device,
+                sizeof(uint32_t) * (1 + MAX_LIGHTS_PER_CLUSTER),
+                LIGHT_CLUSTER_COUNT,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
         }
     }
 
-    void XELightManager::destroyBuffers_() {
+    void XELightManager::setClusterInfo(uint32_t frameIndex, const GPUClusterInfo &info) {
+        GPUClusterInfo copy = info;
+        perFrameLightBuffers[frameIndex].clusterInfo->writeToBuffer(&copy);
+    }
+
+    void XELightManager::markDirty_(uint32_t slot) {
+        const size_t word = slot / 64;
         for (PerFrame& pf: perFrameLightBuffers) {
-            if (pf.buffer) {
-                pf.buffer.reset();
+            if (pf.dirtySlots.size() <= word) {
+                pf.dirtySlots.resize(word + 1, 0);
             }
-            pf.totalSize = 0;
+            pf.dirtySlots[word] |= uint64_t{1} << (slot % 64);
         }
-        capacity = 0;
     }
 
-    void XELightManager::clear() {
-        gpuLights.clear();
+    void XELightManager::markAllDirty_(PerFrame& frame) {
+        frame.headerDirty = true;
+        frame.dirtySlots.assign((gpuLights.size() + 63) / 64, ~uint64_t{0});
     }
 
-    uint32_t XELightManager::addLight(GPULight &light) {
+    LightHandle XELightManager::createLight(const GPULight &light) {
+        LightHandle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = static_cast<LightHandle>(handleSlots.size());
+            handleSlots.push_back(~0u);
+        }
+
+        const uint32_t slot = static_cast<uint32_t>(gpuLights.size());
         gpuLights.push_back(light);
-        return static_cast<uint32_t>(gpuLights.size() - 1);
+        slotHandles.push_back(handle);
+        handleSlots[handle] = slot;
+
+        markDirty_(slot);
+        for (PerFrame& pf: perFrameLightBuffers) {
+            pf.headerDirty = true;
+        }
+        return handle;
     }
 
-    void XELightManager::setLight(uint32_t index, GPULight &light) {
-        if (index < gpuLights.size()) {
-            gpuLights[index] = light;
+    void XELightManager::updateLight(LightHandle handle, const GPULight &light) {
+        assert(handle < handleSlots.size() && handleSlots[handle] != ~0u && "Invalid light handle");
+        const uint32_t slot = handleSlots[handle];
+        if (std::memcmp(&gpuLights[slot], &light, sizeof(GPULight)) == 0) {
+            return;
+        }
+        gpuLights[slot] = light;
+        markDirty_(slot);
+    }
+
+    void XELightManager::destroyLight(LightHandle handle) {
+        assert(handle < handleSlots.size() && handleSlots[handle] != ~0u && "Invalid light handle");
+        const uint32_t slot = handleSlots[handle];
+        const uint32_t last = static_cast<uint32_t>(gpuLights.size() - 1);
+
+        // Keep the array dense, the last light takes the freed slot
+        if (slot != last) {
+            gpuLights[slot] = gpuLights[last];
+            slotHandles[slot] = slotHandles[last];
+            handleSlots[slotHandles[slot]] = slot;
+            markDirty_(slot);
+        }
+        gpuLights.pop_back();
+        slotHandles.pop_back();
+        handleSlots[handle] = ~0u;
+        freeHandles.push_back(handle);
+
+        for (PerFrame& pf: perFrameLightBuffers) {
+            pf.headerDirty = true;
         }
     }
 
     void XELightManager::reserve(uint32_t minCapacity) {
         if (minCapacity <= capacity) return;
 
-        const uint32_t newCapacity = std::max(minCapacity, (capacity > 0) ? (capacity + capacity / 2) : 128u );
-
-        createBuffers_(newCapacity);
-        rewriteDescriptorSets_();
+        // The other frame slots may still be read by frames in flight, each grows in its own upload()
+        capacity = std::max(minCapacity, (capacity > 0) ? (capacity + capacity / 2) : 128u );
     }
 
     void XELightManager::upload(uint32_t frameIndex) {
@@ -115,18 +195,54 @@ namespace xe {
             reserve(static_cast<uint32_t>(gpuLights.size()));
         }
 
-        hdr.count = static_cast<uint32_t>(gpuLights.size());
-
         PerFrame &pf = perFrameLightBuffers[frameIndex];
+        // This frame's fence was waited on, its old buffer and set are no longer read
+        if (pf.capacity < capacity) {
+            createBuffers_(pf, capacity);
+            rewriteDescriptorSet_(frameIndex);
+            // The new buffer holds nothing yet
+            markAllDirty_(pf);
+        }
+        lastUploadBytes = 0;
+        lastUploadRanges = 0;
 
         // Write Header
-        pf.buffer->writeToBuffer(&hdr, sizeof(hdr), 0);
+        if (pf.headerDirty) {
+            hdr.count = static_cast<uint32_t>(gpuLights.size());
+            pf.buffer->writeToBuffer(&hdr, sizeof(hdr), 0);
+            pf.headerDirty = false;
+            lastUploadBytes += sizeof(hdr);
+        }
 
-        // Write light positions
-        if (!gpuLights.empty()) {
-            pf.buffer->writeToBuffer(gpuLights.data(),
-                static_cast<VkDeviceSize>(gpuLights.size() * sizeof(GPULight)),
-                sizeof(hdr));
+        // Write every run of consecutive dirty slots with one copy, slots past the end were destroyed
+        const uint32_t lightCount = static_cast<uint32_t>(gpuLights.size());
+        auto writeRange = [&](uint32_t first, uint32_t end) {
+            const VkDeviceSize size = static_cast<VkDeviceSize>(end - first) * sizeof(GPULight);
+            pf.buffer->writeToBuffer(&gpuLights[first], size, sizeof(hdr) + first * sizeof(GPULight));
+            lastUploadBytes += size;
+            lastUploadRanges++;
+        };
+
+        uint32_t runStart = ~0u;
+        for (size_t word = 0; word < pf.dirtySlots.size(); word++) {
+            const uint64_t bits = pf.dirtySlots[word];
+            if (bits == 0 && runStart == ~0u) {
+                continue;
+            }
+            for (uint32_t bit = 0; bit < 64; bit++) {
+                const uint32_t slot = static_cast<uint32_t>(word * 64 + bit);
+                const bool dirty = ((bits >> bit) & 1u) != 0 && slot < lightCount;
+                if (dirty && runStart == ~0u) {
+                    runStart = slot;
+                } else if (!dirty && runStart != ~0u) {
+                    writeRange(runStart, slot);
+                    runStart = ~0u;
+                }
+            }
+        }
+        if (runStart != ~0u) {
+            writeRange(runStart, std::min(lightCount, static_cast<uint32_t>(pf.dirtySlots.size() * 64)));
         }
+        std::fill(pf.dirtySlots.begin(), pf.dirtySlots.end(), 0);
     }
-}
+}
\ No newline at end of file
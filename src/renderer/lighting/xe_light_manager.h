@@ -19,6 +19,14 @@ namespace xe {
         uint32_t pad1{0}, pad2{0}, pad3{0};
     };
 
+    // Stable id of a light, its slot in the GPU array can move when other lights are destroyed
+    using LightHandle = uint32_t;
+    static constexpr LightHandle INVALID_LIGHT_HANDLE = ~0u;
+
+    // Lights live in one SSBO per frame in flight (header + GPULight[]). Changes are tracked per slot with a
+    // dirty bitmask for every frame in flight, so upload() only copies the ranges that changed since the same
+    // frame slot was last uploaded. Each frame slot grows its own SSBO in upload(), after its fence was waited on,
+    // so a buffer is never freed while a frame in flight still reads it.
     class XELightManager {
     public:
         XELightManager(XEDevice& device, uint32_t framesInFlight,uint32_t initialCapacity);
@@ -28,14 +36,26 @@ namespace xe {
         XELightManager& operator=(const XELightManager&) = delete;
 
         // CPU side
-        void clear();  // call once per frame, before filling
-        uint32_t addLight(GPULight& light);  // return index
-        void setLight(uint32_t index, GPULight& light);  // modify properties of light at a specific index
-        void reserve(uint32_t minCapacity);  // optional manual grow
-        void upload(uint32_t frameIndex);  // Upload SSBO to gpu at index frameIndex
+        LightHandle createLight(const GPULight& light);
+        void updateLight(LightHandle handle, const GPULight& light);  // no-op when nothing changed
+        void destroyLight(LightHandle handle);  // the last light moves into the freed slot
+        const GPULight& getLight(LightHandle handle) const { return gpuLights[handleSlots[handle]]; }
+        uint32_t getLightSlot(LightHandle handle) const { return handleSlots[handle]; }  // index in the SSBO
+        void reserve(uint32_t minCapacity);  // optional manual grow, each frame slot grows at its next upload()
+        void upload(uint32_t frameIndex);  // Copies what changed since this frame slot was last uploaded
+
+        // What the last upload() copied
+        VkDeviceSize getLastUploadBytes() const { return lastUploadBytes; }
+        uint32_t getLastUploadRanges() const { return lastUploadRanges; }
 
         void createOrthographicProjection();
 
+        // Clustered lighting, binding 1 (ClusterInfo) and 2 (per-cluster light lists) of the light set.
+        // The lists are written by XELightClusterSystem on the GPU.
+        void setClusterInfo(uint32_t frameIndex, const GPUClusterInfo& info);
+        XEBuffer& getClusterLightBuffer(uint32_t frameIndex) const { return *perFrameLightBuffers[frameIndex].clusterLights; }
+        uint32_t getLightCount() const { return static_cast<uint32_t>(gpuLights.size()); }
+
         // Return descriptor index
         VkDescriptorSet descriptorSet(uint32_t frameIndex) const { return LightSSBODescriptorSets[frameIndex]; }
         VkDescriptorSetLayout getDescriptorLayout() const { return LightSSBOSetLayout->getDescriptorSetLayout(); }
@@ -44,23 +64,35 @@ namespace xe {
         struct PerFrame {
             std::unique_ptr<XEBuffer> buffer; // single blob: header + lights[]
             VkDeviceSize totalSize{0};
+            uint32_t capacity{0};  // lights
+            std::unique_ptr<XEBuffer> clusterInfo;
+            std::unique_ptr<XEBuffer> clusterLights; // LIGHT_CLUSTER_COUNT x (count + MAX_LIGHTS_PER_CLUSTER indices)
+            std::vector<uint64_t> dirtySlots;  // one bit per light slot
+            bool headerDirty{true};
         };
 
         void allocateDescriptorSets_();
-        void createBuffers_(uint32_t capacityLights);
-        void destroyBuffers_();
-        void rewriteDescriptorSets_(); // (re)point sets to the per-frame buffers
+        void createBuffers_(PerFrame& frame, uint32_t capacityLights);
+        void createClusterBuffers_();
+        void rewriteDescriptorSet_(uint32_t frameIndex); // (re)point the set to the frame's buffers
+        void markDirty_(uint32_t slot);
+        void markAllDirty_(PerFrame& frame);
 
         XEDevice& device;
         uint32_t framesInFlight;
 
         // CPU side Buffer
         std::vector<GPULight> gpuLights{};
+        std::vector<LightHandle> slotHandles{};   // per slot
+        std::vector<uint32_t> handleSlots{};      // per handle, ~0u when free
+        std::vector<LightHandle> freeHandles{};
         LightSSBOHeader hdr{}; // filled during upload
+        VkDeviceSize lastUploadBytes{0};
+        uint32_t lastUploadRanges{0};
 
         // GPU side resources
         std::vector<PerFrame> perFrameLightBuffers;
-        uint32_t capacity{0};
+        uint32_t capacity{0};  // every frame slot grows to at least this at its next upload
 
         std::unique_ptr<XEDescriptorPool> LightSSBOPool{};
         std::unique_ptr<XEDescriptorSetLayout> LightSSBOSetLayout{};
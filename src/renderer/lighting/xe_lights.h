@@ -14,5 +14,37 @@ namespace xe {
         glm::vec4 direction; // xyz, w=unused
         glm::vec4 param; // x=range, y=innerCos, z=outerCos, w=specPow
     };
+
+    // Clustered forward lighting: screen tiles x exponential depth slices of the camera frustum
+    static constexpr uint32_t LIGHT_CLUSTER_X = 16;
+    static constexpr uint32_t LIGHT_CLUSTER_Y = 9;
+    static constexpr uint32_t LIGHT_CLUSTER_Z = 24;
+    static constexpr uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+    // Each cluster owns a count followed by this many light indices
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 255;
+
+    // std140 ClusterInfo of light_cluster.comp / simple_fragment.frag
+    struct GPUClusterInfo {
+        glm::uvec4 grid{LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z, MAX_LIGHTS_PER_CLUSTER};
+        glm::vec4 tileSize{1.f};     // xy = tile size in pixels
+        glm::vec4 depth{0.f};        // x = near, y = far, z = slice scale, w = slice bias
+        glm::vec4 projection{0.f};   // x = P[0][0], y = P[1][1], z = clustered lighting on
+        glm::mat4 view{1.f};
+    };
+    static_assert(sizeof(GPUClusterInfo) == 128, "must match the std140 ClusterInfo struct");
+
+    // Point and spot light shadows: one atlas tile per cube face (point) or per light (spot)
+    static constexpr uint32_t MAX_SHADOWED_LOCAL_LIGHTS = 32;
+    static constexpr uint32_t MAX_LOCAL_SHADOW_TILES = MAX_SHADOWED_LOCAL_LIGHTS * 6;
+    // Size of the light slot -> tile map, lights in later slots are never shadowed
+    static constexpr uint32_t MAX_LOCAL_SHADOW_SLOTS = 4096;
+
+    // std430 LocalShadowTile of simple_fragment.frag
+    struct GPULocalShadowTile {
+        glm::mat4 viewProjection{1.f};
+        glm::vec4 rect{0.f};     // xy = atlas uv offset, zw = uv scale
+        glm::vec4 params{0.f};   // x = world texel size per unit of distance, y = half texel in tile uv
+    };
+    static_assert(sizeof(GPULocalShadowTile) == 96, "must match the std430 LocalShadowTile struct");
 }
 
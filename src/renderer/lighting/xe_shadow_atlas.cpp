@@ -0,0 +1,136 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/lighting/xe_shadow_atlas.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace xe {
+
+    static bool isPowerOfTwo(uint32_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    XEShadowAtlas::XEShadowAtlas(uint32_t atlasSize, uint32_t minTileSize): atlasSize(atlasSize),
+        minTileSize(minTileSize) {
+        if (!isPowerOfTwo(atlasSize) || !isPowerOfTwo(minTileSize) || minTileSize > atlasSize) {
+            throw std::runtime_error("shadow atlas and tile sizes must be powers of two!");
+        }
+
+        const uint32_t levelCount = levelOf(minTileSize) + 1;
+        levels.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            levels[level].resize(size_t(1) << (2 * level));
+        }
+        clear();
+    }
+
+    void XEShadowAtlas::clear() {
+        for (auto& nodes: levels) {
+            std::fill(nodes.begin(), nodes.end(), NodeState::Unused);
+        }
+        levels[0][0] = NodeState::Free;
+        usedTexels = 0;
+    }
+
+    uint32_t XEShadowAtlas::roundTileSize(float texels) const {
+        uint32_t size = minTileSize;
+        while (size < atlasSize && static_cast<float>(size) < texels) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    uint32_t XEShadowAtlas::levelOf(uint32_t size) const {
+        uint32_t level = 0;
+        while ((atlasSize >> level) > size) {
+            level++;
+        }
+        return level;
+    }
+
+    XEShadowAtlas::Tile XEShadowAtlas::allocate(uint32_t size) {
+        const uint32_t tileSize = roundTileSize(static_cast<float>(size));
+        const uint32_t level = levelOf(tileSize);
+
+        const int32_t index = findFree(level);
+        if (index < 0) {
+            return {};
+        }
+        levels[level][index] = NodeState::Allocated;
+        usedTexels += uint64_t(tileSize) * tileSize;
+
+        const uint32_t dim = 1u << level;
+        return {(index % dim) * tileSize, (index / dim) * tileSize, tileSize};
+    }
+
+    void XEShadowAtlas::release(const Tile& tile) {
+        if (!tile.valid()) {
+            return;
+        }
+
+        uint32_t level = levelOf(tile.size);
+        uint32_t x = tile.x / tile.size;
+        uint32_t y = tile.y / tile.size;
+        uint32_t index = y * (1u << level) + x;
+        if (levels[level][index] != NodeState::Allocated) {
+            throw std::runtime_error("releasing a shadow atlas tile that is not allocated!");
+        }
+        levels[level][index] = NodeState::Free;
+        usedTexels -= uint64_t(tile.size) * tile.size;
+
+        // Merge upwards while all four siblings are free
+        while (level > 0) {
+            const uint32_t dim = 1u << level;
+            const uint32_t first = (y & ~1u) * dim + (x & ~1u);
+            auto& nodes = levels[level];
+            if (nodes[first] != NodeState::Free || nodes[first + 1] != NodeState::Free ||
+                nodes[first + dim] != NodeState::Free || nodes[first + dim + 1] != NodeState::Free) {
+                break;
+            }
+            nodes[first] = nodes[first + 1] = nodes[first + dim] = nodes[first + dim + 1] = NodeState::Unused;
+
+            level--;
+            x >>= 1;
+            y >>= 1;
+            levels[level][y * (1u << level) + x] = NodeState::Free;
+        }
+    }
+
+    int32_t XEShadowAtlas::findFree(uint32_t level) {
+        // Free nodes of the right size come from already split parents, so small tiles fill up holes first
+        auto& nodes = levels[level];
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i] == NodeState::Free) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        if (level == 0) {
+            return -1;
+        }
+
+        const int32_t parent = findFree(level - 1);
+        if (parent < 0) {
+            return -1;
+        }
+        split(level - 1, static_cast<uint32_t>(parent));
+
+        const uint32_t parentDim = 1u << (level - 1);
+        const uint32_t x = static_cast<uint32_t>(parent) % parentDim;
+        const uint32_t y = static_cast<uint32_t>(parent) / parentDim;
+        return static_cast<int32_t>(2 * y * (parentDim * 2) + 2 * x);
+    }
+
+    void XEShadowAtlas::split(uint32_t level, uint32_t index) {
+        levels[level][index] = NodeState::Split;
+
+        const uint32_t dim = 1u << level;
+        const uint32_t childDim = dim * 2;
+        const uint32_t first = 2 * (index / dim) * childDim + 2 * (index % dim);
+        auto& children = levels[level + 1];
+        children[first] = children[first + 1] = NodeState::Free;
+        children[first + childDim] = children[first + childDim + 1] = NodeState::Free;
+    }
+}
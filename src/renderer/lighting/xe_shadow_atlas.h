@@ -0,0 +1,58 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+
+    // Quadtree allocator of square power-of-two tiles in a square shadow atlas. A free node is split into four
+    // children when a smaller tile is needed, and four free siblings merge back into their parent on release,
+    // so mixed tile sizes pack without a repack pass. Only bookkeeping, the atlas image lives elsewhere.
+    class XEShadowAtlas {
+    public:
+        struct Tile {
+            uint32_t x = 0;     // texels
+            uint32_t y = 0;
+            uint32_t size = 0;  // 0 = no tile
+
+            bool valid() const { return size != 0; }
+        };
+
+        XEShadowAtlas(uint32_t atlasSize, uint32_t minTileSize);
+
+        // size is rounded up to a power of two within [minTileSize, atlasSize], an invalid tile when full
+        Tile allocate(uint32_t size);
+        void release(const Tile& tile);
+        void clear();
+
+        // The size allocate() would hand out for a request of `texels`
+        uint32_t roundTileSize(float texels) const;
+
+        uint32_t getAtlasSize() const { return atlasSize; }
+        uint32_t getMinTileSize() const { return minTileSize; }
+        uint64_t getUsedTexels() const { return usedTexels; }
+
+    private:
+        enum class NodeState : uint8_t {
+            Unused,     // inside a free or allocated ancestor
+            Free,
+            Split,
+            Allocated
+        };
+
+        uint32_t levelOf(uint32_t size) const;
+        // A free node at level, splitting a coarser one if needed, -1 when none is left
+        int32_t findFree(uint32_t level);
+        void split(uint32_t level, uint32_t index);
+
+        uint32_t atlasSize;
+        uint32_t minTileSize;
+        uint64_t usedTexels = 0;
+        // levels[l] holds (1 << l) x (1 << l) nodes of atlasSize >> l texels, row major
+        std::vector<std::vector<NodeState>> levels;
+    };
+}
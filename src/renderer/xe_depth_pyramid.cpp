@@ -0,0 +1,245 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/xe_depth_pyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace xe {
+
+    struct ReducePushConstantData {
+        int32_t srcWidth;
+        int32_t srcHeight;
+        int32_t dstWidth;
+        int32_t dstHeight;
+    };
+
+    static uint32_t previousPowerOfTwo(uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    XEDepthPyramid::XEDepthPyramid(XEDevice &device, uint32_t framesInFlight, VkExtent2D depthExtent):
+        xe_device(device), framesInFlight(framesInFlight) {
+
+        descriptorSetLayout = XEDescriptorSetLayout::Builder(device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+        descriptorPool = XEDescriptorPool::Builder(device)
+        .setMaxSets(MAX_LEVELS + framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_LEVELS + framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_LEVELS + framesInFlight)
+        .build();
+
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ReducePushConstantData);
+
+        VkDescriptorSetLayout setLayout = descriptorSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+        }
+
+        // Point sampling, the reduction and the occlusion test fetch exact texels
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+
+        if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+        }
+
+        createPyramid(depthExtent);
+    }
+
+    XEDepthPyramid::~XEDepthPyramid() {
+        destroyPyramid();
+        reducePipeline.reset();
+        vkDestroySampler(xe_device.device(), sampler, nullptr);
+        vkDestroyPipelineLayout(xe_device.device(), pipelineLayout, nullptr);
+    }
+
+    void XEDepthPyramid::createPyramid(VkExtent2D depthExtent) {
+        sourceExtent = depthExtent;
+        width = previousPowerOfTwo(std::max(depthExtent.width, 1u));
+        height = previousPowerOfTwo(std::max(depthExtent.height, 1u));
+        levelCount = 1;
+        while (levelCount < MAX_LEVELS && (std::max(width, height) >> levelCount) > 0) {
+            levelCount++;
+        }
+        generation++;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        xe_device.createImageWithInfoVMA(imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, pyramidImage, pyramidAllocation);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = pyramidImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(xe_device.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view!");
+        }
+
+        levelViews.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            if (vkCreateImageView(xe_device.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid level view!");
+            }
+        }
+
+        // GENERAL for its whole life, written as storage, sampled by the next level and the culling pass
+        VkCommandBuffer commandBuffer = xe_device.beginSingleTimeCommandsGraphics();
+        VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = pyramidImage;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+        xe_device.endSingleTimeCommandsGraphics(commandBuffer);
+
+        descriptorPool->resetPool();
+        levelSets.assign(levelCount, VK_NULL_HANDLE);
+        for (uint32_t level = 1; level < levelCount; level++) {
+            VkDescriptorImageInfo srcInfo{sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+            XEDescriptorWriter(*descriptorSetLayout, *descriptorPool)
+            .writeImage(0, &srcInfo)
+            .writeImage(1, &dstInfo)
+            .build(levelSets[level]);
+        }
+        depthSets.assign(framesInFlight, VK_NULL_HANDLE);
+    }
+
+    void XEDepthPyramid::destroyPyramid() {
+        for (VkImageView view: levelViews) {
+            vkDestroyImageView(xe_device.device(), view, nullptr);
+        }
+        levelViews.clear();
+        if (pyramidView != VK_NULL_HANDLE) {
+            vkDestroyImageView(xe_device.device(), pyramidView, nullptr);
+            pyramidView = VK_NULL_HANDLE;
+        }
+        if (pyramidImage != VK_NULL_HANDLE) {
+            vmaDestroyImage(xe_device.vmaAllocator(), pyramidImage, pyramidAllocation);
+            pyramidImage = VK_NULL_HANDLE;
+        }
+    }
+
+    void XEDepthPyramid::resize(VkExtent2D depthExtent) {
+        if (depthExtent.width == sourceExtent.width && depthExtent.height == sourceExtent.height) {
+            return;
+        }
+        // The other frame in flight may still read the old pyramid
+        vkDeviceWaitIdle(xe_device.device());
+        destroyPyramid();
+        createPyramid(depthExtent);
+    }
+
+    void XEDepthPyramid::build(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView,
+        VkExtent2D depthExtent) {
+        resize(depthExtent);
+        if (!reducePipeline) {
+            reducePipeline = std::make_unique<XEPipeline>(xe_device, "assets\\shaders\\depth_reduce.spv", pipelineLayout);
+        }
+
+        // The depth view changes with the acquired swap chain image, this frame slot's set is free to rewrite
+        VkDescriptorImageInfo depthInfo{sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo level0Info{VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+        XEDescriptorWriter depthWriter{*descriptorSetLayout, *descriptorPool};
+        depthWriter.writeImage(0, &depthInfo).writeImage(1, &level0Info);
+        if (depthSets[frameIndex] == VK_NULL_HANDLE) {
+            depthWriter.build(depthSets[frameIndex]);
+        } else {
+            depthWriter.overwrite(depthSets[frameIndex]);
+        }
+
+        // Last frame's occlusion test may still be reading the pyramid
+        VkMemoryBarrier readBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        readBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        readBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &readBarrier, 0, nullptr, 0, nullptr);
+
+        reducePipeline->bind(commandBuffer);
+
+        uint32_t srcWidth = depthExtent.width;
+        uint32_t srcHeight = depthExtent.height;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            const uint32_t dstWidth = std::max(width >> level, 1u);
+            const uint32_t dstHeight = std::max(height >> level, 1u);
+
+            VkDescriptorSet set = level == 0 ? depthSets[frameIndex] : levelSets[level];
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0,
+                nullptr);
+
+            ReducePushConstantData push{static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight),
+                static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight)};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkCmdDispatch(commandBuffer, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+            // Next level (and after the last one the culling pass) reads what was just written
+            VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = pyramidImage;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_device.h"
+#include "renderer/xe_descriptors.h"
+#include "renderer/xe_pipeline.h"
+#include "vulkan/vulkan.h"
+#include "vma/vk_mem_alloc.h"
+
+#include <memory>
+#include <vector>
+
+namespace xe {
+
+    // Hierarchical-Z pyramid of the swap chain depth for occlusion culling. Level 0 is the depth extent rounded
+    // down to powers of two, every texel holds the farthest depth of the texels it covers one level up (max
+    // reduction, the depth buffer is not reversed), so a box whose nearest depth is behind it is hidden.
+    // The image stays in VK_IMAGE_LAYOUT_GENERAL, written as storage and read through getImageView().
+    class XEDepthPyramid {
+    public:
+        static constexpr uint32_t MAX_LEVELS = 16;
+
+        XEDepthPyramid(XEDevice& device, uint32_t framesInFlight, VkExtent2D depthExtent);
+        ~XEDepthPyramid();
+
+        XEDepthPyramid(const XEDepthPyramid&) = delete;
+        XEDepthPyramid& operator=(const XEDepthPyramid&) = delete;
+
+        // Recreates the pyramid for a new depth extent (waits for the device). Call before recording anything that
+        // binds getImageView() this frame, a descriptor set updated after being bound invalidates the command buffer.
+        void resize(VkExtent2D depthExtent);
+
+        // Records the reduction chain from a depth attachment in DEPTH_STENCIL_READ_ONLY_OPTIMAL, outside of any
+        // render pass
+        void build(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView, VkExtent2D depthExtent);
+
+        VkImageView getImageView() const { return pyramidView; }
+        VkSampler getSampler() const { return sampler; }
+        uint32_t getWidth() const { return width; }
+        uint32_t getHeight() const { return height; }
+        uint32_t getLevelCount() const { return levelCount; }
+        // Bumped whenever the image is recreated, descriptor sets holding getImageView() must be rewritten
+        uint32_t getGeneration() const { return generation; }
+
+    private:
+        void createPyramid(VkExtent2D depthExtent);
+        void destroyPyramid();
+
+        XEDevice& xe_device;
+        uint32_t framesInFlight;
+
+        VkImage pyramidImage{VK_NULL_HANDLE};
+        VmaAllocation pyramidAllocation{};
+        VkImageView pyramidView{VK_NULL_HANDLE};
+        std::vector<VkImageView> levelViews;
+        VkSampler sampler{VK_NULL_HANDLE};
+
+        VkExtent2D sourceExtent{0, 0};
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t levelCount{0};
+        uint32_t generation{0};
+
+        std::unique_ptr<XEPipeline> reducePipeline;
+        VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+        std::unique_ptr<XEDescriptorPool> descriptorPool{};
+        std::unique_ptr<XEDescriptorSetLayout> descriptorSetLayout{};
+        std::vector<VkDescriptorSet> levelSets;      // level i reads level i - 1, [0] unused
+        std::vector<VkDescriptorSet> depthSets;      // level 0 per frame in flight, rewritten every build
+    };
+}
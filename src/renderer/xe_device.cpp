@@ -186,12 +186,40 @@ namespace xe
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.depthClamp = VK_TRUE;
+        // Optional, used by the indirect draw path
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        // Optional, cooked textures are BC7/BC5 (the raw RGBA8 path is the fallback)
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        // Optional, used by the single pass shadow cascades (one viewport per cascade)
+        deviceFeatures.multiViewport = supportedFeatures.multiViewport;
+        enabledFeatures = deviceFeatures;
+
+        // Optional, used by the GPU culling path (vkCmdDrawIndexedIndirectCount)
+        VkPhysicalDeviceVulkan12Features supportedFeatures12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        const bool vulkan12 = properties.apiVersion >= VK_API_VERSION_1_2;
+        if (vulkan12) {
+            VkPhysicalDeviceFeatures2 supportedFeatures2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+            supportedFeatures2.pNext = &supportedFeatures12;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+        }
+
+        VkPhysicalDeviceVulkan12Features deviceFeatures12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        deviceFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+        enabledFeatures12.drawIndirectCount = deviceFeatures12.drawIndirectCount;
+        // Optional, gl_ViewportIndex from the vertex shader for the single pass shadow cascades
+        deviceFeatures12.shaderOutputViewportIndex = supportedFeatures12.shaderOutputViewportIndex;
+        enabledFeatures12.shaderOutputViewportIndex = deviceFeatures12.shaderOutputViewportIndex;
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = vulkan12 ? &deviceFeatures12 : nullptr;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
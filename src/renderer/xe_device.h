@@ -89,6 +89,10 @@ namespace xe {
             VmaAllocation& allocation);
 
         VkPhysicalDeviceProperties properties;
+        // Core features enabled on the logical device (optional ones only when supported)
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        // Vulkan 1.2 features enabled on the logical device (sType/pNext are not meaningful here)
+        VkPhysicalDeviceVulkan12Features enabledFeatures12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
 
         private:
         void createInstance();
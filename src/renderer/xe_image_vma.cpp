@@ -9,28 +9,45 @@
 #include <iostream>
 
 namespace xe {
-    XEImageVMA::XEImageVMA(XEDevice &device, int width, int height, int n_channels, uint32_t mipLevels, void* pixels,
-        VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage): device(device) {
-
-        VkDeviceSize size = width * height * n_channels;
-        std::cout << "Creating VMA Texture image. Size: " << size << std::endl;
+    XEImageVMA::XEImageVMA(XEDevice &device, int width, int height, const std::vector<MipRegion> &mips,
+        const void* data, VkDeviceSize dataSize, VkFormat format, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage)
+        : device(device) {
+        const uint32_t mipLevels = static_cast<uint32_t>(mips.size());
 
         XEBufferVMA stagingBuffer(
             device,
-            size,
+            dataSize,
             1,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VMA_MEMORY_USAGE_CPU_ONLY);
 
         stagingBuffer.map();
-        stagingBuffer.writeToBuffer(pixels);
+        stagingBuffer.writeToBuffer(const_cast<void*>(data));
 
-        createImage(width, height, mipLevels, 1, format, tiling, usage, memoryUsage);
+        createImage(width, height, mipLevels, 1, format, VK_IMAGE_TILING_OPTIMAL, usage, memoryUsage);
         transitionImageLayout(format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-        device.copyBufferToImage(stagingBuffer.getBuffer(), image, static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height), 1);
-        //transitionImageLayout(format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
-        generateMipmaps(width, height, mipLevels);
+
+        std::vector<VkBufferImageCopy> regions(mipLevels);
+        for (uint32_t mip = 0; mip < mipLevels; mip++) {
+            VkBufferImageCopy& region = regions[mip];
+            region.bufferOffset = mips[mip].offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mip;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {mips[mip].width, mips[mip].height, 1};
+        }
+
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommandsTransfer();
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            mipLevels, regions.data());
+        device.endSingleTimeCommandsTransfer(commandBuffer);
+
+        transitionImageLayout(format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            mipLevels);
         stagingBuffer.unmap();
 
         createImageView(mipLevels, 1, format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D);
@@ -175,84 +192,4 @@ namespace xe {
         if (needsGraphicsQueue) { device.endSingleTimeCommandsGraphics(commandBuffer); }
         else { device.endSingleTimeCommandsTransfer(commandBuffer); }
     }
-
-    void XEImageVMA::generateMipmaps(int32_t width, int32_t height, uint32_t mipLevels) {
-        VkCommandBuffer command_buffer = device.beginSingleTimeCommandsGraphics();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = width;
-        int32_t mipHeight = height;
-
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(command_buffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = { 0, 0, 0 };
-            blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = { 0, 0, 0 };
-            blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(command_buffer,
-                image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR);
-
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(command_buffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(command_buffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        device.endSingleTimeCommandsGraphics(command_buffer);
-    }
-}
+}
\ No newline at end of file
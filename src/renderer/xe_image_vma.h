@@ -8,19 +8,27 @@
 #include "vulkan/vulkan.h"
 #include "vma/vk_mem_alloc.h"
 #include <memory>
+#include <vector>
 
 namespace xe {
     class XEImageVMA {
     public:
-        // constructor for stbi path
+        // One buffer to image copy per mip level, offsets into the pixel data
+        struct MipRegion {
+            uint32_t width;
+            uint32_t height;
+            VkDeviceSize offset;
+        };
+
+        // constructor for textures, mips precomputed on the CPU (RGBA8 or block compressed), every level copied
+        // as is in a single copy, no blits
         XEImageVMA(XEDevice& device,
                    int width,
                    int height,
-                   int n_channels,
-                   uint32_t mipLevels,
-                   void* pixels,
+                   const std::vector<MipRegion>& mips,
+                   const void* data,
+                   VkDeviceSize dataSize,
                    VkFormat format,
-                   VkImageTiling tiling,
                    VkImageUsageFlags usage,
                    VmaMemoryUsage memoryUsage);
 
@@ -50,7 +58,6 @@ namespace xe {
         void* mappedMemory = nullptr;
 
         void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-        void generateMipmaps(int32_t width, int32_t height, uint32_t mipLevels);
         void createImage(int width, int height, uint32_t mipLevels, uint32_t n_layers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
         VmaMemoryUsage memoryUsage);
         void createImageView(uint32_t mipLevels, uint32_t n_layers, VkFormat format, VkImageAspectFlags aspect,
@@ -0,0 +1,274 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/xe_mesh_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace xe {
+
+    static constexpr char CACHE_MAGIC[4] = {'X', 'E', 'M', 'C'};
+    static constexpr uint64_t CACHE_ALIGNMENT = 16;
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Reads the JSON string starting at the opening quote at pos, leaves pos past the closing one
+    static std::string readJsonString(const char* json, size_t size, size_t& pos) {
+        std::string out;
+        for (pos++; pos < size && json[pos] != '"'; pos++) {
+            if (json[pos] == '\\' && pos + 1 < size) {
+                pos++;
+            }
+            out += json[pos];
+        }
+        pos++;
+        return out;
+    }
+
+    static std::string decodeUri(const std::string& uri) {
+        std::string out;
+        for (size_t i = 0; i < uri.size(); i++) {
+            if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+                std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+                out += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                out += uri[i];
+            }
+        }
+        return out;
+    }
+
+    // External buffer files of a .gltf ("buffers": [{"uri": ...}]), embedded data: uris are part of the json itself
+    static std::vector<std::string> gltfBufferUris(const char* json, size_t size) {
+        std::vector<std::string> uris;
+        size_t pos = 0;
+        int depth = 0;
+        int buffersDepth = -1;  // depth of the "buffers" array while inside it
+        std::string lastKey;
+
+        while (pos < size) {
+            const char c = json[pos];
+            if (c == '"') {
+                const std::string value = readJsonString(json, size, pos);
+                while (pos < size && std::isspace(static_cast<unsigned char>(json[pos]))) { pos++; }
+                if (pos < size && json[pos] == ':') {
+                    lastKey = value;
+                } else if (buffersDepth >= 0 && depth == buffersDepth + 1 && lastKey == "uri" &&
+                    value.compare(0, 5, "data:") != 0) {
+                    uris.push_back(decodeUri(value));
+                }
+                continue;
+            }
+
+            if (c == '[' || c == '{') {
+                if (c == '[' && depth == 1 && lastKey == "buffers") {
+                    buffersDepth = depth + 1;
+                }
+                depth++;
+            } else if (c == ']' || c == '}') {
+                depth--;
+                if (depth < buffersDepth) {
+                    buffersDepth = -1;
+                }
+            }
+            if (c != ':' && !std::isspace(static_cast<unsigned char>(c))) {
+                lastKey.clear();
+            }
+            pos++;
+        }
+        return uris;
+    }
+
+    std::string XEMeshCache::cachePathFor(const std::string &modelPath) {
+        return modelPath + ".xemc";
+    }
+
+    bool XEMeshCache::computeKey(const std::string &modelPath, uint32_t importFlags, uint32_t cookFlags, Key &key) {
+        XEMappedFile source{};
+        if (!source.open(modelPath)) {
+            return false;
+        }
+
+        key.sourceHash = hashBytes(source.data(), source.size());
+
+        // A .gltf keeps its geometry in separate buffer files, an edited .bin must invalidate the cache too
+        std::string extension = std::filesystem::path(modelPath).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".gltf") {
+            const std::filesystem::path modelDir = std::filesystem::path(modelPath).parent_path();
+            for (const std::string& uri: gltfBufferUris(reinterpret_cast<const char*>(source.data()), source.size())) {
+                const std::string bufferPath = (modelDir / uri).string();
+                XEMappedFile buffer{};
+                if (!buffer.open(bufferPath)) {
+                    std::cout << "[MeshCache] Not caching " << modelPath << ": cannot read buffer " << bufferPath
+                        << std::endl;
+                    return false;
+                }
+                key.sourceHash = hashBytes(uri.data(), uri.size(), key.sourceHash);
+                key.sourceHash = hashBytes(buffer.data(), buffer.size(), key.sourceHash);
+            }
+        }
+
+        key.importFlags = importFlags;
+        key.cookFlags = cookFlags;
+        return true;
+    }
+
+    bool XEMeshCache::open(const std::string &cachePath, const Key &key) {
+        if (!file.open(cachePath)) {
+            return false;
+        }
+
+        auto reject = [&](const char* reason) {
+            std::cout << "[MeshCache] Ignoring " << cachePath << ": " << reason << std::endl;
+            file.close();
+            header = nullptr;
+            return false;
+        };
+
+        if (file.size() < sizeof(Header)) { return reject("truncated header"); }
+
+        header = reinterpret_cast<const Header*>(file.data());
+        if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) { return reject("bad magic"); }
+        if (header->version != VERSION) { return reject("version mismatch"); }
+        if (header->vertexFormat > static_cast<uint32_t>(XEModel::VertexFormat::Packed)) { return reject("bad vertex format"); }
+        const uint32_t vertexStride = XEModel::vertexStride(vertexFormat());
+        if (header->vertexStride != vertexStride || header->meshStride != sizeof(XEModel::XEMesh)) {
+            return reject("layout mismatch");
+        }
+        if (header->sourceHash != key.sourceHash || header->importFlags != key.importFlags ||
+            header->cookFlags != key.cookFlags) {
+            return reject("stale");
+        }
+
+        const uint64_t vertexBytes = static_cast<uint64_t>(header->vertexCount) * vertexStride;
+        const uint64_t indexBytes = static_cast<uint64_t>(header->indexCount) * sizeof(uint32_t);
+        const uint64_t meshBytes = static_cast<uint64_t>(header->meshCount) * sizeof(XEModel::XEMesh);
+
+        if (header->vertexDataOffset + vertexBytes > file.size() ||
+            header->indexDataOffset + indexBytes > file.size() ||
+            header->meshDataOffset + meshBytes > file.size() ||
+            header->materialDataOffset > file.size()) {
+            return reject("truncated data");
+        }
+
+        vertexData = file.data() + header->vertexDataOffset;
+        indexData = reinterpret_cast<const uint32_t*>(file.data() + header->indexDataOffset);
+        return true;
+    }
+
+    std::vector<XEModel::XEMesh> XEMeshCache::meshes() const {
+        std::vector<XEModel::XEMesh> result(header->meshCount);
+        std::memcpy(result.data(), file.data() + header->meshDataOffset, result.size() * sizeof(XEModel::XEMesh));
+        return result;
+    }
+
+    std::vector<XEMaterialDesc> XEMeshCache::materialDescs() const {
+        std::vector<XEMaterialDesc> result(header->materialCount);
+
+        const uint8_t* cursor = file.data() + header->materialDataOffset;
+        const uint8_t* end = file.data() + file.size();
+
+        auto readString = [&](std::string& out) {
+            uint32_t length = 0;
+            if (cursor + sizeof(length) > end) return;
+            std::memcpy(&length, cursor, sizeof(length));
+            cursor += sizeof(length);
+            if (cursor + length > end) return;
+            out.assign(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+        };
+
+        for (auto& desc: result) {
+            readString(desc.albedoFileName);
+            readString(desc.normalFileName);
+        }
+        return result;
+    }
+
+    bool XEMeshCache::write(const std::string &cachePath, const Key &key, const XEModel::Builder &builder) {
+        Header hdr{};
+        std::memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        hdr.version = VERSION;
+        hdr.sourceHash = key.sourceHash;
+        hdr.importFlags = key.importFlags;
+        hdr.cookFlags = key.cookFlags;
+        hdr.vertexFormat = static_cast<uint32_t>(builder.vertexFormat);
+        hdr.vertexStride = XEModel::vertexStride(builder.vertexFormat);
+        hdr.meshStride = sizeof(XEModel::XEMesh);
+        hdr.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        hdr.indexCount = static_cast<uint32_t>(builder.indices.size());
+        hdr.meshCount = static_cast<uint32_t>(builder.meshes.size());
+        hdr.materialCount = static_cast<uint32_t>(builder.materialDescs.size());
+
+        const void* vertexSource = builder.vertexFormat == XEModel::VertexFormat::Packed ?
+            static_cast<const void*>(builder.packedVertices.data()) : static_cast<const void*>(builder.vertices.data());
+        const uint64_t vertexBytes = static_cast<uint64_t>(hdr.vertexCount) * hdr.vertexStride;
+
+        hdr.vertexDataOffset = alignUp(sizeof(Header), CACHE_ALIGNMENT);
+        hdr.indexDataOffset = alignUp(hdr.vertexDataOffset + vertexBytes, CACHE_ALIGNMENT);
+        hdr.meshDataOffset = alignUp(hdr.indexDataOffset + builder.indices.size() * sizeof(uint32_t),
+            CACHE_ALIGNMENT);
+        hdr.materialDataOffset = alignUp(hdr.meshDataOffset + builder.meshes.size() * sizeof(XEModel::XEMesh),
+            CACHE_ALIGNMENT);
+
+        // Write next to the destination and rename, so a crash never leaves a half-written cache behind
+        const std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                return false;
+            }
+
+            auto padTo = [&](uint64_t offset) {
+                static const char zeros[CACHE_ALIGNMENT] = {};
+                uint64_t pos = static_cast<uint64_t>(out.tellp());
+                if (offset > pos) out.write(zeros, static_cast<std::streamsize>(offset - pos));
+            };
+
+            out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+            padTo(hdr.vertexDataOffset);
+            out.write(static_cast<const char*>(vertexSource), static_cast<std::streamsize>(vertexBytes));
+            padTo(hdr.indexDataOffset);
+            out.write(reinterpret_cast<const char*>(builder.indices.data()),
+                static_cast<std::streamsize>(builder.indices.size() * sizeof(uint32_t)));
+            padTo(hdr.meshDataOffset);
+            out.write(reinterpret_cast<const char*>(builder.meshes.data()),
+                static_cast<std::streamsize>(builder.meshes.size() * sizeof(XEModel::XEMesh)));
+            padTo(hdr.materialDataOffset);
+
+            auto writeString = [&](const std::string& s) {
+                uint32_t length = static_cast<uint32_t>(s.size());
+                out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                out.write(s.data(), length);
+            };
+
+            for (const auto& desc: builder.materialDescs) {
+                writeString(desc.albedoFileName);
+                writeString(desc.normalFileName);
+            }
+
+            if (!out.good()) {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+}
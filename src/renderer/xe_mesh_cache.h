@@ -0,0 +1,80 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_model.h"
+#include "renderer/materials/xe_materials.h"
+#include "utils/xe_mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xe {
+
+    // On-disk cache of the fully imported (cooked) mesh data of a model: vertices, indices, the XEMesh table
+    // and the material descriptors. A warm start maps the cooked file and uploads straight from the mapping,
+    // Assimp is never touched.
+    class XEMeshCache {
+    public:
+        // Bump whenever the layout of Vertex/XEMesh or the import pipeline output changes
+        static constexpr uint32_t VERSION = 4;
+
+        struct Key {
+            uint64_t sourceHash = 0;  // content hash of the source model file
+            uint32_t importFlags = 0;  // Assimp post-process flags the data was produced with
+            uint32_t cookFlags = 0;  // XEModel::ImportOptions::cookFlags() the data was produced with
+        };
+
+        XEMeshCache() = default;
+        ~XEMeshCache() = default;
+
+        XEMeshCache(const XEMeshCache&) = delete;
+        XEMeshCache& operator=(const XEMeshCache&) = delete;
+
+        static std::string cachePathFor(const std::string& modelPath);
+        static bool computeKey(const std::string& modelPath, uint32_t importFlags, uint32_t cookFlags, Key& key);
+        static bool write(const std::string& cachePath, const Key& key, const XEModel::Builder& builder);
+
+        // Maps the cooked file. Fails (and leaves nothing mapped) if it is missing, stale or malformed.
+        bool open(const std::string& cachePath, const Key& key);
+
+        // Vertex data in vertexFormat() layout
+        const void* vertices() const { return vertexData; }
+        XEModel::VertexFormat vertexFormat() const { return static_cast<XEModel::VertexFormat>(header->vertexFormat); }
+        uint32_t vertexCount() const { return header->vertexCount; }
+        const uint32_t* indices() const { return indexData; }
+        uint32_t indexCount() const { return header->indexCount; }
+
+        std::vector<XEModel::XEMesh> meshes() const;
+        std::vector<XEMaterialDesc> materialDescs() const;
+
+    private:
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint64_t sourceHash;
+            uint32_t importFlags;
+            uint32_t vertexStride;
+            uint32_t meshStride;
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            uint32_t meshCount;
+            uint32_t materialCount;
+            uint32_t cookFlags;
+            uint32_t vertexFormat;
+            uint32_t pad;
+            uint64_t vertexDataOffset;
+            uint64_t indexDataOffset;
+            uint64_t meshDataOffset;
+            uint64_t materialDataOffset;
+        };
+
+        XEMappedFile file;
+        const Header* header = nullptr;
+        const uint8_t* vertexData = nullptr;
+        const uint32_t* indexData = nullptr;
+    };
+}
@@ -0,0 +1,227 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/xe_mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace xe {
+
+    // Forsyth scoring parameters (https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html)
+    static constexpr int FORSYTH_CACHE_SIZE = 32;
+    static constexpr float FORSYTH_LAST_TRI_SCORE = 0.75f;
+    static constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    static constexpr float FORSYTH_VALENCE_SCALE = 2.0f;
+
+    static float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;  // no triangles left, never pick
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the vertices of the last triangle get a fixed score so the next triangle is not
+                // biased towards a particular edge
+                score = FORSYTH_LAST_TRI_SCORE;
+            } else {
+                const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+
+        // bonus for vertices with few triangles left, gets rid of lone triangles early
+        score += FORSYTH_VALENCE_SCALE / std::sqrt(static_cast<float>(remainingTriangles));
+        return score;
+    }
+
+    void XEMeshOptimizer::weldVertices(std::vector<XEModel::Vertex> &vertices, std::vector<uint32_t> &indices) {
+        std::unordered_map<XEModel::Vertex, uint32_t> uniqueVertices{};
+        uniqueVertices.reserve(vertices.size());
+
+        std::vector<XEModel::Vertex> welded{};
+        welded.reserve(vertices.size());
+        std::vector<uint32_t> remap(vertices.size());
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            auto [it, inserted] = uniqueVertices.try_emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+            if (inserted) {
+                welded.push_back(vertices[i]);
+            }
+            remap[i] = it->second;
+        }
+
+        for (auto& index: indices) {
+            index = remap[index];
+        }
+        vertices.swap(welded);
+    }
+
+    void XEMeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || vertexCount == 0) {
+            return;
+        }
+
+        // Vertex -> triangle adjacency. The live triangles of vertex v are
+        // adjacency[adjacencyOffset[v], adjacencyOffset[v] + remaining[v])
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            remaining[indices[i]]++;
+        }
+
+        std::vector<uint32_t> adjacencyOffset(vertexCount, 0);
+        for (uint32_t v = 1; v < vertexCount; v++) {
+            adjacencyOffset[v] = adjacencyOffset[v - 1] + remaining[v - 1];
+        }
+
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        {
+            std::vector<uint32_t> fill = adjacencyOffset;
+            for (size_t i = 0; i < triangleCount * 3; i++) {
+                adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+        }
+
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        int64_t bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] +
+                vertexScore[indices[t * 3 + 2]];
+            if (triangleScore[t] > bestScore) {
+                bestScore = triangleScore[t];
+                bestTriangle = static_cast<int64_t>(t);
+            }
+        }
+
+        std::vector<uint32_t> output{};
+        output.reserve(triangleCount * 3);
+
+        std::vector<uint32_t> cache{};
+        std::vector<uint32_t> newCache{};
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+        size_t scanCursor = 0;
+
+        while (output.size() < triangleCount * 3) {
+            if (bestTriangle < 0) {
+                // Nothing adjacent to the cache left, continue with the next unemitted triangle
+                while (emitted[scanCursor]) {
+                    scanCursor++;
+                }
+                bestTriangle = static_cast<int64_t>(scanCursor);
+            }
+
+            const uint32_t* triangle = &indices[static_cast<size_t>(bestTriangle) * 3];
+            emitted[bestTriangle] = true;
+
+            newCache.clear();
+            for (int k = 0; k < 3; k++) {
+                const uint32_t v = triangle[k];
+                output.push_back(v);
+
+                // Remove the triangle from the vertex's live list
+                uint32_t* live = &adjacency[adjacencyOffset[v]];
+                for (uint32_t i = 0; i < remaining[v]; i++) {
+                    if (live[i] == static_cast<uint32_t>(bestTriangle)) {
+                        std::swap(live[i], live[remaining[v] - 1]);
+                        break;
+                    }
+                }
+                remaining[v]--;
+
+                if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+                    newCache.push_back(v);
+                }
+            }
+
+            // LRU cache update: the emitted triangle goes to the front
+            for (uint32_t v: cache) {
+                if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+                    newCache.push_back(v);
+                }
+            }
+
+            for (size_t i = 0; i < newCache.size(); i++) {
+                const uint32_t v = newCache[i];
+                cachePosition[v] = static_cast<int>(i) < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+                vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+            }
+
+            // Rescore the live triangles around every touched vertex, pick the best one in the cache
+            bestTriangle = -1;
+            bestScore = -1.0f;
+            for (size_t i = 0; i < newCache.size(); i++) {
+                const uint32_t v = newCache[i];
+                const uint32_t* live = &adjacency[adjacencyOffset[v]];
+
+                for (uint32_t j = 0; j < remaining[v]; j++) {
+                    const uint32_t t = live[j];
+                    triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] +
+                        vertexScore[indices[t * 3 + 2]];
+
+                    if (cachePosition[v] >= 0 && triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+
+            if (newCache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE)) {
+                newCache.resize(FORSYTH_CACHE_SIZE);
+            }
+            cache.swap(newCache);
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+
+    void XEMeshOptimizer::optimizeVertexFetch(std::vector<XEModel::Vertex> &vertices, std::vector<uint32_t> &indices) {
+        constexpr uint32_t UNUSED = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+
+        std::vector<XEModel::Vertex> reordered{};
+        reordered.reserve(vertices.size());
+
+        for (auto& index: indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+    }
+
+    XEMeshOptimizer::CacheStats XEMeshOptimizer::analyzeVertexCache(const uint32_t *indices, size_t indexCount,
+        uint32_t vertexCount, uint32_t cacheSize) {
+        CacheStats stats{};
+        stats.triangles = indexCount / 3;
+        stats.vertices = vertexCount;
+
+        // FIFO cache: a vertex is a hit if it was inserted less than cacheSize misses ago
+        std::vector<uint64_t> insertedAt(vertexCount, 0);
+        uint64_t clock = cacheSize + 1;
+
+        for (size_t i = 0; i < stats.triangles * 3; i++) {
+            const uint32_t v = indices[i];
+            if (clock - insertedAt[v] > cacheSize) {
+                insertedAt[v] = clock++;
+                stats.transformedVertices++;
+            }
+        }
+        return stats;
+    }
+}
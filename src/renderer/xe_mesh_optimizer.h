@@ -0,0 +1,51 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_model.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+
+    // Import time index/vertex buffer optimizations. Everything works on a single mesh with mesh-local indices.
+    class XEMeshOptimizer {
+    public:
+        // Cache size used for the ACMR/ATVR report (a typical post-transform FIFO)
+        static constexpr uint32_t REPORT_CACHE_SIZE = 16;
+
+        struct CacheStats {
+            uint64_t transformedVertices = 0;  // cache misses
+            uint64_t triangles = 0;
+            uint64_t vertices = 0;
+
+            // Average cache miss ratio: transformed vertices per triangle (0.5 ideal, 3.0 worst)
+            float acmr() const { return triangles ? static_cast<float>(transformedVertices) / triangles : 0.0f; }
+            // Average transform to vertex ratio: transformed vertices per unique vertex (1.0 ideal)
+            float atvr() const { return vertices ? static_cast<float>(transformedVertices) / vertices : 0.0f; }
+
+            CacheStats& operator+=(const CacheStats& other) {
+                transformedVertices += other.transformedVertices;
+                triangles += other.triangles;
+                vertices += other.vertices;
+                return *this;
+            }
+        };
+
+        // Merges bitwise identical vertices and remaps the indices
+        static void weldVertices(std::vector<XEModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+        // Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm)
+        static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+        // Reorders vertices in first-use order of the index buffer, drops unreferenced vertices
+        static void optimizeVertexFetch(std::vector<XEModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+        // Simulates a FIFO post-transform cache over a triangle list
+        static CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount,
+            uint32_t cacheSize = REPORT_CACHE_SIZE);
+    };
+}
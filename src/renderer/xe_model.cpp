@@ -3,32 +3,23 @@
 //
 
 #include "renderer/xe_model.h"
+#include "renderer/xe_mesh_cache.h"
 #include "utils/xe_utils.h"
+#include "utils/xe_thread_pool.h"
 
 //#define TINYOBJLOADER_IMPLEMENTATION
 //#include "tiny_obj_loader.h"
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 
 
-namespace std {
-    template <>
-    struct hash<xe::XEModel::Vertex> {
-        size_t operator()(xe::XEModel::Vertex const& v) const {
-            size_t seed = 0;
-            xe::hashCombine(seed, v.position, v.color, v.normal, v.uv);
-            return seed;
-        }
-    };
-}
-
-
 namespace xe {
     std::vector<VkVertexInputBindingDescription> XEModel::Vertex::getBindingDescriptions() {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
@@ -71,56 +62,279 @@ namespace xe {
         return attributeDescriptions;
     }
 
+    std::vector<VkVertexInputBindingDescription> XEModel::PackedVertex::getBindingDescriptions() {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(PackedVertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescriptions;
+    }
+
+    // Same locations as Vertex, the shader variant (PACKED_VERTEX) decodes them
+    std::vector<VkVertexInputAttributeDescription> XEModel::PackedVertex::getAttributeDescriptions() {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(5);
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[0].offset = offsetof(PackedVertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, color);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[2].offset = offsetof(PackedVertex, normal);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[3].offset = offsetof(PackedVertex, uv);
+
+        attributeDescriptions[4].binding = 0;
+        attributeDescriptions[4].location = 4;
+        attributeDescriptions[4].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[4].offset = offsetof(PackedVertex, tangent);
+
+        return attributeDescriptions;
+    }
+
+    std::vector<VkVertexInputBindingDescription> XEModel::getPositionBindingDescriptions(VertexFormat format) {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = format == VertexFormat::Packed ? sizeof(PackedVertex::position) : sizeof(glm::vec3);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> XEModel::getPositionAttributeDescriptions(VertexFormat format) {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(1);
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = format == VertexFormat::Packed ? VK_FORMAT_R16G16B16A16_SNORM :
+            VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].offset = 0;
+
+        return attributeDescriptions;
+    }
+
     XEModel::XEModel(XEDevice &deviceRef, XEModel::Builder&& builder): deviceRef{deviceRef},
-    meshes(std::move(builder.meshes)) {
-        createVertexBuffer(builder.vertices);
-        createIndexBuffer(builder.indices);
+    meshes(std::move(builder.meshes)), vertexFormat(builder.vertexFormat) {
+        const void* vertexData = builder.vertices.data();
+        uint32_t count = static_cast<uint32_t>(builder.vertices.size());
+        if (vertexFormat == VertexFormat::Packed) {
+            vertexData = builder.packedVertices.data();
+            count = static_cast<uint32_t>(builder.packedVertices.size());
+        }
+
+        createVertexBuffer(vertexData, vertexStride(vertexFormat), count);
+        if (builder.positionStream) {
+            createPositionBuffer(vertexData, count);
+        }
+        createIndexBuffer(builder.indices.data(), static_cast<uint32_t>(builder.indices.size()));
+        computeModelBounds();
+    }
+
+    // Warm start: upload straight out of the memory mapped cooked file
+    XEModel::XEModel(XEDevice &deviceRef, const XEMeshCache &cache, std::vector<XEMesh>&& meshes, bool positionStream):
+    deviceRef{deviceRef}, meshes(std::move(meshes)), vertexFormat(cache.vertexFormat()) {
+        createVertexBuffer(cache.vertices(), vertexStride(vertexFormat), cache.vertexCount());
+        if (positionStream) {
+            createPositionBuffer(cache.vertices(), cache.vertexCount());
+        }
+        createIndexBuffer(cache.indices(), cache.indexCount());
+        computeModelBounds();
     }
 
     XEModel::~XEModel() {}
 
-    void XEModel::createVertexBuffer(const std::vector<Vertex> &vertices) {
-        vertexCount = static_cast<uint32_t>(vertices.size());
+    void XEModel::computeModelBounds() {
+        if (meshes.empty()) {
+            return;
+        }
+
+        bounds = meshes[0].bounds;
+        for (const auto& mesh: meshes) {
+            bounds = mergeAABB(bounds, mesh.bounds);
+        }
+
+        // Sphere around the model AABB center enclosing every mesh sphere
+        const glm::vec3 center{(bounds.minX + bounds.maxX) * 0.5f, (bounds.minY + bounds.maxY) * 0.5f,
+            (bounds.minZ + bounds.maxZ) * 0.5f};
+        float radius = 0.0f;
+        for (const auto& mesh: meshes) {
+            const glm::vec3 meshCenter{mesh.sphere.centerX, mesh.sphere.centerY, mesh.sphere.centerZ};
+            radius = std::max(radius, glm::length(meshCenter - center) + mesh.sphere.radius);
+        }
+        sphere = {center.x, center.y, center.z, radius};
+    }
+
+    void XEModel::createVertexBuffer(const void* vertices, uint32_t stride, uint32_t count) {
+        vertexCount = count;
         assert(vertexCount >= 3 && "vertex count must be greater than 3");
         //VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertexCount;
-        uint32_t vertexSize = sizeof(vertices[0]);
+        uint32_t vertexSize = stride;
 
         vertexBuffer = XEBufferVMA::createBufferAndTransferDataToGPU(
             deviceRef,
             vertexSize,
             vertexCount,
             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            (void *)vertices.data());
+            (void *)vertices);
+    }
+
+    void XEModel::createPositionBuffer(const void *vertices, uint32_t count) {
+        // De-interleave the positions so depth-only passes fetch 12 (Full) or 8 (Packed) bytes per vertex
+        if (vertexFormat == VertexFormat::Packed) {
+            const PackedVertex* src = static_cast<const PackedVertex*>(vertices);
+            std::vector<std::array<int16_t, 4>> positions(count);
+            for (uint32_t i = 0; i < count; i++) {
+                std::memcpy(positions[i].data(), src[i].position, sizeof(src[i].position));
+            }
+
+            positionBuffer = XEBufferVMA::createBufferAndTransferDataToGPU(
+                deviceRef,
+                sizeof(positions[0]),
+                count,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                (void *)positions.data());
+        } else {
+            const Vertex* src = static_cast<const Vertex*>(vertices);
+            std::vector<glm::vec3> positions(count);
+            for (uint32_t i = 0; i < count; i++) {
+                positions[i] = src[i].position;
+            }
+
+            positionBuffer = XEBufferVMA::createBufferAndTransferDataToGPU(
+                deviceRef,
+                sizeof(positions[0]),
+                count,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                (void *)positions.data());
+        }
     }
 
-    void XEModel::createIndexBuffer(const std::vector<uint32_t> &indices) {
-        indexCount = static_cast<uint32_t>(indices.size());
+    void XEModel::createIndexBuffer(const uint32_t* indices, uint32_t count) {
+        indexCount = count;
         hasIndexBuffer = indexCount > 0;
 
         if (!hasIndexBuffer) {
             return;
         }
 
+        // Indices are mesh-local (drawn with vertexOffset), so a model whose meshes all stay below 64k vertices
+        // can use 16 bit indices. Primitive restart is off, so 0xFFFF is a regular index.
+        const uint32_t maxIndex = *std::max_element(indices, indices + indexCount);
+
+        if (maxIndex <= std::numeric_limits<uint16_t>::max()) {
+            std::vector<uint16_t> indices16(indices, indices + indexCount);
+            indexType = VK_INDEX_TYPE_UINT16;
+
+            indexBuffer = XEBufferVMA::createBufferAndTransferDataToGPU(
+                deviceRef,
+                sizeof(uint16_t),
+                indexCount,
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                (void *)indices16.data());
+            return;
+        }
+
         // VkDeviceSize indexBufferSize = sizeof(indices[0]) * indexCount;
         uint32_t indexSize = sizeof(indices[0]);
+        indexType = VK_INDEX_TYPE_UINT32;
 
         indexBuffer = XEBufferVMA::createBufferAndTransferDataToGPU(
             deviceRef,
             indexSize,
             indexCount,
             VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            (void *)indices.data());
+            (void *)indices);
+    }
+
+    void XEModel::resolveMaterials(XEMaterialManager &materialManager, const std::vector<XEMaterialDesc> &descs,
+        std::vector<XEMesh> &meshes) {
+        // Materials are shared between meshes, so create each one once and remap the local indices
+        std::vector<int> resolved(descs.size(), -1);
+
+        for (auto& mesh: meshes) {
+            if (mesh.materialIndex < 0 || mesh.materialIndex >= static_cast<int>(descs.size())) {
+                mesh.materialIndex = materialManager.getDefaultMaterialIndex();
+                continue;
+            }
+
+            int& global = resolved[mesh.materialIndex];
+            if (global < 0) {
+                global = materialManager.create(descs[mesh.materialIndex]);
+            }
+            mesh.materialIndex = global;
+        }
     }
 
     std::unique_ptr<XEModel> XEModel::createModelFromFile(XEDevice &device, XEMaterialManager& materialManager,
         const std::string &modelPath) {
+        return createModelFromFile(device, materialManager, modelPath, ImportOptions{});
+    }
+
+    std::unique_ptr<XEModel> XEModel::createModelFromFile(XEDevice &device, XEMaterialManager& materialManager,
+        const std::string &modelPath, const ImportOptions& options) {
+        const std::string cachePath = XEMeshCache::cachePathFor(modelPath);
+        XEMeshCache::Key cacheKey{};
+        const bool cacheable = XEMeshCache::computeKey(modelPath, Builder::IMPORT_FLAGS, options.cookFlags(), cacheKey);
+
+        if (cacheable) {
+            XEMeshCache cache{};
+            if (cache.open(cachePath, cacheKey)) {
+                std::vector<XEMesh> cachedMeshes = cache.meshes();
+                resolveMaterials(materialManager, cache.materialDescs(), cachedMeshes);
+
+                std::cout<<"Loaded cooked model "<<cachePath<<std::endl;
+                std::cout<<"Vertex Count: "<<cache.vertexCount()<<std::endl;
+                return std::make_unique<XEModel>(device, cache, std::move(cachedMeshes), options.positionStream);
+            }
+        }
+
         Builder builder{};
-        builder.materialMgr = &materialManager;
 
         auto pos = modelPath.find_last_of("/\\");
         builder.modelDir = (pos == std::string::npos) ? std::string{} : modelPath.substr(0, pos + 1);
+        builder.positionStream = options.positionStream;
+
+        // One pool for every phase of the import, unless the caller shares its own
+        std::unique_ptr<XEThreadPool> importPool;
+        XEThreadPool* pool = nullptr;
+        if (options.parallelImport) {
+            pool = options.threadPool;
+            if (!pool) {
+                importPool = std::make_unique<XEThreadPool>(options.importThreads);
+                pool = importPool.get();
+            }
+        }
 
-        builder.loadModel(modelPath);
+        builder.loadModel(modelPath, pool);
+        if (options.optimizeMeshes) {
+            builder.optimizeMeshes(pool);
+        }
+        if (options.splitForIndex16) {
+            builder.splitMeshesForIndex16();
+        }
+        builder.computeBounds();
+        if (options.vertexFormat == VertexFormat::Packed) {
+            builder.packVertices();
+        }
+
+        if (cacheable && !XEMeshCache::write(cachePath, cacheKey, builder)) {
+            std::cerr<<"[MeshCache] Failed to write "<<cachePath<<std::endl;
+        }
+
+        resolveMaterials(materialManager, builder.materialDescs, builder.meshes);
 
         std::cout<<"Loaded model "<<modelPath<<std::endl;
         std::cout<<"Vertex Count: "<<builder.vertices.size()<<std::endl;
@@ -132,8 +346,25 @@ namespace xe {
         VkDeviceSize offsets[] = {0};
         vkCmdBindVertexBuffers(cmdBuffer, 0, 1, buffers, offsets);
 
+        bindIndexBuffer(cmdBuffer);
+    }
+
+    void XEModel::bindPositions(VkCommandBuffer cmdBuffer) {
+        if (!positionBuffer) {
+            bind(cmdBuffer);
+            return;
+        }
+
+        VkBuffer buffers[] = {positionBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(cmdBuffer, 0, 1, buffers, offsets);
+
+        bindIndexBuffer(cmdBuffer);
+    }
+
+    void XEModel::bindIndexBuffer(VkCommandBuffer cmdBuffer) {
         if (hasIndexBuffer) {
-            vkCmdBindIndexBuffer(cmdBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(cmdBuffer, indexBuffer->getBuffer(), 0, indexType);
         }
     }
 
@@ -161,12 +392,12 @@ namespace xe {
         }
     }
 
-    void XEModel::drawMesh(VkCommandBuffer cmdBuffer, const XEMesh& mesh) {
+    void XEModel::drawMesh(VkCommandBuffer cmdBuffer, const XEMesh& mesh, uint32_t instanceCount) {
         if (hasIndexBuffer) {
             vkCmdDrawIndexed(
                 cmdBuffer,
                 mesh.indexCount,
-                1,
+                instanceCount,
                 mesh.firstIndex,
                 mesh.vertexOffset,
                 0);
@@ -174,170 +405,9 @@ namespace xe {
             vkCmdDraw(
                 cmdBuffer,
                 mesh.vertexCount,
-                1,
+                instanceCount,
                 mesh.vertexOffset,
                 0);
         }
     }
-
-    static std::string joinPath(const std::string& baseDir, const std::string& rel) {
-        if (rel.empty()) return rel;
-        // If rel already looks absolute, return as is (basic heuristic)
-        if (rel.size() > 1 && (rel[1] == ':' || rel[0] == '/' || rel[0] == '\\')) return rel;
-        std::string p = baseDir;
-        if (!p.empty() && p.back() != '/' && p.back() != '\\') p.push_back('/');
-        p += rel;
-        // Normalize slashes for platform
-        std::replace(p.begin(), p.end(), '\\', '/');
-        return p;
-    }
-
-    void XEModel::Builder::loadModel(const std::string &path) {
-        Assimp::Importer importer{};
-
-        const aiScene* scene = importer.ReadFile(path,
-            aiProcess_Triangulate |
-            aiProcess_CalcTangentSpace |
-            aiProcess_FlipUVs |
-            aiProcess_MakeLeftHanded);
-
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-            throw std::runtime_error(importer.GetErrorString());
-        }
-
-        processNode(scene->mRootNode, scene, aiMatrix4x4());
-    }
-
-    void XEModel::Builder::processNode(aiNode *node, const aiScene *scene, const aiMatrix4x4& parentTransform) {
-        // combine parent transform with this node's transform
-        aiMatrix4x4 globalTransform = parentTransform * node->mTransformation;
-
-        // process all node meshes
-        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            processMesh(mesh, scene, globalTransform);
-        }
-
-        // Recursively traverse through all child nodes
-        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-            processNode(node->mChildren[i], scene, globalTransform);
-        }
-    }
-
-    void XEModel::Builder::processMesh(aiMesh *mesh, const aiScene *scene, const aiMatrix4x4& transform) {
-        XEMesh meshInfo{};
-        meshInfo.vertexOffset = static_cast<int32_t>(vertices.size());
-        meshInfo.vertexCount = mesh->mNumVertices;
-        meshInfo.firstIndex = indices.size();
-
-        aiMatrix3x3 M3(transform);
-        aiMatrix3x3 N3 = M3;  // copy
-        N3.Inverse();
-        N3.Transpose();
-
-        // Process vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-            Vertex vertex;
-
-            // apply transform to positions
-            aiVector3D pos = transform * mesh->mVertices[i];
-
-            // Positions
-            vertex.position = {pos.x, pos.y, pos.z};
-
-            // Normals
-            if (mesh->HasNormals()) {
-                aiVector3D normal = N3 * mesh->mNormals[i];
-
-                // normalize
-                float len = std::sqrt(normal.x*normal.x + normal.y*normal.y + normal.z*normal.z);
-                if (len > 0) { normal.x/=len; normal.y/=len; normal.z/=len; }
-                vertex.normal = { normal.x, normal.y, normal.z };
-            }
-
-            if (mesh->HasTangentsAndBitangents()) {
-                aiVector3D T = N3 * mesh->mTangents[i];
-                aiVector3D B = N3 * mesh->mBitangents[i];
-                aiVector3D N = N3 * mesh->mNormals[i];
-
-                // Orthonormalize T against N via Gram-Schmidt Process
-                // T = normalize(t - n * dot(n,t))
-                float ndott = N.x * T.x + N.y * T.y + N.z * T.z;
-                T.x -= N.x * ndott;
-                T.y -= N.y * ndott;
-                T.z -= N.z * ndott;
-                float t_len = std::sqrt(T.x * T.x + T.y * T.y + T.z * T.z);
-                if (t_len > 0) { T.x /= t_len; T.y /= t_len; T.z /= t_len; }
-
-                // Handedness: sign = dot(cross(N,T), B) >= 0 ? +1 : -1
-                aiVector3D c = aiVector3D(
-                    N.y*T.z - N.z*T.y,
-                    N.z*T.x - N.x*T.z,
-                    N.x*T.y - N.y*T.x
-                );
-                float sign = (c.x * B.x + c.y * B.y + c.z * B.z) < 0.0f ? 1.0f : -1.0f;
-                vertex.tangent = {T.x, T.y, T.z, sign};
-            } else {
-                vertex.tangent = {1,0,0, 1};
-            }
-
-            // Texture coordinates
-            if (mesh->HasTextureCoords(0)) {
-                glm::vec2 uv;
-                uv.x = mesh->mTextureCoords[0][i].x;
-                uv.y = mesh->mTextureCoords[0][i].y;
-                vertex.uv = uv;
-            }
-
-            // colors
-            if (mesh->HasVertexColors(0)) {
-                vertex.color = {
-                    mesh->mColors[0][i].r,
-                    mesh->mColors[0][i].g,
-                    mesh->mColors[0][i].b
-                };
-            } else {
-                vertex.color = {1.0f, 1.0f, 1.0f}; // default white
-            }
-            vertices.push_back(vertex);
-        }
-
-        // process indices
-        for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; ++j) {
-                indices.push_back(face.mIndices[j]);
-            }
-        }
-        meshInfo.indexCount = indices.size() - meshInfo.firstIndex;
-
-        int materialIndex = materialMgr->getDefaultMaterialIndex();
-
-        if (scene->HasMaterials() && mesh->mMaterialIndex >= 0 && materialMgr) {
-            aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
-            aiString texPath;
-            XEMaterialDesc materialDesc{};
-
-            auto readTex = [&](aiTextureType type) -> std::string {
-                if (mat->GetTexture(type, 0, &texPath) == AI_SUCCESS) {
-                    std::string full_path = joinPath(modelDir, std::string(texPath.C_Str()));
-
-                    return full_path;
-                }
-                return {};
-            };
-
-            materialDesc.albedoFileName = readTex(aiTextureType_BASE_COLOR);
-            if (materialDesc.albedoFileName.empty()) { materialDesc.albedoFileName = readTex(aiTextureType_DIFFUSE); }
-            materialDesc.normalFileName = readTex(aiTextureType_NORMALS);
-            if (materialDesc.normalFileName.empty()) { materialDesc.normalFileName = readTex(aiTextureType_HEIGHT); }
-
-            materialIndex = materialMgr->create(materialDesc);
-        }
-
-        // Push back meshInfo
-        meshInfo.materialIndex = materialIndex;
-        meshes.push_back(meshInfo);
-    }
 }
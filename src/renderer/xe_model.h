@@ -9,10 +9,14 @@
 #include "renderer/materials/xe_materials.h"
 #include "gfx_resource_managers/xe_texture_manager.h"
 #include "gfx_resource_managers/xe_material_manager.h"
+#include "utils/xe_utils.h"
+#include "utils/xe_bounds.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm/glm.hpp"
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
 
 // ASSIMP imports
 #include "assimp/Importer.hpp"
@@ -21,9 +25,11 @@
 
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 
 namespace xe {
+    class XEMeshCache;
 
     class XEModel {
     public:
@@ -39,31 +45,120 @@ namespace xe {
             static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 
             bool operator==(const Vertex& other) const {
-                return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
+                return position == other.position && color == other.color && normal == other.normal && uv == other.uv &&
+                    tangent == other.tangent;
             }
         };
 
+        enum class VertexFormat : uint32_t {
+            Full = 0,    // Vertex, 60 bytes of fp32
+            Packed = 1   // PackedVertex, 24 bytes, positions quantized against the mesh bounds
+        };
+
+        // Compact vertex: snorm16 position relative to the mesh bounds (w = tangent handedness),
+        // octahedral snorm16 normal and tangent, half uv and unorm8 color
+        struct PackedVertex {
+            int16_t position[4];
+            int16_t normal[2];
+            int16_t tangent[2];
+            uint16_t uv[2];
+            uint8_t color[4];
+
+            static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+            static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        };
+
         struct XEMesh {
             uint32_t firstIndex;
             uint32_t indexCount;
             int32_t vertexOffset;
             uint32_t vertexCount;
-            int materialIndex = 0; // texture index
+            int materialIndex = 0; // local index into the model's material descs until resolved, -1 = default
+
+            // Local (model) space bounds, filled at import and cached with the mesh
+            AABB3 bounds{};
+            BoundingSphere sphere{};
+
+            // Packed vertices only: objectPosition = quantOffset + snormPosition * quantScale
+            glm::vec3 quantOffset{0.f};
+            glm::vec3 quantScale{1.f};
+
+            glm::mat4 dequantizeMatrix() const {
+                glm::mat4 m{1.f};
+                m[0][0] = quantScale.x;
+                m[1][1] = quantScale.y;
+                m[2][2] = quantScale.z;
+                m[3] = glm::vec4(quantOffset, 1.f);
+                return m;
+            }
+        };
+
+        struct ImportOptions {
+            bool parallelImport = true;
+            uint32_t importThreads = 0;  // 0 = derive from hardware concurrency
+            XEThreadPool* threadPool = nullptr;  // shared pool for the import, null creates one of importThreads
+            bool optimizeMeshes = true;  // weld vertices, reorder for post-transform cache and vertex fetch
+            VertexFormat vertexFormat = VertexFormat::Full;
+            bool positionStream = true;  // extra tightly packed position buffer for depth-only passes
+            bool splitForIndex16 = true;  // split meshes above 64k vertices so the model can use 16 bit indices
+
+            // Options that change the cooked output, part of the mesh cache key
+            uint32_t cookFlags() const {
+                return (optimizeMeshes ? 1u : 0u) | (vertexFormat == VertexFormat::Packed ? 2u : 0u) |
+                    (splitForIndex16 ? 4u : 0u);
+            }
         };
 
         struct Builder {
+            static constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate |
+                aiProcess_CalcTangentSpace |
+                aiProcess_FlipUVs |
+                aiProcess_MakeLeftHanded;
+
             std::vector<Vertex> vertices{};
+            std::vector<PackedVertex> packedVertices{};
+            VertexFormat vertexFormat = VertexFormat::Full;
+            bool positionStream = false;
             std::vector<uint32_t> indices{};
             std::vector<XEMesh> meshes{};
-            XEMaterialManager* materialMgr = nullptr;
+            std::vector<XEMaterialDesc> materialDescs{};
+            std::unordered_map<unsigned int, int> sceneMaterialToDesc{};
             std::string modelDir;
 
-            void loadModel(const std::string& path);
+            // pool may be null, the scene is then processed serially on the calling thread
+            void loadModel(const std::string& path, XEThreadPool* pool);
             void processNode(aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform);
             void processMesh(aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform);
+            int findOrAddMaterial(const aiMesh* mesh, const aiScene* scene);
+
+            // Parallel path: flatten the node tree into jobs with precomputed vertex/index offsets, then
+            // transform every mesh on a worker pool straight into the preallocated arrays
+            struct MeshJob {
+                const aiMesh* mesh = nullptr;
+                aiMatrix4x4 transform;
+                uint32_t firstVertex = 0;
+                uint32_t firstIndex = 0;
+            };
+
+            void gatherMeshJobs(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform,
+                std::vector<MeshJob>& jobs);
+            void processMeshesParallel(const aiScene* scene, XEThreadPool& pool);
+
+            // Per mesh: weld, Forsyth triangle reorder, vertex fetch reorder. Rebuilds vertices/indices/meshes.
+            void optimizeMeshes(XEThreadPool* pool);
+
+            // Per mesh AABB and bounding sphere from the final vertex data
+            void computeBounds();
+
+            // Splits meshes referencing more than 64k vertices into chunks that each fit 16 bit indices
+            void splitMeshesForIndex16();
+
+            // Quantizes vertices into packedVertices and fills the per-mesh dequantization params
+            void packVertices();
         };
 
         XEModel(XEDevice& deviceRef, XEModel::Builder&& builder);
+        XEModel(XEDevice& deviceRef, const XEMeshCache& cache, std::vector<XEMesh>&& meshes, bool positionStream);
         ~XEModel();
 
         XEModel(const XEModel &) = delete;
@@ -71,13 +166,33 @@ namespace xe {
 
         static std::unique_ptr<XEModel> createModelFromFile(XEDevice& device, XEMaterialManager& materialManager,
             const std::string& modelPath);
+        static std::unique_ptr<XEModel> createModelFromFile(XEDevice& device, XEMaterialManager& materialManager,
+            const std::string& modelPath, const ImportOptions& options);
 
         void bind(VkCommandBuffer cmdBuffer);
+        // Depth-only passes: binds the position stream (when built) instead of the interleaved vertices
+        void bindPositions(VkCommandBuffer cmdBuffer);
         void draw(VkCommandBuffer cmdBuffer);
-        void drawMesh(VkCommandBuffer cmdBuffer, const XEMesh& mesh);
+        void drawMesh(VkCommandBuffer cmdBuffer, const XEMesh& mesh, uint32_t instanceCount = 1);
 
         // Access Meshes
         std::vector<XEMesh>& getMeshes() { return meshes; }
+        VertexFormat getVertexFormat() const { return vertexFormat; }
+        VkIndexType getIndexType() const { return indexType; }
+        bool isIndexed() const { return hasIndexBuffer; }
+
+        // Union of all mesh bounds, local space
+        const AABB3& getBounds() const { return bounds; }
+        const BoundingSphere& getBoundingSphere() const { return sphere; }
+        bool hasPositionStream() const { return positionBuffer != nullptr; }
+
+        // Position stream layout: vec3 for Full, snorm16x4 (same encoding as PackedVertex::position) for Packed
+        static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions(VertexFormat format);
+        static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions(VertexFormat format);
+
+        static uint32_t vertexStride(VertexFormat format) {
+            return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+        }
 
     private:
         XEDevice& deviceRef;
@@ -85,20 +200,44 @@ namespace xe {
         // Vertex
         std::unique_ptr<XEBufferVMA> vertexBuffer;
         uint32_t vertexCount;
+        VertexFormat vertexFormat = VertexFormat::Full;
+
+        // Position only stream
+        std::unique_ptr<XEBufferVMA> positionBuffer;
 
         // Index
         std::unique_ptr<XEBufferVMA> indexBuffer;
         uint32_t indexCount;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;  // UINT16 when every mesh fits in 64k vertices
 
         // Meshes:
         std::vector<XEMesh> meshes;
+        AABB3 bounds{};
+        BoundingSphere sphere{};
 
         // Materials:
         std::vector<XEMaterial> materials;
 
         bool hasIndexBuffer = false;
 
-        void createVertexBuffer(const std::vector<Vertex> &vertices);
-        void createIndexBuffer(const std::vector<uint32_t> &indices);
+        static void resolveMaterials(XEMaterialManager& materialManager, const std::vector<XEMaterialDesc>& descs,
+            std::vector<XEMesh>& meshes);
+
+        void computeModelBounds();
+        void createVertexBuffer(const void* vertices, uint32_t stride, uint32_t count);
+        void createPositionBuffer(const void* vertices, uint32_t count);
+        void createIndexBuffer(const uint32_t* indices, uint32_t count);
+        void bindIndexBuffer(VkCommandBuffer cmdBuffer);
+    };
+}
+
+namespace std {
+    template <>
+    struct hash<xe::XEModel::Vertex> {
+        size_t operator()(xe::XEModel::Vertex const& v) const {
+            size_t seed = 0;
+            xe::hashCombine(seed, v.position, v.color, v.normal, v.uv, v.tangent);
+            return seed;
+        }
     };
 }
@@ -0,0 +1,521 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/xe_model.h"
+#include "renderer/xe_mesh_optimizer.h"
+#include "utils/xe_thread_pool.h"
+
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+
+// CPU side of the model import (Assimp scene -> vertices, indices, meshes, materials), no device needed
+namespace xe {
+    static std::string joinPath(const std::string& baseDir, const std::string& rel) {
+        if (rel.empty()) return rel;
+        // If rel already looks absolute, return as is (basic heuristic)
+        if (rel.size() > 1 && (rel[1] == ':' || rel[0] == '/' || rel[0] == '\\')) return rel;
+        std::string p = baseDir;
+        if (!p.empty() && p.back() != '/' && p.back() != '\\') p.push_back('/');
+        p += rel;
+        // Normalize slashes for platform
+        std::replace(p.begin(), p.end(), '\\', '/');
+        return p;
+    }
+
+    static uint32_t countMeshIndices(const aiMesh* mesh) {
+        uint32_t count = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+            count += mesh->mFaces[i].mNumIndices;
+        }
+        return count;
+    }
+
+    // Transforms every vertex of one aiMesh into out[0, mNumVertices). Shared by the serial and the parallel
+    // import path so both produce byte-identical output.
+    static void writeMeshVertices(const aiMesh* mesh, const aiMatrix4x4& transform, XEModel::Vertex* out) {
+        aiMatrix3x3 M3(transform);
+        aiMatrix3x3 N3 = M3;  // copy
+        N3.Inverse();
+        N3.Transpose();
+
+        for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+            XEModel::Vertex vertex;
+
+            // apply transform to positions
+            aiVector3D pos = transform * mesh->mVertices[i];
+
+            // Positions
+            vertex.position = {pos.x, pos.y, pos.z};
+
+            // Normals
+            if (mesh->HasNormals()) {
+                aiVector3D normal = N3 * mesh->mNormals[i];
+
+                // normalize
+                float len = std::sqrt(normal.x*normal.x + normal.y*normal.y + normal.z*normal.z);
+                if (len > 0) { normal.x/=len; normal.y/=len; normal.z/=len; }
+                vertex.normal = { normal.x, normal.y, normal.z };
+            }
+
+            if (mesh->HasTangentsAndBitangents()) {
+                aiVector3D T = N3 * mesh->mTangents[i];
+                aiVector3D B = N3 * mesh->mBitangents[i];
+                aiVector3D N = N3 * mesh->mNormals[i];
+
+                // Orthonormalize T against N via Gram-Schmidt Process
+                // T = normalize(t - n * dot(n,t))
+                float ndott = N.x * T.x + N.y * T.y + N.z * T.z;
+                T.x -= N.x * ndott;
+                T.y -= N.y * ndott;
+                T.z -= N.z * ndott;
+                float t_len = std::sqrt(T.x * T.x + T.y * T.y + T.z * T.z);
+                if (t_len > 0) { T.x /= t_len; T.y /= t_len; T.z /= t_len; }
+
+                // Handedness: sign = dot(cross(N,T), B) >= 0 ? +1 : -1
+                aiVector3D c = aiVector3D(
+                    N.y*T.z - N.z*T.y,
+                    N.z*T.x - N.x*T.z,
+                    N.x*T.y - N.y*T.x
+                );
+                float sign = (c.x * B.x + c.y * B.y + c.z * B.z) < 0.0f ? 1.0f : -1.0f;
+                vertex.tangent = {T.x, T.y, T.z, sign};
+            } else {
+                vertex.tangent = {1,0,0, 1};
+            }
+
+            // Texture coordinates
+            if (mesh->HasTextureCoords(0)) {
+                glm::vec2 uv;
+                uv.x = mesh->mTextureCoords[0][i].x;
+                uv.y = mesh->mTextureCoords[0][i].y;
+                vertex.uv = uv;
+            }
+
+            // colors
+            if (mesh->HasVertexColors(0)) {
+                vertex.color = {
+                    mesh->mColors[0][i].r,
+                    mesh->mColors[0][i].g,
+                    mesh->mColors[0][i].b
+                };
+            } else {
+                vertex.color = {1.0f, 1.0f, 1.0f}; // default white
+            }
+            out[i] = vertex;
+        }
+    }
+
+    static void writeMeshIndices(const aiMesh* mesh, uint32_t* out) {
+        for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+            const aiFace& face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; ++j) {
+                *out++ = face.mIndices[j];
+            }
+        }
+    }
+
+    void XEModel::Builder::loadModel(const std::string &path, XEThreadPool* pool) {
+        Assimp::Importer importer{};
+
+        const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+            throw std::runtime_error(importer.GetErrorString());
+        }
+
+        // Both paths produce byte-identical output, see tests/xe_parallel_import_test.cpp
+        if (!pool) {
+            processNode(scene->mRootNode, scene, aiMatrix4x4());
+            return;
+        }
+
+        processMeshesParallel(scene, *pool);
+    }
+
+    void XEModel::Builder::processNode(aiNode *node, const aiScene *scene, const aiMatrix4x4& parentTransform) {
+        // combine parent transform with this node's transform
+        aiMatrix4x4 globalTransform = parentTransform * node->mTransformation;
+
+        // process all node meshes
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+            processMesh(mesh, scene, globalTransform);
+        }
+
+        // Recursively traverse through all child nodes
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            processNode(node->mChildren[i], scene, globalTransform);
+        }
+    }
+
+    void XEModel::Builder::processMesh(aiMesh *mesh, const aiScene *scene, const aiMatrix4x4& transform) {
+        XEMesh meshInfo{};
+        meshInfo.vertexOffset = static_cast<int32_t>(vertices.size());
+        meshInfo.vertexCount = mesh->mNumVertices;
+        meshInfo.firstIndex = indices.size();
+        meshInfo.indexCount = countMeshIndices(mesh);
+
+        // Process vertices
+        vertices.resize(vertices.size() + mesh->mNumVertices);
+        writeMeshVertices(mesh, transform, vertices.data() + meshInfo.vertexOffset);
+
+        // process indices
+        indices.resize(indices.size() + meshInfo.indexCount);
+        writeMeshIndices(mesh, indices.data() + meshInfo.firstIndex);
+
+        // Push back meshInfo
+        meshInfo.materialIndex = findOrAddMaterial(mesh, scene);
+        meshes.push_back(meshInfo);
+    }
+
+    void XEModel::Builder::gatherMeshJobs(const aiNode *node, const aiScene *scene, const aiMatrix4x4 &parentTransform,
+        std::vector<MeshJob> &jobs) {
+        // Same traversal order as processNode, so offsets line up with the serial path
+        aiMatrix4x4 globalTransform = parentTransform * node->mTransformation;
+
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            MeshJob job{};
+            job.mesh = scene->mMeshes[node->mMeshes[i]];
+            job.transform = globalTransform;
+            jobs.push_back(job);
+        }
+
+        for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+            gatherMeshJobs(node->mChildren[i], scene, globalTransform, jobs);
+        }
+    }
+
+    void XEModel::Builder::processMeshesParallel(const aiScene *scene, XEThreadPool& pool) {
+        std::vector<MeshJob> jobs;
+        gatherMeshJobs(scene->mRootNode, scene, aiMatrix4x4(), jobs);
+
+        // Precompute every mesh's vertex/index range and resolve materials up front (single threaded,
+        // materials are deduplicated in traversal order)
+        uint32_t vertexTotal = static_cast<uint32_t>(vertices.size());
+        uint32_t indexTotal = static_cast<uint32_t>(indices.size());
+
+        meshes.reserve(meshes.size() + jobs.size());
+        for (auto& job: jobs) {
+            job.firstVertex = vertexTotal;
+            job.firstIndex = indexTotal;
+
+            XEMesh meshInfo{};
+            meshInfo.vertexOffset = static_cast<int32_t>(vertexTotal);
+            meshInfo.vertexCount = job.mesh->mNumVertices;
+            meshInfo.firstIndex = indexTotal;
+            meshInfo.indexCount = countMeshIndices(job.mesh);
+            meshInfo.materialIndex = findOrAddMaterial(job.mesh, scene);
+            meshes.push_back(meshInfo);
+
+            vertexTotal += meshInfo.vertexCount;
+            indexTotal += meshInfo.indexCount;
+        }
+
+        vertices.resize(vertexTotal);
+        indices.resize(indexTotal);
+
+        // Every job writes a disjoint slice of the preallocated arrays
+        pool.parallelFor(static_cast<uint32_t>(jobs.size()), [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const MeshJob& job = jobs[i];
+                writeMeshVertices(job.mesh, job.transform, vertices.data() + job.firstVertex);
+                writeMeshIndices(job.mesh, indices.data() + job.firstIndex);
+            }
+        });
+    }
+
+    void XEModel::Builder::optimizeMeshes(XEThreadPool* pool) {
+        struct OptimizedMesh {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            XEMeshOptimizer::CacheStats before;
+            XEMeshOptimizer::CacheStats after;
+        };
+
+        std::vector<OptimizedMesh> results(meshes.size());
+
+        auto optimizeRange = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const XEMesh& mesh = meshes[i];
+                OptimizedMesh& result = results[i];
+
+                result.vertices.assign(vertices.begin() + mesh.vertexOffset,
+                    vertices.begin() + mesh.vertexOffset + mesh.vertexCount);
+                result.indices.assign(indices.begin() + mesh.firstIndex,
+                    indices.begin() + mesh.firstIndex + mesh.indexCount);
+
+                result.before = XEMeshOptimizer::analyzeVertexCache(result.indices.data(), result.indices.size(),
+                    mesh.vertexCount);
+
+                // Non-indexed meshes are drawn straight from the vertex buffer, leave them alone
+                if (!result.indices.empty()) {
+                    XEMeshOptimizer::weldVertices(result.vertices, result.indices);
+                    XEMeshOptimizer::optimizeVertexCache(result.indices, static_cast<uint32_t>(result.vertices.size()));
+                    XEMeshOptimizer::optimizeVertexFetch(result.vertices, result.indices);
+                }
+
+                result.after = XEMeshOptimizer::analyzeVertexCache(result.indices.data(), result.indices.size(),
+                    static_cast<uint32_t>(result.vertices.size()));
+            }
+        };
+
+        // Meshes are optimized independently, each into its own result
+        if (pool) {
+            pool->parallelFor(static_cast<uint32_t>(meshes.size()), optimizeRange);
+        } else {
+            optimizeRange(0, static_cast<uint32_t>(meshes.size()));
+        }
+
+        // Stitch the meshes back together in their original order
+        std::vector<Vertex> optimizedVertices{};
+        std::vector<uint32_t> optimizedIndices{};
+        optimizedVertices.reserve(vertices.size());
+        optimizedIndices.reserve(indices.size());
+
+        XEMeshOptimizer::CacheStats before{};
+        XEMeshOptimizer::CacheStats after{};
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            XEMesh& mesh = meshes[i];
+            OptimizedMesh& result = results[i];
+
+            mesh.vertexOffset = static_cast<int32_t>(optimizedVertices.size());
+            mesh.vertexCount = static_cast<uint32_t>(result.vertices.size());
+            mesh.firstIndex = static_cast<uint32_t>(optimizedIndices.size());
+            mesh.indexCount = static_cast<uint32_t>(result.indices.size());
+
+            optimizedVertices.insert(optimizedVertices.end(), result.vertices.begin(), result.vertices.end());
+            optimizedIndices.insert(optimizedIndices.end(), result.indices.begin(), result.indices.end());
+
+            before += result.before;
+            after += result.after;
+        }
+
+        std::cout << "[MeshOptimizer] Vertices: " << vertices.size() << " -> " << optimizedVertices.size() << std::endl;
+        std::cout << "[MeshOptimizer] ACMR (FIFO " << XEMeshOptimizer::REPORT_CACHE_SIZE << "): " << before.acmr()
+            << " -> " << after.acmr() << std::endl;
+        std::cout << "[MeshOptimizer] ATVR (FIFO " << XEMeshOptimizer::REPORT_CACHE_SIZE << "): " << before.atvr()
+            << " -> " << after.atvr() << std::endl;
+
+        vertices.swap(optimizedVertices);
+        indices.swap(optimizedIndices);
+    }
+
+    void XEModel::Builder::computeBounds() {
+        for (auto& mesh: meshes) {
+            if (mesh.vertexCount == 0) {
+                continue;
+            }
+
+            const float* positions = &vertices[mesh.vertexOffset].position.x;
+            mesh.bounds = computeAABB(positions, mesh.vertexCount, sizeof(Vertex));
+            mesh.sphere = computeBoundingSphere(positions, mesh.vertexCount, sizeof(Vertex), mesh.bounds);
+        }
+    }
+
+    void XEModel::Builder::splitMeshesForIndex16() {
+        constexpr uint32_t MAX_CHUNK_VERTICES = std::numeric_limits<uint16_t>::max() + 1u;
+
+        bool needsSplit = false;
+        for (const auto& mesh: meshes) {
+            needsSplit |= mesh.indexCount > 0 && mesh.vertexCount > MAX_CHUNK_VERTICES;
+        }
+        if (!needsSplit) {
+            return;
+        }
+
+        std::vector<Vertex> splitVertices{};
+        std::vector<uint32_t> splitIndices{};
+        std::vector<XEMesh> splitMeshes{};
+        splitVertices.reserve(vertices.size());
+        splitIndices.reserve(indices.size());
+
+        constexpr uint32_t UNMAPPED = ~0u;
+        std::vector<uint32_t> remap{};
+
+        for (const auto& mesh: meshes) {
+            const Vertex* meshVertices = vertices.data() + mesh.vertexOffset;
+            const uint32_t* meshIndices = indices.data() + mesh.firstIndex;
+
+            if (mesh.indexCount == 0 || mesh.vertexCount <= MAX_CHUNK_VERTICES) {
+                XEMesh copy = mesh;
+                copy.vertexOffset = static_cast<int32_t>(splitVertices.size());
+                copy.firstIndex = static_cast<uint32_t>(splitIndices.size());
+                splitVertices.insert(splitVertices.end(), meshVertices, meshVertices + mesh.vertexCount);
+                splitIndices.insert(splitIndices.end(), meshIndices, meshIndices + mesh.indexCount);
+                splitMeshes.push_back(copy);
+                continue;
+            }
+
+            // Walk the triangles in order (keeps the cache optimized order) and start a new chunk whenever
+            // the next triangle would push the chunk past 64k unique vertices. Border vertices get duplicated.
+            remap.assign(mesh.vertexCount, UNMAPPED);
+            std::vector<uint32_t> chunkVertices{};  // mesh-local vertex ids in the current chunk
+
+            XEMesh chunk = mesh;
+            auto beginChunk = [&]() {
+                for (uint32_t v: chunkVertices) {
+                    remap[v] = UNMAPPED;
+                }
+                chunkVertices.clear();
+                chunk.vertexOffset = static_cast<int32_t>(splitVertices.size());
+                chunk.firstIndex = static_cast<uint32_t>(splitIndices.size());
+            };
+            auto endChunk = [&]() {
+                chunk.vertexCount = static_cast<uint32_t>(chunkVertices.size());
+                chunk.indexCount = static_cast<uint32_t>(splitIndices.size()) - chunk.firstIndex;
+                if (chunk.indexCount > 0) {
+                    splitMeshes.push_back(chunk);
+                }
+            };
+
+            beginChunk();
+            for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3) {
+                uint32_t newVertices = 0;
+                for (uint32_t k = 0; k < 3; k++) {
+                    newVertices += remap[meshIndices[i + k]] == UNMAPPED ? 1 : 0;
+                }
+
+                if (chunkVertices.size() + newVertices > MAX_CHUNK_VERTICES) {
+                    endChunk();
+                    beginChunk();
+                }
+
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t v = meshIndices[i + k];
+                    if (remap[v] == UNMAPPED) {
+                        remap[v] = static_cast<uint32_t>(chunkVertices.size());
+                        chunkVertices.push_back(v);
+                        splitVertices.push_back(meshVertices[v]);
+                    }
+                    splitIndices.push_back(remap[v]);
+                }
+            }
+            endChunk();
+        }
+
+        std::cout << "[Index16] Split " << meshes.size() << " meshes into " << splitMeshes.size()
+            << " (vertices: " << vertices.size() << " -> " << splitVertices.size() << ")" << std::endl;
+
+        vertices.swap(splitVertices);
+        indices.swap(splitIndices);
+        meshes.swap(splitMeshes);
+    }
+
+    static int16_t packSnorm16(float value) {
+        return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    static uint8_t packUnorm8(float value) {
+        return static_cast<uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // Octahedral encoding of a unit vector into [-1, 1]^2
+    static glm::vec2 octEncode(const glm::vec3& v) {
+        const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (l1 <= 0.0f) {
+            return {0.0f, 0.0f};
+        }
+
+        glm::vec3 n = v / l1;
+        if (n.z >= 0.0f) {
+            return {n.x, n.y};
+        }
+        return {
+            (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)
+        };
+    }
+
+    void XEModel::Builder::packVertices() {
+        packedVertices.resize(vertices.size());
+
+        for (auto& mesh: meshes) {
+            if (mesh.vertexCount == 0) {
+                continue;
+            }
+
+            const Vertex* src = vertices.data() + mesh.vertexOffset;
+            PackedVertex* dst = packedVertices.data() + mesh.vertexOffset;
+
+            // Quantize against the import bounds (computeBounds runs first)
+            const glm::vec3 minPos{mesh.bounds.minX, mesh.bounds.minY, mesh.bounds.minZ};
+            const glm::vec3 maxPos{mesh.bounds.maxX, mesh.bounds.maxY, mesh.bounds.maxZ};
+
+            // Flat meshes still need a non-zero scale on the flat axis
+            mesh.quantOffset = (minPos + maxPos) * 0.5f;
+            mesh.quantScale = glm::max((maxPos - minPos) * 0.5f, glm::vec3(1e-6f));
+            const glm::vec3 invScale = 1.0f / mesh.quantScale;
+
+            for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+                const Vertex& v = src[i];
+                PackedVertex& p = dst[i];
+
+                const glm::vec3 q = (v.position - mesh.quantOffset) * invScale;
+                p.position[0] = packSnorm16(q.x);
+                p.position[1] = packSnorm16(q.y);
+                p.position[2] = packSnorm16(q.z);
+                p.position[3] = packSnorm16(v.tangent.w < 0.0f ? -1.0f : 1.0f);
+
+                const glm::vec2 n = octEncode(v.normal);
+                p.normal[0] = packSnorm16(n.x);
+                p.normal[1] = packSnorm16(n.y);
+
+                const glm::vec2 t = octEncode(glm::vec3(v.tangent));
+                p.tangent[0] = packSnorm16(t.x);
+                p.tangent[1] = packSnorm16(t.y);
+
+                p.uv[0] = glm::packHalf1x16(v.uv.x);
+                p.uv[1] = glm::packHalf1x16(v.uv.y);
+
+                p.color[0] = packUnorm8(v.color.r);
+                p.color[1] = packUnorm8(v.color.g);
+                p.color[2] = packUnorm8(v.color.b);
+                p.color[3] = 255;
+            }
+        }
+
+        vertexFormat = VertexFormat::Packed;
+    }
+
+    int XEModel::Builder::findOrAddMaterial(const aiMesh *mesh, const aiScene *scene) {
+        int materialIndex = -1;  // default material
+
+        auto known = sceneMaterialToDesc.find(mesh->mMaterialIndex);
+        if (known != sceneMaterialToDesc.end()) {
+            materialIndex = known->second;
+        } else if (scene->HasMaterials() && mesh->mMaterialIndex < scene->mNumMaterials) {
+            aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
+            aiString texPath;
+            XEMaterialDesc materialDesc{};
+
+            auto readTex = [&](aiTextureType type) -> std::string {
+                if (mat->GetTexture(type, 0, &texPath) == AI_SUCCESS) {
+                    std::string full_path = joinPath(modelDir, std::string(texPath.C_Str()));
+
+                    return full_path;
+                }
+                return {};
+            };
+
+            materialDesc.albedoFileName = readTex(aiTextureType_BASE_COLOR);
+            if (materialDesc.albedoFileName.empty()) { materialDesc.albedoFileName = readTex(aiTextureType_DIFFUSE); }
+            materialDesc.normalFileName = readTex(aiTextureType_NORMALS);
+            if (materialDesc.normalFileName.empty()) { materialDesc.normalFileName = readTex(aiTextureType_HEIGHT); }
+
+            materialDescs.push_back(materialDesc);
+            materialIndex = static_cast<int>(materialDescs.size() - 1);
+            sceneMaterialToDesc[mesh->mMaterialIndex] = materialIndex;
+        }
+
+        return materialIndex;
+    }
+}
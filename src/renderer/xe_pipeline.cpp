@@ -28,11 +28,22 @@ namespace xe {
         createShadowPassPipeline(vertFilePath,  configInfo);
     }
 
+    XEPipeline::XEPipeline(XEDevice& device,
+            const std::string& compFilePath,
+            VkPipelineLayout pipelineLayout) : xe_device{device}, bindPoint{VK_PIPELINE_BIND_POINT_COMPUTE} {
+        createComputePipeline(compFilePath, pipelineLayout);
+    }
+
     XEPipeline::~XEPipeline() {
         if (fragShaderModule != VK_NULL_HANDLE) {
             vkDestroyShaderModule(xe_device.device(), fragShaderModule, nullptr);
         }
-        vkDestroyShaderModule(xe_device.device(), vertShaderModule, nullptr);
+        if (compShaderModule != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(xe_device.device(), compShaderModule, nullptr);
+        }
+        if (vertShaderModule != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(xe_device.device(), vertShaderModule, nullptr);
+        }
         vkDestroyPipeline(xe_device.device(), graphicsPipeline, nullptr);
     }
 
@@ -168,6 +179,29 @@ namespace xe {
         }
     }
 
+    void XEPipeline::createComputePipeline(const std::string &compFilePath, VkPipelineLayout pipelineLayout) {
+        auto compCode = readFile(compFilePath);
+
+        createShaderModule(compCode, &compShaderModule);
+
+        VkPipelineShaderStageCreateInfo shaderStage{};
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStage.module = compShaderModule;
+        shaderStage.pName = "main";
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = shaderStage;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(xe_device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline!");
+        }
+    }
+
     auto XEPipeline::createSkyboxPipeline(const std::string &vertFilePath, const std::string &fragFilePath,
         const PipelineConfigInfo &configInfo) -> void {
         auto vertCode = readFile(vertFilePath);
@@ -242,7 +276,7 @@ namespace xe {
     }
 
     void XEPipeline::bind(VkCommandBuffer commandBuffer) {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, bindPoint, graphicsPipeline);
     }
 
     void XEPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -359,8 +393,9 @@ namespace xe {
         configInfo.colorBlendInfo.attachmentCount = 0;
         configInfo.colorBlendInfo.pAttachments = nullptr;
 
-        configInfo.bindingDescriptions = XEModel::Vertex::getBindingDescriptions();
-        configInfo.attributeDescriptions = XEModel::Vertex::getAttributeDescriptions();
+        // Depth only: read the tightly packed position stream (see XEModel::bindPositions)
+        configInfo.bindingDescriptions = XEModel::getPositionBindingDescriptions(XEModel::VertexFormat::Full);
+        configInfo.attributeDescriptions = XEModel::getPositionAttributeDescriptions(XEModel::VertexFormat::Full);
     }
 
     void XEPipeline::defaultSkyboxPipelineConfigInfo(PipelineConfigInfo &configInfo) {
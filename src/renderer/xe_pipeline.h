@@ -44,6 +44,11 @@ namespace xe {
         XEPipeline(XEDevice& device,
             const std::string& vertFilePath,
             const PipelineConfigInfo& configInfo);
+
+        // For compute passes
+        XEPipeline(XEDevice& device,
+            const std::string& compFilePath,
+            VkPipelineLayout pipelineLayout);
         ~XEPipeline();
 
         XEPipeline(const XEPipeline&) = delete;
@@ -62,6 +67,7 @@ namespace xe {
             const std::string& fragFilePath,
             const PipelineConfigInfo& configInfo);
         void createShadowPassPipeline(const std::string& vertFilePath, const PipelineConfigInfo& configInfo);
+        void createComputePipeline(const std::string& compFilePath, VkPipelineLayout pipelineLayout);
         auto createSkyboxPipeline(const std::string &vertFilePath,
                                   const std::string &fragFilePath,
                                   const PipelineConfigInfo &configInfo) -> void;
@@ -72,5 +78,7 @@ namespace xe {
         VkPipeline graphicsPipeline;
         VkShaderModule vertShaderModule = VK_NULL_HANDLE;
         VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        VkShaderModule compShaderModule = VK_NULL_HANDLE;
+        VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     };
 }
@@ -109,14 +109,18 @@ namespace xe {
         currentFrameIndex = (currentFrameIndex + 1) % XESwapChain::MAX_FRAMES_IN_FLIGHT;
     }
 
-    void XERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+    void XERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, SwapChainPass pass) {
         assert(isFrameStarted && "Can't call swapChainRenderPass without starting frame render!!");
         assert(commandBuffer == getCurrentCommandBuffer() &&
             "Can't begin a render pass on a command buffer from a different frame!");
 
         VkRenderPassBeginInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = xe_swap_chain->getRenderPass();
+        switch (pass) {
+            case SwapChainPass::Early: renderPassInfo.renderPass = xe_swap_chain->getEarlyRenderPass(); break;
+            case SwapChainPass::Late: renderPassInfo.renderPass = xe_swap_chain->getLateRenderPass(); break;
+            default: renderPassInfo.renderPass = xe_swap_chain->getRenderPass(); break;
+        }
         renderPassInfo.framebuffer = xe_swap_chain->getFrameBuffer(currentImageIndex);
 
         renderPassInfo.renderArea.offset = {0, 0};
@@ -13,6 +13,9 @@
 
 namespace xe {
 
+    // Main pass as one render pass, or split around the depth pyramid build of the occlusion culling
+    enum class SwapChainPass { Single, Early, Late };
+
     class XERenderer {
     public:
         XERenderer(XEWindow& xe_window, XEDevice& xe_device);
@@ -24,6 +27,12 @@ namespace xe {
         bool isFrameInProgress() const { return isFrameStarted; }
         float getAspectRatio() const { return xe_swap_chain->extentAspectRatio(); }
         VkRenderPass getSwapChainRenderPass() const { return xe_swap_chain->getRenderPass(); }
+        VkExtent2D getSwapChainExtent() const { return xe_swap_chain->getSwapChainExtent(); }
+
+        VkImageView getCurrentDepthImageView() const {
+            assert(isFrameStarted && "Cannot get depth image view when frame not in progress.");
+            return xe_swap_chain->getDepthImageView(static_cast<int>(currentImageIndex));
+        }
 
         VkCommandBuffer getCurrentCommandBuffer() const {
             assert(isFrameStarted && "Cannot get command buffer when frame not in progress.");
@@ -37,7 +46,7 @@ namespace xe {
 
         VkCommandBuffer beginFrame();
         void endFrame();
-        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+        void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, SwapChainPass pass = SwapChainPass::Single);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
     private:
@@ -27,6 +27,10 @@ namespace xe
 
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        // Compatible with getRenderPass(). Early clears and keeps depth for sampling, late loads color and depth.
+        VkRenderPass getEarlyRenderPass() { return earlyRenderPass; }
+        VkRenderPass getLateRenderPass() { return lateRenderPass; }
+        VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
@@ -54,6 +58,7 @@ namespace xe
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
+        VkRenderPass createSwapChainRenderPass(bool loadContents, bool keepDepth);
         void createFramebuffers();
         void createSyncObjects();
 
@@ -70,6 +75,8 @@ namespace xe
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
         VkRenderPass renderPass;
+        VkRenderPass earlyRenderPass;
+        VkRenderPass lateRenderPass;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
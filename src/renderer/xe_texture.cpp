@@ -12,14 +12,15 @@
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
+#include <vector>
 
 namespace xe {
-    XETexture::XETexture(const std::string& fileName, XEDevice& deviceRef, VkFormat imageFormat) : device(deviceRef) {
-        int width, height, channels;
-        uint32_t mipLevels;
+    XETexture::DecodedImage XETexture::decode(const std::string &fileName) {
+        DecodedImage image{};
+        image.fileName = fileName;
 
-        stbi_uc* pixels = stbi_load(fileName.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-        std::cout << "Loading image: " << fileName << " width: " << width << " height: " << height << " channels: " << channels << std::endl;
+        stbi_uc* pixels = stbi_load(fileName.c_str(), &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+        std::cout << "Loading image: " << fileName << " width: " << image.width << " height: " << image.height << " channels: " << image.channels << std::endl;
 
         if (!pixels) {
             std::string reason = stbi_failure_reason() ? stbi_failure_reason() : "unknown";
@@ -29,21 +30,55 @@ namespace xe {
             throw std::runtime_error("Failed to load texture");
         }
 
-        if (channels == 3 || channels == 2 || channels == 1) {
-            channels = 4; // default to four channels
+        image.pixels = std::unique_ptr<unsigned char, void (*)(void*)>(pixels, stbi_image_free);
+        return image;
+    }
+
+    XETexture::XETexture(const std::string& fileName, XEDevice& deviceRef, VkFormat imageFormat, MipFilter mipFilter)
+        : XETexture(decode(fileName), deviceRef, imageFormat, mipFilter) { }
+
+    XETexture::XETexture(const DecodedImage& image, XEDevice& deviceRef, VkFormat imageFormat, MipFilter mipFilter)
+        : XETexture(buildMipChain(image.pixels.get(), static_cast<uint32_t>(image.width),
+            static_cast<uint32_t>(image.height), mipFilter), deviceRef, imageFormat) {
+        std::cout<<"Loaded texture: "<<image.fileName<<"\n";
+    }
+
+    XETexture::XETexture(const XEMipChain& mips, XEDevice& deviceRef, VkFormat imageFormat, uint32_t firstMip)
+        : device(deviceRef) {
+        const size_t base = mips.levels[firstMip].offset;
+        std::vector<XEImageVMA::MipRegion> regions(mips.levels.size() - firstMip);
+        for (size_t mip = firstMip; mip < mips.levels.size(); mip++) {
+            regions[mip - firstMip] = {mips.levels[mip].width, mips.levels[mip].height, mips.levels[mip].offset - base};
         }
 
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        xe_image_vma = std::make_unique<XEImageVMA>(device, static_cast<int>(mips.levels[firstMip].width),
+            static_cast<int>(mips.levels[firstMip].height), regions, mips.rgba.data() + base,
+            mips.rgba.size() - base, imageFormat, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY);
+
+        createTextureSampler();
+        createImageInfo();
+    }
 
-        xe_image_vma = std::make_unique<XEImageVMA>(device, width, height, channels, mipLevels, (void*) pixels,
-            imageFormat, VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+    XETexture::XETexture(const XETextureCache& cooked, XEDevice& deviceRef, uint32_t firstMip) : device(deviceRef) {
+        const XETextureCache::Level first = cooked.level(firstMip);
+        std::vector<XEImageVMA::MipRegion> mips(cooked.mipCount() - firstMip);
+        for (uint32_t mip = firstMip; mip < cooked.mipCount(); mip++) {
+            const XETextureCache::Level level = cooked.level(mip);
+            mips[mip - firstMip] = {level.width, level.height, level.offset - first.offset};
+        }
+
+        xe_image_vma = std::make_unique<XEImageVMA>(device, static_cast<int>(first.width),
+            static_cast<int>(first.height), mips, cooked.data() + first.offset, cooked.dataSize() - first.offset,
+            formatFor(cooked.format()), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
             VMA_MEMORY_USAGE_GPU_ONLY);
 
-        stbi_image_free(pixels);
         createTextureSampler();
         createImageInfo();
-        std::cout<<"Loaded texture: "<<fileName<<"\n";
+    }
+
+    VkFormat XETexture::formatFor(XETextureCache::Format format) {
+        return format == XETextureCache::Format::BC5_UNORM ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
     }
 
     XETexture::~XETexture() {
@@ -7,16 +7,38 @@
 
 #include "renderer/xe_device.h"
 #include "renderer/xe_image_vma.h"
+#include "renderer/xe_texture_cache.h"
+#include "utils/xe_mip_builder.h"
 
 
 #include <memory>
+#include <string>
 #include "vulkan/vulkan.h"
 
 
 namespace xe {
     class XETexture {
     public:
-        XETexture(const std::string& fileName, XEDevice& deviceRef, VkFormat imageFormat);
+        // RGBA8 pixels of an image file. Decoding touches no Vulkan state, so it may run on any thread.
+        struct DecodedImage {
+            std::string fileName;
+            int width = 0;
+            int height = 0;
+            int channels = 0;  // of the file, the pixels always have four
+            std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, nullptr};
+        };
+        static DecodedImage decode(const std::string& fileName);
+
+        // Mips are built on the CPU with the given filter, which should match the format (SRGB for *_SRGB)
+        XETexture(const std::string& fileName, XEDevice& deviceRef, VkFormat imageFormat, MipFilter mipFilter);
+        XETexture(const DecodedImage& image, XEDevice& deviceRef, VkFormat imageFormat, MipFilter mipFilter);
+        // Uploads an RGBA8 chain built off the render thread, on the thread that owns the device queues.
+        // firstMip > 0 leaves out the larger levels, for a low resolution copy.
+        XETexture(const XEMipChain& mips, XEDevice& deviceRef, VkFormat imageFormat, uint32_t firstMip = 0);
+        // Uploads a cooked texture, block compressed with every mip precomputed
+        XETexture(const XETextureCache& cooked, XEDevice& deviceRef, uint32_t firstMip = 0);
+
+        static VkFormat formatFor(XETextureCache::Format format);
         ~XETexture();
 
         XETexture(const XETexture&) = delete;
@@ -0,0 +1,166 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "renderer/xe_texture_cache.h"
+#include "utils/xe_block_compression.h"
+#include "utils/xe_mip_builder.h"
+
+#include "stb_image.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace xe {
+
+    static constexpr char CACHE_MAGIC[4] = {'X', 'E', 'T', 'C'};
+    static constexpr uint64_t CACHE_ALIGNMENT = 16;
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::string XETextureCache::cachePathFor(const std::string &texturePath, Format format) {
+        // The same image may be cooked both ways (e.g. a mask used as colour and as a normal map)
+        return texturePath + (format == Format::BC5_UNORM ? ".bc5.xetc" : ".bc7.xetc");
+    }
+
+    bool XETextureCache::computeKey(const std::string &texturePath, Format format, Key &key) {
+        XEMappedFile source{};
+        if (!source.open(texturePath)) {
+            return false;
+        }
+
+        key.sourceHash = hashBytes(source.data(), source.size());
+        key.format = format;
+        return true;
+    }
+
+    bool XETextureCache::open(const std::string &cachePath, const Key &key) {
+        if (!file.open(cachePath)) {
+            return false;
+        }
+
+        auto reject = [&](const char* reason) {
+            std::cout << "[TextureCache] Ignoring " << cachePath << ": " << reason << std::endl;
+            file.close();
+            header = nullptr;
+            levels = nullptr;
+            return false;
+        };
+
+        if (file.size() < sizeof(Header)) { return reject("truncated header"); }
+
+        header = reinterpret_cast<const Header*>(file.data());
+        if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) { return reject("bad magic"); }
+        if (header->version != VERSION) { return reject("version mismatch"); }
+        if (header->sourceHash != key.sourceHash || header->format != static_cast<uint32_t>(key.format)) {
+            return reject("stale");
+        }
+        if (header->mipCount == 0 || header->mipCount > 32) { return reject("bad mip count"); }
+
+        const uint64_t tableBytes = static_cast<uint64_t>(header->mipCount) * sizeof(Level);
+        if (header->levelTableOffset + tableBytes > file.size() ||
+            header->dataOffset + header->dataSize > file.size()) {
+            return reject("truncated data");
+        }
+
+        levels = reinterpret_cast<const Level*>(file.data() + header->levelTableOffset);
+        for (uint32_t mip = 0; mip < header->mipCount; mip++) {
+            if (levels[mip].offset + levels[mip].size > header->dataSize) {
+                return reject("bad level table");
+            }
+        }
+        return true;
+    }
+
+    XETextureCache::Level XETextureCache::level(uint32_t mip) const {
+        return levels[mip];
+    }
+
+    bool XETextureCache::cook(const std::string &texturePath, const Key &key, const std::string &cachePath,
+        XEThreadPool* pool) {
+        int width = 0, height = 0, channels = 0;
+        std::unique_ptr<stbi_uc, void (*)(void*)> pixels(
+            stbi_load(texturePath.c_str(), &width, &height, &channels, STBI_rgb_alpha), stbi_image_free);
+        if (!pixels) {
+            std::string reason = stbi_failure_reason() ? stbi_failure_reason() : "unknown";
+            std::cerr << "[TextureCache] Failed to load: " << texturePath << " reason=" << reason << "\n";
+            throw std::runtime_error("Failed to load texture");
+        }
+
+        const bool normalMap = key.format == Format::BC5_UNORM;
+        const XEMipChain mips = buildMipChain(pixels.get(), static_cast<uint32_t>(width),
+            static_cast<uint32_t>(height), normalMap ? MipFilter::Normal : MipFilter::SRGB);
+        pixels.reset();
+
+        Header hdr{};
+        std::memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        hdr.version = VERSION;
+        hdr.sourceHash = key.sourceHash;
+        hdr.format = static_cast<uint32_t>(key.format);
+        hdr.width = static_cast<uint32_t>(width);
+        hdr.height = static_cast<uint32_t>(height);
+        hdr.mipCount = static_cast<uint32_t>(mips.levels.size());
+
+        std::vector<Level> table(mips.levels.size());
+        uint64_t dataSize = 0;
+        for (size_t mip = 0; mip < mips.levels.size(); mip++) {
+            table[mip].width = mips.levels[mip].width;
+            table[mip].height = mips.levels[mip].height;
+            table[mip].offset = dataSize;
+            table[mip].size = compressedSize(table[mip].width, table[mip].height);
+            // Whole blocks, so every level starts on a block boundary as vkCmdCopyBufferToImage requires
+            dataSize += table[mip].size;
+        }
+
+        std::vector<uint8_t> blocks(dataSize);
+        for (uint32_t mip = 0; mip < hdr.mipCount; mip++) {
+            compressImage(normalMap ? BlockFormat::BC5 : BlockFormat::BC7, mips.level(mip), table[mip].width,
+                table[mip].height, blocks.data() + table[mip].offset, pool);
+        }
+
+        hdr.levelTableOffset = alignUp(sizeof(Header), CACHE_ALIGNMENT);
+        hdr.dataOffset = alignUp(hdr.levelTableOffset + table.size() * sizeof(Level), CACHE_ALIGNMENT);
+        hdr.dataSize = dataSize;
+
+        // Write next to the destination and rename, so a crash never leaves a half-written cache behind
+        const std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                return false;
+            }
+
+            auto padTo = [&](uint64_t offset) {
+                static const char zeros[CACHE_ALIGNMENT] = {};
+                uint64_t pos = static_cast<uint64_t>(out.tellp());
+                if (offset > pos) out.write(zeros, static_cast<std::streamsize>(offset - pos));
+            };
+
+            out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+            padTo(hdr.levelTableOffset);
+            out.write(reinterpret_cast<const char*>(table.data()),
+                static_cast<std::streamsize>(table.size() * sizeof(Level)));
+            padTo(hdr.dataOffset);
+            out.write(reinterpret_cast<const char*>(blocks.data()), static_cast<std::streamsize>(blocks.size()));
+
+            if (!out.good()) {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,86 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "utils/xe_mapped_file.h"
+
+#include <cstdint>
+#include <string>
+
+namespace xe {
+
+    class XEThreadPool;
+
+    // On-disk cache of a cooked texture: every mip level block compressed on the CPU (BC7 sRGB for colour,
+    // BC5 for tangent space normals), stored level 0 first in one blob so it uploads from a single staging buffer.
+    // Keyed by the content hash of the source image and the format. Has no Vulkan dependency so the offline
+    // cooker builds it without a GPU.
+    class XETextureCache {
+    public:
+        // Bump whenever the header, the mip filters or the encoders change
+        static constexpr uint32_t VERSION = 2;
+
+        enum class Format : uint32_t {
+            BC7_SRGB = 1,
+            BC5_UNORM = 2,
+        };
+
+        struct Key {
+            uint64_t sourceHash = 0;  // content hash of the source image file
+            Format format = Format::BC7_SRGB;
+        };
+
+        struct Level {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint64_t offset = 0;  // into data()
+            uint64_t size = 0;
+        };
+
+        XETextureCache() = default;
+        ~XETextureCache() = default;
+
+        XETextureCache(const XETextureCache&) = delete;
+        XETextureCache& operator=(const XETextureCache&) = delete;
+
+        static std::string cachePathFor(const std::string& texturePath, Format format);
+        static bool computeKey(const std::string& texturePath, Format format, Key& key);
+        // Decodes the source, builds the mips and compresses them. The block rows are spread over pool if given.
+        // Throws if the source cannot be decoded, false if the cache cannot be written.
+        static bool cook(const std::string& texturePath, const Key& key, const std::string& cachePath,
+            XEThreadPool* pool = nullptr);
+
+        // Maps the cooked file. Fails (and leaves nothing mapped) if it is missing, stale or malformed.
+        bool open(const std::string& cachePath, const Key& key);
+
+        Format format() const { return static_cast<Format>(header->format); }
+        uint32_t width() const { return header->width; }
+        uint32_t height() const { return header->height; }
+        uint32_t mipCount() const { return header->mipCount; }
+        Level level(uint32_t mip) const;
+
+        // Every level, back to back
+        const uint8_t* data() const { return file.data() + header->dataOffset; }
+        uint64_t dataSize() const { return header->dataSize; }
+
+    private:
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint64_t sourceHash;
+            uint32_t format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipCount;
+            uint64_t levelTableOffset;
+            uint64_t dataOffset;
+            uint64_t dataSize;
+        };
+
+        XEMappedFile file;
+        const Header* header = nullptr;
+        const Level* levels = nullptr;
+    };
+}
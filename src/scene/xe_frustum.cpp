@@ -0,0 +1,125 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "scene/xe_frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace xe {
+    XEFrustum::XEFrustum(const glm::mat4 &viewProjection) {
+        update(viewProjection);
+    }
+
+    void XEFrustum::update(const glm::mat4 &viewProjection) {
+        // Gribb/Hartmann. glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i]).
+        // Clip space is -w <= x,y <= w and 0 <= z <= w.
+        const glm::vec4 row0{viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]};
+        const glm::vec4 row1{viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]};
+        const glm::vec4 row2{viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]};
+        const glm::vec4 row3{viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]};
+
+        planes[Left] = row3 + row0;
+        planes[Right] = row3 - row0;
+        planes[Bottom] = row3 + row1;
+        planes[Top] = row3 - row1;
+        planes[Near] = row2;
+        planes[Far] = row3 - row2;
+
+        for (auto& plane: planes) {
+            const float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) {
+                plane /= length;
+            }
+        }
+        planeMask = (1u << PlaneCount) - 1;
+    }
+
+    bool XEFrustum::intersects(const AABB3 &worldBounds) const {
+        for (uint32_t i = 0; i < PlaneCount; i++) {
+            if (!(planeMask & (1u << i))) {
+                continue;
+            }
+
+            // Corner farthest along the plane normal (p-vertex)
+            const glm::vec4& p = planes[i];
+            const float x = p.x >= 0.0f ? worldBounds.maxX : worldBounds.minX;
+            const float y = p.y >= 0.0f ? worldBounds.maxY : worldBounds.minY;
+            const float z = p.z >= 0.0f ? worldBounds.maxZ : worldBounds.minZ;
+
+            if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    XEFrustum::Containment XEFrustum::classify(const AABB3 &worldBounds) const {
+        Containment result = Containment::Inside;
+        for (uint32_t i = 0; i < PlaneCount; i++) {
+            if (!(planeMask & (1u << i))) {
+                continue;
+            }
+
+            // p-vertex outside: rejected. n-vertex (nearest corner) outside: straddles the plane
+            const glm::vec4& p = planes[i];
+            const float px = p.x >= 0.0f ? worldBounds.maxX : worldBounds.minX;
+            const float py = p.y >= 0.0f ? worldBounds.maxY : worldBounds.minY;
+            const float pz = p.z >= 0.0f ? worldBounds.maxZ : worldBounds.minZ;
+            if (p.x * px + p.y * py + p.z * pz + p.w < 0.0f) {
+                return Containment::Outside;
+            }
+
+            const float nx = p.x >= 0.0f ? worldBounds.minX : worldBounds.maxX;
+            const float ny = p.y >= 0.0f ? worldBounds.minY : worldBounds.maxY;
+            const float nz = p.z >= 0.0f ? worldBounds.minZ : worldBounds.maxZ;
+            if (p.x * nx + p.y * ny + p.z * nz + p.w < 0.0f) {
+                result = Containment::Intersects;
+            }
+        }
+        return result;
+    }
+
+    bool XEFrustum::intersects(const BoundingSphere &worldSphere) const {
+        for (uint32_t i = 0; i < PlaneCount; i++) {
+            if (!(planeMask & (1u << i))) {
+                continue;
+            }
+
+            const glm::vec4& p = planes[i];
+            const float distance = p.x * worldSphere.centerX + p.y * worldSphere.centerY + p.z * worldSphere.centerZ + p.w;
+            if (distance < -worldSphere.radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    AABB3 XEFrustum::transformAABB(const AABB3 &localBounds, const glm::mat4 &transform) {
+        const glm::vec3 center{(localBounds.minX + localBounds.maxX) * 0.5f, (localBounds.minY + localBounds.maxY) * 0.5f,
+            (localBounds.minZ + localBounds.maxZ) * 0.5f};
+        const glm::vec3 extent{(localBounds.maxX - localBounds.minX) * 0.5f, (localBounds.maxY - localBounds.minY) * 0.5f,
+            (localBounds.maxZ - localBounds.minZ) * 0.5f};
+
+        const glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        const glm::mat3 m{transform};
+        const glm::vec3 worldExtent =
+            glm::abs(m[0]) * extent.x +
+            glm::abs(m[1]) * extent.y +
+            glm::abs(m[2]) * extent.z;
+
+        return {
+            worldCenter.x - worldExtent.x, worldCenter.y - worldExtent.y, worldCenter.z - worldExtent.z,
+            worldCenter.x + worldExtent.x, worldCenter.y + worldExtent.y, worldCenter.z + worldExtent.z
+        };
+    }
+
+    BoundingSphere XEFrustum::transformSphere(const BoundingSphere &localSphere, const glm::mat4 &transform) {
+        const glm::vec3 center = glm::vec3(transform * glm::vec4(localSphere.centerX, localSphere.centerY,
+            localSphere.centerZ, 1.0f));
+        const float maxScale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+            glm::length(glm::vec3(transform[2]))});
+        return {center.x, center.y, center.z, localSphere.radius * maxScale};
+    }
+}
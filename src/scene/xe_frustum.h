@@ -0,0 +1,60 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "utils/xe_utils.h"
+#include "utils/xe_bounds.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace xe {
+
+    struct CullingStats {
+        uint32_t testedMeshes = 0;
+        uint32_t visibleMeshes = 0;
+        uint32_t culledObjects = 0;  // rejected on the model bound, meshes not tested individually
+        uint32_t nodesVisited = 0;   // BVH nodes, 0 for the linear scan
+    };
+
+    // Six planes (xyz = inward normal, w = distance) extracted from a projection * view matrix.
+    // Works for any zero-to-one depth projection (the perspective camera, the orthographic cascades),
+    // the y flip and left-handedness are already baked into the matrix.
+    class XEFrustum {
+    public:
+        enum Plane { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+        enum class Containment { Outside, Intersects, Inside };
+
+        XEFrustum() = default;
+        explicit XEFrustum(const glm::mat4& viewProjection);
+
+        void update(const glm::mat4& viewProjection);
+
+        // false only if the box is completely outside one plane (conservative)
+        bool intersects(const AABB3& worldBounds) const;
+        bool intersects(const BoundingSphere& worldSphere) const;
+        // Also reports boxes completely inside every enabled plane, so hierarchies can skip testing their children
+        Containment classify(const AABB3& worldBounds) const;
+
+        // Skip a plane, e.g. the near plane of a shadow cascade rendered with depth clamp
+        void disablePlane(Plane plane) { planeMask &= ~(1u << plane); }
+        bool isPlaneEnabled(Plane plane) const { return (planeMask & (1u << plane)) != 0; }
+
+        const std::array<glm::vec4, PlaneCount>& getPlanes() const { return planes; }
+
+        // Arvo: world AABB of a transformed local box from its center and the absolute rotation/scale (exact)
+        static AABB3 transformAABB(const AABB3& localBounds, const glm::mat4& transform);
+        // Center transformed, radius scaled by the largest axis scale
+        static BoundingSphere transformSphere(const BoundingSphere& localSphere, const glm::mat4& transform);
+
+    private:
+        std::array<glm::vec4, PlaneCount> planes{};
+        uint32_t planeMask = (1u << PlaneCount) - 1;
+    };
+}
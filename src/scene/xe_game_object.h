@@ -46,6 +46,8 @@ namespace xe {
         glm::vec3 color{};
         TransformComponent transform{};
         bool canCastShadow = false;
+        // Never moves, shadow caches keep what it casts (call XEShadowSystem::invalidateStaticCache otherwise)
+        bool isStatic = false;
 
     private:
         XEGameObject(id_t objId): id(objId) {};
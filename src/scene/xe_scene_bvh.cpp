@@ -0,0 +1,561 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "scene/xe_scene_bvh.h"
+#include "utils/xe_bounds.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+namespace xe {
+
+    static constexpr uint32_t BVH_BIN_COUNT = 16;
+    static constexpr uint32_t BVH_MIN_LEAF_PRIMITIVES = 2;   // never split below this
+    static constexpr uint32_t BVH_MAX_LEAF_PRIMITIVES = 8;   // always split above this, whatever the SAH says
+    static constexpr uint32_t BVH_MAX_DEPTH = 64;            // bounds the traversal stacks
+    static constexpr float BVH_TRAVERSAL_COST = 1.0f;        // relative to one primitive test
+    static constexpr uint32_t BVH_INSIDE_BIT = 0x80000000u;
+
+    static AABB3 emptyAABB() {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        return {inf, inf, inf, -inf, -inf, -inf};
+    }
+
+    static float surfaceArea(const AABB3& b) {
+        const float dx = b.maxX - b.minX;
+        const float dy = b.maxY - b.minY;
+        const float dz = b.maxZ - b.minZ;
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+            return 0.0f;
+        }
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    static glm::vec3 centroid(const AABB3& b) {
+        return {(b.minX + b.maxX) * 0.5f, (b.minY + b.maxY) * 0.5f, (b.minZ + b.maxZ) * 0.5f};
+    }
+
+    // Slab test, tNear is clamped to 0 when the origin is inside the box
+    static bool intersectRay(const AABB3& b, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance,
+        float& tNear) {
+        const float tx0 = (b.minX - origin.x) * invDirection.x;
+        const float tx1 = (b.maxX - origin.x) * invDirection.x;
+        const float ty0 = (b.minY - origin.y) * invDirection.y;
+        const float ty1 = (b.maxY - origin.y) * invDirection.y;
+        const float tz0 = (b.minZ - origin.z) * invDirection.z;
+        const float tz1 = (b.maxZ - origin.z) * invDirection.z;
+
+        const float tMin = std::max({std::min(tx0, tx1), std::min(ty0, ty1), std::min(tz0, tz1), 0.0f});
+        const float tMax = std::min({std::max(tx0, tx1), std::max(ty0, ty1), std::max(tz0, tz1), maxDistance});
+        tNear = tMin;
+        return tMin <= tMax;
+    }
+
+    void XESceneBVH::build(XEGameObject::Map &gameObjects) {
+        std::vector<BVHItem> sceneItems{};
+        std::vector<AABB3> sceneBounds{};
+        std::vector<std::pair<XEGameObject::id_t, glm::mat4>> transforms{};
+
+        for (auto& kv: gameObjects) {
+            auto& obj = kv.second;
+            if (!obj.model) {
+                continue;
+            }
+
+            const glm::mat4 modelMatrix = obj.transform.mat4();
+            transforms.emplace_back(obj.getId(), modelMatrix);
+
+            const auto& meshes = obj.model->getMeshes();
+            for (uint32_t i = 0; i < meshes.size(); i++) {
+                sceneItems.push_back({obj.getId(), i});
+                sceneBounds.push_back(XEFrustum::transformAABB(meshes[i].bounds, modelMatrix));
+            }
+        }
+
+        build(sceneItems, sceneBounds);
+
+        objects.clear();
+        for (const auto& [id, transform]: transforms) {
+            objects[id].transform = transform;
+        }
+        for (uint32_t i = 0; i < items.size(); i++) {
+            objects[items[i].objectId].primitives.push_back(i);
+        }
+    }
+
+    void XESceneBVH::build(const std::vector<BVHItem> &inItems, const std::vector<AABB3> &worldBounds) {
+        nodes.clear();
+        parents.clear();
+        items.clear();
+        primitiveBounds.clear();
+        primitiveLeaf.clear();
+        objects.clear();
+
+        const uint32_t count = static_cast<uint32_t>(inItems.size());
+        if (count == 0) {
+            return;
+        }
+
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0u);
+
+        std::vector<glm::vec3> centroids(count);
+        AABB3 rootBounds = emptyAABB();
+        for (uint32_t i = 0; i < count; i++) {
+            centroids[i] = centroid(worldBounds[i]);
+            rootBounds = mergeAABB(rootBounds, worldBounds[i]);
+        }
+
+        nodes.reserve(2 * count - 1);
+        parents.reserve(2 * count - 1);
+        nodes.push_back({rootBounds, 0, count});
+        parents.push_back(~0u);
+
+        struct BuildEntry {
+            uint32_t node;
+            uint32_t depth;
+        };
+        std::vector<BuildEntry> stack{{0, 0}};
+
+        struct Bin {
+            AABB3 bounds;
+            uint32_t count;
+        };
+
+        while (!stack.empty()) {
+            const BuildEntry entry = stack.back();
+            stack.pop_back();
+
+            const uint32_t first = nodes[entry.node].leftFirst;
+            const uint32_t primitiveCount = nodes[entry.node].primitiveCount;
+            if (primitiveCount <= BVH_MIN_LEAF_PRIMITIVES || entry.depth >= BVH_MAX_DEPTH) {
+                continue;
+            }
+
+            glm::vec3 centroidMin{std::numeric_limits<float>::max()};
+            glm::vec3 centroidMax{-std::numeric_limits<float>::max()};
+            for (uint32_t i = first; i < first + primitiveCount; i++) {
+                centroidMin = glm::min(centroidMin, centroids[order[i]]);
+                centroidMax = glm::max(centroidMax, centroids[order[i]]);
+            }
+
+            // Binned SAH: bucket the centroids along every axis and sweep the bin boundaries
+            int bestAxis = -1;
+            uint32_t bestSplit = 0;
+            float bestCost = std::numeric_limits<float>::max();
+
+            for (int axis = 0; axis < 3; axis++) {
+                const float extent = centroidMax[axis] - centroidMin[axis];
+                if (extent <= 0.0f) {
+                    continue;
+                }
+
+                std::array<Bin, BVH_BIN_COUNT> bins{};
+                for (auto& bin: bins) {
+                    bin.bounds = emptyAABB();
+                }
+
+                const float scale = BVH_BIN_COUNT / extent;
+                for (uint32_t i = first; i < first + primitiveCount; i++) {
+                    const uint32_t p = order[i];
+                    const uint32_t b = std::min(BVH_BIN_COUNT - 1,
+                        static_cast<uint32_t>((centroids[p][axis] - centroidMin[axis]) * scale));
+                    bins[b].bounds = mergeAABB(bins[b].bounds, worldBounds[p]);
+                    bins[b].count++;
+                }
+
+                std::array<float, BVH_BIN_COUNT - 1> leftCost{};
+                AABB3 sweep = emptyAABB();
+                uint32_t sweepCount = 0;
+                for (uint32_t b = 0; b < BVH_BIN_COUNT - 1; b++) {
+                    sweep = mergeAABB(sweep, bins[b].bounds);
+                    sweepCount += bins[b].count;
+                    leftCost[b] = surfaceArea(sweep) * sweepCount;
+                }
+
+                sweep = emptyAABB();
+                sweepCount = 0;
+                for (uint32_t b = BVH_BIN_COUNT - 1; b > 0; b--) {
+                    sweep = mergeAABB(sweep, bins[b].bounds);
+                    sweepCount += bins[b].count;
+                    const float cost = leftCost[b - 1] + surfaceArea(sweep) * sweepCount;
+                    if (cost < bestCost && sweepCount > 0 && sweepCount < primitiveCount) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b;
+                    }
+                }
+            }
+
+            if (bestAxis < 0) {
+                continue;  // all centroids coincide
+            }
+
+            const float parentArea = surfaceArea(nodes[entry.node].bounds);
+            const float leafCost = parentArea * primitiveCount;
+            if (BVH_TRAVERSAL_COST * parentArea + bestCost >= leafCost && primitiveCount <= BVH_MAX_LEAF_PRIMITIVES) {
+                continue;
+            }
+
+            const float scale = BVH_BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+            auto middle = std::partition(order.begin() + first, order.begin() + first + primitiveCount,
+                [&](uint32_t p) {
+                    const uint32_t b = std::min(BVH_BIN_COUNT - 1,
+                        static_cast<uint32_t>((centroids[p][bestAxis] - centroidMin[bestAxis]) * scale));
+                    return b < bestSplit;
+                });
+            const uint32_t leftCount = static_cast<uint32_t>(middle - order.begin()) - first;
+            if (leftCount == 0 || leftCount == primitiveCount) {
+                continue;
+            }
+
+            AABB3 leftBounds = emptyAABB();
+            AABB3 rightBounds = emptyAABB();
+            for (uint32_t i = first; i < first + leftCount; i++) {
+                leftBounds = mergeAABB(leftBounds, worldBounds[order[i]]);
+            }
+            for (uint32_t i = first + leftCount; i < first + primitiveCount; i++) {
+                rightBounds = mergeAABB(rightBounds, worldBounds[order[i]]);
+            }
+
+            const uint32_t left = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({leftBounds, first, leftCount});
+            nodes.push_back({rightBounds, first + leftCount, primitiveCount - leftCount});
+            parents.push_back(entry.node);
+            parents.push_back(entry.node);
+
+            nodes[entry.node].leftFirst = left;
+            nodes[entry.node].primitiveCount = 0;
+
+            stack.push_back({left + 1, entry.depth + 1});
+            stack.push_back({left, entry.depth + 1});
+        }
+
+        // Store the primitives in leaf order so leaves read contiguous memory
+        items.resize(count);
+        primitiveBounds.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            items[i] = inItems[order[i]];
+            primitiveBounds[i] = worldBounds[order[i]];
+        }
+
+        primitiveLeaf.resize(count);
+        for (uint32_t n = 0; n < nodes.size(); n++) {
+            for (uint32_t i = 0; i < nodes[n].primitiveCount; i++) {
+                primitiveLeaf[nodes[n].leftFirst + i] = n;
+            }
+        }
+    }
+
+    void XESceneBVH::update(XEGameObject::Map &gameObjects) {
+        std::vector<uint32_t> moved{};
+
+        for (auto& kv: gameObjects) {
+            auto& obj = kv.second;
+            auto entry = objects.find(obj.getId());
+            if (!obj.model || entry == objects.end()) {
+                continue;  // added after the build, picked up by the next build
+            }
+
+            const glm::mat4 modelMatrix = obj.transform.mat4();
+            if (modelMatrix == entry->second.transform) {
+                continue;
+            }
+
+            entry->second.transform = modelMatrix;
+            const auto& meshes = obj.model->getMeshes();
+            for (uint32_t p: entry->second.primitives) {
+                primitiveBounds[p] = XEFrustum::transformAABB(meshes[items[p].meshIndex].bounds, modelMatrix);
+                moved.push_back(p);
+            }
+        }
+
+        if (!moved.empty()) {
+            refitPrimitives(moved);
+        }
+    }
+
+    void XESceneBVH::refitObject(XEGameObject &gameObject) {
+        auto entry = objects.find(gameObject.getId());
+        if (!gameObject.model || entry == objects.end()) {
+            return;
+        }
+
+        entry->second.transform = gameObject.transform.mat4();
+        const auto& meshes = gameObject.model->getMeshes();
+        for (uint32_t p: entry->second.primitives) {
+            primitiveBounds[p] = XEFrustum::transformAABB(meshes[items[p].meshIndex].bounds, entry->second.transform);
+        }
+        refitPrimitives(entry->second.primitives);
+    }
+
+    void XESceneBVH::refitPrimitives(const std::vector<uint32_t> &primitives) {
+        // Mark the touched leaves and their ancestors, then refit bottom-up. Children are always stored after
+        // their parent, so a reverse sweep visits them first.
+        std::vector<uint8_t> dirty(nodes.size(), 0);
+        for (uint32_t p: primitives) {
+            for (uint32_t n = primitiveLeaf[p]; n != ~0u && !dirty[n]; n = parents[n]) {
+                dirty[n] = 1;
+            }
+        }
+
+        for (uint32_t n = static_cast<uint32_t>(nodes.size()); n-- > 0;) {
+            if (!dirty[n]) {
+                continue;
+            }
+
+            Node& node = nodes[n];
+            if (node.primitiveCount > 0) {
+                node.bounds = emptyAABB();
+                for (uint32_t i = node.leftFirst; i < node.leftFirst + node.primitiveCount; i++) {
+                    node.bounds = mergeAABB(node.bounds, primitiveBounds[i]);
+                }
+            } else {
+                node.bounds = mergeAABB(nodes[node.leftFirst].bounds, nodes[node.leftFirst + 1].bounds);
+            }
+        }
+    }
+
+    void XESceneBVH::queryFrustum(const XEFrustum &frustum, std::vector<BVHItem> &result, BVHQueryStats *stats) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        BVHQueryStats localStats{};
+        uint32_t stack[BVH_MAX_DEPTH + 2];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const uint32_t entry = stack[--stackSize];
+            const uint32_t nodeIndex = entry & ~BVH_INSIDE_BIT;
+            uint32_t inside = entry & BVH_INSIDE_BIT;
+            const Node& node = nodes[nodeIndex];
+            localStats.nodesVisited++;
+
+            // Once a node is completely inside, nothing below it needs a plane test
+            if (!inside) {
+                const XEFrustum::Containment containment = frustum.classify(node.bounds);
+                if (containment == XEFrustum::Containment::Outside) {
+                    continue;
+                }
+                if (containment == XEFrustum::Containment::Inside) {
+                    inside = BVH_INSIDE_BIT;
+                }
+            }
+
+            if (node.primitiveCount > 0) {
+                for (uint32_t i = node.leftFirst; i < node.leftFirst + node.primitiveCount; i++) {
+                    if (!inside) {
+                        localStats.primitivesTested++;
+                        if (!frustum.intersects(primitiveBounds[i])) {
+                            continue;
+                        }
+                    }
+                    result.push_back(items[i]);
+                }
+            } else {
+                stack[stackSize++] = (node.leftFirst + 1) | inside;
+                stack[stackSize++] = node.leftFirst | inside;
+            }
+        }
+
+        if (stats) {
+            *stats = localStats;
+        }
+    }
+
+    bool XESceneBVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, BVHRayHit &hit,
+        float maxDistance) const {
+        if (nodes.empty()) {
+            return false;
+        }
+
+        const glm::vec3 invDirection = 1.0f / direction;
+        float closest = maxDistance;
+        bool found = false;
+
+        struct RayEntry {
+            uint32_t node;
+            float tNear;
+        };
+        RayEntry stack[BVH_MAX_DEPTH + 2];
+        uint32_t stackSize = 0;
+
+        float rootNear = 0.0f;
+        if (!intersectRay(nodes[0].bounds, origin, invDirection, closest, rootNear)) {
+            return false;
+        }
+        stack[stackSize++] = {0, rootNear};
+
+        while (stackSize > 0) {
+            const RayEntry entry = stack[--stackSize];
+            if (entry.tNear > closest) {
+                continue;  // a closer hit was found after this node was pushed
+            }
+
+            const Node& node = nodes[entry.node];
+            if (node.primitiveCount > 0) {
+                for (uint32_t i = node.leftFirst; i < node.leftFirst + node.primitiveCount; i++) {
+                    float t = 0.0f;
+                    if (intersectRay(primitiveBounds[i], origin, invDirection, closest, t) && t < closest) {
+                        closest = t;
+                        hit.item = items[i];
+                        hit.distance = t;
+                        found = true;
+                    }
+                }
+                continue;
+            }
+
+            // Visit the nearer child first so the farther one is usually pruned
+            float tLeft = 0.0f;
+            float tRight = 0.0f;
+            const bool hitLeft = intersectRay(nodes[node.leftFirst].bounds, origin, invDirection, closest, tLeft);
+            const bool hitRight = intersectRay(nodes[node.leftFirst + 1].bounds, origin, invDirection, closest, tRight);
+
+            if (hitLeft && hitRight) {
+                if (tLeft <= tRight) {
+                    stack[stackSize++] = {node.leftFirst + 1, tRight};
+                    stack[stackSize++] = {node.leftFirst, tLeft};
+                } else {
+                    stack[stackSize++] = {node.leftFirst, tLeft};
+                    stack[stackSize++] = {node.leftFirst + 1, tRight};
+                }
+            } else if (hitLeft) {
+                stack[stackSize++] = {node.leftFirst, tLeft};
+            } else if (hitRight) {
+                stack[stackSize++] = {node.leftFirst + 1, tRight};
+            }
+        }
+        return found;
+    }
+
+    XESceneBVH::BenchmarkResult XESceneBVH::benchmark(const std::vector<AABB3> &sceneBounds, uint32_t tiles,
+        const XEFrustum &frustum, const glm::vec3 &rayOrigin) {
+        BenchmarkResult result{};
+        if (sceneBounds.empty() || tiles == 0) {
+            return result;
+        }
+
+        AABB3 sceneExtent = emptyAABB();
+        for (const auto& b: sceneBounds) {
+            sceneExtent = mergeAABB(sceneExtent, b);
+        }
+        const float stepX = (sceneExtent.maxX - sceneExtent.minX) * 1.05f;
+        const float stepZ = (sceneExtent.maxZ - sceneExtent.minZ) * 1.05f;
+
+        // Tiles are centered on the original scene so the camera stays in the middle of the block
+        std::vector<BVHItem> tiledItems{};
+        std::vector<AABB3> tiledBounds{};
+        tiledItems.reserve(sceneBounds.size() * tiles * tiles);
+        tiledBounds.reserve(sceneBounds.size() * tiles * tiles);
+        for (uint32_t tz = 0; tz < tiles; tz++) {
+            for (uint32_t tx = 0; tx < tiles; tx++) {
+                const float offsetX = (static_cast<float>(tx) - static_cast<float>(tiles - 1) * 0.5f) * stepX;
+                const float offsetZ = (static_cast<float>(tz) - static_cast<float>(tiles - 1) * 0.5f) * stepZ;
+                for (uint32_t i = 0; i < sceneBounds.size(); i++) {
+                    const AABB3& b = sceneBounds[i];
+                    tiledItems.push_back({tz * tiles + tx, i});
+                    tiledBounds.push_back({b.minX + offsetX, b.minY, b.minZ + offsetZ,
+                        b.maxX + offsetX, b.maxY, b.maxZ + offsetZ});
+                }
+            }
+        }
+
+        using clock = std::chrono::steady_clock;
+        auto seconds = [](clock::time_point start) {
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+
+        XESceneBVH bvh{};
+        auto start = clock::now();
+        bvh.build(tiledItems, tiledBounds);
+        result.buildMs = seconds(start) * 1000.0;
+        result.primitiveCount = static_cast<uint32_t>(tiledItems.size());
+        result.nodeCount = static_cast<uint32_t>(bvh.nodes.size());
+
+        // Roughly the same amount of work for every scene size
+        const uint32_t frustumIterations = std::max(8u, 4000000u / result.primitiveCount);
+        std::vector<BVHItem> visible{};
+        visible.reserve(tiledItems.size());
+        size_t sink = 0;
+
+        start = clock::now();
+        for (uint32_t i = 0; i < frustumIterations; i++) {
+            visible.clear();
+            bvh.queryFrustum(frustum, visible);
+            sink += visible.size();
+        }
+        result.bvhFrustumQueriesPerSec = frustumIterations / seconds(start);
+        result.visiblePrimitives = static_cast<uint32_t>(visible.size());
+
+        start = clock::now();
+        for (uint32_t i = 0; i < frustumIterations; i++) {
+            visible.clear();
+            for (uint32_t p = 0; p < tiledBounds.size(); p++) {
+                if (frustum.intersects(tiledBounds[p])) {
+                    visible.push_back(tiledItems[p]);
+                }
+            }
+            sink += visible.size();
+        }
+        result.linearFrustumQueriesPerSec = frustumIterations / seconds(start);
+
+        if (visible.size() != result.visiblePrimitives) {
+            std::cerr << "[BVH] Frustum query mismatch: " << result.visiblePrimitives << " (bvh) vs " << visible.size()
+                << " (linear)" << std::endl;
+        }
+
+        std::mt19937 rng{1234};
+        std::uniform_real_distribution<float> uniform{-1.0f, 1.0f};
+        std::vector<glm::vec3> directions(1024);
+        for (auto& d: directions) {
+            do {
+                d = {uniform(rng), uniform(rng), uniform(rng)};
+            } while (glm::dot(d, d) < 1e-4f);
+            d = glm::normalize(d);
+        }
+
+        const uint32_t rayCount = std::max(static_cast<uint32_t>(directions.size()), 40000000u / result.primitiveCount);
+        uint32_t bvhHits = 0;
+        start = clock::now();
+        for (uint32_t i = 0; i < rayCount; i++) {
+            BVHRayHit hit{};
+            bvhHits += bvh.raycast(rayOrigin, directions[i % directions.size()], hit) ? 1 : 0;
+        }
+        result.bvhRaysPerSec = rayCount / seconds(start);
+
+        // The linear scan is slow on big scenes, a smaller ray batch is enough for a stable number
+        const uint32_t linearRayCount = std::max(64u, rayCount / 64);
+        uint32_t linearHits = 0;
+        start = clock::now();
+        for (uint32_t i = 0; i < linearRayCount; i++) {
+            const glm::vec3 invDirection = 1.0f / directions[i % directions.size()];
+            float closest = std::numeric_limits<float>::max();
+            bool found = false;
+            for (const auto& b: tiledBounds) {
+                float t = 0.0f;
+                if (intersectRay(b, rayOrigin, invDirection, closest, t) && t < closest) {
+                    closest = t;
+                    found = true;
+                }
+            }
+            linearHits += found ? 1 : 0;
+        }
+        result.linearRaysPerSec = linearRayCount / seconds(start);
+        sink += bvhHits + linearHits;
+
+        std::cout << "[BVH] " << result.primitiveCount << " primitives, " << result.nodeCount << " nodes, build "
+            << result.buildMs << " ms | frustum queries/s: bvh " << result.bvhFrustumQueriesPerSec << ", linear "
+            << result.linearFrustumQueriesPerSec << " (" << result.visiblePrimitives << " visible) | rays/s: bvh "
+            << result.bvhRaysPerSec << ", linear " << result.linearRaysPerSec << " (checksum " << sink << ")"
+            << std::endl;
+        return result;
+    }
+}
@@ -0,0 +1,101 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "scene/xe_game_object.h"
+#include "scene/xe_frustum.h"
+#include "utils/xe_utils.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace xe {
+
+    // One BVH primitive: a mesh of a game object, bounded in world space
+    struct BVHItem {
+        XEGameObject::id_t objectId;
+        uint32_t meshIndex;
+    };
+
+    struct BVHQueryStats {
+        uint32_t nodesVisited = 0;
+        uint32_t primitivesTested = 0;
+    };
+
+    struct BVHRayHit {
+        BVHItem item{};
+        float distance = std::numeric_limits<float>::max();
+    };
+
+    // Binned SAH bounding volume hierarchy over the world space mesh bounds of the scene.
+    // Nodes live in one flat array with siblings next to each other, primitives are stored in leaf order.
+    class XESceneBVH {
+    public:
+        struct Node {
+            AABB3 bounds;
+            uint32_t leftFirst;        // interior: left child (right child is leftFirst + 1), leaf: first primitive
+            uint32_t primitiveCount;   // 0 for interior nodes
+        };
+        static_assert(sizeof(Node) == 32, "two nodes per cache line");
+
+        struct BenchmarkResult {
+            uint32_t primitiveCount = 0;
+            uint32_t nodeCount = 0;
+            uint32_t visiblePrimitives = 0;
+            double buildMs = 0.0;
+            double bvhFrustumQueriesPerSec = 0.0;
+            double linearFrustumQueriesPerSec = 0.0;
+            double bvhRaysPerSec = 0.0;
+            double linearRaysPerSec = 0.0;
+        };
+
+        // Every mesh of every object with a model
+        void build(XEGameObject::Map& gameObjects);
+        void build(const std::vector<BVHItem>& items, const std::vector<AABB3>& worldBounds);
+
+        // Refits the objects whose transform changed since the last build/update. Topology is kept,
+        // so large movements degrade query quality until the next build.
+        void update(XEGameObject::Map& gameObjects);
+        void refitObject(XEGameObject& gameObject);
+
+        // Appends every primitive whose bounds intersect the frustum. Shadow cascades pass their orthographic
+        // light volume (with the near plane disabled when rendering with depth clamp).
+        void queryFrustum(const XEFrustum& frustum, std::vector<BVHItem>& result, BVHQueryStats* stats = nullptr) const;
+
+        // Closest primitive bounds hit along the ray (mesh granularity, no triangles on the CPU)
+        bool raycast(const glm::vec3& origin, const glm::vec3& direction, BVHRayHit& hit,
+            float maxDistance = std::numeric_limits<float>::max()) const;
+
+        bool empty() const { return nodes.empty(); }
+        const std::vector<Node>& getNodes() const { return nodes; }
+        const std::vector<AABB3>& getPrimitiveBounds() const { return primitiveBounds; }
+
+        // Build time and query throughput against a linear scan over the same bounds. The scene bounds are
+        // tiled tiles x tiles times on the XZ plane to emulate larger scenes.
+        static BenchmarkResult benchmark(const std::vector<AABB3>& sceneBounds, uint32_t tiles,
+            const XEFrustum& frustum, const glm::vec3& rayOrigin);
+
+    private:
+        void refitPrimitives(const std::vector<uint32_t>& primitives);
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> parents;          // per node, root has ~0u
+        std::vector<BVHItem> items;             // leaf order
+        std::vector<AABB3> primitiveBounds;     // leaf order
+        std::vector<uint32_t> primitiveLeaf;    // leaf node of every primitive
+
+        struct ObjectEntry {
+            glm::mat4 transform{1.f};
+            std::vector<uint32_t> primitives;
+        };
+        std::unordered_map<XEGameObject::id_t, ObjectEntry> objects;
+    };
+}
@@ -10,6 +10,9 @@
 #include "vulkan/vulkan.h"
 
 namespace xe {
+    class XESceneBVH;
+    class XEGPUCullingSystem;
+
     struct FrameInfo {
         int frameIndex;
         float frameTime;
@@ -18,5 +21,8 @@ namespace xe {
         VkDescriptorSet globalDescriptorSet;
         VkDescriptorSet lightDescriptorSet;
         XEGameObject::Map &gameObjects;
+        const XESceneBVH* sceneBVH = nullptr;  // optional, the systems fall back to a linear scan
+        const XEGPUCullingSystem* gpuCulling = nullptr;  // set when the frame's draws were culled on the GPU
+        float viewportHeight = 0.0f;  // pixels, for screen size estimates, 0 when unknown
     };
 }
@@ -0,0 +1,477 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "systems/xe_gpu_culling_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace xe {
+
+    struct CullPushConstantData {
+        uint32_t drawCount;
+        uint32_t viewCount;
+        uint32_t commandCapacity;
+        uint32_t batchCapacity;
+        uint32_t phase;            // CULL_PHASE_*
+        uint32_t lateRegion;       // command/count region of the late phase
+        uint32_t pad0, pad1;
+    };
+
+    // cull.comp phases
+    static constexpr uint32_t CULL_PHASE_ALL = 0;     // frustum only
+    static constexpr uint32_t CULL_PHASE_EARLY = 1;   // occlusion views keep last frame's visible draws
+    static constexpr uint32_t CULL_PHASE_LATE = 2;    // view 0 against the depth pyramid
+
+    // Indexed and non-indexed commands share the stride, see cull.comp
+    static constexpr VkDeviceSize COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
+    XEGPUCullingSystem::XEGPUCullingSystem(XEDevice &device, XEDrawManager &drawManager, XEDepthPyramid &depthPyramid,
+        uint32_t framesInFlight, uint32_t viewCount): xe_device(device), drawManager(drawManager),
+        depthPyramid(depthPyramid), viewCount(viewCount) {
+
+        if (viewCount > MAX_CULL_VIEWS) {
+            throw std::runtime_error("too many GPU culling views!");
+        }
+
+        views.resize(viewCount);
+        viewFrustums.resize(viewCount);
+        viewCastersOnly.assign(viewCount, false);
+        visibleCounts.assign(viewCount, 0);
+
+        supported = drawManager.isSupported() && device.enabledFeatures.multiDrawIndirect == VK_TRUE &&
+            device.enabledFeatures12.drawIndirectCount == VK_TRUE;
+        if (!supported) {
+            std::cout << "[GPUCulling] drawIndirectCount not supported, GPU culling disabled" << std::endl;
+            return;
+        }
+
+        descriptorPool = XEDescriptorPool::Builder(device)
+        .setMaxSets(framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight)
+        .build();
+
+        descriptorSetLayout = XEDescriptorSetLayout::Builder(device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstantData);
+
+        VkDescriptorSetLayout setLayout = descriptorSetLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline layout!");
+        }
+
+        uint32_t drawCapacity = 0;
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            drawCapacity = std::max(drawCapacity, drawManager.getCapacity(i));
+        }
+        createVisibilityBuffer(drawCapacity);
+
+        perFrame.resize(framesInFlight);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            perFrame[i].viewBuffer = std::make_unique<XEBuffer>(
+                device,
+                sizeof(GPUCullView),
+                MAX_CULL_VIEWS,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            perFrame[i].viewBuffer->map();
+
+            createBuffers(perFrame[i], drawManager.getCapacity(i), 64);
+            writeDescriptorSet(perFrame[i], i);
+        }
+    }
+
+    XEGPUCullingSystem::~XEGPUCullingSystem() {
+        cullPipeline.reset();
+        if (pipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(xe_device.device(), pipelineLayout, nullptr);
+        }
+    }
+
+    void XEGPUCullingSystem::createPipeline() {
+        cullPipeline = std::make_unique<XEPipeline>(xe_device, "assets\\shaders\\cull.spv", pipelineLayout);
+    }
+
+    void XEGPUCullingSystem::createBuffers(PerFrame &frame, uint32_t capacity, uint32_t batchCapacity) {
+        frame.capacity = capacity;
+        frame.batchCapacity = batchCapacity;
+
+        frame.commandBuffer = std::make_unique<XEBuffer>(
+            xe_device,
+            COMMAND_STRIDE,
+            capacity * (viewCount + 1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        frame.countBuffer = std::make_unique<XEBuffer>(
+            xe_device,
+            sizeof(uint32_t),
+            batchCapacity * (viewCount + 1) + 1,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        frame.readbackBuffer = std::make_unique<XEBuffer>(
+            xe_device,
+            frame.countBuffer->getBufferSize() + frame.commandBuffer->getBufferSize(),
+            1,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.readbackBuffer->map();
+
+        // Nothing recorded into the new buffers yet
+        frame.countsCopied = false;
+        frame.commandsCopied = false;
+    }
+
+    void XEGPUCullingSystem::createVisibilityBuffer(uint32_t capacity) {
+        visibilityCapacity = capacity;
+        visibilityBuffer = std::make_unique<XEBuffer>(
+            xe_device,
+            sizeof(uint32_t),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        visibilityCleared = false;
+    }
+
+    void XEGPUCullingSystem::writeDescriptorSet(PerFrame &frame, uint32_t frameIndex) {
+        XEBuffer& drawData = drawManager.getDrawDataBuffer(frameIndex);
+        auto drawDataInfo = drawData.descriptorInfo();
+        auto commandInfo = frame.commandBuffer->descriptorInfo();
+        auto countInfo = frame.countBuffer->descriptorInfo();
+        auto viewInfo = frame.viewBuffer->descriptorInfo();
+        VkDescriptorImageInfo pyramidInfo{depthPyramid.getSampler(), depthPyramid.getImageView(),
+            VK_IMAGE_LAYOUT_GENERAL};
+        auto visibilityInfo = visibilityBuffer->descriptorInfo();
+
+        XEDescriptorWriter writer{*descriptorSetLayout, *descriptorPool};
+        writer.writeBuffer(0, &drawDataInfo)
+            .writeBuffer(1, &commandInfo)
+            .writeBuffer(2, &countInfo)
+            .writeBuffer(3, &viewInfo)
+            .writeImage(4, &pyramidInfo)
+            .writeBuffer(5, &visibilityInfo);
+        if (frame.descriptorSet == VK_NULL_HANDLE) {
+            writer.build(frame.descriptorSet);
+        } else {
+            writer.overwrite(frame.descriptorSet);
+        }
+        frame.boundDrawData = drawData.getBuffer();
+        frame.boundVisibility = visibilityBuffer->getBuffer();
+        frame.boundPyramidGeneration = depthPyramid.getGeneration();
+    }
+
+    void XEGPUCullingSystem::setView(uint32_t view, const XEFrustum &frustum, bool castersOnly) {
+        assert(view < viewCount && "GPU culling view out of range");
+
+        GPUCullView& gpuView = views[view];
+        for (uint32_t i = 0; i < XEFrustum::PlaneCount; i++) {
+            // A plane every point is in front of
+            gpuView.planes[i] = frustum.isPlaneEnabled(static_cast<XEFrustum::Plane>(i)) ?
+                frustum.getPlanes()[i] : glm::vec4(0.f, 0.f, 0.f, 1.f);
+        }
+        gpuView.castersOnly = castersOnly ? 1u : 0u;
+
+        viewFrustums[view] = frustum;
+        viewCastersOnly[view] = castersOnly;
+    }
+
+    void XEGPUCullingSystem::setOcclusion(bool enabled, const glm::mat4 &viewProjection) {
+        occlusionEnabled = enabled;
+        views[0].viewProjection = viewProjection;
+        views[0].occlusion = enabled ? 1u : 0u;
+    }
+
+    void XEGPUCullingSystem::cull(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        if (!supported) {
+            return;
+        }
+        if (!cullPipeline) {
+            createPipeline();
+        }
+
+        PerFrame& frame = perFrame[frameIndex];
+        const auto& batches = drawManager.getObjectBatches();
+        const uint32_t drawCount = drawManager.getDrawCount();
+        const uint32_t batchCount = static_cast<uint32_t>(batches.size());
+
+        // Shared by every frame slot, so the other slot's cull must be finished before it is replaced
+        if (drawManager.getCapacity(frameIndex) > visibilityCapacity) {
+            vkDeviceWaitIdle(xe_device.device());
+            createVisibilityBuffer(drawManager.getCapacity(frameIndex));
+        }
+
+        // The fence of this frame slot was waited on, so its buffers are free to be replaced
+        if (drawManager.getCapacity(frameIndex) > frame.capacity || batchCount > frame.batchCapacity) {
+            createBuffers(frame, std::max(drawManager.getCapacity(frameIndex), frame.capacity),
+                std::max(batchCount, frame.batchCapacity + frame.batchCapacity / 2));
+            writeDescriptorSet(frame, frameIndex);
+        } else if (drawManager.getDrawDataBuffer(frameIndex).getBuffer() != frame.boundDrawData ||
+            visibilityBuffer->getBuffer() != frame.boundVisibility ||
+            depthPyramid.getGeneration() != frame.boundPyramidGeneration) {
+            writeDescriptorSet(frame, frameIndex);
+        }
+
+        frame.viewBuffer->writeToBuffer(views.data(), sizeof(GPUCullView) * viewCount);
+        frame.occlusion = occlusionEnabled;
+        frame.validating = validationRequested;
+        validationRequested = false;
+        frame.drawCount = drawCount;
+        frame.batches = batches;
+        frame.frustums = viewFrustums;
+        frame.castersOnly = viewCastersOnly;
+
+        vkCmdFillBuffer(commandBuffer, frame.countBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        if (!visibilityCleared) {
+            // Nothing counts as visible at first, the late phase draws all of it
+            vkCmdFillBuffer(commandBuffer, visibilityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+            visibilityCleared = true;
+        }
+
+        // Also orders the last submitted late phase's visibility writes before this early phase
+        VkMemoryBarrier clearBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        dispatch(commandBuffer, frame, frame.occlusion ? CULL_PHASE_EARLY : CULL_PHASE_ALL, viewCount);
+
+        // Without occlusion nothing else touches the counts this frame
+        if (!frame.occlusion) {
+            recordReadback(commandBuffer, frame);
+        }
+    }
+
+    void XEGPUCullingSystem::cullLate(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        PerFrame& frame = perFrame[frameIndex];
+        if (!supported || !frame.occlusion) {
+            return;
+        }
+
+        // The pyramid build ends with its own write -> read barrier
+        dispatch(commandBuffer, frame, CULL_PHASE_LATE, 1);
+        recordReadback(commandBuffer, frame);
+    }
+
+    void XEGPUCullingSystem::dispatch(VkCommandBuffer commandBuffer, PerFrame &frame, uint32_t phase,
+        uint32_t dispatchViews) {
+        if (frame.drawCount > 0) {
+            cullPipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                0, 1,
+                &frame.descriptorSet,
+                0,
+                nullptr);
+
+            CullPushConstantData push{frame.drawCount, viewCount, frame.capacity, frame.batchCapacity, phase,
+                viewCount, 0, 0};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkCmdDispatch(commandBuffer, (frame.drawCount + 63) / 64, dispatchViews, 1);
+        }
+
+        VkMemoryBarrier cullBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &cullBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void XEGPUCullingSystem::recordReadback(VkCommandBuffer commandBuffer, PerFrame &frame) {
+        // Counts every frame for the stats, the commands only when a validation was asked for
+        const VkDeviceSize countBytes = frame.countBuffer->getBufferSize();
+        VkBufferCopy countCopy{0, 0, countBytes};
+        vkCmdCopyBuffer(commandBuffer, frame.countBuffer->getBuffer(), frame.readbackBuffer->getBuffer(), 1, &countCopy);
+        frame.countsCopied = true;
+
+        if (frame.validating) {
+            VkBufferCopy commandCopy{0, countBytes, frame.commandBuffer->getBufferSize()};
+            vkCmdCopyBuffer(commandBuffer, frame.commandBuffer->getBuffer(), frame.readbackBuffer->getBuffer(), 1,
+                &commandCopy);
+            frame.commandsCopied = true;
+            frame.validating = false;
+        }
+
+        VkMemoryBarrier readbackBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            1, &readbackBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void XEGPUCullingSystem::drawBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t view,
+        uint32_t batchIndex) const {
+        assert(view <= viewCount && "GPU culling view out of range");
+        const PerFrame& frame = perFrame[frameIndex];
+        const ObjectBatch& batch = frame.batches[batchIndex];
+
+        const VkDeviceSize commandOffset = (static_cast<VkDeviceSize>(view) * frame.capacity + batch.firstDraw) *
+            COMMAND_STRIDE;
+        const VkDeviceSize countOffset = (static_cast<VkDeviceSize>(view) * frame.batchCapacity + batchIndex) *
+            sizeof(uint32_t);
+
+        if (batch.model->isIndexed()) {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, frame.commandBuffer->getBuffer(), commandOffset,
+                frame.countBuffer->getBuffer(), countOffset, batch.drawCount, COMMAND_STRIDE);
+        } else {
+            vkCmdDrawIndirectCount(commandBuffer, frame.commandBuffer->getBuffer(), commandOffset,
+                frame.countBuffer->getBuffer(), countOffset, batch.drawCount, COMMAND_STRIDE);
+        }
+    }
+
+    void XEGPUCullingSystem::readResults(uint32_t frameIndex) {
+        if (!supported) {
+            return;
+        }
+
+        // The frame's fence has been waited on, so the copies of the last cull using this slot are complete
+        PerFrame& frame = perFrame[frameIndex];
+        if (!frame.countsCopied) {
+            return;
+        }
+        frame.countsCopied = false;
+
+        const auto* counts = static_cast<const uint32_t*>(frame.readbackBuffer->getMappedMemory());
+        auto regionCount = [&](uint32_t region) {
+            uint32_t visible = 0;
+            for (uint32_t b = 0; b < frame.batches.size(); b++) {
+                visible += std::min(counts[region * frame.batchCapacity + b], frame.batches[b].drawCount);
+            }
+            return visible;
+        };
+        for (uint32_t view = 0; view < viewCount; view++) {
+            visibleCounts[view] = regionCount(view);
+        }
+
+        if (frame.occlusion) {
+            occlusionStats.earlyDraws = visibleCounts[0];
+            occlusionStats.lateDraws = regionCount(viewCount);
+            occlusionStats.occluded = counts[(viewCount + 1) * frame.batchCapacity];
+            visibleCounts[0] += occlusionStats.lateDraws;
+        } else {
+            occlusionStats = {};
+        }
+
+        if (frame.commandsCopied) {
+            frame.commandsCopied = false;
+            validate(frame, frameIndex);
+        }
+    }
+
+    void XEGPUCullingSystem::validate(const PerFrame &frame, uint32_t frameIndex) {
+        const auto* readback = static_cast<const uint8_t*>(frame.readbackBuffer->getMappedMemory());
+        const auto* counts = reinterpret_cast<const uint32_t*>(readback);
+        const auto* commands = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(readback +
+            frame.countBuffer->getBufferSize());
+        // Not rewritten yet, beginFrame of this slot comes after readResults
+        const auto* drawData = static_cast<const GPUDrawData*>(
+            drawManager.getDrawDataBuffer(frameIndex).getMappedMemory());
+
+        GPUCullValidation result{};
+        result.done = true;
+        std::vector<uint8_t> gpuKept(frame.drawCount);
+
+        for (uint32_t view = 0; view < viewCount; view++) {
+            std::fill(gpuKept.begin(), gpuKept.end(), 0);
+
+            // The camera's late region holds the rest of its draws
+            const bool occlusion = view == 0 && frame.occlusion;
+            std::vector<uint32_t> regions{view};
+            if (occlusion) {
+                regions.push_back(viewCount);
+            }
+            for (uint32_t region: regions) {
+                for (uint32_t b = 0; b < frame.batches.size(); b++) {
+                    const ObjectBatch& batch = frame.batches[b];
+                    uint32_t count = counts[region * frame.batchCapacity + b];
+                    if (count > batch.drawCount) {
+                        result.mismatches += count - batch.drawCount;
+                        count = batch.drawCount;
+                    }
+
+                    const bool indexed = batch.model->isIndexed();
+                    for (uint32_t i = 0; i < count; i++) {
+                        const VkDrawIndexedIndirectCommand& command = commands[region * frame.capacity + batch.firstDraw + i];
+                        // Non-indexed: {vertexCount, instanceCount, firstVertex, firstInstance, pad}
+                        const uint32_t drawIndex = indexed ? command.firstInstance :
+                            static_cast<uint32_t>(command.vertexOffset);
+
+                        if (drawIndex < batch.firstDraw || drawIndex >= batch.firstDraw + batch.drawCount ||
+                            gpuKept[drawIndex]) {
+                            result.mismatches++;
+                            continue;
+                        }
+
+                        const GPUDrawData& draw = drawData[drawIndex];
+                        const bool contentsMatch = indexed ?
+                            command.indexCount == draw.indexCount && command.firstIndex == draw.firstIndex &&
+                            command.vertexOffset == draw.vertexOffset :
+                            command.indexCount == draw.indexCount && command.firstIndex == static_cast<uint32_t>(draw.vertexOffset);
+                        if (!contentsMatch || command.instanceCount != 1) {
+                            result.mismatches++;
+                        }
+
+                        gpuKept[drawIndex] = 1;
+                        result.gpuVisible[view]++;
+                    }
+                }
+            }
+
+            for (uint32_t d = 0; d < frame.drawCount; d++) {
+                const GPUDrawData& draw = drawData[d];
+                bool visible = !(frame.castersOnly[view] && !(draw.cullFlags & DRAW_CULL_CASTS_SHADOW));
+                if (visible) {
+                    const AABB3 localBounds{draw.boundsMin.x, draw.boundsMin.y, draw.boundsMin.z,
+                        draw.boundsMax.x, draw.boundsMax.y, draw.boundsMax.z};
+                    visible = frame.frustums[view].intersects(XEFrustum::transformAABB(localBounds, draw.modelMatrix));
+                }
+
+                if (visible) {
+                    result.cpuVisible[view]++;
+                }
+                // Occluded draws are dropped on top of the frustum test, so the GPU only has to keep a subset
+                if (occlusion ? (gpuKept[d] != 0 && !visible) : visible != (gpuKept[d] != 0)) {
+                    result.mismatches++;
+                }
+            }
+
+            std::cout << "[GPUCulling] View " << view << ": GPU " << result.gpuVisible[view] << " / CPU "
+                << result.cpuVisible[view] << " of " << frame.drawCount << " draws" << std::endl;
+        }
+
+        // Boxes touching a plane can land on either side through float rounding, so a few are expected
+        if (result.mismatches == 0) {
+            std::cout << "[GPUCulling] Validation passed" << std::endl;
+        } else {
+            std::cout << "[GPUCulling] Validation found " << result.mismatches << " mismatches" << std::endl;
+        }
+        lastValidation = result;
+    }
+}
@@ -0,0 +1,162 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_device.h"
+#include "renderer/xe_buffer.h"
+#include "renderer/xe_descriptors.h"
+#include "renderer/xe_pipeline.h"
+#include "renderer/xe_depth_pyramid.h"
+#include "renderer/gfx_resource_managers/xe_draw_manager.h"
+#include "scene/xe_frustum.h"
+
+#include "vulkan/vulkan.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace xe {
+
+    static constexpr uint32_t MAX_CULL_VIEWS = 8;
+
+    // std140 CullView of cull.comp
+    struct GPUCullView {
+        std::array<glm::vec4, XEFrustum::PlaneCount> planes{};
+        glm::mat4 viewProjection{1.f};  // occlusion test only
+        uint32_t castersOnly{0};
+        uint32_t occlusion{0};
+        uint32_t pad[2]{};
+    };
+    static_assert(sizeof(GPUCullView) == 176, "must match the std140 CullView struct");
+
+    struct GPUCullValidation {
+        bool done = false;
+        uint32_t mismatches = 0;     // draws only one side kept, plus GPU commands with wrong contents
+        std::array<uint32_t, MAX_CULL_VIEWS> gpuVisible{};
+        std::array<uint32_t, MAX_CULL_VIEWS> cpuVisible{};
+    };
+
+    // Camera draws of the last completed two-phase cull
+    struct GPUOcclusionStats {
+        uint32_t earlyDraws = 0;     // visible last frame, drawn before the pyramid build
+        uint32_t lateDraws = 0;      // newly visible, drawn after it
+        uint32_t occluded = 0;       // in the frustum but behind the pyramid
+    };
+
+    // Frustum culling of every XEDrawManager draw in a compute pass. Each view (camera, shadow cascades) gets
+    // a compacted command region and one count per object, drawn with vkCmdDraw(Indexed)IndirectCount, so the
+    // CPU records one call per object and view no matter how many meshes are visible.
+    //
+    // With occlusion on, the camera view is culled in two phases. cull() keeps only the draws that were visible
+    // last frame, those are drawn and the depth pyramid is built from their depth, then cullLate() tests every
+    // draw against the pyramid, records the result for the next frame and emits the newly visible ones into
+    // getLateView().
+    class XEGPUCullingSystem {
+    public:
+        XEGPUCullingSystem(XEDevice& device, XEDrawManager& drawManager, XEDepthPyramid& depthPyramid,
+            uint32_t framesInFlight, uint32_t viewCount);
+        ~XEGPUCullingSystem();
+
+        XEGPUCullingSystem(const XEGPUCullingSystem&) = delete;
+        XEGPUCullingSystem& operator=(const XEGPUCullingSystem&) = delete;
+
+        // Needs drawIndirectCount (Vulkan 1.2) on top of what the draw manager needs
+        bool isSupported() const { return supported; }
+
+        // Call after the frame fence wait and before XEDrawManager::beginFrame, while the slot's draw data
+        // still holds what the last cull of this slot read
+        void readResults(uint32_t frameIndex);
+
+        // Views are kept until changed, a frustum with every plane disabled keeps every draw
+        void setView(uint32_t view, const XEFrustum& frustum, bool castersOnly);
+
+        // Two-phase occlusion culling of view 0 against the depth pyramid, projected with viewProjection
+        void setOcclusion(bool enabled, const glm::mat4& viewProjection);
+        bool isOcclusionEnabled() const { return occlusionEnabled; }
+
+        // Records the cull dispatch, outside of any render pass and after XEDrawManager::beginFrame.
+        // With occlusion on this is the early phase, the pyramid must have its size for this frame already.
+        void cull(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        // Late phase, after the depth pyramid was built from the early draws, outside of any render pass
+        void cullLate(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        // Draws the visible meshes of one object (XEDrawManager::getObjectBatches index) in a view
+        void drawBatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t view, uint32_t batchIndex) const;
+
+        // Command region of the camera draws found by cullLate, pass it to drawBatch as the view
+        uint32_t getLateView() const { return viewCount; }
+
+        // Reads back the commands of the next cull and compares them against XEFrustum on the CPU
+        void requestValidation() { validationRequested = true; }
+        const GPUCullValidation& getLastValidation() const { return lastValidation; }
+
+        // Visible meshes per view, from the last completed cull (a frame or two behind)
+        uint32_t getVisibleCount(uint32_t view) const { return visibleCounts[view]; }
+        const GPUOcclusionStats& getOcclusionStats() const { return occlusionStats; }
+
+    private:
+        struct PerFrame {
+            std::unique_ptr<XEBuffer> viewBuffer;
+            std::unique_ptr<XEBuffer> commandBuffer;   // viewCount + 1 (late) regions of `capacity` commands
+            std::unique_ptr<XEBuffer> countBuffer;     // viewCount + 1 regions of `batchCapacity` counts, occluded count
+            std::unique_ptr<XEBuffer> readbackBuffer;  // counts, then the commands when validating
+            VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+            VkBuffer boundDrawData{VK_NULL_HANDLE};
+            VkBuffer boundVisibility{VK_NULL_HANDLE};
+            uint32_t boundPyramidGeneration{0};
+            uint32_t capacity{0};
+            uint32_t batchCapacity{0};
+
+            // What the recorded cull saw, for readResults
+            bool countsCopied{false};
+            bool commandsCopied{false};
+            bool occlusion{false};
+            bool validating{false};
+            uint32_t drawCount{0};
+            std::vector<ObjectBatch> batches;
+            std::vector<XEFrustum> frustums;
+            std::vector<bool> castersOnly;
+        };
+
+        void createPipeline();
+        void createBuffers(PerFrame& frame, uint32_t capacity, uint32_t batchCapacity);
+        void createVisibilityBuffer(uint32_t capacity);
+        void writeDescriptorSet(PerFrame& frame, uint32_t frameIndex);
+        void dispatch(VkCommandBuffer commandBuffer, PerFrame& frame, uint32_t phase, uint32_t dispatchViews);
+        void recordReadback(VkCommandBuffer commandBuffer, PerFrame& frame);
+        void validate(const PerFrame& frame, uint32_t frameIndex);
+
+        XEDevice& xe_device;
+        XEDrawManager& drawManager;
+        XEDepthPyramid& depthPyramid;
+        uint32_t viewCount;
+        bool supported{false};
+
+        std::unique_ptr<XEPipeline> cullPipeline;
+        VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+        std::unique_ptr<XEDescriptorPool> descriptorPool{};
+        std::unique_ptr<XEDescriptorSetLayout> descriptorSetLayout{};
+
+        std::vector<PerFrame> perFrame;
+
+        // One flag per draw, whether the late phase found it visible. Shared by the frames in flight, they
+        // run in submission order and the next early phase reads what the last late phase wrote.
+        std::unique_ptr<XEBuffer> visibilityBuffer;
+        uint32_t visibilityCapacity{0};
+        bool visibilityCleared{false};
+
+        std::vector<GPUCullView> views;
+        std::vector<XEFrustum> viewFrustums;
+        std::vector<bool> viewCastersOnly;
+        std::vector<uint32_t> visibleCounts;
+        bool occlusionEnabled{false};
+        GPUOcclusionStats occlusionStats{};
+
+        bool validationRequested{false};
+        GPUCullValidation lastValidation{};
+    };
+}
@@ -0,0 +1,75 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "systems/xe_light_cluster_system.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace xe {
+
+    XELightClusterSystem::XELightClusterSystem(XEDevice &device, XELightManager &lightManager):
+        xe_device(device), lightManager(lightManager) {
+
+        VkDescriptorSetLayout setLayout = lightManager.getDescriptorLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create light cluster pipeline layout!");
+        }
+    }
+
+    XELightClusterSystem::~XELightClusterSystem() {
+        clusterPipeline.reset();
+        vkDestroyPipelineLayout(xe_device.device(), pipelineLayout, nullptr);
+    }
+
+    void XELightClusterSystem::assignLights(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+        const glm::mat4 &projection, const glm::mat4 &view, float nearClip, float farClip, VkExtent2D extent) {
+
+        GPUClusterInfo info{};
+        // Not rounded: the cluster bounds are exact fractions of the screen, the fragment lookup must match them
+        info.tileSize = glm::vec4(
+            static_cast<float>(extent.width) / LIGHT_CLUSTER_X,
+            static_cast<float>(extent.height) / LIGHT_CLUSTER_Y, 0.f, 0.f);
+        // slice = log(z / near) * Z / log(far / near), folded into scale * log(z) + bias
+        const float sliceScale = static_cast<float>(LIGHT_CLUSTER_Z) / std::log(farClip / nearClip);
+        info.depth = glm::vec4(nearClip, farClip, sliceScale, -std::log(nearClip) * sliceScale);
+        info.projection = glm::vec4(projection[0][0], projection[1][1], enabled ? 1.f : 0.f, 0.f);
+        info.view = view;
+        lightManager.setClusterInfo(frameIndex, info);
+
+        if (!enabled) {
+            return;
+        }
+        if (!clusterPipeline) {
+            clusterPipeline = std::make_unique<XEPipeline>(xe_device, "assets\\shaders\\light_cluster.spv",
+                pipelineLayout);
+        }
+
+        clusterPipeline->bind(commandBuffer);
+        VkDescriptorSet lightSet = lightManager.descriptorSet(frameIndex);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            pipelineLayout,
+            0, 1,
+            &lightSet,
+            0,
+            nullptr);
+        vkCmdDispatch(commandBuffer, (LIGHT_CLUSTER_COUNT + 63) / 64, 1, 1);
+
+        // The lists of this frame slot are read by the main pass fragment shader
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
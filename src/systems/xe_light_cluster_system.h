@@ -0,0 +1,46 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "renderer/xe_device.h"
+#include "renderer/xe_pipeline.h"
+#include "renderer/lighting/xe_light_manager.h"
+#include "renderer/lighting/xe_lights.h"
+
+#include "vulkan/vulkan.h"
+
+#include <memory>
+
+namespace xe {
+
+    // Clustered forward lighting. Splits the camera frustum into LIGHT_CLUSTER_X x Y screen tiles and
+    // LIGHT_CLUSTER_Z exponential depth slices, and assigns the lights of XELightManager to the clusters their
+    // range touches in a compute pass, so simple_fragment.frag only evaluates the lights of its own cluster.
+    // The results live in the light manager's descriptor set (bindings 1 and 2).
+    class XELightClusterSystem {
+    public:
+        XELightClusterSystem(XEDevice& device, XELightManager& lightManager);
+        ~XELightClusterSystem();
+
+        XELightClusterSystem(const XELightClusterSystem&) = delete;
+        XELightClusterSystem& operator=(const XELightClusterSystem&) = delete;
+
+        // Off: the fragment shader loops over every light
+        void setEnabled(bool enable) { enabled = enable; }
+        bool isEnabled() const { return enabled; }
+
+        // Records the assignment, after XELightManager::upload and outside of any render pass
+        void assignLights(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4& projection,
+            const glm::mat4& view, float nearClip, float farClip, VkExtent2D extent);
+
+    private:
+        XEDevice& xe_device;
+        XELightManager& lightManager;
+        bool enabled{true};
+
+        std::unique_ptr<XEPipeline> clusterPipeline;
+        VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    };
+}
@@ -0,0 +1,803 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "systems/xe_local_shadow_system.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "renderer/xe_swap_chain.h"
+
+namespace xe {
+
+    struct LocalShadowPushConstantData {
+        glm::mat4 modelViewProjection{1.f};  // the tile's light view projection folded in on the CPU
+    };
+
+    static constexpr VkDeviceSize TILE_BUFFER_TILES_OFFSET = sizeof(glm::uvec4);
+    static constexpr VkDeviceSize TILE_BUFFER_SLOTS_OFFSET =
+        TILE_BUFFER_TILES_OFFSET + MAX_LOCAL_SHADOW_TILES * sizeof(GPULocalShadowTile);
+    static constexpr VkDeviceSize TILE_BUFFER_SIZE = TILE_BUFFER_SLOTS_OFFSET + MAX_LOCAL_SHADOW_SLOTS * sizeof(uint32_t);
+
+    // Half angle of the spot frustum, a little wider than the outer cone so PCF at the cone edge stays inside
+    static float spotHalfAngle(const GPULight& light) {
+        const float outerAngle = std::acos(std::clamp(light.param.z, -1.0f, 1.0f));
+        return std::min(outerAngle + glm::radians(2.0f), glm::radians(85.0f));
+    }
+
+    static bool sphereTouchesBox(const glm::vec3& center, float radius, const AABB3& box) {
+        const glm::vec3 closest = glm::clamp(center, glm::vec3(box.minX, box.minY, box.minZ),
+            glm::vec3(box.maxX, box.maxY, box.maxZ));
+        const glm::vec3 d = closest - center;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    XELocalShadowSystem::XELocalShadowSystem(XEDevice &device, XELightManager &lightManager, uint32_t atlasSize):
+        xe_device(device), lightManager(lightManager), atlas(atlasSize, 64), maxTileSize(atlasSize / 4) {
+
+        gpuTiles.resize(MAX_LOCAL_SHADOW_TILES);
+        slotTiles.assign(MAX_LOCAL_SHADOW_SLOTS, 0);
+
+        createRenderPass();
+        createAtlas();
+        createFramebuffer();
+        createSampler();
+        createBuffers();
+        createDescriptors();
+
+        createPipelineLayout();
+    }
+
+    XELocalShadowSystem::~XELocalShadowSystem() {
+        vkDestroyPipelineLayout(xe_device.device(), pipelineLayout, nullptr);
+        vkDestroySampler(xe_device.device(), sampler, nullptr);
+        vkDestroyFramebuffer(xe_device.device(), framebuffer, nullptr);
+        vkDestroyImageView(xe_device.device(), atlasView, nullptr);
+        vkDestroyRenderPass(xe_device.device(), renderPass, nullptr);
+    }
+
+    bool XELocalShadowSystem::setShadowed(LightHandle handle, bool shadowed, float importance) {
+        auto it = std::find_if(lights.begin(), lights.end(), [&](const ShadowedLight& light) {
+            return light.handle == handle;
+        });
+
+        if (!shadowed) {
+            if (it != lights.end()) {
+                releaseTiles(*it);
+                lights.erase(it);
+            }
+            return true;
+        }
+
+        if (it != lights.end()) {
+            it->importance = importance;
+            return true;
+        }
+        if (lights.size() >= MAX_SHADOWED_LOCAL_LIGHTS) {
+            return false;
+        }
+
+        ShadowedLight light{};
+        light.handle = handle;
+        light.importance = importance;
+        lights.push_back(light);
+        return true;
+    }
+
+    bool XELocalShadowSystem::isShadowed(LightHandle handle) const {
+        return std::any_of(lights.begin(), lights.end(), [&](const ShadowedLight& light) {
+            return light.handle == handle;
+        });
+    }
+
+    void XELocalShadowSystem::setEnabled(bool enable) {
+        if (enabled && !enable) {
+            releaseAll();
+        }
+        enabled = enable;
+    }
+
+    void XELocalShadowSystem::update(FrameInfo &frame_info) {
+        frameCounter++;
+        stats = {};
+
+        if (!enabled) {
+            writeTileBuffer(frame_info.frameIndex);
+            return;
+        }
+
+        trackCasters(frame_info.gameObjects);
+
+        XECamera& camera = frame_info.camera;
+        const XEFrustum cameraFrustum{camera.getProjection() * camera.getView()};
+        const glm::vec3 cameraPosition{camera.getInverseView()[3]};
+        const float tanHalfFov = std::tan(camera.getFOV() * 0.5f);
+
+        // (light index, tile size) of the visible lights whose tiles have to be (re)allocated
+        std::vector<std::pair<uint32_t, uint32_t>> pending;
+
+        for (uint32_t i = 0; i < lights.size(); i++) {
+            ShadowedLight& light = lights[i];
+
+            const bool alive = lightManager.getLightSlot(light.handle) < lightManager.getLightCount();
+            const GPULight* gpuLight = alive ? &lightManager.getLight(light.handle) : nullptr;
+            const uint32_t type = gpuLight ? static_cast<uint32_t>(gpuLight->position.w + 0.5f) : 0;
+            if ((type != 1 && type != 2) || gpuLight->color.a <= 0.0f || gpuLight->param.x <= 0.0f) {
+                releaseTiles(light);
+                light.type = 0;
+                light.visible = false;
+                continue;
+            }
+
+            if (type != light.type) {
+                releaseTiles(light);
+                light.type = type;
+                light.faceCount = type == 1 ? 6 : 1;
+                light.shape = *gpuLight;
+                updateProjections(light);
+            } else if (shapeChanged(light, *gpuLight)) {
+                light.shape = *gpuLight;
+                updateProjections(light);
+                light.dirty.fill(true);
+            }
+
+            const glm::vec3 position{gpuLight->position};
+            const float range = gpuLight->param.x;
+            light.visible = cameraFrustum.intersects(BoundingSphere{position.x, position.y, position.z, range});
+
+            // Projected radius of the light's sphere over half the screen height, a light filling the screen
+            // asks for the largest tile
+            const float distance = glm::length(position - cameraPosition);
+            const float coverage = distance <= range ? 1.0f : std::min(1.0f, range / (distance * tanHalfFov));
+            light.requestedTexels = coverage * light.importance * static_cast<float>(maxTileSize);
+
+            // Off screen lights keep their tiles until the space is needed
+            if (!light.visible) {
+                continue;
+            }
+
+            // Within the rounding band of the current size plus some slack the tiles stay put, so a light
+            // hovering around a power of two does not re-render every frame
+            uint32_t tileSize = light.tileSize;
+            if (tileSize == 0 || light.requestedTexels > tileSize * 1.25f || light.requestedTexels < tileSize * 0.4f) {
+                tileSize = std::min(atlas.roundTileSize(light.requestedTexels), maxTileSize);
+            }
+            if (tileSize != light.tileSize) {
+                pending.emplace_back(i, tileSize);
+            }
+        }
+
+        // Largest first, they are the hardest to place
+        std::sort(pending.begin(), pending.end(), [&](const auto& a, const auto& b) {
+            return lights[a.first].requestedTexels > lights[b.first].requestedTexels;
+        });
+
+        for (const auto& [index, requestedSize]: pending) {
+            ShadowedLight& light = lights[index];
+
+            if (light.tileSize != 0) {
+                // Resized only when the new tiles fit, otherwise the current ones stay valid and cached
+                const auto currentTiles = light.tiles;
+                if (allocateTiles(light, requestedSize)) {
+                    for (const auto& tile: currentTiles) {
+                        atlas.release(tile);
+                    }
+                } else {
+                    light.tiles = currentTiles;
+                }
+                continue;
+            }
+
+            uint32_t tileSize = requestedSize;
+            while (!allocateTiles(light, tileSize)) {
+                // Evict an off screen light first, then settle for smaller tiles
+                auto offscreen = std::find_if(lights.begin(), lights.end(), [](const ShadowedLight& other) {
+                    return !other.visible && other.tileSize != 0;
+                });
+                if (offscreen != lights.end()) {
+                    releaseTiles(*offscreen);
+                } else if (tileSize > atlas.getMinTileSize()) {
+                    tileSize >>= 1;
+                } else {
+                    stats.unallocatedLights++;
+                    break;
+                }
+            }
+        }
+
+        for (ShadowedLight& light: lights) {
+            if (light.tileSize == 0) {
+                continue;
+            }
+
+            // Casters that moved into, out of or inside a face's frustum
+            const glm::vec3 position{light.shape.position};
+            const float range = light.shape.param.x;
+            for (const AABB3& bounds: changedCasterBounds) {
+                if (!sphereTouchesBox(position, range, bounds)) {
+                    continue;
+                }
+                for (uint32_t face = 0; face < light.faceCount; face++) {
+                    if (!light.dirty[face] && light.frustums[face].intersects(bounds)) {
+                        light.dirty[face] = true;
+                    }
+                }
+            }
+            if (!caching) {
+                light.dirty.fill(true);
+            }
+
+            // Destroying other lights moves this one to another slot
+            const uint32_t slot = lightManager.getLightSlot(light.handle);
+            if (slot != light.slot) {
+                light.slot = slot;
+                tileBufferDirty = true;
+            }
+
+            stats.shadowedLights++;
+            stats.tiles += light.faceCount;
+        }
+        stats.atlasUsage = static_cast<float>(static_cast<double>(atlas.getUsedTexels()) /
+            (static_cast<double>(atlas.getAtlasSize()) * atlas.getAtlasSize()));
+
+        writeTileBuffer(frame_info.frameIndex);
+    }
+
+    void XELocalShadowSystem::render(FrameInfo &frame_info) {
+        stats.renderedTiles = 0;
+        stats.casterDraws = 0;
+
+        // Off screen lights light nothing visible, their dirty tiles wait until they come back
+        const bool anyDirty = std::any_of(lights.begin(), lights.end(), [](const ShadowedLight& light) {
+            return light.visible && light.tileSize != 0 &&
+                std::any_of(light.dirty.begin(), light.dirty.begin() + light.faceCount, [](bool dirty) { return dirty; });
+        });
+        if (!enabled || !anyDirty) {
+            return;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = {atlas.getAtlasSize(), atlas.getAtlasSize()};
+        // Loaded, only the dirty tiles are cleared
+        renderPassInfo.clearValueCount = 0;
+
+        vkCmdBeginRenderPass(frame_info.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        for (ShadowedLight& light: lights) {
+            if (!light.visible || light.tileSize == 0) {
+                continue;
+            }
+            for (uint32_t face = 0; face < light.faceCount; face++) {
+                if (!light.dirty[face]) {
+                    continue;
+                }
+                renderTile(frame_info, light, face);
+                light.dirty[face] = false;
+                stats.renderedTiles++;
+            }
+        }
+
+        vkCmdEndRenderPass(frame_info.commandBuffer);
+    }
+
+    void XELocalShadowSystem::renderTile(FrameInfo &frame_info, const ShadowedLight &light, uint32_t face) {
+        VkCommandBuffer commandBuffer = frame_info.commandBuffer;
+        const XEShadowAtlas::Tile& tile = light.tiles[face];
+
+        VkViewport viewport = {};
+        viewport.x = static_cast<float>(tile.x);
+        viewport.y = static_cast<float>(tile.y);
+        viewport.width = static_cast<float>(tile.size);
+        viewport.height = static_cast<float>(tile.size);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D rect{{static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)}, {tile.size, tile.size}};
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &rect);
+        vkCmdSetDepthBias(commandBuffer, depthBiasConstant, 0.0f, depthBiasSlope);
+
+        VkClearAttachment clear = {};
+        clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clear.clearValue.depthStencil = {1.0f, 0};
+        VkClearRect clearRect = {};
+        clearRect.rect = rect;
+        clearRect.baseArrayLayer = 0;
+        clearRect.layerCount = 1;
+        vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &clearRect);
+
+        const XEFrustum& frustum = light.frustums[face];
+        visibleItems.clear();
+
+        if (frame_info.sceneBVH && !frame_info.sceneBVH->empty()) {
+            frame_info.sceneBVH->queryFrustum(frustum, visibleItems);
+
+            // The BVH holds every object, the caster map only the shadow casters
+            visibleItems.erase(std::remove_if(visibleItems.begin(), visibleItems.end(), [&](const BVHItem& item) {
+                return casters.find(item.objectId) == casters.end();
+            }), visibleItems.end());
+        } else {
+            for (const auto& [id, caster]: casters) {
+                if (!frustum.intersects(caster.bounds)) {
+                    continue;
+                }
+                const auto& meshes = caster.model->getMeshes();
+                for (uint32_t i = 0; i < meshes.size(); i++) {
+                    if (frustum.intersects(XEFrustum::transformAABB(meshes[i].bounds, caster.transform))) {
+                        visibleItems.push_back({id, i});
+                    }
+                }
+            }
+        }
+        std::sort(visibleItems.begin(), visibleItems.end(), [](const BVHItem& a, const BVHItem& b) {
+            return a.objectId != b.objectId ? a.objectId < b.objectId : a.meshIndex < b.meshIndex;
+        });
+
+        const glm::mat4& viewProjection = light.viewProjections[face];
+        XEPipeline* boundPipeline = nullptr;
+        XEGameObject* obj = nullptr;
+        XEGameObject::id_t currentId = ~0u;
+        glm::mat4 modelViewProjection{1.f};
+        bool packed = false;
+
+        for (const auto& item: visibleItems) {
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = frame_info.gameObjects.find(item.objectId);
+                obj = it != frame_info.gameObjects.end() ? &it->second : nullptr;
+                if (!obj) {
+                    continue;
+                }
+                modelViewProjection = viewProjection * obj->transform.mat4();
+
+                const XEModel::VertexFormat format = obj->model->getVertexFormat();
+                const bool positionOnly = obj->model->hasPositionStream();
+                packed = format == XEModel::VertexFormat::Packed;
+
+                XEPipeline& pipeline = pipelineFor(format, positionOnly);
+                if (&pipeline != boundPipeline) {
+                    pipeline.bind(commandBuffer);
+                    boundPipeline = &pipeline;
+                }
+
+                if (positionOnly) {
+                    obj->model->bindPositions(commandBuffer);
+                } else {
+                    obj->model->bind(commandBuffer);
+                }
+            }
+
+            if (!obj) {
+                continue;
+            }
+
+            const auto& mesh = obj->model->getMeshes()[item.meshIndex];
+
+            LocalShadowPushConstantData push = {};
+            push.modelViewProjection = packed ? modelViewProjection * mesh.dequantizeMatrix() : modelViewProjection;
+
+            vkCmdPushConstants(
+                commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                0,
+                sizeof(LocalShadowPushConstantData),
+                &push);
+
+            obj->model->drawMesh(commandBuffer, mesh);
+            stats.casterDraws++;
+        }
+    }
+
+    void XELocalShadowSystem::trackCasters(XEGameObject::Map &gameObjects) {
+        changedCasterBounds.clear();
+
+        for (auto& kv: gameObjects) {
+            auto& obj = kv.second;
+            if (!obj.canCastShadow || !obj.model) {
+                continue;
+            }
+
+            const glm::mat4 transform = obj.transform.mat4();
+            auto [it, inserted] = casters.try_emplace(kv.first);
+            CasterState& caster = it->second;
+            if (inserted || caster.model != obj.model.get() || caster.transform != transform) {
+                if (!inserted) {
+                    changedCasterBounds.push_back(caster.bounds);
+                }
+                caster.transform = transform;
+                caster.model = obj.model.get();
+                caster.bounds = XEFrustum::transformAABB(obj.model->getBounds(), transform);
+                changedCasterBounds.push_back(caster.bounds);
+            }
+            caster.seenFrame = frameCounter;
+        }
+
+        // Destroyed, or no longer casting
+        for (auto it = casters.begin(); it != casters.end();) {
+            if (it->second.seenFrame != frameCounter) {
+                changedCasterBounds.push_back(it->second.bounds);
+                it = casters.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool XELocalShadowSystem::shapeChanged(const ShadowedLight &light, const GPULight &gpuLight) const {
+        if (glm::vec3(light.shape.position) != glm::vec3(gpuLight.position) || light.shape.param.x != gpuLight.param.x) {
+            return true;
+        }
+        // Direction and cone only shape spot frusta
+        return light.type == 2 && (glm::vec3(light.shape.direction) != glm::vec3(gpuLight.direction) ||
+            light.shape.param.z != gpuLight.param.z);
+    }
+
+    void XELocalShadowSystem::updateProjections(ShadowedLight &light) {
+        const glm::vec3 position{light.shape.position};
+        const float range = light.shape.param.x;
+
+        if (light.type == 1) {
+            // +X, -X, +Y, -Y, +Z, -Z, the order simple_fragment.frag picks faces in from the major axis
+            static const std::array<glm::vec3, MAX_FACES> directions = {
+                glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+            static const std::array<glm::vec3, MAX_FACES> ups = {
+                glm::vec3(0, 1, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1),
+                glm::vec3(0, 0, -1), glm::vec3(0, 1, 0), glm::vec3(0, 1, 0)};
+
+            glm::mat4 projection = glm::perspectiveLH_ZO(glm::half_pi<float>(), 1.0f, nearClip, range);
+            projection[1][1] *= -1;
+            for (uint32_t face = 0; face < MAX_FACES; face++) {
+                light.viewProjections[face] = projection * glm::lookAtLH(position, position + directions[face], ups[face]);
+            }
+        } else {
+            glm::vec3 direction{light.shape.direction};
+            direction = glm::length(direction) > 1e-6f ? glm::normalize(direction) : glm::vec3(0, -1, 0);
+            const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+
+            glm::mat4 projection = glm::perspectiveLH_ZO(2.0f * spotHalfAngle(light.shape), 1.0f, nearClip, range);
+            projection[1][1] *= -1;
+            light.viewProjections[0] = projection * glm::lookAtLH(position, position + direction, up);
+        }
+
+        // Casters behind the near plane still land in the tile through depth clamp
+        for (uint32_t face = 0; face < light.faceCount; face++) {
+            light.frustums[face].update(light.viewProjections[face]);
+            light.frustums[face].disablePlane(XEFrustum::Near);
+        }
+        tileBufferDirty = true;
+    }
+
+    bool XELocalShadowSystem::allocateTiles(ShadowedLight &light, uint32_t tileSize) {
+        for (uint32_t face = 0; face < light.faceCount; face++) {
+            light.tiles[face] = atlas.allocate(tileSize);
+            if (!light.tiles[face].valid()) {
+                for (uint32_t allocated = 0; allocated < face; allocated++) {
+                    atlas.release(light.tiles[allocated]);
+                    light.tiles[allocated] = {};
+                }
+                return false;
+            }
+        }
+
+        light.tileSize = tileSize;
+        light.dirty.fill(true);
+        tileBufferDirty = true;
+        return true;
+    }
+
+    void XELocalShadowSystem::releaseTiles(ShadowedLight &light) {
+        if (light.tileSize == 0) {
+            return;
+        }
+        for (auto& tile: light.tiles) {
+            atlas.release(tile);
+            tile = {};
+        }
+        light.tileSize = 0;
+        tileBufferDirty = true;
+    }
+
+    void XELocalShadowSystem::releaseAll() {
+        for (ShadowedLight& light: lights) {
+            releaseTiles(light);
+            light.type = 0;
+            light.visible = false;
+        }
+        tileBufferDirty = true;
+    }
+
+    void XELocalShadowSystem::writeTileBuffer(uint32_t frameIndex) {
+        if (tileBufferDirty) {
+            std::fill(slotTiles.begin(), slotTiles.end(), 0u);
+            tileCount = 0;
+
+            const float atlasSize = static_cast<float>(atlas.getAtlasSize());
+            for (const ShadowedLight& light: lights) {
+                if (light.tileSize == 0 || light.slot >= MAX_LOCAL_SHADOW_SLOTS) {
+                    continue;
+                }
+
+                const float tanHalfFov = light.type == 1 ? 1.0f : std::tan(spotHalfAngle(light.shape));
+                const float tileSize = static_cast<float>(light.tileSize);
+
+                slotTiles[light.slot] = tileCount + 1;
+                for (uint32_t face = 0; face < light.faceCount; face++) {
+                    GPULocalShadowTile& gpuTile = gpuTiles[tileCount++];
+                    gpuTile.viewProjection = light.viewProjections[face];
+                    gpuTile.rect = glm::vec4(light.tiles[face].x, light.tiles[face].y, tileSize, tileSize) / atlasSize;
+                    gpuTile.params = glm::vec4(2.0f * tanHalfFov / tileSize, 0.5f / tileSize, 0.0f, 0.0f);
+                }
+            }
+
+            tileBufferDirty = false;
+            tileBufferVersion++;
+        }
+
+        // Each frame in flight has its own copy, written once per change
+        if (uploadedVersions[frameIndex] == tileBufferVersion) {
+            return;
+        }
+
+        XEBuffer& buffer = *tileBuffers[frameIndex];
+        glm::uvec4 header{tileCount, 0, 0, 0};
+        buffer.writeToBuffer(&header, sizeof(header), 0);
+        if (tileCount > 0) {
+            buffer.writeToBuffer(gpuTiles.data(), tileCount * sizeof(GPULocalShadowTile), TILE_BUFFER_TILES_OFFSET);
+        }
+        buffer.writeToBuffer(slotTiles.data(), slotTiles.size() * sizeof(uint32_t), TILE_BUFFER_SLOTS_OFFSET);
+        buffer.flush();
+        uploadedVersions[frameIndex] = tileBufferVersion;
+    }
+
+    void XELocalShadowSystem::createRenderPass() {
+        VkAttachmentDescription depth = {};
+
+        // Tiles that are not re-rendered keep their contents, so the atlas is loaded and stays shader readable
+        depth.format = VK_FORMAT_D32_SFLOAT;
+        depth.samples = VK_SAMPLE_COUNT_1_BIT;
+        depth.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depth.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depth.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkAttachmentReference depthRef = {};
+        depthRef.attachment = 0;
+        depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthRef;
+
+        std::array<VkSubpassDependency, 2> deps{};
+        // The previous frame's main pass samples the atlas before tiles are overwritten
+        deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        deps[0].dstSubpass = 0;
+        deps[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        deps[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        deps[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        deps[1].srcSubpass    = 0;
+        deps[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+        deps[1].srcStageMask  = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        deps[1].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depth;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(deps.size());
+        renderPassInfo.pDependencies = deps.data();
+
+        if (vkCreateRenderPass(xe_device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create local shadow render pass!");
+        }
+    }
+
+    void XELocalShadowSystem::createAtlas() {
+        const int size = static_cast<int>(atlas.getAtlasSize());
+        atlasImage = std::make_unique<XEImageVMA>(xe_device, size, size, 1,
+            VK_FORMAT_D32_SFLOAT,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = atlasImage->getImage();
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_D32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(xe_device.device(), &viewInfo, nullptr, &atlasView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create local shadow atlas image view!!");
+        }
+
+        // The render pass expects the shader read layout, tiles are cleared before their first use
+        VkCommandBuffer commandBuffer = xe_device.beginSingleTimeCommandsGraphics();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = atlasImage->getImage();
+        barrier.subresourceRange = viewInfo.subresourceRange;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        xe_device.endSingleTimeCommandsGraphics(commandBuffer);
+    }
+
+    void XELocalShadowSystem::createFramebuffer() {
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &atlasView;
+        framebufferInfo.width = atlas.getAtlasSize();
+        framebufferInfo.height = atlas.getAtlasSize();
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(xe_device.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create local shadow framebuffer!");
+        }
+    }
+
+    void XELocalShadowSystem::createSampler() {
+        VkSamplerCreateInfo samplerInfo{};
+
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_TRUE;
+        samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.mipLodBias = 0.0f;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(xe_device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create local shadow sampler!!");
+        }
+    }
+
+    void XELocalShadowSystem::createBuffers() {
+        tileBuffers.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
+        uploadedVersions.assign(XESwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+
+        for (auto& buffer: tileBuffers) {
+            buffer = std::make_unique<XEBuffer>(
+                xe_device,
+                TILE_BUFFER_SIZE,
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                xe_device.properties.limits.minStorageBufferOffsetAlignment);
+
+            buffer->map();
+        }
+    }
+
+    void XELocalShadowSystem::createDescriptors() {
+        descriptorPool = XEDescriptorPool::Builder(xe_device)
+        .setMaxSets(XESwapChain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, XESwapChain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, XESwapChain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+
+        descriptorSetLayout = XEDescriptorSetLayout::Builder(xe_device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build();
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = atlasView;
+        imageInfo.sampler = sampler;
+
+        descriptorSets.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (int i = 0; i < descriptorSets.size(); i++) {
+            auto bufferInfo = tileBuffers[i]->descriptorInfo();
+            XEDescriptorWriter(*descriptorSetLayout, *descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .writeImage(1, &imageInfo)
+            .build(descriptorSets[i]);
+        }
+    }
+
+    void XELocalShadowSystem::createPipelineLayout() {
+        VkPushConstantRange push_constant_range = {};
+        push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(LocalShadowPushConstantData);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 0;
+        pipelineLayoutInfo.pSetLayouts = nullptr;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
+
+        if (vkCreatePipelineLayout(xe_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create local shadow pipeline layout!");
+        }
+    }
+
+    std::unique_ptr<XEPipeline> XELocalShadowSystem::createPipeline(XEModel::VertexFormat vertexFormat,
+        bool positionOnly) {
+        assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+        PipelineConfigInfo pipelineConfig = {};
+        XEPipeline::defaultShadowPipelineConfigInfo(pipelineConfig);
+
+        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.pipelineLayout = pipelineLayout;
+        pipelineConfig.subpass = 0;
+
+        const bool packed = vertexFormat == XEModel::VertexFormat::Packed;
+        if (positionOnly) {
+            pipelineConfig.bindingDescriptions = XEModel::getPositionBindingDescriptions(vertexFormat);
+            pipelineConfig.attributeDescriptions = XEModel::getPositionAttributeDescriptions(vertexFormat);
+        } else if (packed) {
+            pipelineConfig.bindingDescriptions = XEModel::PackedVertex::getBindingDescriptions();
+            pipelineConfig.attributeDescriptions = XEModel::PackedVertex::getAttributeDescriptions();
+        } else {
+            pipelineConfig.bindingDescriptions = XEModel::Vertex::getBindingDescriptions();
+            pipelineConfig.attributeDescriptions = XEModel::Vertex::getAttributeDescriptions();
+        }
+
+        return std::make_unique<XEPipeline>(xe_device,
+            packed ? "assets\\shaders\\shadow_shader_packed_local.spv" : "assets\\shaders\\shadow_shader_local.spv",
+            pipelineConfig);
+    }
+
+    XEPipeline& XELocalShadowSystem::pipelineFor(XEModel::VertexFormat vertexFormat, bool positionOnly) {
+        auto& pipeline = pipelines[static_cast<uint32_t>(vertexFormat) * 2 + (positionOnly ? 1 : 0)];
+        if (!pipeline) {
+            pipeline = createPipeline(vertexFormat, positionOnly);
+        }
+        return *pipeline;
+    }
+}
@@ -0,0 +1,161 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "renderer/xe_pipeline.h"
+#include "renderer/xe_device.h"
+#include "renderer/xe_image_vma.h"
+#include "renderer/xe_descriptors.h"
+#include "renderer/xe_buffer.h"
+#include "renderer/lighting/xe_light_manager.h"
+#include "renderer/lighting/xe_lights.h"
+#include "renderer/lighting/xe_shadow_atlas.h"
+#include "scene/xe_game_object.h"
+#include "scene/xe_frustum.h"
+#include "scene/xe_scene_bvh.h"
+#include "systems/xe_frame_info.h"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace xe {
+
+    // Shadows of point and spot lights, rendered into one D32 atlas shared by every frame in flight.
+    // A shadowed light gets a square tile per cube face (point) or a single tile (spot), sized from its screen
+    // coverage times its importance. Tiles keep their contents until the light moves, the tile is resized or
+    // moved, or a caster inside the tile's frustum moves, appears or disappears, so static lights over static
+    // geometry are rendered once.
+    // Fragment side: set 5 of the main pass, binding 0 the tile buffer (header, tiles, light slot -> tile map),
+    // binding 1 the atlas with a compare sampler.
+    class XELocalShadowSystem {
+    public:
+        struct Stats {
+            uint32_t shadowedLights = 0;     // lights holding tiles
+            uint32_t tiles = 0;
+            uint32_t renderedTiles = 0;      // re-rendered in the last frame
+            uint32_t casterDraws = 0;        // mesh draws of the last frame
+            uint32_t unallocatedLights = 0;  // visible but did not fit in the atlas
+            float atlasUsage = 0.0f;         // allocated texels / atlas texels
+        };
+
+        XELocalShadowSystem(XEDevice& device, XELightManager& lightManager, uint32_t atlasSize = 4096);
+        ~XELocalShadowSystem();
+
+        XELocalShadowSystem(const XELocalShadowSystem &) = delete;
+        XELocalShadowSystem &operator=(const XELocalShadowSystem &) = delete;
+
+        // importance scales the tile size, 1 = what the coverage asks for. Unshadow a light before destroying it.
+        // false when MAX_SHADOWED_LOCAL_LIGHTS are already shadowed.
+        bool setShadowed(LightHandle handle, bool shadowed, float importance = 1.0f);
+        bool isShadowed(LightHandle handle) const;
+
+        // Disabling releases every tile
+        void setEnabled(bool enable);
+        bool isEnabled() const { return enabled; }
+        // Without caching every tile is re-rendered every frame
+        void setCaching(bool enable) { caching = enable; }
+        bool getCaching() const { return caching; }
+
+        // Sizes and places the tiles, finds the dirty ones and writes this frame's tile buffer.
+        // After the lights of the frame are final.
+        void update(FrameInfo& frame_info);
+        // Renders the dirty tiles, outside of any render pass and before the main pass samples the atlas
+        void render(FrameInfo& frame_info);
+
+        const Stats& getStats() const { return stats; }
+        VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout->getDescriptorSetLayout(); }
+        VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+
+    private:
+        static constexpr uint32_t MAX_FACES = 6;
+
+        struct ShadowedLight {
+            LightHandle handle = INVALID_LIGHT_HANDLE;
+            float importance = 1.0f;
+            GPULight shape{};           // the light as its tiles were last rendered
+            uint32_t type = 0;          // 1 point, 2 spot, 0 none
+            uint32_t faceCount = 0;
+            uint32_t slot = ~0u;        // light slot of the last tile buffer write
+            uint32_t tileSize = 0;      // of every face, 0 without tiles
+            float requestedTexels = 0.0f;
+            bool visible = false;
+            std::array<XEShadowAtlas::Tile, MAX_FACES> tiles{};
+            std::array<glm::mat4, MAX_FACES> viewProjections{};
+            std::array<XEFrustum, MAX_FACES> frustums{};
+            std::array<bool, MAX_FACES> dirty{};
+        };
+
+        // World state of a shadow caster as of the last update
+        struct CasterState {
+            glm::mat4 transform{1.f};
+            XEModel* model = nullptr;
+            AABB3 bounds{};
+            uint64_t seenFrame = 0;
+        };
+
+        void createRenderPass();
+        void createAtlas();
+        void createFramebuffer();
+        void createSampler();
+        void createBuffers();
+        void createDescriptors();
+        void createPipelineLayout();
+        std::unique_ptr<XEPipeline> createPipeline(XEModel::VertexFormat vertexFormat, bool positionOnly);
+        XEPipeline& pipelineFor(XEModel::VertexFormat vertexFormat, bool positionOnly);
+
+        void trackCasters(XEGameObject::Map& gameObjects);
+        bool shapeChanged(const ShadowedLight& light, const GPULight& gpuLight) const;
+        void updateProjections(ShadowedLight& light);
+        bool allocateTiles(ShadowedLight& light, uint32_t tileSize);
+        void releaseTiles(ShadowedLight& light);
+        void releaseAll();
+        void writeTileBuffer(uint32_t frameIndex);
+        void renderTile(FrameInfo& frame_info, const ShadowedLight& light, uint32_t face);
+
+        XEDevice& xe_device;
+        XELightManager& lightManager;
+
+        XEShadowAtlas atlas;
+        uint32_t maxTileSize;
+        std::unique_ptr<XEImageVMA> atlasImage;
+        VkImageView atlasView{VK_NULL_HANDLE};  // 2D, for the framebuffer and the sampler
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        VkFramebuffer framebuffer{VK_NULL_HANDLE};
+        VkSampler sampler{VK_NULL_HANDLE};
+        VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+        // [vertexFormat * 2 + positionOnly], created on first use
+        std::array<std::unique_ptr<XEPipeline>, 4> pipelines;
+
+        std::unique_ptr<XEDescriptorPool> descriptorPool;
+        std::unique_ptr<XEDescriptorSetLayout> descriptorSetLayout;
+        std::vector<VkDescriptorSet> descriptorSets;
+        std::vector<std::unique_ptr<XEBuffer>> tileBuffers;
+        std::vector<uint64_t> uploadedVersions;  // per frame in flight, tileBufferVersion of the last write
+
+        std::vector<ShadowedLight> lights;
+        std::unordered_map<XEGameObject::id_t, CasterState> casters;
+        std::vector<AABB3> changedCasterBounds;  // old and new bounds of every caster that changed
+        std::vector<BVHItem> visibleItems;
+
+        // CPU copy of the tile buffer, rebuilt when a tile, matrix or light slot changes
+        std::vector<GPULocalShadowTile> gpuTiles;
+        std::vector<uint32_t> slotTiles;  // first tile + 1 per light slot, 0 = no shadow
+        uint32_t tileCount = 0;
+        uint64_t tileBufferVersion = 1;
+        bool tileBufferDirty = false;
+
+        bool enabled = true;
+        bool caching = true;
+        uint64_t frameCounter = 0;
+        Stats stats{};
+
+        float depthBiasConstant = 1.25f;
+        float depthBiasSlope = 1.75f;
+        float nearClip = 0.05f;
+    };
+}
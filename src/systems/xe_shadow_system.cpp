@@ -7,21 +7,62 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm/glm.hpp"
 
 #include "renderer/xe_swap_chain.h"
+#include "systems/xe_gpu_culling_system.h"
 
 namespace xe {
 
     struct SimplePushConstantData {
         glm::mat4 modelMatrix{1.f};
-        alignas(16) int32_t cascadeIndex{0};
+        alignas(16) int32_t cascadeIndex{0};  // the cascade mask in the single pass
     };
 
-    XEShadowSystem::XEShadowSystem(XEDevice &device, XELightManager &lightManager):
-      xe_device(device), lightManager(lightManager){
+    // 2D view of a cascade atlas, for the framebuffer and the sampler
+    static VkImageView createAtlasView(XEDevice& device, VkImage image) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_D32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VkImageView view{VK_NULL_HANDLE};
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create shadow image view!!");
+        }
+        return view;
+    }
+
+    static VkFramebuffer createAtlasFramebuffer(XEDevice& device, VkRenderPass renderPass, VkImageView view,
+        int width, int height) {
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &view;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+
+        VkFramebuffer framebuffer{VK_NULL_HANDLE};
+        if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            std::cerr << "failed to create shadow pass framebuffer" << std::endl;
+            throw std::runtime_error("failed to create shadow pass framebuffer!");
+        }
+        return framebuffer;
+    }
+
+    XEShadowSystem::XEShadowSystem(XEDevice &device, XELightManager &lightManager, XEDrawManager &drawManager):
+      xe_device(device), lightManager(lightManager), drawManager(drawManager){
 
         shadowUboBuffers.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
 
@@ -40,7 +81,14 @@ namespace xe {
         // cascade info per frame
         cascadeInfos.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
 
-        createShadowRenderPass();
+        uploadedUboVersions.assign(XESwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+        slotFitVersions.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
+        slotRenderedFrames.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
+        slotHadDynamic.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
+        invalidateStaticCache();
+
+        createRenderPasses();
+        layoutAtlas();
         createDepthImagesAndViews();
         createSamplers();
         createFramebuffers();
@@ -50,37 +98,110 @@ namespace xe {
         initializeDescriptorSet();
 
         createPipelineLayout();
-        createPipeline();
+        pipelineFor(XEModel::VertexFormat::Full, true, DrawMode::Direct);
+
+        singlePassSupported = xe_device.enabledFeatures.multiViewport &&
+            xe_device.enabledFeatures12.shaderOutputViewportIndex &&
+            xe_device.properties.limits.maxViewports >= SHADOW_MAP_CASCADE_COUNT;
+        singlePass = singlePassSupported;
+        if (!singlePassSupported) {
+            std::cout << "[Shadow] multiViewport or shaderOutputViewportIndex not supported, one pass per cascade"
+                << std::endl;
+        }
+
+        createTimestampQueries();
     }
 
     XEShadowSystem::~XEShadowSystem() {
         vkDestroyPipelineLayout(xe_device.device(), xe_pipeline_layout, nullptr);
 
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(xe_device.device(), timestampQueryPool, nullptr);
+        }
+
 
         vkDestroySampler(xe_device.device(), shadowDepthSampler, nullptr);
 
-        for (CascadeInfo& cascadeInfo : cascadeInfos) {
-            for (VkFramebuffer& frameBuffer: cascadeInfo.frameBuffers) {
-                vkDestroyFramebuffer(xe_device.device(), frameBuffer, nullptr);
-            }
-            for (VkImageView& imageView: cascadeInfo.shadowLayerImageViews) {
-                vkDestroyImageView(xe_device.device(), imageView, nullptr);
+        destroyAtlases();
+        vkDestroyRenderPass(xe_device.device(), shadowRenderPass, nullptr);
+        vkDestroyRenderPass(xe_device.device(), staticRenderPass, nullptr);
+        vkDestroyRenderPass(xe_device.device(), compositeRenderPass, nullptr);
+
+    }
+
+    void XEShadowSystem::setCascadeResolutions(const std::array<int, SHADOW_MAP_CASCADE_COUNT>& resolutions) {
+        if (resolutions == shadowMapDimensions) {
+            return;
+        }
+        for (int resolution: resolutions) {
+            if (resolution <= 0) {
+                throw std::runtime_error("shadow cascade resolutions must be positive!");
             }
         }
-        vkDestroyRenderPass(xe_device.device(), shadowRenderPass, nullptr);
 
+        // The atlases may still be in use by frames in flight
+        vkDeviceWaitIdle(xe_device.device());
+
+        const std::array<int, SHADOW_MAP_CASCADE_COUNT> previous = shadowMapDimensions;
+        shadowMapDimensions = resolutions;
+        try {
+            layoutAtlas();
+        } catch (const std::runtime_error&) {
+            shadowMapDimensions = previous;
+            layoutAtlas();
+            throw;
+        }
+
+        destroyAtlases();
+        createDepthImagesAndViews();
+        createFramebuffers();
+        for (int i = 0; i < shadowPassDescriptorSets.size(); i++) {
+            shadowDescriptorImageInfo[i].imageView = cascadeInfos[i].atlasView;
+            auto bufferInfo = shadowUboBuffers[i]->descriptorInfo();
+            XEDescriptorWriter(*shadowPassDescriptorSetLayout, *shadowPassDescriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .writeImage(1, &shadowDescriptorImageInfo[i])
+            .overwrite(shadowPassDescriptorSets[i]);
+        }
+
+        // Texel snapping depends on the resolution, and every cached cascade is gone
+        for (CascadeFit& fit: cascadeFits) {
+            fit.version = 0;
+        }
+        invalidateStaticCache();
     }
 
-    void XEShadowSystem::renderGameObjects(FrameInfo &frame_info, GPULight sunLight) {
-        calculateSplitDepths(frame_info.camera.getNearClip(), frame_info.camera.getFarClip());
+    ShadowMemoryFootprint XEShadowSystem::getMemoryFootprint() const {
+        // D32, one atlas per frame in flight and one for the static casters
+        const uint64_t atlasBytes = uint64_t(atlasExtent.width) * atlasExtent.height * sizeof(float);
 
-        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
-            beginShadowRenderPass(frame_info.commandBuffer, frame_info.frameIndex, cascade);
+        ShadowMemoryFootprint footprint{};
+        footprint.frameAtlasBytes = atlasBytes * shadowXEImages.size();
+        footprint.staticAtlasBytes = staticImage ? atlasBytes : 0;
+        return footprint;
+    }
 
-            xe_pipeline->bind(frame_info.commandBuffer);
+    void XEShadowSystem::invalidateStaticCache() {
+        staticFitVersions.fill(0);
+        // The frame atlases hold copies of the old static cascades
+        for (auto& versions: slotFitVersions) {
+            versions.fill(0);
+        }
+    }
 
-            glm::vec3 sunLightDirToOrigin = -glm::normalize(glm::vec3(sunLight.direction));
+    void XEShadowSystem::updateCascades(FrameInfo &frame_info, GPULight sunLight) {
+        frameCounter++;
 
+        const auto previousSplits = shadowUbo.splitDepths;
+        calculateSplitDepths(frame_info.camera.getNearClip(), frame_info.camera.getFarClip());
+        if (shadowUbo.splitDepths != previousSplits) {
+            uboVersion++;
+        }
+
+        glm::vec3 sunLightDirToOrigin = -glm::normalize(glm::vec3(sunLight.direction));
+        const glm::mat4& invView = frame_info.camera.getInverseView();
+
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
             float zNear = (cascade == 0) ? frame_info.camera.getNearClip() : shadowUbo.splitDepths[cascade - 1];
             float zFar = shadowUbo.splitDepths[cascade];
 
@@ -89,46 +210,738 @@ namespace xe {
             std::array<glm::vec3, 4> farPlane = getFarPlane(frame_info.camera.getFOV(), frame_info.camera.getAspect(),
                 zFar);
 
-            LightBBResult result = createViewVolumeAndCalcLightPos(nearPlane, farPlane, frame_info.camera.getInverseView(), sunLightDirToOrigin);
+            // Frustum slice corners in world space
+            std::array<glm::vec3, 8> frustumWS{};
+            for (int i = 0; i < 4; i++) {
+                frustumWS[i] = glm::vec3(invView * glm::vec4(nearPlane[i], 1.0f));
+                frustumWS[4 + i] = glm::vec3(invView * glm::vec4(farPlane[i], 1.0f));
+            }
+
+            cascadeCacheStats[cascade] = {};
+            if (!fitCascade(cascade, frustumWS, sunLightDirToOrigin)) {
+                continue;
+            }
+            cascadeCacheStats[cascade].refit = true;
+            uboVersion++;
+
+            const CascadeFit& fit = cascadeFits[cascade];
+            shadowUbo.cascadeLightProjections[cascade] = fit.lightProjection;
+            shadowUbo.cascadeLightViews[cascade] = fit.lightView;
 
-            shadowUbo.cascadeLightProjections[cascade] = result.lightProjection;
-            shadowUbo.cascadeLightViews[cascade] = result.lightView;
+            // Casters between the light and the near plane still land in the map through depth clamp,
+            // so only the side and far planes of the cascade volume reject anything
+            cascadeFrustums[cascade].update(fit.lightProjection * fit.lightView);
+            cascadeFrustums[cascade].disablePlane(XEFrustum::Near);
+        }
+
+        // Each frame in flight has its own UBO, written when the matrices or splits differ from its last write
+        if (uploadedUboVersions[frame_info.frameIndex] != uboVersion) {
             shadowUboBuffers[frame_info.frameIndex]->writeToBuffer(&shadowUbo);
             shadowUboBuffers[frame_info.frameIndex]->flush();
+            uploadedUboVersions[frame_info.frameIndex] = uboVersion;
+        }
+    }
 
+    bool XEShadowSystem::fitCascade(int cascade, const std::array<glm::vec3, 8>& frustumWS, const glm::vec3& lightDir) {
+        // Frustum center in world
+        glm::vec3 centerWorldSpace = glm::vec3(0.0f, 0.0f, 0.0f);
+        for (const auto& p: frustumWS) {
+            centerWorldSpace += p;
+        }
+        centerWorldSpace /=  8.0f;
+
+        // Radius - max distance from center, only depends on the projection so the box size does not shimmer
+        float radius = 0.0f;
+        for (const auto& p: frustumWS) {
+            radius = std::max(radius, glm::length(p - centerWorldSpace));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // The padding lets the slice move inside a cached box before it has to be refitted
+        const float padding = caching ? cascadePadding : 0.0f;
+        const float extent = std::ceil(radius * (1.0f + padding) * 16.0f) / 16.0f;
+
+        // Light rotation (Left handed), the box is placed in this frame
+        const glm::vec3 worldUp(0,1,0);
+        glm::vec3 up = (std::abs(glm::dot(lightDir, worldUp)) > 0.99f) ? glm::vec3(0,0,1) : worldUp;
+        const glm::mat4 lightRotation = glm::lookAtLH(glm::vec3(0.0f), lightDir, up);
+        const glm::vec3 centerLightSpace = glm::vec3(lightRotation * glm::vec4(centerWorldSpace, 1.0f));
+
+        CascadeFit& fit = cascadeFits[cascade];
+        const bool sameVolume = fit.version != 0 && fit.lightDir == lightDir;
+        if (sameVolume && caching && extent <= fit.extent && extent > fit.extent * 0.75f) {
+            // Keep the box while the slice's sphere is still inside it
+            const glm::vec3 offset = glm::abs(centerLightSpace - fit.centerLightSpace);
+            if (std::max(offset.x, std::max(offset.y, offset.z)) + radius <= fit.extent) {
+                return false;
+            }
+        }
+
+        // Whole texel steps, so moving the box does not make the shadow edges crawl
+        const float texelSize = 2.0f * extent / static_cast<float>(shadowMapDimensions[cascade]);
+        const glm::vec3 snappedCenter = glm::floor(centerLightSpace / texelSize + 0.5f) * texelSize;
+        if (sameVolume && fit.extent == extent && fit.centerLightSpace == snappedCenter) {
+            return false;
+        }
+
+        fit.lightDir = lightDir;
+        fit.extent = extent;
+        fit.centerLightSpace = snappedCenter;
+        // Eye on the light side of the box, looking through it
+        fit.lightView = glm::translate(glm::mat4(1.0f),
+            -glm::vec3(snappedCenter.x, snappedCenter.y, snappedCenter.z - extent)) * lightRotation;
+        fit.lightProjection = glm::orthoLH_ZO(-extent, extent, -extent, extent, 0.0f, 2.0f * extent);
+        fit.lightProjection[1][1] *= -1;
+        fit.version = ++fitCounter;
+        return true;
+    }
+
+    void XEShadowSystem::renderGameObjects(FrameInfo &frame_info) {
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        const XEGPUCullingSystem* gpuCulling = frame_info.gpuCulling;
+        const bool indirect = indirectDraws || gpuCulling;
+        // The compute culled draws cover every caster of a view, so they cannot be split into static and dynamic
+        const bool cached = caching && !gpuCulling;
+        const int frameIndex = frame_info.frameIndex;
+
+        if (cached && !staticImage) {
+            createStaticAtlas();
+        }
+
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            readTimestamps(frameIndex);
+            vkCmdResetQueryPool(frame_info.commandBuffer, timestampQueryPool, frameIndex * 2, 2);
+            vkCmdWriteTimestamp(frame_info.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool,
+                frameIndex * 2);
+        }
+
+        passStats = {};
+        cascadeCullingStats.fill({});
+        // The instanced draws need the per mesh path, the indirect ones keep a pass per cascade
+        passStats.singlePass = singlePass && !indirect;
+
+        if (passStats.singlePass) {
+            renderCascadesSinglePass(frame_info, cached);
+        } else {
+            renderCascadesSeparately(frame_info, cached, indirect);
+        }
+
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(frame_info.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool,
+                frameIndex * 2 + 1);
+            timestampsWritten[frameIndex] = true;
+        }
+
+        lastRecordTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - recordStart).count();
+    }
+
+    void XEShadowSystem::renderCascadesSeparately(FrameInfo& frame_info, bool cached, bool indirect) {
+        const XEGPUCullingSystem* gpuCulling = frame_info.gpuCulling;
+        const int frameIndex = frame_info.frameIndex;
+
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+            const CascadeFit& fit = cascadeFits[cascade];
+            VkFramebuffer framebuffer = cascadeInfos[frameIndex].frameBuffer;
+            CullingStats& stats = cascadeCullingStats[cascade];
+            CascadeCacheStats& cacheStats = cascadeCacheStats[cascade];
+
+            if (!cached) {
+                beginShadowRenderPass(frame_info.commandBuffer, shadowRenderPass, framebuffer, cascade);
+                bindCascadeState(frame_info, cascade, indirect);
+                if (gpuCulling) {
+                    drawGPUCulledCasters(frame_info, cascade, stats);
+                } else {
+                    gatherCasters(frame_info, cascade, CasterFilter::All, visibleItems, stats);
+                    stats.visibleMeshes += drawCasters(frame_info, cascade, visibleItems, indirect);
+                }
+                endShadowRenderPass(frame_info.commandBuffer);
+
+                slotFitVersions[frameIndex][cascade] = fit.version;
+                slotRenderedFrames[frameIndex][cascade] = frameCounter;
+                slotHadDynamic[frameIndex][cascade] = true;
+                cacheStats.rendered = true;
+                continue;
+            }
+
+            renderStaticCascade(frame_info, cascade);
+
+            // This frame's layer is kept while it holds the current volume and its dynamic casters are not due
+            const bool stale = slotFitVersions[frameIndex][cascade] != fit.version;
+            const bool due = frameCounter - slotRenderedFrames[frameIndex][cascade] >= cascadeUpdateIntervals[cascade];
+            if (!stale && !due) {
+                continue;
+            }
+
+            gatherCasters(frame_info, cascade, CasterFilter::Dynamic, visibleItems, stats);
+            if (!stale && visibleItems.empty() && !slotHadDynamic[frameIndex][cascade]) {
+                // Still the plain static layer
+                slotRenderedFrames[frameIndex][cascade] = frameCounter;
+                continue;
+            }
+
+            copyStaticCascades(frame_info.commandBuffer, frameIndex, 1u << cascade);
+            beginShadowRenderPass(frame_info.commandBuffer, compositeRenderPass, framebuffer, cascade);
+            bindCascadeState(frame_info, cascade, indirect);
+            cacheStats.dynamicCasters = drawCasters(frame_info, cascade, visibleItems, indirect);
+            stats.visibleMeshes += cacheStats.dynamicCasters;
+            endShadowRenderPass(frame_info.commandBuffer);
+
+            slotFitVersions[frameIndex][cascade] = fit.version;
+            slotRenderedFrames[frameIndex][cascade] = frameCounter;
+            slotHadDynamic[frameIndex][cascade] = !visibleItems.empty();
+            cacheStats.rendered = true;
+        }
+    }
+
+    void XEShadowSystem::renderStaticCascade(FrameInfo& frame_info, int cascade) {
+        // Static casters, once per light volume
+        const CascadeFit& fit = cascadeFits[cascade];
+        if (staticFitVersions[cascade] == fit.version) {
+            return;
+        }
+
+        CullingStats& stats = cascadeCullingStats[cascade];
+        gatherCasters(frame_info, cascade, CasterFilter::Static, staticItems, stats);
+        beginShadowRenderPass(frame_info.commandBuffer, staticRenderPass, staticFramebuffer, cascade);
+        bindCascadeState(frame_info, cascade, false);
+        stats.visibleMeshes += drawCasters(frame_info, cascade, staticItems, false);
+        endShadowRenderPass(frame_info.commandBuffer);
+
+        staticFitVersions[cascade] = fit.version;
+        cascadeCacheStats[cascade].staticRendered = true;
+    }
+
+    void XEShadowSystem::renderCascadesSinglePass(FrameInfo& frame_info, bool cached) {
+        const int frameIndex = frame_info.frameIndex;
+        VkFramebuffer framebuffer = cascadeInfos[frameIndex].frameBuffer;
+        std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT> cascadeMeshes{};
+
+        uint32_t renderMask = 0;
+        if (!cached) {
+            renderMask = (1u << SHADOW_MAP_CASCADE_COUNT) - 1;
+            gatherCasterMasks(frame_info, renderMask, CasterFilter::All, maskedItems);
+
+            // Every cascade is redrawn, so the clear may cover the whole atlas
+            beginSinglePass(frame_info.commandBuffer, shadowRenderPass, framebuffer);
+        } else {
+            // The static casters stay one pass per cascade, they are only redrawn after a refit
+            uint32_t candidateMask = 0;
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                renderStaticCascade(frame_info, cascade);
+
+                const bool stale = slotFitVersions[frameIndex][cascade] != cascadeFits[cascade].version;
+                const bool due = frameCounter - slotRenderedFrames[frameIndex][cascade] >= cascadeUpdateIntervals[cascade];
+                if (stale || due) {
+                    candidateMask |= 1u << cascade;
+                }
+            }
+            if (candidateMask == 0) {
+                return;
+            }
+
+            gatherCasterMasks(frame_info, candidateMask, CasterFilter::Dynamic, maskedItems);
+            std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT> dynamicCounts{};
+            for (const MaskedItem& masked: maskedItems) {
+                for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                    dynamicCounts[cascade] += (masked.cascadeMask >> cascade) & 1u;
+                }
+            }
+
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                if (!(candidateMask & (1u << cascade))) {
+                    continue;
+                }
+                const bool stale = slotFitVersions[frameIndex][cascade] != cascadeFits[cascade].version;
+                if (!stale && dynamicCounts[cascade] == 0 && !slotHadDynamic[frameIndex][cascade]) {
+                    // Still the plain static cascade
+                    slotRenderedFrames[frameIndex][cascade] = frameCounter;
+                    continue;
+                }
+                renderMask |= 1u << cascade;
+            }
+            if (renderMask == 0) {
+                return;
+            }
+
+            // Kept cascades are neither copied nor drawn
+            for (MaskedItem& masked: maskedItems) {
+                masked.cascadeMask &= renderMask;
+            }
+            maskedItems.erase(std::remove_if(maskedItems.begin(), maskedItems.end(), [](const MaskedItem& masked) {
+                return masked.cascadeMask == 0;
+            }), maskedItems.end());
+
+            copyStaticCascades(frame_info.commandBuffer, frameIndex, renderMask);
+            // Loads the whole atlas, the cascades outside renderMask get no draws
+            beginSinglePass(frame_info.commandBuffer, compositeRenderPass, framebuffer);
+        }
+
+        bindCascadeState(frame_info, 0, false);
+        drawMaskedCasters(frame_info, maskedItems, cascadeMeshes);
+        endShadowRenderPass(frame_info.commandBuffer);
+
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+            if (!(renderMask & (1u << cascade))) {
+                continue;
+            }
+            cascadeCullingStats[cascade].visibleMeshes += cascadeMeshes[cascade];
+            if (cached) {
+                cascadeCacheStats[cascade].dynamicCasters = cascadeMeshes[cascade];
+            }
+            slotFitVersions[frameIndex][cascade] = cascadeFits[cascade].version;
+            slotRenderedFrames[frameIndex][cascade] = frameCounter;
+            slotHadDynamic[frameIndex][cascade] = !cached || cascadeMeshes[cascade] > 0;
+            cascadeCacheStats[cascade].rendered = true;
+        }
+    }
+
+    void XEShadowSystem::beginSinglePass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,
+        VkFramebuffer framebuffer) {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = atlasExtent;
+
+        VkClearValue clearDepthValues = {};
+        clearDepthValues.depthStencil = {1.0f, 0};
+
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearDepthValues;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        passStats.renderPasses++;
+
+        // Viewport i is cascade i's rect, the scissors keep the guard band out of the neighbours
+        std::array<VkViewport, SHADOW_MAP_CASCADE_COUNT> viewports{};
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+            const VkRect2D& rect = cascadeRects[cascade];
+            viewports[cascade] = {static_cast<float>(rect.offset.x), static_cast<float>(rect.offset.y),
+                static_cast<float>(rect.extent.width), static_cast<float>(rect.extent.height), 0.0f, 1.0f};
+        }
+        vkCmdSetViewport(commandBuffer, 0, SHADOW_MAP_CASCADE_COUNT, viewports.data());
+        vkCmdSetScissor(commandBuffer, 0, SHADOW_MAP_CASCADE_COUNT, cascadeRects.data());
+
+        // Depth bias is not per viewport, the largest cascade values keep every cascade free of acne
+        vkCmdSetDepthBias(commandBuffer, *std::max_element(std::begin(constB), std::end(constB)), 0.0f,
+            *std::max_element(std::begin(slope), std::end(slope)));
+    }
+
+    void XEShadowSystem::gatherCasterMasks(FrameInfo& frame_info, uint32_t cascadeMask, CasterFilter filter,
+        std::vector<MaskedItem>& items) {
+        items.clear();
+
+        if (casterCulling && frame_info.sceneBVH && !frame_info.sceneBVH->empty()) {
+            // One query per cascade, merged per mesh
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                if (cascadeMask & (1u << cascade)) {
+                    gatherCasters(frame_info, cascade, filter, cascadeItems, cascadeCullingStats[cascade]);
+                    for (const BVHItem& item: cascadeItems) {
+                        items.push_back({item, 1u << cascade});
+                    }
+                }
+            }
+            std::sort(items.begin(), items.end(), [](const MaskedItem& a, const MaskedItem& b) {
+                return a.item.objectId != b.item.objectId ? a.item.objectId < b.item.objectId :
+                    a.item.meshIndex < b.item.meshIndex;
+            });
+
+            size_t merged = 0;
+            for (size_t i = 0; i < items.size(); i++) {
+                if (merged > 0 && items[merged - 1].item.objectId == items[i].item.objectId &&
+                    items[merged - 1].item.meshIndex == items[i].item.meshIndex) {
+                    items[merged - 1].cascadeMask |= items[i].cascadeMask;
+                } else {
+                    items[merged++] = items[i];
+                }
+            }
+            items.resize(merged);
+            return;
+        }
+
+        // One walk over the objects, each bound is transformed once and tested against every cascade
+        for (auto& kv: frame_info.gameObjects) {
+            auto& obj = kv.second;
+
+            if (!acceptsCaster(obj, filter)) { continue; }
+            const glm::mat4 modelMatrix = obj.transform.mat4();
+            const auto& meshes = obj.model->getMeshes();
+
+            uint32_t objectMask = cascadeMask;
+            if (casterCulling) {
+                const AABB3 objectBounds = XEFrustum::transformAABB(obj.model->getBounds(), modelMatrix);
+                for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                    if ((objectMask & (1u << cascade)) && !cascadeFrustums[cascade].intersects(objectBounds)) {
+                        objectMask &= ~(1u << cascade);
+                        cascadeCullingStats[cascade].testedMeshes += static_cast<uint32_t>(meshes.size());
+                        cascadeCullingStats[cascade].culledObjects++;
+                    }
+                }
+            }
+            if (objectMask == 0) {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < meshes.size(); i++) {
+                const AABB3 meshBounds = casterCulling ? XEFrustum::transformAABB(meshes[i].bounds, modelMatrix) : AABB3{};
+                uint32_t meshMask = objectMask;
+                for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                    if (!(objectMask & (1u << cascade))) {
+                        continue;
+                    }
+                    cascadeCullingStats[cascade].testedMeshes++;
+                    if (casterCulling && !cascadeFrustums[cascade].intersects(meshBounds)) {
+                        meshMask &= ~(1u << cascade);
+                    }
+                }
+                if (meshMask != 0) {
+                    items.push_back({{obj.getId(), i}, meshMask});
+                }
+            }
+        }
+    }
+
+    void XEShadowSystem::drawMaskedCasters(FrameInfo& frame_info, const std::vector<MaskedItem>& items,
+        std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT>& cascadeMeshes) {
+        XEPipeline* boundPipeline = nullptr;
+        XEGameObject* obj = nullptr;
+        XEGameObject::id_t currentId = ~0u;
+        glm::mat4 modelMatrix{1.f};
+        bool packed = false;
+
+        for (const auto& masked: items) {
+            const BVHItem& item = masked.item;
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = frame_info.gameObjects.find(item.objectId);
+                obj = it != frame_info.gameObjects.end() ? &it->second : nullptr;
+                if (!obj) {
+                    continue;
+                }
+                modelMatrix = obj->transform.mat4();
+
+                const XEModel::VertexFormat format = obj->model->getVertexFormat();
+                const bool positionOnly = usePositionStreams && obj->model->hasPositionStream();
+                packed = format == XEModel::VertexFormat::Packed;
+
+                XEPipeline& pipeline = pipelineFor(format, positionOnly, DrawMode::SinglePass);
+                if (&pipeline != boundPipeline) {
+                    pipeline.bind(frame_info.commandBuffer);
+                    boundPipeline = &pipeline;
+                }
+
+                if (positionOnly) {
+                    obj->model->bindPositions(frame_info.commandBuffer);
+                } else {
+                    obj->model->bind(frame_info.commandBuffer);
+                }
+            }
+
+            if (!obj) {
+                continue;
+            }
+
+            const auto& mesh = obj->model->getMeshes()[item.meshIndex];
+            uint32_t instanceCount = 0;
+            for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+                const uint32_t bit = (masked.cascadeMask >> cascade) & 1u;
+                cascadeMeshes[cascade] += bit;
+                instanceCount += bit;
+            }
+
+            SimplePushConstantData push = {};
+            push.modelMatrix = packed ? modelMatrix * mesh.dequantizeMatrix() : modelMatrix;
+            push.cascadeIndex = static_cast<int32_t>(masked.cascadeMask);
+
+            vkCmdPushConstants(
+                frame_info.commandBuffer,
+                xe_pipeline_layout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                0,
+                sizeof(SimplePushConstantData),
+                &push);
+
+            // One instance per cascade in the mask
+            obj->model->drawMesh(frame_info.commandBuffer, mesh, instanceCount);
+            passStats.drawCalls++;
+            passStats.instances += instanceCount;
+        }
+    }
+
+    void XEShadowSystem::bindCascadeState(FrameInfo& frame_info, int cascade, bool indirect) {
+        vkCmdBindDescriptorSets(
+            frame_info.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            xe_pipeline_layout,
+            0, 1,
+            &shadowPassDescriptorSets[frame_info.frameIndex],
+            0,
+            nullptr);
+
+        if (indirect) {
+            VkDescriptorSet drawDataSet = drawManager.descriptorSet(frame_info.frameIndex);
             vkCmdBindDescriptorSets(
                 frame_info.commandBuffer,
                 VK_PIPELINE_BIND_POINT_GRAPHICS,
                 xe_pipeline_layout,
-                0, 1,
-                &shadowPassDescriptorSets[frame_info.frameIndex],
+                1, 1,
+                &drawDataSet,
                 0,
                 nullptr);
 
-            for (auto& kv: frame_info.gameObjects) {
-                auto& obj = kv.second;
+            // Only the cascade index is pushed, the model matrices come from the draw data
+            SimplePushConstantData push = {};
+            push.cascadeIndex = cascade;
+            vkCmdPushConstants(
+                frame_info.commandBuffer,
+                xe_pipeline_layout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                0,
+                sizeof(SimplePushConstantData),
+                &push);
+        }
+    }
+
+    bool XEShadowSystem::acceptsCaster(const XEGameObject& obj, CasterFilter filter) {
+        return obj.canCastShadow && (filter == CasterFilter::All || obj.isStatic == (filter == CasterFilter::Static));
+    }
+
+    void XEShadowSystem::gatherCasters(FrameInfo& frame_info, int cascade, CasterFilter filter,
+        std::vector<BVHItem>& items, CullingStats& stats) {
+        const XEFrustum& cascadeFrustum = cascadeFrustums[cascade];
+
+        items.clear();
+
+        if (casterCulling && frame_info.sceneBVH && !frame_info.sceneBVH->empty()) {
+            BVHQueryStats queryStats{};
+            frame_info.sceneBVH->queryFrustum(cascadeFrustum, items, &queryStats);
+            stats.testedMeshes += queryStats.primitivesTested;
+            stats.nodesVisited += queryStats.nodesVisited;
+
+            // The BVH holds every object, drop the non-casters
+            items.erase(std::remove_if(items.begin(), items.end(), [&](const BVHItem& item) {
+                auto it = frame_info.gameObjects.find(item.objectId);
+                return it == frame_info.gameObjects.end() || !acceptsCaster(it->second, filter);
+            }), items.end());
+            std::sort(items.begin(), items.end(), [](const BVHItem& a, const BVHItem& b) {
+                return a.objectId != b.objectId ? a.objectId < b.objectId : a.meshIndex < b.meshIndex;
+            });
+            return;
+        }
+
+        for (auto& kv: frame_info.gameObjects) {
+            auto& obj = kv.second;
+
+            if (!acceptsCaster(obj, filter)) { continue; }
+            const glm::mat4 modelMatrix = obj.transform.mat4();
+            const auto& meshes = obj.model->getMeshes();
 
-                //if (!obj.canCastShadow) { continue; }
-                obj.model->bind(frame_info.commandBuffer);
+            if (casterCulling && !cascadeFrustum.intersects(XEFrustum::transformAABB(obj.model->getBounds(), modelMatrix))) {
+                stats.testedMeshes += static_cast<uint32_t>(meshes.size());
+                stats.culledObjects++;
+                continue;
+            }
 
-                for (auto& mesh: obj.model->getMeshes()) {
-                    SimplePushConstantData push = {};
-                    push.modelMatrix = obj.transform.mat4();
-                    push.cascadeIndex = cascade;
+            for (uint32_t i = 0; i < meshes.size(); i++) {
+                stats.testedMeshes++;
+                if (casterCulling && !cascadeFrustum.intersects(XEFrustum::transformAABB(meshes[i].bounds, modelMatrix))) {
+                    continue;
+                }
+                items.push_back({obj.getId(), i});
+            }
+        }
+    }
 
-                    vkCmdPushConstants(
-                        frame_info.commandBuffer,
-                        xe_pipeline_layout,
-                        VK_SHADER_STAGE_VERTEX_BIT,
-                        0,
-                        sizeof(SimplePushConstantData),
-                        &push);
+    uint32_t XEShadowSystem::drawCasters(FrameInfo& frame_info, int cascade, const std::vector<BVHItem>& items,
+        bool indirect) {
+        XEPipeline* boundPipeline = nullptr;
+        uint32_t drawnMeshes = 0;
+
+        if (indirect) {
+            const auto& batches = drawManager.writeView(frame_info.frameIndex, 1 + cascade, items);
+            for (const auto& batch: batches) {
+                const bool positionOnly = usePositionStreams && batch.model->hasPositionStream();
+                XEPipeline& pipeline = pipelineFor(batch.model->getVertexFormat(), positionOnly, DrawMode::Indirect);
+                if (&pipeline != boundPipeline) {
+                    pipeline.bind(frame_info.commandBuffer);
+                    boundPipeline = &pipeline;
+                }
 
-                    obj.model->drawMesh(frame_info.commandBuffer, mesh);
+                if (positionOnly) {
+                    batch.model->bindPositions(frame_info.commandBuffer);
+                } else {
+                    batch.model->bind(frame_info.commandBuffer);
                 }
+                drawManager.drawBatch(frame_info.commandBuffer, frame_info.frameIndex, batch);
+                drawnMeshes += batch.commandCount;
+                passStats.drawCalls++;
             }
+            return drawnMeshes;
+        }
 
-            endShadowRenderPass(frame_info.commandBuffer);
+        XEGameObject* obj = nullptr;
+        XEGameObject::id_t currentId = ~0u;
+        glm::mat4 modelMatrix{1.f};
+        bool packed = false;
+
+        for (const auto& item: items) {
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = frame_info.gameObjects.find(item.objectId);
+                obj = it != frame_info.gameObjects.end() ? &it->second : nullptr;
+                if (!obj) {
+                    continue;
+                }
+                modelMatrix = obj->transform.mat4();
+
+                const XEModel::VertexFormat format = obj->model->getVertexFormat();
+                const bool positionOnly = usePositionStreams && obj->model->hasPositionStream();
+                packed = format == XEModel::VertexFormat::Packed;
+
+                XEPipeline& pipeline = pipelineFor(format, positionOnly, DrawMode::Direct);
+                if (&pipeline != boundPipeline) {
+                    pipeline.bind(frame_info.commandBuffer);
+                    boundPipeline = &pipeline;
+                }
+
+                if (positionOnly) {
+                    obj->model->bindPositions(frame_info.commandBuffer);
+                } else {
+                    obj->model->bind(frame_info.commandBuffer);
+                }
+            }
+
+            if (!obj) {
+                continue;
+            }
+
+            const auto& mesh = obj->model->getMeshes()[item.meshIndex];
+            drawnMeshes++;
+
+            SimplePushConstantData push = {};
+            // Depth only, so the packed position dequantization can ride along in the model matrix
+            push.modelMatrix = packed ? modelMatrix * mesh.dequantizeMatrix() : modelMatrix;
+            push.cascadeIndex = cascade;
+
+            vkCmdPushConstants(
+                frame_info.commandBuffer,
+                xe_pipeline_layout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                0,
+                sizeof(SimplePushConstantData),
+                &push);
+
+            obj->model->drawMesh(frame_info.commandBuffer, mesh);
+            passStats.drawCalls++;
+        }
+        return drawnMeshes;
+    }
+
+    void XEShadowSystem::drawGPUCulledCasters(FrameInfo& frame_info, int cascade, CullingStats& stats) {
+        // Culled by the compute pass, one count driven draw per caster
+        const XEGPUCullingSystem* gpuCulling = frame_info.gpuCulling;
+        XEPipeline* boundPipeline = nullptr;
+
+        const auto& batches = drawManager.getObjectBatches();
+        for (uint32_t b = 0; b < batches.size(); b++) {
+            const ObjectBatch& batch = batches[b];
+            if (!batch.castsShadow) {
+                continue;
+            }
+
+            const bool positionOnly = usePositionStreams && batch.model->hasPositionStream();
+            XEPipeline& pipeline = pipelineFor(batch.model->getVertexFormat(), positionOnly, DrawMode::Indirect);
+            if (&pipeline != boundPipeline) {
+                pipeline.bind(frame_info.commandBuffer);
+                boundPipeline = &pipeline;
+            }
+
+            if (positionOnly) {
+                batch.model->bindPositions(frame_info.commandBuffer);
+            } else {
+                batch.model->bind(frame_info.commandBuffer);
+            }
+            gpuCulling->drawBatch(frame_info.commandBuffer, frame_info.frameIndex, 1 + cascade, b);
+            stats.testedMeshes += batch.drawCount;
+            passStats.drawCalls++;
+        }
+        stats.visibleMeshes = gpuCulling->getVisibleCount(1 + cascade);
+    }
+
+    void XEShadowSystem::copyStaticCascades(VkCommandBuffer commandBuffer, int frameIndex, uint32_t cascadeMask) {
+        VkImage frameImage = shadowXEImages[frameIndex]->getImage();
+
+        // The other cascades keep their contents, so the atlas leaves the sampled layout instead of UNDEFINED.
+        // Earlier sampling and this frame's earlier cascades have to finish first.
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = frameImage;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        // The static pass made its writes visible to transfer reads, both atlases share the layout
+        std::array<VkImageCopy, SHADOW_MAP_CASCADE_COUNT> regions{};
+        uint32_t regionCount = 0;
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+            if (!(cascadeMask & (1u << cascade))) {
+                continue;
+            }
+            const VkRect2D& rect = cascadeRects[cascade];
+            VkImageCopy& region = regions[regionCount++];
+            region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+            region.srcOffset = {rect.offset.x, rect.offset.y, 0};
+            region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+            region.dstOffset = {rect.offset.x, rect.offset.y, 0};
+            region.extent = {rect.extent.width, rect.extent.height, 1};
+        }
+
+        vkCmdCopyImage(commandBuffer, staticImage->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameImage,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions.data());
+    }
+
+    void XEShadowSystem::createTimestampQueries() {
+        if (!xe_device.properties.limits.timestampComputeAndGraphics) {
+            std::cout << "[Shadow] Timestamps not supported, pass timing disabled" << std::endl;
+            return;
+        }
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * XESwapChain::MAX_FRAMES_IN_FLIGHT;
+
+        if (vkCreateQueryPool(xe_device.device(), &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow timestamp query pool!");
+        }
+        timestampsWritten.assign(XESwapChain::MAX_FRAMES_IN_FLIGHT, false);
+    }
+
+    void XEShadowSystem::readTimestamps(int frameIndex) {
+        // The frame's fence has been waited on, so the previous submission using this slot is complete
+        if (!timestampsWritten[frameIndex]) {
+            return;
+        }
+
+        std::array<uint64_t, 2> timestamps{};
+        if (vkGetQueryPoolResults(xe_device.device(), timestampQueryPool, frameIndex * 2, 2, sizeof(timestamps),
+            timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            lastPassTimeMs = static_cast<float>(timestamps[1] - timestamps[0]) *
+                xe_device.properties.limits.timestampPeriod * 1e-6f;
         }
     }
 
@@ -138,7 +951,8 @@ namespace xe {
         push_constant_range.offset = 0;
         push_constant_range.size = sizeof(SimplePushConstantData);
 
-        std::array<VkDescriptorSetLayout, 1> setLayouts = {shadowPassDescriptorSetLayout->getDescriptorSetLayout()};
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {shadowPassDescriptorSetLayout->getDescriptorSetLayout(),
+            drawManager.getDescriptorLayout()};
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -153,17 +967,30 @@ namespace xe {
         }
     }
 
-    void XEShadowSystem::createShadowRenderPass() {
+    void XEShadowSystem::createRenderPasses() {
+        // The clears only cover the render area, i.e. one cascade's rect of the atlas
+        shadowRenderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // Static casters, copied into the frame atlases afterwards
+        staticRenderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        // Dynamic casters over a copied static cascade
+        compositeRenderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    VkRenderPass XEShadowSystem::createDepthRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout,
+        VkImageLayout finalLayout) {
         VkAttachmentDescription depth = {};
 
         depth.format = VK_FORMAT_D32_SFLOAT;
         depth.samples = VK_SAMPLE_COUNT_1_BIT;
-        depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth.loadOp = loadOp;
         depth.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depth.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        depth.initialLayout = initialLayout;
+        depth.finalLayout = finalLayout;
 
         VkAttachmentReference depthRef = {};
         depthRef.attachment = 0;
@@ -176,22 +1003,23 @@ namespace xe {
 
         // Optional: external deps to be explicit about ordering
         std::array<VkSubpassDependency, 2> deps{};
-        // External -> subpass (write depth)
+        // External -> subpass (write depth, after earlier sampling, static layer copies or a copy into this layer)
         deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         deps[0].dstSubpass = 0;
-        deps[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        deps[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        deps[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        deps[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         deps[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-        // Subpass -> external (read depth)
+        // Subpass -> external (read depth, sampled or copied)
         deps[1].srcSubpass    = 0;
         deps[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
         deps[1].srcStageMask  = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        deps[1].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        deps[1].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
         deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
         deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
         VkRenderPassCreateInfo renderPassInfo = {};
@@ -203,13 +1031,16 @@ namespace xe {
         renderPassInfo.dependencyCount = static_cast<uint32_t>(deps.size());
         renderPassInfo.pDependencies = deps.data();
 
-        if (vkCreateRenderPass(xe_device.device(), &renderPassInfo, nullptr, &shadowRenderPass) != VK_SUCCESS) {
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        if (vkCreateRenderPass(xe_device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             std::cerr << "failed to create render pass" << std::endl;
             throw std::runtime_error("failed to create render pass!");
         }
+        return renderPass;
     }
 
-    void XEShadowSystem::createPipeline() {
+    std::unique_ptr<XEPipeline> XEShadowSystem::createPipeline(XEModel::VertexFormat vertexFormat, bool positionOnly,
+        DrawMode mode) {
         assert(xe_pipeline_layout != nullptr && "Cannot create pipeline before pipeline layout!");
 
         PipelineConfigInfo pipelineConfig = {};
@@ -218,11 +1049,46 @@ namespace xe {
         pipelineConfig.renderPass = shadowRenderPass;
         pipelineConfig.pipelineLayout = xe_pipeline_layout;
         pipelineConfig.subpass = 0;
+        if (mode == DrawMode::SinglePass) {
+            // One viewport and scissor per cascade rect, picked by gl_ViewportIndex
+            pipelineConfig.viewportInfo.viewportCount = SHADOW_MAP_CASCADE_COUNT;
+            pipelineConfig.viewportInfo.scissorCount = SHADOW_MAP_CASCADE_COUNT;
+        }
+
+        // The shader only reads location 0, so the same module works for the interleaved and the position stream
+        const bool packed = vertexFormat == XEModel::VertexFormat::Packed;
+        if (positionOnly) {
+            pipelineConfig.bindingDescriptions = XEModel::getPositionBindingDescriptions(vertexFormat);
+            pipelineConfig.attributeDescriptions = XEModel::getPositionAttributeDescriptions(vertexFormat);
+        } else if (packed) {
+            pipelineConfig.bindingDescriptions = XEModel::PackedVertex::getBindingDescriptions();
+            pipelineConfig.attributeDescriptions = XEModel::PackedVertex::getAttributeDescriptions();
+        } else {
+            pipelineConfig.bindingDescriptions = XEModel::Vertex::getBindingDescriptions();
+            pipelineConfig.attributeDescriptions = XEModel::Vertex::getAttributeDescriptions();
+        }
 
-        xe_pipeline = std::make_unique<XEPipeline>(xe_device,
-            "assets\\shaders\\shadow_shader.spv",
+        std::string vertShader = packed ? "assets\\shaders\\shadow_shader_packed" : "assets\\shaders\\shadow_shader";
+        if (mode == DrawMode::Indirect) {
+            vertShader += "_indirect.spv";
+        } else if (mode == DrawMode::SinglePass) {
+            vertShader += "_single_pass.spv";
+        } else {
+            vertShader += ".spv";
+        }
+
+        return std::make_unique<XEPipeline>(xe_device,
+            vertShader,
             pipelineConfig);
+    }
 
+    XEPipeline& XEShadowSystem::pipelineFor(XEModel::VertexFormat vertexFormat, bool positionOnly, DrawMode mode) {
+        auto& pipeline = xe_pipelines[static_cast<uint32_t>(vertexFormat) * 6 + (positionOnly ? 3 : 0) +
+            static_cast<uint32_t>(mode)];
+        if (!pipeline) {
+            pipeline = createPipeline(vertexFormat, positionOnly, mode);
+        }
+        return *pipeline;
     }
 
     void XEShadowSystem::createDescriptorPool() {
@@ -253,42 +1119,121 @@ namespace xe {
 
     }
 
+    void XEShadowSystem::layoutAtlas() {
+        std::array<int, SHADOW_MAP_CASCADE_COUNT> order{};
+        for (int i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return shadowMapDimensions[a] > shadowMapDimensions[b];
+        });
+
+        // Power of two sizes in decreasing order fill every shelf completely
+        const int width = shadowMapDimensions[order[0]];
+        int x = 0;
+        int y = 0;
+        int shelfHeight = 0;
+        for (int cascade: order) {
+            const int size = shadowMapDimensions[cascade];
+            if (x + size > width) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            cascadeRects[cascade] = {{x, y}, {static_cast<uint32_t>(size), static_cast<uint32_t>(size)}};
+            x += size;
+            shelfHeight = std::max(shelfHeight, size);
+        }
+        const int height = y + shelfHeight;
+
+        const uint32_t maxDimension = xe_device.properties.limits.maxImageDimension2D;
+        if (static_cast<uint32_t>(width) > maxDimension || static_cast<uint32_t>(height) > maxDimension) {
+            throw std::runtime_error("shadow cascade atlas exceeds the maximum image size!");
+        }
+        atlasExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+
+        for (int cascade = 0; cascade < SHADOW_MAP_CASCADE_COUNT; cascade++) {
+            const VkRect2D& rect = cascadeRects[cascade];
+            shadowUbo.cascadeAtlasRects[cascade] = {
+                static_cast<float>(rect.offset.x) / width, static_cast<float>(rect.offset.y) / height,
+                static_cast<float>(rect.extent.width) / width, static_cast<float>(rect.extent.height) / height};
+        }
+        uboVersion++;
+    }
+
     void XEShadowSystem::createDepthImagesAndViews() {
         shadowXEImages.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
 
         for (int i = 0; i < shadowXEImages.size(); i++) {
-            shadowXEImages[i] = std::make_unique<XEImageVMA>(xe_device, shadowMapWidth, shadowMapHeight,
-                SHADOW_MAP_CASCADE_COUNT,
+            shadowXEImages[i] = std::make_unique<XEImageVMA>(xe_device, atlasExtent.width, atlasExtent.height, 1,
                 VK_FORMAT_D32_SFLOAT,
                 VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT,
                 VMA_MEMORY_USAGE_GPU_ONLY);
+
+            cascadeInfos[i].atlasView = createAtlasView(xe_device, shadowXEImages[i]->getImage());
+            // The cascade passes expect the sampled layout, every cascade is cleared before its first use
+            transitionAtlas(shadowXEImages[i]->getImage(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
         }
 
-        // create a single layer image view per cascade for each frame. [frame][cascade]
-        for (int f = 0; f < cascadeInfos.size(); f++) {
-            VkImage image = shadowXEImages[f]->getImage();
-
-            for (int i = 0; i < cascadeInfos[f].shadowLayerImageViews.size(); i++) {
-                // Image view for this cascade's layer (inside the depth map)
-                // This view is used to render to that specific depth image layer
-                VkImageViewCreateInfo viewInfo{};
-                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-                viewInfo.image = image;
-                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = VK_FORMAT_D32_SFLOAT;
-                viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-                viewInfo.subresourceRange.baseMipLevel = 0;
-                viewInfo.subresourceRange.levelCount = 1;
-                viewInfo.subresourceRange.baseArrayLayer = i;
-                viewInfo.subresourceRange.layerCount = 1;
-
-                if (vkCreateImageView(xe_device.device(), &viewInfo, nullptr,
-                    &cascadeInfos[f].shadowLayerImageViews[i]) != VK_SUCCESS) {
-                    throw std::runtime_error("Failed to create shadow image view!!");
-                }
-            }
+        std::cout << "[Shadow] Cascade atlas " << atlasExtent.width << "x" << atlasExtent.height << ", "
+            << getMemoryFootprint().frameAtlasBytes / (1024 * 1024) << " MB for " << shadowXEImages.size()
+            << " frames in flight" << std::endl;
+    }
+
+    void XEShadowSystem::createStaticAtlas() {
+        staticImage = std::make_unique<XEImageVMA>(xe_device, atlasExtent.width, atlasExtent.height, 1,
+            VK_FORMAT_D32_SFLOAT,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY);
+
+        staticAtlasView = createAtlasView(xe_device, staticImage->getImage());
+        staticFramebuffer = createAtlasFramebuffer(xe_device, staticRenderPass, staticAtlasView,
+            atlasExtent.width, atlasExtent.height);
+        transitionAtlas(staticImage->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+
+    void XEShadowSystem::destroyAtlases() {
+        for (CascadeInfo& cascadeInfo : cascadeInfos) {
+            vkDestroyFramebuffer(xe_device.device(), cascadeInfo.frameBuffer, nullptr);
+            vkDestroyImageView(xe_device.device(), cascadeInfo.atlasView, nullptr);
+            cascadeInfo = {};
         }
+        shadowXEImages.clear();
+
+        if (staticImage) {
+            vkDestroyFramebuffer(xe_device.device(), staticFramebuffer, nullptr);
+            vkDestroyImageView(xe_device.device(), staticAtlasView, nullptr);
+            staticFramebuffer = VK_NULL_HANDLE;
+            staticAtlasView = VK_NULL_HANDLE;
+            staticImage.reset();
+        }
+    }
+
+    void XEShadowSystem::transitionAtlas(VkImage image, VkImageLayout newLayout) {
+        VkCommandBuffer commandBuffer = xe_device.beginSingleTimeCommandsGraphics();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = 0;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        xe_device.endSingleTimeCommandsGraphics(commandBuffer);
     }
 
     void XEShadowSystem::createSamplers() {
@@ -319,45 +1264,27 @@ namespace xe {
         shadowDescriptorImageInfo.resize(XESwapChain::MAX_FRAMES_IN_FLIGHT);
         for (int i = 0; i < shadowDescriptorImageInfo.size(); i++) {
             shadowDescriptorImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            shadowDescriptorImageInfo[i].imageView = shadowXEImages[i]->getImageView();
+            shadowDescriptorImageInfo[i].imageView = cascadeInfos[i].atlasView;
             shadowDescriptorImageInfo[i].sampler = shadowDepthSampler;
         }
     }
 
     void XEShadowSystem::createFramebuffers() {
-
         for (CascadeInfo& cascadeInfo : cascadeInfos) {
-
-            for (int i = 0; i < cascadeInfo.frameBuffers.size(); i++) {
-                VkImageView attachments = cascadeInfo.shadowLayerImageViews[i];
-
-                VkFramebufferCreateInfo framebufferInfo = {};
-                framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                framebufferInfo.renderPass = shadowRenderPass;
-                framebufferInfo.attachmentCount = 1;
-                framebufferInfo.pAttachments = &attachments;
-                framebufferInfo.width = shadowMapWidth;
-                framebufferInfo.height = shadowMapHeight;
-                framebufferInfo.layers = 1;
-
-                if (vkCreateFramebuffer(xe_device.device(), &framebufferInfo, nullptr,
-                    &cascadeInfo.frameBuffers[i]) != VK_SUCCESS) {
-                    std::cerr << "failed to create shadow pass framebuffer" << std::endl;
-                    throw std::runtime_error("failed to create shadow pass framebuffer!");
-                }
-            }
-
+            cascadeInfo.frameBuffer = createAtlasFramebuffer(xe_device, shadowRenderPass, cascadeInfo.atlasView,
+                atlasExtent.width, atlasExtent.height);
         }
     }
 
-    void XEShadowSystem::beginShadowRenderPass(VkCommandBuffer commandBuffer, int frameIndex, int cascade) {
+    void XEShadowSystem::beginShadowRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,
+        VkFramebuffer framebuffer, int cascade) {
         VkRenderPassBeginInfo shadowRenderPassInfo = {};
         shadowRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        shadowRenderPassInfo.renderPass = shadowRenderPass;
-        shadowRenderPassInfo.framebuffer = cascadeInfos[frameIndex].frameBuffers[cascade];
-        shadowRenderPassInfo.renderArea.offset = {0, 0};
-        shadowRenderPassInfo.renderArea.extent = {static_cast<uint32_t>(shadowMapWidth),
-            static_cast<uint32_t>(shadowMapHeight)};
+        shadowRenderPassInfo.renderPass = renderPass;
+        shadowRenderPassInfo.framebuffer = framebuffer;
+        // Only this cascade's rect is cleared and drawn
+        const VkRect2D& rect = cascadeRects[cascade];
+        shadowRenderPassInfo.renderArea = rect;
 
         VkClearValue clearDepthValues = {};
         clearDepthValues.depthStencil = {1.0f, 0};
@@ -366,20 +1293,18 @@ namespace xe {
         shadowRenderPassInfo.pClearValues = &clearDepthValues;
 
         vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        passStats.renderPasses++;
 
         VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(shadowMapWidth);
-        viewport.height = static_cast<float>(shadowMapHeight);
+        viewport.x = static_cast<float>(rect.offset.x);
+        viewport.y = static_cast<float>(rect.offset.y);
+        viewport.width = static_cast<float>(rect.extent.width);
+        viewport.height = static_cast<float>(rect.extent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
 
-        VkRect2D scissor{{0,0}, {static_cast<uint32_t>(shadowMapWidth),
-                        static_cast<uint32_t>(shadowMapHeight)}};
-
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdSetScissor(commandBuffer, 0, 1, &rect);
 
         // Tune these two at runtime to fight acne/peter-panning
         vkCmdSetDepthBias(commandBuffer, constB[cascade], 0.0f, slope[cascade]);
@@ -432,52 +1357,4 @@ namespace xe {
         return farPlane;
     }
 
-    LightBBResult XEShadowSystem::createViewVolumeAndCalcLightPos(const std::array<glm::vec3, 4>& zNearPlane,
-                                                                  const std::array<glm::vec3, 4>& zFarPlane, const glm::mat4& invViewMatrix, const glm::vec3& directionalLightDir) {
-
-        // Frustum coordinates in world space
-        glm::vec3 nearTopRightWorld = glm::vec3(invViewMatrix * glm::vec4(zNearPlane[0] ,1.0));
-        glm::vec3 nearBottomRightWorld = glm::vec3(invViewMatrix * glm::vec4(zNearPlane[1] ,1.0));
-        glm::vec3 nearBottomLeftWorld = glm::vec3(invViewMatrix * glm::vec4(zNearPlane[2] ,1.0));
-        glm::vec3 nearTopLeftWorld = glm::vec3(invViewMatrix * glm::vec4(zNearPlane[3] ,1.0));
-
-        glm::vec3 farTopRightWorld = glm::vec3(invViewMatrix * glm::vec4(zFarPlane[0] ,1.0));
-        glm::vec3 farBottomRightWorld = glm::vec3(invViewMatrix * glm::vec4(zFarPlane[1] ,1.0));
-        glm::vec3 farBottomLeftWorld = glm::vec3(invViewMatrix * glm::vec4(zFarPlane[2] ,1.0));
-        glm::vec3 farTopLeftWorld = glm::vec3(invViewMatrix * glm::vec4(zFarPlane[3] ,1.0));
-
-        std::vector<glm::vec3> frustumWS = { nearTopRightWorld, nearBottomRightWorld, nearBottomLeftWorld,
-            nearTopLeftWorld, farTopRightWorld, farBottomRightWorld, farBottomLeftWorld, farTopLeftWorld};
-
-        // Frustum center in world
-        glm::vec3 centerWorldSpace = glm::vec3(0.0f, 0.0f, 0.0f);
-        for (const auto& p: frustumWS) {
-            centerWorldSpace += p;
-        }
-        centerWorldSpace /=  8.0f;
-
-        // Radius  - max distance from center (used to calculate light view matrix)
-        float radius = 0.0f;
-        for (const auto& p: frustumWS) {
-            radius = std::max(radius, glm::length(p - centerWorldSpace));
-        }
-        radius = std::ceil(radius * 16.0f) / 16.0f;
-
-        glm::vec3 maxExtents = glm::vec3{radius, radius, radius};
-        glm::vec3 minExtents = -maxExtents;
-
-        // Build LightViewMatrix (Left handed)
-        const glm::vec3 worldUp(0,1,0);
-        glm::vec3 up = (std::abs(glm::dot(directionalLightDir, worldUp)) > 0.99f) ? glm::vec3(0,0,1) : worldUp;
-        glm::vec3 eye = centerWorldSpace - directionalLightDir * -minExtents.z;
-
-        glm::mat4 lightView = glm::lookAtLH(eye, centerWorldSpace, up);
-        glm::mat4 lightProjection = glm::orthoLH_ZO(minExtents.x, maxExtents.x,
-                                              minExtents.y, maxExtents.y,
-                                              0.0f, maxExtents.z - minExtents.z);
-        lightProjection[1][1] *= -1;
-
-        return LightBBResult{lightProjection, lightView};
-    }
-
 }
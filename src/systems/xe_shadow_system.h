@@ -12,13 +12,17 @@
 #include "systems/xe_camera.h"
 #include "systems/xe_frame_info.h"
 #include "renderer/lighting/xe_light_manager.h"
+#include "renderer/gfx_resource_managers/xe_draw_manager.h"
 #include "renderer/xe_descriptors.h"
 #include "renderer/xe_buffer.h"
 #include "renderer/lighting/xe_lights.h"
+#include "scene/xe_frustum.h"
+#include "scene/xe_scene_bvh.h"
 #include "utils/xe_utils.h"
 
 #include <memory>
 #include <array>
+#include <algorithm>
 
 #define SHADOW_MAP_CASCADE_COUNT 4
 
@@ -27,58 +31,182 @@ namespace xe {
         std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> cascadeLightProjections;
         std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> cascadeLightViews;
         std::array<float, SHADOW_MAP_CASCADE_COUNT> splitDepths;
+        std::array<glm::vec4, SHADOW_MAP_CASCADE_COUNT> cascadeAtlasRects;  // xy = atlas uv offset, zw = uv scale
     };
 
-    struct LightBBResult {
-        glm::mat4 lightProjection{1.f};
-        glm::mat4 lightView{1.f};
+    // Per frame in flight: 2D view of the cascade atlas (sampled and rendered) and its framebuffer,
+    // each cascade renders into its own rect
+    struct CascadeInfo {
+        VkFramebuffer frameBuffer{VK_NULL_HANDLE};
+        VkImageView atlasView{VK_NULL_HANDLE};
     };
 
-    struct CascadeInfo {
-        std::array<VkFramebuffer, SHADOW_MAP_CASCADE_COUNT> frameBuffers;
-        std::array<VkImageView, SHADOW_MAP_CASCADE_COUNT> shadowLayerImageViews;
+    // Commands recorded by the last cascade pass
+    struct ShadowPassStats {
+        bool singlePass = false;
+        uint32_t renderPasses = 0;
+        uint32_t drawCalls = 0;     // direct, indirect and indirect count draws
+        uint32_t instances = 0;     // cascade instances of the single pass draws
+    };
+
+    // Texel storage of the cascade atlases, the driver may pad the allocations
+    struct ShadowMemoryFootprint {
+        uint64_t frameAtlasBytes = 0;   // all frames in flight
+        uint64_t staticAtlasBytes = 0;  // 0 until the cascade cache is used
+    };
+
+    // What the cascade cache did for one cascade in the last frame
+    struct CascadeCacheStats {
+        bool refit = false;             // the light volume moved, the cached layers no longer apply
+        bool rendered = false;          // the layer of this frame's slot was rewritten
+        bool staticRendered = false;    // the static caster layer was re-rendered
+        uint32_t dynamicCasters = 0;    // meshes drawn over the static layer
+    };
+
+    // Light volume of a cascade: a padded box around the slice's bounding sphere, snapped to whole texels
+    struct CascadeFit {
+        glm::mat4 lightView{1.f};
+        glm::mat4 lightProjection{1.f};
+        glm::vec3 lightDir{0.f};
+        glm::vec3 centerLightSpace{0.f};  // box center in the light's rotation frame
+        float extent = 0.0f;              // half size of the box
+        uint64_t version = 0;             // 0 = never fitted
     };
 
     class XEShadowSystem {
     public:
-        XEShadowSystem(XEDevice& device, XELightManager& lightManager);
+        XEShadowSystem(XEDevice& device, XELightManager& lightManager, XEDrawManager& drawManager);
         ~XEShadowSystem();
 
         XEShadowSystem(const XEShadowSystem &) = delete;
         XEShadowSystem &operator=(const XEShadowSystem &) = delete;
 
-        void renderGameObjects(FrameInfo& frame_info, GPULight sunLight);
+        // Fits the cascades to the camera and the sun, before culling and renderGameObjects
+        void updateCascades(FrameInfo& frame_info, GPULight sunLight);
+        void renderGameObjects(FrameInfo& frame_info);
+
+        // Light volume of a cascade from the last updateCascades, near plane disabled (depth clamp)
+        const XEFrustum& getCascadeFrustum(int cascade) const { return cascadeFrustums[cascade]; }
+
+        // Cascade caching: the light volumes are padded and texel snapped so they survive small camera moves,
+        // static casters are rendered once per volume into a shared atlas, and each frame's cascade is a copy of
+        // the static one with the dynamic casters drawn over it. Not used with GPU culling.
+        void setCaching(bool enable) { caching = enable; }
+        bool getCaching() const { return caching; }
+        // Frames between dynamic caster refreshes of a cascade whose volume did not move, e.g. 8 for the last one.
+        // Each frame in flight has its own layers, so values below MAX_FRAMES_IN_FLIGHT act like 1.
+        void setCascadeUpdateInterval(int cascade, uint32_t frames) { cascadeUpdateIntervals[cascade] = std::max(frames, 1u); }
+        uint32_t getCascadeUpdateInterval(int cascade) const { return cascadeUpdateIntervals[cascade]; }
+        // Re-renders every static layer, after static objects were moved, added or removed
+        void invalidateStaticCache();
+        const std::array<CascadeCacheStats, SHADOW_MAP_CASCADE_COUNT>& getCascadeCacheStats() const { return cascadeCacheStats; }
+
+        // Square resolution per cascade. The cascades are packed into one D32 atlas per frame in flight (plus one
+        // for the cascade cache), so this trades shadow detail against memory. Waits for the device to go idle.
+        void setCascadeResolutions(const std::array<int, SHADOW_MAP_CASCADE_COUNT>& resolutions);
+        const std::array<int, SHADOW_MAP_CASCADE_COUNT>& getCascadeResolutions() const { return shadowMapDimensions; }
+        VkExtent2D getAtlasExtent() const { return atlasExtent; }
+        ShadowMemoryFootprint getMemoryFootprint() const;
+
+        // All cascades in one render pass over the atlas: one draw per caster mesh, instanced once per cascade it
+        // touches (the per-view caster mask goes in the push constant), and the vertex shader routes each instance
+        // to its cascade's viewport. Needs multiViewport and shaderOutputViewportIndex; indirect and GPU culled
+        // frames keep a pass per cascade.
+        void setSinglePass(bool enable) { singlePass = enable && singlePassSupported; }
+        bool getSinglePass() const { return singlePass; }
+        bool isSinglePassSupported() const { return singlePassSupported; }
+        const ShadowPassStats& getPassStats() const { return passStats; }
+
+        // Use the models' position-only streams (falls back to the interleaved vertices per model)
+        void setUsePositionStreams(bool enable) { usePositionStreams = enable; }
+        bool getUsePositionStreams() const { return usePositionStreams; }
+        // Cull casters against each cascade's orthographic light volume
+        void setCasterCulling(bool enable) { casterCulling = enable; }
+        bool getCasterCulling() const { return casterCulling; }
+        const std::array<CullingStats, SHADOW_MAP_CASCADE_COUNT>& getCascadeCullingStats() const { return cascadeCullingStats; }
+        // Multi-draw indirect from XEDrawManager (views 1..SHADOW_MAP_CASCADE_COUNT) instead of per mesh draws
+        void setIndirectDraws(bool enable) { indirectDraws = enable && drawManager.isSupported(); }
+        bool getIndirectDraws() const { return indirectDraws; }
+        // CPU time spent recording all cascades of the last frame (culling included)
+        float getLastRecordTimeMs() const { return lastRecordTimeMs; }
+        // GPU time of the whole cascade pass, from timestamps of the last completed use of a frame slot
+        float getLastPassTimeMs() const { return lastPassTimeMs; }
         VkDescriptorSetLayout getDescriptorSetLayout() { return shadowPassDescriptorSetLayout->getDescriptorSetLayout(); }
         VkDescriptorSet getDescriptorSet(int index) { return shadowPassDescriptorSets[index]; }
 
     private:
         void createPipelineLayout();
-        void createShadowRenderPass();
-        void createPipeline();
+        void createRenderPasses();
+        // Every depth pass shares the dependencies, so pipelines and framebuffers work with all of them
+        VkRenderPass createDepthRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout,
+            VkImageLayout finalLayout);
+        enum class DrawMode { Direct, Indirect, SinglePass };
+        std::unique_ptr<XEPipeline> createPipeline(XEModel::VertexFormat vertexFormat, bool positionOnly, DrawMode mode);
+        XEPipeline& pipelineFor(XEModel::VertexFormat vertexFormat, bool positionOnly, DrawMode mode);
+        void createTimestampQueries();
+        void readTimestamps(int frameIndex);
         void createDescriptorPool();
         void createDescriptorSetLayout();
         void initializeDescriptorSet();
+        // Shelf packs the cascades, largest first, into an atlas as wide as the largest cascade
+        void layoutAtlas();
         void createDepthImagesAndViews();
         void createSamplers();
         void createFramebuffers();
+        void createStaticAtlas();
+        void destroyAtlases();
+        void transitionAtlas(VkImage image, VkImageLayout newLayout);
 
-        void beginShadowRenderPass(VkCommandBuffer commandBuffer, int frameIndex, int cascade);
+        void beginShadowRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+            int cascade);
         void endShadowRenderPass(VkCommandBuffer commandBuffer);
 
+        enum class CasterFilter { All, Static, Dynamic };
+        static bool acceptsCaster(const XEGameObject& obj, CasterFilter filter);
+        void bindCascadeState(FrameInfo& frame_info, int cascade, bool indirect);
+        // Casters inside the cascade volume, sorted by object
+        void gatherCasters(FrameInfo& frame_info, int cascade, CasterFilter filter, std::vector<BVHItem>& items,
+            CullingStats& stats);
+        // Returns the number of meshes drawn
+        uint32_t drawCasters(FrameInfo& frame_info, int cascade, const std::vector<BVHItem>& items, bool indirect);
+        void drawGPUCulledCasters(FrameInfo& frame_info, int cascade, CullingStats& stats);
+        // One render pass per cascade (and per static refresh)
+        void renderCascadesSeparately(FrameInfo& frame_info, bool cached, bool indirect);
+        // Re-renders the static casters of a cascade whose volume changed
+        void renderStaticCascade(FrameInfo& frame_info, int cascade);
+        // Static atlas rects -> this frame's atlas rects, leaves the atlas in TRANSFER_DST for the composite pass
+        void copyStaticCascades(VkCommandBuffer commandBuffer, int frameIndex, uint32_t cascadeMask);
+
+        // Single pass path
+        struct MaskedItem {
+            BVHItem item;
+            uint32_t cascadeMask;  // bit per cascade the mesh is drawn into
+        };
+        void renderCascadesSinglePass(FrameInfo& frame_info, bool cached);
+        void beginSinglePass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer);
+        // Casters of the cascades in cascadeMask with the cascades each one is visible in, grouped by object
+        void gatherCasterMasks(FrameInfo& frame_info, uint32_t cascadeMask, CasterFilter filter,
+            std::vector<MaskedItem>& items);
+        void drawMaskedCasters(FrameInfo& frame_info, const std::vector<MaskedItem>& items,
+            std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT>& cascadeMeshes);
+
+        // true when the volume changed
+        bool fitCascade(int cascade, const std::array<glm::vec3, 8>& frustumWS, const glm::vec3& lightDir);
+
         void calculateSplitDepths(float nearClip, float farClip);
         const std::array<glm::vec3, 4> getNearPlane(float fov_y, float cam_aspect, float z_near);
         const std::array<glm::vec3, 4> getFarPlane(float fov_y, float cam_aspect, float z_far);
 
-        LightBBResult createViewVolumeAndCalcLightPos(const std::array<glm::vec3, 4>& zNearPlane,
-            const std::array<glm::vec3, 4>& zFarPlane, const glm::mat4& invViewMatrix,
-            const glm::vec3& directionalLightDir);
 
         XEDevice& xe_device;
-        std::unique_ptr<xe::XEPipeline> xe_pipeline;
+        // [vertexFormat * 6 + positionOnly * 3 + mode], created on first use
+        std::array<std::unique_ptr<xe::XEPipeline>, 12> xe_pipelines;
         VkPipelineLayout xe_pipeline_layout{VK_NULL_HANDLE};
-        VkRenderPass shadowRenderPass{VK_NULL_HANDLE};
+        // The passes only touch one cascade's rect, so none of them starts from UNDEFINED
+        VkRenderPass shadowRenderPass{VK_NULL_HANDLE};     // clear, stays in SHADER_READ_ONLY
         
         XELightManager& lightManager;
+        XEDrawManager& drawManager;
 
         std::unique_ptr<XEDescriptorPool> shadowPassDescriptorPool;
         std::unique_ptr<XEDescriptorSetLayout> shadowPassDescriptorSetLayout;
@@ -89,11 +217,57 @@ namespace xe {
         std::vector<std::unique_ptr<XEBuffer>> shadowUboBuffers;
         std::vector<CascadeInfo> cascadeInfos;
 
-        int shadowMapWidth = 2048;
-        int shadowMapHeight = 2048;
-        std::array<int, 4> shadowMapDimensions{4096, 4096, 2048, 2048};
+        std::array<int, SHADOW_MAP_CASCADE_COUNT> shadowMapDimensions{4096, 4096, 2048, 2048};
+        std::array<VkRect2D, SHADOW_MAP_CASCADE_COUNT> cascadeRects{};
+        VkExtent2D atlasExtent{};
 
         ShadowUbo shadowUbo{};
+        std::array<XEFrustum, SHADOW_MAP_CASCADE_COUNT> cascadeFrustums{};
+
+        // Cascade cache
+        bool caching = true;
+        float cascadePadding = 0.15f;  // extra box size, relative to the slice radius
+        std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT> cascadeUpdateIntervals{1, 1, 4, 8};
+        std::array<CascadeFit, SHADOW_MAP_CASCADE_COUNT> cascadeFits{};
+        uint64_t fitCounter = 0;
+        uint64_t frameCounter = 0;
+        uint64_t uboVersion = 1;                     // bumped when a fit or a split changes
+        std::vector<uint64_t> uploadedUboVersions;   // per frame in flight
+        // Per frame in flight and cascade: the fit its layer holds, when it was last rendered, and whether
+        // dynamic casters were drawn into it (they have to be erased once they leave)
+        std::vector<std::array<uint64_t, SHADOW_MAP_CASCADE_COUNT>> slotFitVersions;
+        std::vector<std::array<uint64_t, SHADOW_MAP_CASCADE_COUNT>> slotRenderedFrames;
+        std::vector<std::array<bool, SHADOW_MAP_CASCADE_COUNT>> slotHadDynamic;
+        std::array<CascadeCacheStats, SHADOW_MAP_CASCADE_COUNT> cascadeCacheStats{};
+
+        // Static casters per cascade, an atlas shared by all frames in flight, always in TRANSFER_SRC layout.
+        // Created on the first cached frame.
+        std::unique_ptr<XEImageVMA> staticImage;
+        VkImageView staticAtlasView{VK_NULL_HANDLE};
+        VkFramebuffer staticFramebuffer{VK_NULL_HANDLE};
+        std::array<uint64_t, SHADOW_MAP_CASCADE_COUNT> staticFitVersions{};
+        VkRenderPass staticRenderPass{VK_NULL_HANDLE};     // clear, stays in TRANSFER_SRC
+        VkRenderPass compositeRenderPass{VK_NULL_HANDLE};  // loads the copied static cascade
+        std::vector<BVHItem> staticItems;
+
+        bool usePositionStreams = true;
+
+        bool casterCulling = true;
+        std::array<CullingStats, SHADOW_MAP_CASCADE_COUNT> cascadeCullingStats{};
+        std::vector<BVHItem> visibleItems;
+
+        bool indirectDraws = false;
+        float lastRecordTimeMs = 0.0f;
+
+        bool singlePassSupported = false;
+        bool singlePass = false;
+        ShadowPassStats passStats{};
+        std::vector<MaskedItem> maskedItems;
+        std::vector<BVHItem> cascadeItems;
+
+        VkQueryPool timestampQueryPool{VK_NULL_HANDLE};  // 2 queries per frame in flight
+        std::vector<bool> timestampsWritten;
+        float lastPassTimeMs = 0.0f;
 
         float cascadeSplitLambda = 0.73f;
         const float slope[4]  = {1.25f, 1.5f, 1.75f, 2.0f};
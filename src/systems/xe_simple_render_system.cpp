@@ -3,11 +3,14 @@
 //
 
 #include "systems/xe_simple_render_system.h"
+#include "systems/xe_gpu_culling_system.h"
 
 #include <stdexcept>
+#include <algorithm>
 #include <array>
 #include <string>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
 #define GLM_FORCE_RADIANS
@@ -23,6 +26,8 @@ namespace xe {
         int normalIndex{0};
         int pad1{0};
         int pad2{0};
+        glm::vec4 quantOffset{0.f};
+        glm::vec4 quantScale{1.f};
     };
 
     XESimpleRenderSystem::XESimpleRenderSystem(XEDevice& device,
@@ -31,16 +36,20 @@ namespace xe {
         XETextureManager& textureManager,
         XEMaterialManager& materialManager,
         VkDescriptorSetLayout shadowSamplerLayout,
-        XELightManager& lightManager): xe_device(device), textureManager(textureManager), lightManager(lightManager),
-        materialManager(materialManager) {
+        VkDescriptorSetLayout localShadowLayout,
+        XELightManager& lightManager,
+        XEDrawManager& drawManager): xe_device(device), renderPass(renderPass), textureManager(textureManager),
+        lightManager(lightManager), materialManager(materialManager), drawManager(drawManager) {
 
         descriptorSetLayouts.push_back(globalSetLayout);
         descriptorSetLayouts.push_back(textureManager.getDescriptorLayout());
         descriptorSetLayouts.push_back(lightManager.getDescriptorLayout());
         descriptorSetLayouts.push_back(shadowSamplerLayout);
+        descriptorSetLayouts.push_back(drawManager.getDescriptorLayout());
+        descriptorSetLayouts.push_back(localShadowLayout);
 
         createPipelineLayout();
-        createPipeline(renderPass);
+        xe_pipelines[0] = createPipeline(XEModel::VertexFormat::Full, false);
     }
 
     XESimpleRenderSystem::~XESimpleRenderSystem() {
@@ -66,7 +75,7 @@ namespace xe {
         }
     }
 
-    void XESimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+    std::unique_ptr<XEPipeline> XESimpleRenderSystem::createPipeline(XEModel::VertexFormat vertexFormat, bool indirect) {
         assert(xe_pipeline_layout != nullptr && "Cannot create pipeline before pipeline layout!");
 
         std::string pipelineType = "graphics";
@@ -75,15 +84,84 @@ namespace xe {
         XEPipeline::defaultPipelineConfigInfo(pipelineConfig);
         pipelineConfig.renderPass = renderPass;
         pipelineConfig.pipelineLayout = xe_pipeline_layout;
-        xe_pipeline = std::make_unique<XEPipeline>(xe_device,
-            "assets\\shaders\\simple_shader.spv",
-            "assets\\shaders\\simple_fragment.spv",
+
+        std::string vertShader = "assets\\shaders\\simple_shader";
+        if (vertexFormat == XEModel::VertexFormat::Packed) {
+            pipelineConfig.bindingDescriptions = XEModel::PackedVertex::getBindingDescriptions();
+            pipelineConfig.attributeDescriptions = XEModel::PackedVertex::getAttributeDescriptions();
+            vertShader += "_packed";
+        }
+        const std::string variant = indirect ? "_indirect.spv" : ".spv";
+
+        return std::make_unique<XEPipeline>(xe_device,
+            vertShader + variant,
+            "assets\\shaders\\simple_fragment" + variant,
             pipelineConfig,
             pipelineType);
     }
 
-    void XESimpleRenderSystem::renderGameObjects(FrameInfo& frame_info, VkDescriptorSet shadowSamplerDescriptorSet) {
-        xe_pipeline->bind(frame_info.commandBuffer);
+    XEPipeline& XESimpleRenderSystem::pipelineFor(XEModel::VertexFormat vertexFormat, bool indirect) {
+        auto& pipeline = xe_pipelines[static_cast<uint32_t>(vertexFormat) * 2 + (indirect ? 1 : 0)];
+        if (!pipeline) {
+            pipeline = createPipeline(vertexFormat, indirect);
+        }
+        return *pipeline;
+    }
+
+    float XESimpleRenderSystem::screenExtentOf(const XEModel::XEMesh& mesh, const glm::mat4& modelMatrix,
+        const FrameInfo& frame_info) {
+        if (frame_info.viewportHeight <= 0.0f) {
+            return 0.0f;
+        }
+
+        const glm::vec3 center{
+            modelMatrix * glm::vec4(mesh.sphere.centerX, mesh.sphere.centerY, mesh.sphere.centerZ, 1.f)};
+        const float scale = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])),
+            glm::length(glm::vec3(modelMatrix[2]))});
+        const float radius = mesh.sphere.radius * scale;
+        // To the nearest point of the sphere, from inside it the mesh may cover the whole screen
+        const float distance = glm::length(center - glm::vec3(frame_info.camera.getInverseView()[3])) - radius;
+        if (distance <= 0.0f) {
+            return 0.0f;
+        }
+        // Projected diameter in pixels
+        return radius * frame_info.camera.getProjection()[1][1] * frame_info.viewportHeight / distance;
+    }
+
+    void XESimpleRenderSystem::markMaterialUsed(int materialIndex, float screenExtent) {
+        const XEMaterial& material = materialManager.getMaterial(materialIndex);
+        textureManager.markUsed(material.albedoIndex, screenExtent);
+        textureManager.markUsed(material.normalIndex, screenExtent);
+    }
+
+    void XESimpleRenderSystem::markVisibleTexturesUsed(FrameInfo& frame_info) {
+        const XEGameObject* obj = nullptr;
+        XEGameObject::id_t currentId = ~0u;
+        glm::mat4 modelMatrix{1.f};
+        for (const auto& item: visibleItems) {
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = frame_info.gameObjects.find(item.objectId);
+                obj = it != frame_info.gameObjects.end() ? &it->second : nullptr;
+                if (obj) {
+                    modelMatrix = obj->transform.mat4();
+                }
+            }
+            if (obj) {
+                const auto& mesh = obj->model->getMeshes()[item.meshIndex];
+                markMaterialUsed(mesh.materialIndex, screenExtentOf(mesh, modelMatrix, frame_info));
+            }
+        }
+    }
+
+    void XESimpleRenderSystem::renderGameObjects(FrameInfo& frame_info, VkDescriptorSet shadowSamplerDescriptorSet,
+        VkDescriptorSet localShadowDescriptorSet, uint32_t gpuCullView) {
+        auto recordStart = std::chrono::high_resolution_clock::now();
+
+        const XEGPUCullingSystem* gpuCulling = frame_info.gpuCulling;
+        const bool indirect = indirectDraws || gpuCulling;
+        pipelineFor(XEModel::VertexFormat::Full, indirect).bind(frame_info.commandBuffer);
+        XEModel::VertexFormat boundFormat = XEModel::VertexFormat::Full;
 
         vkCmdBindDescriptorSets(
             frame_info.commandBuffer,
@@ -94,7 +172,7 @@ namespace xe {
             0,
             nullptr);
 
-        textureSet = textureManager.getDescriptorSet();
+        textureSet = textureManager.getDescriptorSet(frame_info.frameIndex);
 
         vkCmdBindDescriptorSets(
             frame_info.commandBuffer,
@@ -123,27 +201,166 @@ namespace xe {
             0,
             nullptr);
 
-        for (auto& kv: frame_info.gameObjects) {
-            auto& obj = kv.second;
-            obj.model->bind(frame_info.commandBuffer);
-
-            for (auto& mesh: obj.model->getMeshes()) {
-                SimplePushConstantData push = {};
-                XEMaterial material = materialManager.getMaterial(mesh.materialIndex);
-                push.modelMatrix = obj.transform.mat4();
-                push.textureIndex = material.albedoIndex;
-                push.normalIndex = material.normalIndex;
-
-                vkCmdPushConstants(
-                    frame_info.commandBuffer,
-                    xe_pipeline_layout,
-                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                    0,
-                    sizeof(SimplePushConstantData),
-                    &push);
-                obj.model->drawMesh(frame_info.commandBuffer, mesh);
+        vkCmdBindDescriptorSets(
+            frame_info.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            xe_pipeline_layout,
+            5, 1,
+            &localShadowDescriptorSet,
+            0,
+            nullptr);
+
+        if (indirect) {
+            VkDescriptorSet drawDataSet = drawManager.descriptorSet(frame_info.frameIndex);
+            vkCmdBindDescriptorSets(
+                frame_info.commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                xe_pipeline_layout,
+                4, 1,
+                &drawDataSet,
+                0,
+                nullptr);
+        }
+
+        cullingStats = {};
+        visibleItems.clear();
+
+        if (gpuCulling) {
+            // Culled by the compute pass, one count driven draw per object
+            const auto& batches = drawManager.getObjectBatches();
+            for (uint32_t b = 0; b < batches.size(); b++) {
+                const ObjectBatch& batch = batches[b];
+                if (batch.model->getVertexFormat() != boundFormat) {
+                    boundFormat = batch.model->getVertexFormat();
+                    pipelineFor(boundFormat, true).bind(frame_info.commandBuffer);
+                }
+                batch.model->bind(frame_info.commandBuffer);
+                gpuCulling->drawBatch(frame_info.commandBuffer, frame_info.frameIndex, gpuCullView, b);
+            }
+            cullingStats.testedMeshes = drawManager.getDrawCount();
+            cullingStats.visibleMeshes = gpuCulling->getVisibleCount(0);
+
+            // Visibility stays on the GPU, for residency every mesh of an object in the frustum counts as drawn
+            const XEFrustum frustum{frame_info.camera.getProjection() * frame_info.camera.getView()};
+            for (auto& kv: frame_info.gameObjects) {
+                auto& obj = kv.second;
+                const glm::mat4 modelMatrix = obj.transform.mat4();
+                if (!frustum.intersects(XEFrustum::transformAABB(obj.model->getBounds(), modelMatrix))) {
+                    continue;
+                }
+                for (const auto& mesh: obj.model->getMeshes()) {
+                    markMaterialUsed(mesh.materialIndex, screenExtentOf(mesh, modelMatrix, frame_info));
+                }
+            }
+
+            lastRecordTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - recordStart).count();
+            return;
+        }
+
+        const XEFrustum frustum{frame_info.camera.getProjection() * frame_info.camera.getView()};
+
+        if (frustumCulling && frame_info.sceneBVH && !frame_info.sceneBVH->empty()) {
+            BVHQueryStats queryStats{};
+            frame_info.sceneBVH->queryFrustum(frustum, visibleItems, &queryStats);
+            cullingStats.testedMeshes = queryStats.primitivesTested;
+            cullingStats.visibleMeshes = static_cast<uint32_t>(visibleItems.size());
+            cullingStats.nodesVisited = queryStats.nodesVisited;
+
+            // BVH order is spatial, group by object so every model is bound once
+            std::sort(visibleItems.begin(), visibleItems.end(), [](const BVHItem& a, const BVHItem& b) {
+                return a.objectId != b.objectId ? a.objectId < b.objectId : a.meshIndex < b.meshIndex;
+            });
+        } else {
+            for (auto& kv: frame_info.gameObjects) {
+                auto& obj = kv.second;
+                const glm::mat4 modelMatrix = obj.transform.mat4();
+                const auto& meshes = obj.model->getMeshes();
+
+                // Whole model outside: skip without touching its meshes
+                if (frustumCulling && !frustum.intersects(XEFrustum::transformAABB(obj.model->getBounds(), modelMatrix))) {
+                    cullingStats.testedMeshes += static_cast<uint32_t>(meshes.size());
+                    cullingStats.culledObjects++;
+                    continue;
+                }
+
+                for (uint32_t i = 0; i < meshes.size(); i++) {
+                    cullingStats.testedMeshes++;
+                    if (frustumCulling && !frustum.intersects(XEFrustum::transformAABB(meshes[i].bounds, modelMatrix))) {
+                        continue;
+                    }
+                    visibleItems.push_back({obj.getId(), i});
+                }
+            }
+            cullingStats.visibleMeshes = static_cast<uint32_t>(visibleItems.size());
+        }
+
+        markVisibleTexturesUsed(frame_info);
+
+        if (indirect) {
+            // View 0 of the draw manager is the camera
+            for (const auto& batch: drawManager.writeView(frame_info.frameIndex, 0, visibleItems)) {
+                if (batch.model->getVertexFormat() != boundFormat) {
+                    boundFormat = batch.model->getVertexFormat();
+                    pipelineFor(boundFormat, true).bind(frame_info.commandBuffer);
+                }
+                batch.model->bind(frame_info.commandBuffer);
+                drawManager.drawBatch(frame_info.commandBuffer, frame_info.frameIndex, batch);
+            }
+
+            lastRecordTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - recordStart).count();
+            return;
+        }
+
+        XEGameObject* obj = nullptr;
+        XEGameObject::id_t currentId = ~0u;
+        glm::mat4 modelMatrix{1.f};
+
+        for (const auto& item: visibleItems) {
+            if (item.objectId != currentId) {
+                currentId = item.objectId;
+                auto it = frame_info.gameObjects.find(item.objectId);
+                obj = it != frame_info.gameObjects.end() ? &it->second : nullptr;
+                if (!obj) {
+                    continue;  // removed since the BVH was built
+                }
+                modelMatrix = obj->transform.mat4();
+
+                // All variants share the pipeline layout, so the descriptor sets stay bound across the switch
+                if (obj->model->getVertexFormat() != boundFormat) {
+                    boundFormat = obj->model->getVertexFormat();
+                    pipelineFor(boundFormat, false).bind(frame_info.commandBuffer);
+                }
+                obj->model->bind(frame_info.commandBuffer);
+            }
+
+            if (!obj) {
+                continue;
             }
+
+            const auto& mesh = obj->model->getMeshes()[item.meshIndex];
+
+            SimplePushConstantData push = {};
+            XEMaterial material = materialManager.getMaterial(mesh.materialIndex);
+            push.modelMatrix = modelMatrix;
+            push.textureIndex = material.albedoIndex;
+            push.normalIndex = material.normalIndex;
+            push.quantOffset = glm::vec4(mesh.quantOffset, 0.f);
+            push.quantScale = glm::vec4(mesh.quantScale, 0.f);
+
+            vkCmdPushConstants(
+                frame_info.commandBuffer,
+                xe_pipeline_layout,
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                0,
+                sizeof(SimplePushConstantData),
+                &push);
+            obj->model->drawMesh(frame_info.commandBuffer, mesh);
         }
+
+        lastRecordTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - recordStart).count();
     }
 
 }
@@ -13,7 +13,11 @@
 #include "renderer/gfx_resource_managers/xe_texture_manager.h"
 #include "renderer/gfx_resource_managers/xe_material_manager.h"
 #include "renderer/lighting/xe_light_manager.h"
+#include "renderer/gfx_resource_managers/xe_draw_manager.h"
+#include "scene/xe_frustum.h"
+#include "scene/xe_scene_bvh.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -22,27 +26,56 @@ namespace xe {
     public:
         XESimpleRenderSystem(XEDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
             XETextureManager& textureManager, XEMaterialManager& materialManager,
-            VkDescriptorSetLayout shadowSamplerLayout, XELightManager& lightManager);
+            VkDescriptorSetLayout shadowSamplerLayout, VkDescriptorSetLayout localShadowLayout,
+            XELightManager& lightManager, XEDrawManager& drawManager);
         ~XESimpleRenderSystem();
 
         XESimpleRenderSystem(const XESimpleRenderSystem &) = delete;
         XESimpleRenderSystem &operator=(const XESimpleRenderSystem &) = delete;
 
-        void renderGameObjects(FrameInfo& frame_info, VkDescriptorSet shadowSamplerDescriptorSet);
+        // gpuCullView picks the command region when frame_info.gpuCulling is set (the late one for occlusion)
+        void renderGameObjects(FrameInfo& frame_info, VkDescriptorSet shadowSamplerDescriptorSet,
+            VkDescriptorSet localShadowDescriptorSet, uint32_t gpuCullView = 0);
+
+        void setFrustumCulling(bool enable) { frustumCulling = enable; }
+        bool getFrustumCulling() const { return frustumCulling; }
+        const CullingStats& getCullingStats() const { return cullingStats; }
+
+        // Multi-draw indirect from XEDrawManager instead of push constants + one draw per mesh
+        void setIndirectDraws(bool enable) { indirectDraws = enable && drawManager.isSupported(); }
+        bool getIndirectDraws() const { return indirectDraws; }
+        // CPU time spent recording the last frame (culling included)
+        float getLastRecordTimeMs() const { return lastRecordTimeMs; }
 
     private:
         void createPipelineLayout();
-        void createPipeline(VkRenderPass renderPass);
+        std::unique_ptr<XEPipeline> createPipeline(XEModel::VertexFormat vertexFormat, bool indirect);
+        XEPipeline& pipelineFor(XEModel::VertexFormat vertexFormat, bool indirect);
+        // Texture residency: the slots of the materials this frame draws with, and how large they appear
+        static float screenExtentOf(const XEModel::XEMesh& mesh, const glm::mat4& modelMatrix,
+            const FrameInfo& frame_info);
+        void markMaterialUsed(int materialIndex, float screenExtent);
+        void markVisibleTexturesUsed(FrameInfo& frame_info);
 
         XEDevice& xe_device;
-        std::unique_ptr<xe::XEPipeline> xe_pipeline;
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        // [vertexFormat * 2 + indirect], created on first use
+        std::array<std::unique_ptr<xe::XEPipeline>, 4> xe_pipelines;
         VkPipelineLayout xe_pipeline_layout{VK_NULL_HANDLE};
 
         XETextureManager& textureManager;
         XEMaterialManager& materialManager;
         XELightManager& lightManager;
+        XEDrawManager& drawManager;
         VkDescriptorSet textureSet;
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
 
+        bool frustumCulling = true;
+        CullingStats cullingStats{};
+        std::vector<BVHItem> visibleItems;
+
+        bool indirectDraws = false;
+        float lastRecordTimeMs = 0.0f;
+
     };
 }
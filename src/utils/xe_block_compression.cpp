@@ -0,0 +1,288 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "utils/xe_block_compression.h"
+#include "utils/xe_thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace xe {
+
+    namespace {
+        // BC7 4-bit index interpolation weights, out of 64
+        constexpr int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // LSB first, the bit order of every BC format
+        struct BitWriter {
+            uint8_t* out;
+            uint32_t bit = 0;
+
+            void put(uint32_t value, uint32_t count) {
+                for (uint32_t i = 0; i < count; i++, bit++) {
+                    if ((value >> i) & 1u) {
+                        out[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+                    }
+                }
+            }
+        };
+
+        struct Mode6Candidate {
+            int quantized[2][4]{};  // 7-bit endpoint values
+            int pbits[2]{};
+            uint8_t indices[16]{};
+            float error = 0.0f;
+        };
+
+        // Best 7-bit value + p-bit pair per endpoint. The p-bit is shared by the four channels of an endpoint.
+        void quantizeEndpoint(const float* endpoint, int* quantized, int& pbit) {
+            float bestError = -1.0f;
+            for (int p = 0; p < 2; p++) {
+                int q[4];
+                float error = 0.0f;
+                for (int c = 0; c < 4; c++) {
+                    q[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - p) * 0.5f)), 0, 127);
+                    const float d = static_cast<float>((q[c] << 1) | p) - endpoint[c];
+                    error += d * d;
+                }
+                if (bestError < 0.0f || error < bestError) {
+                    bestError = error;
+                    pbit = p;
+                    std::memcpy(quantized, q, sizeof(q));
+                }
+            }
+        }
+
+        void evaluateMode6(const uint8_t* rgba, const float endpoints[2][4], Mode6Candidate& candidate) {
+            quantizeEndpoint(endpoints[0], candidate.quantized[0], candidate.pbits[0]);
+            quantizeEndpoint(endpoints[1], candidate.quantized[1], candidate.pbits[1]);
+
+            int palette[16][4];
+            for (int c = 0; c < 4; c++) {
+                const int e0 = (candidate.quantized[0][c] << 1) | candidate.pbits[0];
+                const int e1 = (candidate.quantized[1][c] << 1) | candidate.pbits[1];
+                for (int i = 0; i < 16; i++) {
+                    palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0 + BC7_WEIGHTS4[i] * e1 + 32) >> 6;
+                }
+            }
+
+            candidate.error = 0.0f;
+            for (int texel = 0; texel < 16; texel++) {
+                const uint8_t* color = rgba + texel * 4;
+                int bestError = -1;
+                for (int i = 0; i < 16; i++) {
+                    int error = 0;
+                    for (int c = 0; c < 4; c++) {
+                        const int d = palette[i][c] - color[c];
+                        error += d * d;
+                    }
+                    if (bestError < 0 || error < bestError) {
+                        bestError = error;
+                        candidate.indices[texel] = static_cast<uint8_t>(i);
+                    }
+                }
+                candidate.error += static_cast<float>(bestError);
+            }
+        }
+
+        // Endpoints that minimize the squared error for fixed indices, per channel
+        bool fitEndpoints(const uint8_t* rgba, const uint8_t* indices, float endpoints[2][4]) {
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (int texel = 0; texel < 16; texel++) {
+                const float b = BC7_WEIGHTS4[indices[texel]] / 64.0f;
+                const float a = 1.0f - b;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < 4; c++) {
+                    ax[c] += a * rgba[texel * 4 + c];
+                    bx[c] += b * rgba[texel * 4 + c];
+                }
+            }
+
+            const float det = aa * bb - ab * ab;
+            if (std::fabs(det) < 1e-6f) {
+                return false;
+            }
+            for (int c = 0; c < 4; c++) {
+                endpoints[0][c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+                endpoints[1][c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        void encodeBC4Block(const uint8_t* values, uint8_t* out) {
+            const uint8_t lo = *std::min_element(values, values + 16);
+            const uint8_t hi = *std::max_element(values, values + 16);
+
+            // hi > lo selects the eight value palette: hi, lo, then six steps from hi to lo
+            int palette[8];
+            palette[0] = hi;
+            palette[1] = lo;
+            for (int i = 2; i < 8; i++) {
+                palette[i] = ((8 - i) * hi + (i - 1) * lo + 3) / 7;
+            }
+
+            std::memset(out, 0, 8);
+            out[0] = hi;
+            out[1] = lo;
+            BitWriter writer{out + 2};
+            for (int texel = 0; texel < 16; texel++) {
+                uint32_t bestIndex = 0;
+                int bestError = 256;
+                // hi == lo leaves every index at 0
+                for (int i = 0; i < (hi > lo ? 8 : 1); i++) {
+                    const int error = std::abs(palette[i] - values[texel]);
+                    if (error < bestError) {
+                        bestError = error;
+                        bestIndex = static_cast<uint32_t>(i);
+                    }
+                }
+                writer.put(bestIndex, 3);
+            }
+        }
+    }
+
+    void encodeBC7Block(const uint8_t* rgba, uint8_t* out) {
+        // Principal axis of the block through power iteration on the covariance
+        float mean[4] = {};
+        for (int texel = 0; texel < 16; texel++) {
+            for (int c = 0; c < 4; c++) {
+                mean[c] += rgba[texel * 4 + c];
+            }
+        }
+        for (float& m: mean) {
+            m /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (int texel = 0; texel < 16; texel++) {
+            float d[4];
+            for (int c = 0; c < 4; c++) {
+                d[c] = rgba[texel * 4 + c] - mean[c];
+            }
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    covariance[i][j] += d[i] * d[j];
+                }
+            }
+        }
+
+        float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    next[i] += covariance[i][j] * axis[j];
+                }
+            }
+            const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f) {
+                break;
+            }
+            for (int c = 0; c < 4; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float tMin = 0.0f, tMax = 0.0f;
+        for (int texel = 0; texel < 16; texel++) {
+            float t = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                t += (rgba[texel * 4 + c] - mean[c]) * axis[c];
+            }
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+
+        float endpoints[2][4];
+        for (int c = 0; c < 4; c++) {
+            endpoints[0][c] = std::clamp(mean[c] + tMin * axis[c], 0.0f, 255.0f);
+            endpoints[1][c] = std::clamp(mean[c] + tMax * axis[c], 0.0f, 255.0f);
+        }
+
+        Mode6Candidate best{};
+        evaluateMode6(rgba, endpoints, best);
+
+        // One least squares pass over the chosen indices, kept only if it helps
+        if (best.error > 0.0f && fitEndpoints(rgba, best.indices, endpoints)) {
+            Mode6Candidate refined{};
+            evaluateMode6(rgba, endpoints, refined);
+            if (refined.error < best.error) {
+                best = refined;
+            }
+        }
+
+        // The anchor (first) index drops its top bit, so it has to be below 8
+        if (best.indices[0] & 8) {
+            for (int c = 0; c < 4; c++) {
+                std::swap(best.quantized[0][c], best.quantized[1][c]);
+            }
+            std::swap(best.pbits[0], best.pbits[1]);
+            for (uint8_t& index: best.indices) {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        std::memset(out, 0, BC_BLOCK_BYTES);
+        BitWriter writer{out};
+        writer.put(1u << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.put(static_cast<uint32_t>(best.quantized[0][c]), 7);
+            writer.put(static_cast<uint32_t>(best.quantized[1][c]), 7);
+        }
+        writer.put(static_cast<uint32_t>(best.pbits[0]), 1);
+        writer.put(static_cast<uint32_t>(best.pbits[1]), 1);
+        writer.put(best.indices[0], 3);
+        for (int texel = 1; texel < 16; texel++) {
+            writer.put(best.indices[texel], 4);
+        }
+    }
+
+    void encodeBC5Block(const uint8_t* rgba, uint8_t* out) {
+        uint8_t red[16], green[16];
+        for (int texel = 0; texel < 16; texel++) {
+            red[texel] = rgba[texel * 4 + 0];
+            green[texel] = rgba[texel * 4 + 1];
+        }
+        encodeBC4Block(red, out);
+        encodeBC4Block(green, out + 8);
+    }
+
+    void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out,
+        XEThreadPool* pool) {
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+
+        auto encodeRows = [&](uint32_t beginRow, uint32_t endRow) {
+            uint8_t block[16 * 4];
+            for (uint32_t by = beginRow; by < endRow; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    for (uint32_t y = 0; y < 4; y++) {
+                        const uint32_t sy = std::min(by * 4 + y, height - 1);
+                        for (uint32_t x = 0; x < 4; x++) {
+                            const uint32_t sx = std::min(bx * 4 + x, width - 1);
+                            std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+                        }
+                    }
+
+                    uint8_t* target = out + (static_cast<size_t>(by) * blocksX + bx) * BC_BLOCK_BYTES;
+                    if (format == BlockFormat::BC7) {
+                        encodeBC7Block(block, target);
+                    } else {
+                        encodeBC5Block(block, target);
+                    }
+                }
+            }
+        };
+
+        if (pool && blocksY > 1) {
+            pool->parallelFor(blocksY, encodeRows);
+        } else {
+            encodeRows(0, blocksY);
+        }
+    }
+}
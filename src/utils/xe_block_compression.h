@@ -0,0 +1,34 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xe {
+
+    class XEThreadPool;
+
+    enum class BlockFormat : uint32_t {
+        BC7 = 1,  // RGBA, mode 6 (one subset, 7.7.7.7 endpoints + p-bits, 4-bit indices)
+        BC5 = 2,  // red and green as two BC4 blocks, for tangent space normals
+    };
+
+    // Both formats store a 4x4 texel block in 16 bytes
+    constexpr size_t BC_BLOCK_BYTES = 16;
+
+    inline size_t compressedSize(uint32_t width, uint32_t height) {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BC_BLOCK_BYTES;
+    }
+
+    // One 4x4 block, 16 RGBA8 texels in row order
+    void encodeBC7Block(const uint8_t* rgba, uint8_t* out);
+    void encodeBC5Block(const uint8_t* rgba, uint8_t* out);
+
+    // A whole image, block rows in order. Blocks past the right or bottom edge repeat the last column/row.
+    // Block rows are spread over the pool when one is given.
+    void compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out,
+        XEThreadPool* pool = nullptr);
+}
@@ -0,0 +1,105 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "utils/xe_bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XE_BOUNDS_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace xe {
+
+    static const float* positionAt(const float* positions, size_t index, size_t strideBytes) {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + index * strideBytes);
+    }
+
+#ifdef XE_BOUNDS_SSE
+    // Loads xyz into a register without reading past the position (the last vertex may end the buffer)
+    static __m128 loadFloat3(const float* p) {
+        __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+        __m128 z = _mm_load_ss(p + 2);
+        return _mm_movelh_ps(xy, z);
+    }
+#endif
+
+    AABB3 computeAABB(const float *positions, size_t count, size_t strideBytes) {
+        AABB3 aabb{FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+        if (count == 0) {
+            return {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+        }
+
+#ifdef XE_BOUNDS_SSE
+        __m128 minV = loadFloat3(positions);
+        __m128 maxV = minV;
+        for (size_t i = 1; i < count; i++) {
+            __m128 p = loadFloat3(positionAt(positions, i, strideBytes));
+            minV = _mm_min_ps(minV, p);
+            maxV = _mm_max_ps(maxV, p);
+        }
+
+        alignas(16) float minOut[4];
+        alignas(16) float maxOut[4];
+        _mm_store_ps(minOut, minV);
+        _mm_store_ps(maxOut, maxV);
+        aabb = {minOut[0], minOut[1], minOut[2], maxOut[0], maxOut[1], maxOut[2]};
+#else
+        for (size_t i = 0; i < count; i++) {
+            const float* p = positionAt(positions, i, strideBytes);
+            aabb.minX = std::min(aabb.minX, p[0]); aabb.maxX = std::max(aabb.maxX, p[0]);
+            aabb.minY = std::min(aabb.minY, p[1]); aabb.maxY = std::max(aabb.maxY, p[1]);
+            aabb.minZ = std::min(aabb.minZ, p[2]); aabb.maxZ = std::max(aabb.maxZ, p[2]);
+        }
+#endif
+        return aabb;
+    }
+
+    BoundingSphere computeBoundingSphere(const float *positions, size_t count, size_t strideBytes,
+        const AABB3 &aabb) {
+        BoundingSphere sphere{
+            (aabb.minX + aabb.maxX) * 0.5f,
+            (aabb.minY + aabb.maxY) * 0.5f,
+            (aabb.minZ + aabb.maxZ) * 0.5f,
+            0.0f
+        };
+
+        float maxDistSq = 0.0f;
+#ifdef XE_BOUNDS_SSE
+        const __m128 center = _mm_setr_ps(sphere.centerX, sphere.centerY, sphere.centerZ, 0.0f);
+        __m128 maxV = _mm_setzero_ps();
+        for (size_t i = 0; i < count; i++) {
+            __m128 d = _mm_sub_ps(loadFloat3(positionAt(positions, i, strideBytes)), center);
+            d = _mm_mul_ps(d, d);
+            // horizontal x + y + z (lane 3 is zero)
+            __m128 sum = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = _mm_add_ss(sum, _mm_movehl_ps(sum, sum));
+            maxV = _mm_max_ss(maxV, sum);
+        }
+        maxDistSq = _mm_cvtss_f32(maxV);
+#else
+        for (size_t i = 0; i < count; i++) {
+            const float* p = positionAt(positions, i, strideBytes);
+            const float dx = p[0] - sphere.centerX;
+            const float dy = p[1] - sphere.centerY;
+            const float dz = p[2] - sphere.centerZ;
+            maxDistSq = std::max(maxDistSq, dx * dx + dy * dy + dz * dz);
+        }
+#endif
+        sphere.radius = std::sqrt(maxDistSq);
+        return sphere;
+    }
+
+    AABB3 mergeAABB(const AABB3 &a, const AABB3 &b) {
+        return {
+            std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::min(a.minZ, b.minZ),
+            std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY), std::max(a.maxZ, b.maxZ)
+        };
+    }
+}
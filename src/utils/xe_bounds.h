@@ -0,0 +1,27 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include "utils/xe_utils.h"
+
+#include <cstddef>
+
+namespace xe {
+
+    struct BoundingSphere {
+        float centerX, centerY, centerZ;
+        float radius;
+    };
+
+    // Bounds over `count` float3 positions located `strideBytes` apart (works directly on interleaved vertices).
+    // Both use SSE when available, 4 lanes per vertex with the 4th lane ignored.
+    AABB3 computeAABB(const float* positions, size_t count, size_t strideBytes);
+
+    // Sphere around the AABB center with the radius of the farthest position (tighter than the AABB diagonal)
+    BoundingSphere computeBoundingSphere(const float* positions, size_t count, size_t strideBytes,
+        const AABB3& aabb);
+
+    AABB3 mergeAABB(const AABB3& a, const AABB3& b);
+}
@@ -0,0 +1,123 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "utils/xe_mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xe {
+    XEMappedFile::~XEMappedFile() {
+        close();
+    }
+
+#ifdef _WIN32
+    bool XEMappedFile::open(const std::string &path) {
+        close();
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        fileHandle = file;
+        mappingHandle = mapping;
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    void XEMappedFile::close() {
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mappingHandle) {
+            CloseHandle(static_cast<HANDLE>(mappingHandle));
+        }
+        if (fileHandle) {
+            CloseHandle(static_cast<HANDLE>(fileHandle));
+        }
+        data_ = nullptr;
+        size_ = 0;
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+    }
+#else
+    bool XEMappedFile::open(const std::string &path) {
+        close();
+
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(file, &st) != 0 || st.st_size == 0) {
+            ::close(file);
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED) {
+            ::close(file);
+            return false;
+        }
+
+        fd = file;
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    void XEMappedFile::close() {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        fd = -1;
+    }
+#endif
+
+    uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,43 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xe {
+
+    // Read-only memory mapping of a whole file. The mapping lives as long as the object.
+    class XEMappedFile {
+    public:
+        XEMappedFile() = default;
+        ~XEMappedFile();
+
+        XEMappedFile(const XEMappedFile&) = delete;
+        XEMappedFile& operator=(const XEMappedFile&) = delete;
+
+        bool open(const std::string& path);  // returns false if the file is missing or cannot be mapped
+        void close();
+
+        bool isOpen() const { return data_ != nullptr; }
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    // 64-bit FNV-1a over a byte range, used to key on-disk caches by source content
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+}
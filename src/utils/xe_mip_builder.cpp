@@ -0,0 +1,240 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "utils/xe_mip_builder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XE_MIP_BUILDER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace xe {
+
+    // Linear values are quantized to 14 bits before the sRGB encode, less than a quarter code of error
+    static constexpr uint32_t LINEAR_TO_SRGB_STEPS = 16384;
+
+    static const std::array<float, 256>& srgbToLinearTable() {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> values{};
+            for (int i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    static const std::array<uint8_t, LINEAR_TO_SRGB_STEPS>& linearToSrgbTable() {
+        static const std::array<uint8_t, LINEAR_TO_SRGB_STEPS> table = [] {
+            std::array<uint8_t, LINEAR_TO_SRGB_STEPS> values{};
+            for (uint32_t i = 0; i < LINEAR_TO_SRGB_STEPS; i++) {
+                float linear = static_cast<float>(i) / (LINEAR_TO_SRGB_STEPS - 1);
+                float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+                values[i] = static_cast<uint8_t>(c * 255.0f + 0.5f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    static uint8_t linearToSrgb(float linear) {
+        linear = std::clamp(linear, 0.0f, 1.0f);
+        return linearToSrgbTable()[static_cast<uint32_t>(linear * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)];
+    }
+
+    static uint8_t toUnorm8(float value) {
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Reference path, also used for the edge texels the SSE loops leave over
+    static void filterTexel(const uint8_t* const texels[4], uint8_t* out, MipFilter filter) {
+        if (filter == MipFilter::Linear) {
+            for (int c = 0; c < 4; c++) {
+                out[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) >> 2);
+            }
+            return;
+        }
+
+        const auto& toLinear = srgbToLinearTable();
+        float sum[4] = {};
+        for (int t = 0; t < 4; t++) {
+            for (int c = 0; c < 3; c++) {
+                sum[c] += filter == MipFilter::SRGB ? toLinear[texels[t][c]] : texels[t][c] / 127.5f - 1.0f;
+            }
+            sum[3] += texels[t][3] / 255.0f;
+        }
+
+        if (filter == MipFilter::SRGB) {
+            for (int c = 0; c < 3; c++) {
+                out[c] = linearToSrgb(sum[c] * 0.25f);
+            }
+        } else {
+            float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+            // Opposing normals cancel out, straight up is the least wrong answer
+            const float n[3] = {
+                length > 1e-6f ? sum[0] / length : 0.0f,
+                length > 1e-6f ? sum[1] / length : 0.0f,
+                length > 1e-6f ? sum[2] / length : 1.0f,
+            };
+            for (int c = 0; c < 3; c++) {
+                out[c] = toUnorm8(n[c] * 0.5f + 0.5f);
+            }
+        }
+        out[3] = toUnorm8(sum[3] * 0.25f);
+    }
+
+#ifdef XE_MIP_BUILDER_SSE
+    // Two output texels per iteration from four texels of each source row, exact integer average
+    static void downsampleLinearPairs(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t pairs) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (uint32_t p = 0; p < pairs; p++) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + p * 16));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + p * 16));
+            // Vertical sums of texels 0,1 and 2,3 as 16-bit channels
+            const __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            // [0 + 1, 2 + 3]
+            const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+            const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + p * 8), _mm_packus_epi16(average, average));
+        }
+    }
+
+    static __m128 loadTexel(const uint8_t* texel) {
+        int32_t packed;
+        std::memcpy(&packed, texel, sizeof(packed));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bytes = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(bytes, zero));
+    }
+
+    // value in [0, 1] per lane
+    static void storeTexel(__m128 value, uint8_t* out) {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+        rounded = _mm_packs_epi32(rounded, rounded);
+        const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(rounded, rounded));
+        std::memcpy(out, &packed, sizeof(packed));
+    }
+
+    static void filterTexelSRGB(const uint8_t* const texels[4], uint8_t* out) {
+        const auto& toLinear = srgbToLinearTable();
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < 4; t++) {
+            const uint8_t* texel = texels[t];
+            sum = _mm_add_ps(sum, _mm_set_ps(texel[3] * (1.0f / 255.0f), toLinear[texel[2]], toLinear[texel[1]],
+                toLinear[texel[0]]));
+        }
+        const __m128 average = _mm_min_ps(_mm_max_ps(_mm_mul_ps(sum, _mm_set1_ps(0.25f)), _mm_setzero_ps()),
+            _mm_set1_ps(1.0f));
+
+        // rgb index the encode table, alpha is already the final value
+        const __m128 scale = _mm_set_ps(255.0f, LINEAR_TO_SRGB_STEPS - 1.0f, LINEAR_TO_SRGB_STEPS - 1.0f,
+            LINEAR_TO_SRGB_STEPS - 1.0f);
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes),
+            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(average, scale), _mm_set1_ps(0.5f))));
+
+        const auto& toSrgb = linearToSrgbTable();
+        out[0] = toSrgb[lanes[0]];
+        out[1] = toSrgb[lanes[1]];
+        out[2] = toSrgb[lanes[2]];
+        out[3] = static_cast<uint8_t>(lanes[3]);
+    }
+
+    static void filterTexelNormal(const uint8_t* const texels[4], uint8_t* out) {
+        // xyz to [-1, 1], alpha to [0, 1]
+        const __m128 scale = _mm_set_ps(1.0f / 255.0f, 1.0f / 127.5f, 1.0f / 127.5f, 1.0f / 127.5f);
+        const __m128 bias = _mm_set_ps(0.0f, -1.0f, -1.0f, -1.0f);
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < 4; t++) {
+            sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(loadTexel(texels[t]), scale), bias));
+        }
+
+        const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        const __m128 xyz = _mm_and_ps(sum, xyzMask);
+        __m128 lengthSq = _mm_mul_ps(xyz, xyz);
+        lengthSq = _mm_add_ps(lengthSq, _mm_shuffle_ps(lengthSq, lengthSq, _MM_SHUFFLE(2, 3, 0, 1)));
+        lengthSq = _mm_add_ps(lengthSq, _mm_shuffle_ps(lengthSq, lengthSq, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        // Opposing normals cancel out, straight up is the least wrong answer
+        const __m128 normal = _mm_cvtss_f32(lengthSq) > 1e-12f
+            ? _mm_div_ps(xyz, _mm_sqrt_ps(lengthSq))
+            : _mm_set_ps(0.0f, 1.0f, 0.0f, 0.0f);
+        const __m128 encoded = _mm_add_ps(_mm_mul_ps(normal, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+        const __m128 alpha = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+        storeTexel(_mm_or_ps(_mm_and_ps(xyzMask, encoded), _mm_andnot_ps(xyzMask, alpha)), out);
+    }
+#endif
+
+    void downsampleLevel(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* target, MipFilter filter) {
+        const uint32_t targetWidth = std::max(1u, width / 2);
+        const uint32_t targetHeight = std::max(1u, height / 2);
+
+        for (uint32_t y = 0; y < targetHeight; y++) {
+            const uint8_t* row0 = source + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+            const uint8_t* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+            uint8_t* out = target + static_cast<size_t>(y) * targetWidth * 4;
+            uint32_t x = 0;
+
+#ifdef XE_MIP_BUILDER_SSE
+            // Only a 1 texel wide source needs the horizontal clamp
+            if (width >= 2) {
+                if (filter == MipFilter::Linear) {
+                    const uint32_t pairs = targetWidth / 2;
+                    downsampleLinearPairs(row0, row1, out, pairs);
+                    x = pairs * 2;
+                } else {
+                    for (; x < targetWidth; x++) {
+                        const uint8_t* texels[4] = {row0 + x * 8, row0 + x * 8 + 4, row1 + x * 8, row1 + x * 8 + 4};
+                        if (filter == MipFilter::SRGB) {
+                            filterTexelSRGB(texels, out + x * 4);
+                        } else {
+                            filterTexelNormal(texels, out + x * 4);
+                        }
+                    }
+                }
+            }
+#endif
+
+            for (; x < targetWidth; x++) {
+                const uint32_t x0 = std::min(x * 2, width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                const uint8_t* texels[4] = {row0 + x0 * 4, row0 + x1 * 4, row1 + x0 * 4, row1 + x1 * 4};
+                filterTexel(texels, out + x * 4, filter);
+            }
+        }
+    }
+
+    XEMipChain buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter) {
+        XEMipChain chain{};
+        const uint32_t levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        chain.levels.resize(levelCount);
+
+        size_t size = 0;
+        for (uint32_t mip = 0; mip < levelCount; mip++) {
+            XEMipChain::Level& level = chain.levels[mip];
+            level.width = std::max(1u, width >> mip);
+            level.height = std::max(1u, height >> mip);
+            level.offset = size;
+            size += static_cast<size_t>(level.width) * level.height * 4;
+        }
+
+        chain.rgba.resize(size);
+        std::memcpy(chain.rgba.data(), rgba, static_cast<size_t>(width) * height * 4);
+        for (uint32_t mip = 1; mip < levelCount; mip++) {
+            const XEMipChain::Level& parent = chain.levels[mip - 1];
+            downsampleLevel(chain.level(mip - 1), parent.width, parent.height,
+                chain.rgba.data() + chain.levels[mip].offset, filter);
+        }
+        return chain;
+    }
+}
@@ -0,0 +1,39 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+
+    // How a 2x2 footprint of RGBA8 texels is reduced to one texel of the next level
+    enum class MipFilter {
+        SRGB,     // colour in sRGB, averaged in linear space, alpha averaged as is
+        Linear,   // every channel averaged as stored
+        Normal,   // tangent space normal in rgb, averaged and renormalized
+    };
+
+    // Every level of an RGBA8 image back to back, level 0 first, so it uploads with a single buffer copy
+    struct XEMipChain {
+        struct Level {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            size_t offset = 0;  // into rgba
+        };
+
+        std::vector<Level> levels;
+        std::vector<uint8_t> rgba;
+
+        const uint8_t* level(uint32_t mip) const { return rgba.data() + levels[mip].offset; }
+    };
+
+    // Full chain down to 1x1 on the calling thread, level 0 is a copy of the source. Box filter; with odd sizes
+    // the last row/column is dropped, a 1 texel wide level repeats its column. SSE2 where available.
+    XEMipChain buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, MipFilter filter);
+    // One level, target is max(1, width / 2) x max(1, height / 2)
+    void downsampleLevel(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* target, MipFilter filter);
+}
@@ -0,0 +1,88 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#include "utils/xe_thread_pool.h"
+
+#include <algorithm>
+
+namespace xe {
+    XEThreadPool::XEThreadPool(uint32_t threadCount) {
+        if (threadCount == 0) {
+            uint32_t hw = std::thread::hardware_concurrency();
+            threadCount = hw > 1 ? hw - 1 : 1;
+        }
+
+        workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    XEThreadPool::~XEThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+
+        for (auto& worker: workers) {
+            worker.join();
+        }
+    }
+
+    std::future<void> XEThreadPool::submit(std::function<void()> task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push(std::move(packaged));
+        }
+        queueCondition.notify_one();
+        return future;
+    }
+
+    void XEThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& body,
+        uint32_t grainSize) {
+        if (count == 0) {
+            return;
+        }
+
+        // A few chunks per worker keeps the load balanced when job sizes vary (e.g. mesh sizes)
+        const uint32_t targetChunks = threadCount() * 4;
+        const uint32_t chunkSize = std::max(std::max(grainSize, 1u), (count + targetChunks - 1) / targetChunks);
+
+        std::vector<std::future<void>> futures;
+        futures.reserve((count + chunkSize - 1) / chunkSize);
+
+        for (uint32_t begin = 0; begin < count; begin += chunkSize) {
+            uint32_t end = std::min(count, begin + chunkSize);
+            futures.push_back(submit([&body, begin, end] { body(begin, end); }));
+        }
+
+        for (auto& future: futures) {
+            future.wait();
+        }
+        for (auto& future: futures) {
+            future.get();
+        }
+    }
+
+    void XEThreadPool::workerLoop() {
+        while (true) {
+            std::shared_ptr<std::packaged_task<void()>> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            (*task)();
+        }
+    }
+}
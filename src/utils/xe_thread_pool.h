@@ -0,0 +1,47 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace xe {
+
+    // Fixed-size worker pool for CPU side jobs (asset import, decoding, binning).
+    class XEThreadPool {
+    public:
+        // threadCount == 0 picks hardware_concurrency - 1 (at least one worker)
+        explicit XEThreadPool(uint32_t threadCount = 0);
+        ~XEThreadPool();
+
+        XEThreadPool(const XEThreadPool&) = delete;
+        XEThreadPool& operator=(const XEThreadPool&) = delete;
+
+        std::future<void> submit(std::function<void()> task);
+
+        // Splits [0, count) into chunks of at least grainSize and blocks until every chunk ran.
+        // Exceptions thrown by the body are rethrown on the calling thread.
+        void parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& body,
+            uint32_t grainSize = 1);
+
+        uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::queue<std::shared_ptr<std::packaged_task<void()>>> tasks;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        bool stopping = false;
+    };
+}
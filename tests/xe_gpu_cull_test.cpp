@@ -0,0 +1,645 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+// Runs cull.comp on a headless Vulkan device, a software one (lavapipe) when there is one, and checks the
+// compacted commands of every view against XEFrustum on the CPU, the same test XEGPUCullingSystem::validate
+// does in the engine. Exits with 77 (skipped) when there is no Vulkan device.
+
+#include "scene/xe_frustum.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "vulkan/vulkan.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace xe;
+
+    constexpr int SKIPPED = 77;
+    constexpr uint32_t MAX_CULL_VIEWS = 8;
+    constexpr uint32_t CULL_CASTS_SHADOW = 1u;
+    constexpr uint32_t CULL_NOT_INDEXED = 2u;
+    constexpr uint32_t CULL_PHASE_ALL = 0;
+    constexpr uint32_t COMMAND_UINTS = 5;
+
+    // std430 DrawData of cull.comp, see GPUDrawData
+    struct alignas(16) DrawData {
+        glm::mat4 modelMatrix{1.f};
+        glm::vec4 quantOffset{0.f};
+        glm::vec4 quantScale{1.f};
+        int32_t material[4]{};
+        glm::vec4 boundsMin{0.f};
+        glm::vec4 boundsMax{0.f};
+        uint32_t indexCount{0};
+        uint32_t firstIndex{0};
+        int32_t vertexOffset{0};
+        uint32_t batchFirstDraw{0};
+        uint32_t batchIndex{0};
+        uint32_t cullFlags{0};
+        uint32_t pad[2]{};
+    };
+    static_assert(sizeof(DrawData) == 176, "must match the std430 DrawData struct");
+
+    // std140 CullView of cull.comp, see GPUCullView
+    struct CullView {
+        std::array<glm::vec4, XEFrustum::PlaneCount> planes{};
+        glm::mat4 viewProjection{1.f};
+        uint32_t castersOnly{0};
+        uint32_t occlusion{0};
+        uint32_t pad[2]{};
+    };
+    static_assert(sizeof(CullView) == 176, "must match the std140 CullView struct");
+
+    struct CullPush {
+        uint32_t drawCount;
+        uint32_t viewCount;
+        uint32_t commandCapacity;
+        uint32_t batchCapacity;
+        uint32_t phase;
+        uint32_t lateRegion;
+        uint32_t pad0, pad1;
+    };
+
+    struct Batch {
+        uint32_t firstDraw;
+        uint32_t drawCount;
+        bool indexed;
+    };
+
+    struct TestView {
+        XEFrustum frustum;
+        bool castersOnly;
+        const char* name;
+    };
+
+    void check(VkResult result, const char* what) {
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error(std::string("failed to ") + what + " (VkResult " + std::to_string(result) + ")");
+        }
+    }
+
+    std::vector<char> readFile(const std::string& path) {
+        std::ifstream file{path, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + path);
+        }
+        std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return buffer;
+    }
+
+    // Boxes this close to an enabled plane may land on either side through float rounding
+    bool touchesPlane(const XEFrustum& frustum, const AABB3& bounds) {
+        for (uint32_t i = 0; i < XEFrustum::PlaneCount; i++) {
+            if (!frustum.isPlaneEnabled(static_cast<XEFrustum::Plane>(i))) {
+                continue;
+            }
+            const glm::vec4& p = frustum.getPlanes()[i];
+            const float x = p.x >= 0.0f ? bounds.maxX : bounds.minX;
+            const float y = p.y >= 0.0f ? bounds.maxY : bounds.minY;
+            const float z = p.z >= 0.0f ? bounds.maxZ : bounds.minZ;
+            if (std::abs(p.x * x + p.y * y + p.z * z + p.w) < 1e-3f) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Minimal compute-only device, buffers are host visible so the test fills and reads them directly
+    class HeadlessDevice {
+    public:
+        ~HeadlessDevice() {
+            for (VkBuffer buffer: buffers) vkDestroyBuffer(device, buffer, nullptr);
+            for (VkDeviceMemory memory: memories) vkFreeMemory(device, memory, nullptr);
+            if (device != VK_NULL_HANDLE) vkDestroyDevice(device, nullptr);
+            if (instance != VK_NULL_HANDLE) vkDestroyInstance(instance, nullptr);
+        }
+
+        // false when there is no usable device
+        bool create() {
+            VkApplicationInfo appInfo{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+            appInfo.pApplicationName = "xe_gpu_cull_test";
+            appInfo.apiVersion = VK_API_VERSION_1_0;
+
+            VkInstanceCreateInfo instanceInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+            instanceInfo.pApplicationInfo = &appInfo;
+            if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS) {
+                instance = VK_NULL_HANDLE;
+                return false;
+            }
+
+            uint32_t deviceCount = 0;
+            vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+            std::vector<VkPhysicalDevice> devices(deviceCount);
+            vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+            // Prefer the software rasterizer so the result does not depend on the build machine's GPU
+            int bestScore = -1;
+            for (VkPhysicalDevice candidate: devices) {
+                uint32_t familyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+                std::vector<VkQueueFamilyProperties> families(familyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+
+                for (uint32_t i = 0; i < familyCount; i++) {
+                    if (!(families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                        continue;
+                    }
+                    VkPhysicalDeviceProperties properties;
+                    vkGetPhysicalDeviceProperties(candidate, &properties);
+                    const int score = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 1 : 0;
+                    if (score > bestScore) {
+                        bestScore = score;
+                        physicalDevice = candidate;
+                        queueFamily = i;
+                        deviceName = properties.deviceName;
+                    }
+                    break;
+                }
+            }
+            if (physicalDevice == VK_NULL_HANDLE) {
+                return false;
+            }
+
+            const float priority = 1.0f;
+            VkDeviceQueueCreateInfo queueInfo{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+            queueInfo.queueFamilyIndex = queueFamily;
+            queueInfo.queueCount = 1;
+            queueInfo.pQueuePriorities = &priority;
+
+            VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+            deviceInfo.queueCreateInfoCount = 1;
+            deviceInfo.pQueueCreateInfos = &queueInfo;
+            check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "create logical device");
+            vkGetDeviceQueue(device, queueFamily, 0, &queue);
+            return true;
+        }
+
+        VkDeviceMemory allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties) {
+            VkPhysicalDeviceMemoryProperties memoryProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+                if ((requirements.memoryTypeBits & (1u << i)) &&
+                    (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                    VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+                    allocInfo.allocationSize = requirements.size;
+                    allocInfo.memoryTypeIndex = i;
+                    VkDeviceMemory memory;
+                    check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "allocate memory");
+                    memories.push_back(memory);
+                    return memory;
+                }
+            }
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+
+        // Host visible and coherent, mapped for the lifetime of the device
+        VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, void** mapped) {
+            VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+            bufferInfo.size = size;
+            bufferInfo.usage = usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VkBuffer buffer;
+            check(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer), "create buffer");
+            buffers.push_back(buffer);
+
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(device, buffer, &requirements);
+            VkDeviceMemory memory = allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            check(vkBindBufferMemory(device, buffer, memory, 0), "bind buffer memory");
+            check(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped), "map buffer memory");
+            std::memset(*mapped, 0, static_cast<size_t>(size));
+            return buffer;
+        }
+
+        VkInstance instance{VK_NULL_HANDLE};
+        VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+        VkDevice device{VK_NULL_HANDLE};
+        VkQueue queue{VK_NULL_HANDLE};
+        uint32_t queueFamily{0};
+        std::string deviceName;
+
+    private:
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memories;
+    };
+
+    // Random objects of 1 to 4 meshes each, scattered around the origin with random rotation and scale
+    void createScene(uint32_t objectCount, std::vector<DrawData>& draws, std::vector<Batch>& batches) {
+        std::mt19937 rng{1234};
+        std::uniform_real_distribution<float> position{-60.f, 60.f};
+        std::uniform_real_distribution<float> unit{-1.f, 1.f};
+        std::uniform_real_distribution<float> angle{0.f, 6.2831853f};
+        std::uniform_real_distribution<float> scale{0.2f, 3.f};
+        std::uniform_real_distribution<float> size{0.1f, 4.f};
+        std::uniform_int_distribution<uint32_t> meshes{1, 4};
+        std::uniform_int_distribution<uint32_t> count{3, 30000};
+
+        for (uint32_t object = 0; object < objectCount; object++) {
+            glm::vec3 axis{unit(rng), unit(rng), unit(rng)};
+            if (glm::length(axis) < 1e-3f) {
+                axis = {0.f, 1.f, 0.f};
+            }
+            glm::mat4 model = glm::translate(glm::mat4{1.f}, glm::vec3{position(rng), position(rng), position(rng)});
+            model = glm::rotate(model, angle(rng), glm::normalize(axis));
+            model = glm::scale(model, glm::vec3{scale(rng), scale(rng), scale(rng)});
+
+            const bool castsShadow = (rng() & 1u) != 0;
+            const bool indexed = (rng() % 4u) != 0;
+            const uint32_t meshCount = meshes(rng);
+            const uint32_t firstDraw = static_cast<uint32_t>(draws.size());
+            batches.push_back({firstDraw, meshCount, indexed});
+
+            for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+                DrawData draw{};
+                draw.modelMatrix = model;
+                const glm::vec3 center{unit(rng) * 3.f, unit(rng) * 3.f, unit(rng) * 3.f};
+                const glm::vec3 extent{size(rng), size(rng), size(rng)};
+                draw.boundsMin = glm::vec4(center - extent, 0.f);
+                draw.boundsMax = glm::vec4(center + extent, 0.f);
+                draw.indexCount = count(rng);
+                draw.firstIndex = count(rng);
+                draw.vertexOffset = static_cast<int32_t>(count(rng));
+                draw.batchFirstDraw = firstDraw;
+                draw.batchIndex = object;
+                draw.cullFlags = (castsShadow ? CULL_CASTS_SHADOW : 0u) | (indexed ? 0u : CULL_NOT_INDEXED);
+                draws.push_back(draw);
+            }
+        }
+    }
+
+    std::vector<TestView> createViews() {
+        std::vector<TestView> views;
+
+        // Camera in the middle of the scene
+        const glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 80.f);
+        const glm::mat4 view = glm::lookAt(glm::vec3{0.f, 5.f, -20.f}, glm::vec3{10.f, 0.f, 30.f}, glm::vec3{0.f, 1.f, 0.f});
+        views.push_back({XEFrustum{projection * view}, false, "camera"});
+
+        // Shadow cascade: casters only, near plane off as for depth clamp
+        const glm::mat4 lightProjection = glm::ortho(-25.f, 25.f, -25.f, 25.f, 0.f, 100.f);
+        const glm::mat4 lightView = glm::lookAt(glm::vec3{30.f, 50.f, 10.f}, glm::vec3{0.f}, glm::vec3{0.f, 1.f, 0.f});
+        XEFrustum cascade{lightProjection * lightView};
+        cascade.disablePlane(XEFrustum::Near);
+        views.push_back({cascade, true, "cascade"});
+
+        // Looking out of the scene, far plane off
+        const glm::mat4 wideProjection = glm::perspective(glm::radians(100.f), 1.f, 0.5f, 40.f);
+        const glm::mat4 backView = glm::lookAt(glm::vec3{-10.f, 0.f, 0.f}, glm::vec3{-40.f, -20.f, 5.f}, glm::vec3{0.f, 1.f, 0.f});
+        XEFrustum wide{wideProjection * backView};
+        wide.disablePlane(XEFrustum::Far);
+        views.push_back({wide, false, "wide"});
+
+        // Every plane off keeps every draw
+        XEFrustum everything{};
+        for (uint32_t i = 0; i < XEFrustum::PlaneCount; i++) {
+            everything.disablePlane(static_cast<XEFrustum::Plane>(i));
+        }
+        views.push_back({everything, false, "everything"});
+
+        return views;
+    }
+
+    int run(const std::string& shaderPath) {
+        HeadlessDevice xe_device;
+        if (!xe_device.create()) {
+            std::cout << "[GPUCullTest] No Vulkan device, skipped" << std::endl;
+            return SKIPPED;
+        }
+        std::cout << "[GPUCullTest] Device: " << xe_device.deviceName << std::endl;
+        VkDevice device = xe_device.device;
+
+        std::vector<DrawData> draws;
+        std::vector<Batch> batches;
+        // Not a multiple of the workgroup size, so the last group has idle invocations
+        createScene(700, draws, batches);
+        const std::vector<TestView> views = createViews();
+
+        const auto drawCount = static_cast<uint32_t>(draws.size());
+        const auto viewCount = static_cast<uint32_t>(views.size());
+        const auto batchCount = static_cast<uint32_t>(batches.size());
+        const uint32_t commandCapacity = drawCount;
+        const uint32_t batchCapacity = batchCount;
+
+        // Same regions as XEGPUCullingSystem: one per view plus the late region, then the occluded count
+        void* drawMapped;
+        void* commandMapped;
+        void* countMapped;
+        void* viewMapped;
+        void* visibilityMapped;
+        VkBuffer drawBuffer = xe_device.createBuffer(sizeof(DrawData) * drawCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &drawMapped);
+        VkBuffer commandBuffer = xe_device.createBuffer(sizeof(uint32_t) * COMMAND_UINTS * commandCapacity * (viewCount + 1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &commandMapped);
+        VkBuffer countBuffer = xe_device.createBuffer(sizeof(uint32_t) * (batchCapacity * (viewCount + 1) + 1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &countMapped);
+        VkBuffer viewBuffer = xe_device.createBuffer(sizeof(CullView) * MAX_CULL_VIEWS,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &viewMapped);
+        VkBuffer visibilityBuffer = xe_device.createBuffer(sizeof(uint32_t) * drawCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &visibilityMapped);
+
+        std::memcpy(drawMapped, draws.data(), sizeof(DrawData) * drawCount);
+        auto* cullViews = static_cast<CullView*>(viewMapped);
+        for (uint32_t v = 0; v < viewCount; v++) {
+            // Disabled planes as XEGPUCullingSystem::setView writes them
+            for (uint32_t i = 0; i < XEFrustum::PlaneCount; i++) {
+                cullViews[v].planes[i] = views[v].frustum.isPlaneEnabled(static_cast<XEFrustum::Plane>(i)) ?
+                    views[v].frustum.getPlanes()[i] : glm::vec4(0.f, 0.f, 0.f, 1.f);
+            }
+            cullViews[v].castersOnly = views[v].castersOnly ? 1u : 0u;
+        }
+
+        // The depth pyramid is only read by the late phase, a 1x1 image satisfies the binding
+        VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.extent = {1, 1, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImage pyramid;
+        check(vkCreateImage(device, &imageInfo, nullptr, &pyramid), "create pyramid image");
+        VkMemoryRequirements imageRequirements;
+        vkGetImageMemoryRequirements(device, pyramid, &imageRequirements);
+        check(vkBindImageMemory(device, pyramid, xe_device.allocate(imageRequirements, 0), 0), "bind pyramid memory");
+
+        VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = pyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        VkImageView pyramidView;
+        check(vkCreateImageView(device, &viewInfo, nullptr, &pyramidView), "create pyramid view");
+
+        VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        VkSampler sampler;
+        check(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "create sampler");
+
+        // Bindings of XEGPUCullingSystem
+        std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+        const std::array<VkDescriptorType, 6> types{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutInfo.pBindings = bindings.data();
+        VkDescriptorSetLayout setLayout;
+        check(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout), "create descriptor set layout");
+
+        const std::array<VkDescriptorPoolSize, 3> poolSizes{{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}}};
+        VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        VkDescriptorPool descriptorPool;
+        check(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "create descriptor pool");
+
+        VkDescriptorSetAllocateInfo setInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet descriptorSet;
+        check(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet), "allocate descriptor set");
+
+        const std::array<VkDescriptorBufferInfo, 6> bufferInfos{{
+            {drawBuffer, 0, VK_WHOLE_SIZE}, {commandBuffer, 0, VK_WHOLE_SIZE}, {countBuffer, 0, VK_WHOLE_SIZE},
+            {viewBuffer, 0, VK_WHOLE_SIZE}, {}, {visibilityBuffer, 0, VK_WHOLE_SIZE}}};
+        const VkDescriptorImageInfo pyramidInfo{sampler, pyramidView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        std::array<VkWriteDescriptorSet, 6> writes{};
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = types[i];
+            if (types[i] == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+                writes[i].pImageInfo = &pyramidInfo;
+            } else {
+                writes[i].pBufferInfo = &bufferInfos[i];
+            }
+        }
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout pipelineLayout;
+        check(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout), "create pipeline layout");
+
+        const std::vector<char> code = readFile(shaderPath);
+        VkShaderModuleCreateInfo moduleInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        moduleInfo.codeSize = code.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        VkShaderModule shaderModule;
+        check(vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule), "create shader module");
+
+        VkComputePipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        VkPipeline pipeline;
+        check(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline),
+            "create cull pipeline");
+
+        VkCommandPoolCreateInfo commandPoolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        commandPoolInfo.queueFamilyIndex = xe_device.queueFamily;
+        VkCommandPool commandPool;
+        check(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool), "create command pool");
+
+        VkCommandBufferAllocateInfo commandInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        commandInfo.commandPool = commandPool;
+        commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandInfo.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        check(vkAllocateCommandBuffers(device, &commandInfo, &cmd), "allocate command buffer");
+
+        VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        check(vkBeginCommandBuffer(cmd, &beginInfo), "begin command buffer");
+
+        VkImageMemoryBarrier pyramidBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        pyramidBarrier.image = pyramid;
+        pyramidBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        CullPush push{drawCount, viewCount, commandCapacity, batchCapacity, CULL_PHASE_ALL, viewCount, 0, 0};
+        vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(cmd, (drawCount + 63) / 64, viewCount, 1);
+
+        VkMemoryBarrier readbackBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        readbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            1, &readbackBarrier, 0, nullptr, 0, nullptr);
+        check(vkEndCommandBuffer(cmd), "record command buffer");
+
+        VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkFence fence;
+        check(vkCreateFence(device, &fenceInfo, nullptr, &fence), "create fence");
+        VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        check(vkQueueSubmit(xe_device.queue, 1, &submitInfo, fence), "submit cull");
+        check(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX), "wait for cull");
+
+        // Same checks as XEGPUCullingSystem::validate, minus the occlusion regions
+        const auto* counts = static_cast<const uint32_t*>(countMapped);
+        const auto* commands = static_cast<const uint32_t*>(commandMapped);
+        uint32_t failures = 0;
+        uint32_t touching = 0;
+        std::vector<uint8_t> gpuKept(drawCount);
+
+        for (uint32_t v = 0; v < viewCount; v++) {
+            std::fill(gpuKept.begin(), gpuKept.end(), 0);
+            uint32_t gpuVisible = 0;
+            uint32_t cpuVisible = 0;
+
+            for (uint32_t b = 0; b < batchCount; b++) {
+                const Batch& batch = batches[b];
+                const uint32_t count = counts[v * batchCapacity + b];
+                if (count > batch.drawCount) {
+                    std::cerr << "[GPUCullTest] " << views[v].name << ": batch " << b << " counts " << count
+                        << " of " << batch.drawCount << " draws" << std::endl;
+                    failures++;
+                    continue;
+                }
+
+                for (uint32_t i = 0; i < count; i++) {
+                    const uint32_t* command = &commands[(v * commandCapacity + batch.firstDraw + i) * COMMAND_UINTS];
+                    const uint32_t drawIndex = batch.indexed ? command[4] : command[3];
+                    if (drawIndex < batch.firstDraw || drawIndex >= batch.firstDraw + batch.drawCount ||
+                        gpuKept[drawIndex]) {
+                        std::cerr << "[GPUCullTest] " << views[v].name << ": batch " << b
+                            << " has a bad or repeated draw " << drawIndex << std::endl;
+                        failures++;
+                        continue;
+                    }
+
+                    const DrawData& draw = draws[drawIndex];
+                    const bool contentsMatch = batch.indexed ?
+                        command[0] == draw.indexCount && command[2] == draw.firstIndex &&
+                        static_cast<int32_t>(command[3]) == draw.vertexOffset :
+                        command[0] == draw.indexCount && static_cast<int32_t>(command[2]) == draw.vertexOffset;
+                    if (!contentsMatch || command[1] != 1) {
+                        std::cerr << "[GPUCullTest] " << views[v].name << ": wrong command for draw " << drawIndex
+                            << std::endl;
+                        failures++;
+                    }
+
+                    gpuKept[drawIndex] = 1;
+                    gpuVisible++;
+                }
+            }
+
+            for (uint32_t d = 0; d < drawCount; d++) {
+                const DrawData& draw = draws[d];
+                bool visible = !(views[v].castersOnly && !(draw.cullFlags & CULL_CASTS_SHADOW));
+                bool ambiguous = false;
+                if (visible) {
+                    const AABB3 localBounds{draw.boundsMin.x, draw.boundsMin.y, draw.boundsMin.z,
+                        draw.boundsMax.x, draw.boundsMax.y, draw.boundsMax.z};
+                    const AABB3 worldBounds = XEFrustum::transformAABB(localBounds, draw.modelMatrix);
+                    visible = views[v].frustum.intersects(worldBounds);
+                    ambiguous = touchesPlane(views[v].frustum, worldBounds);
+                }
+
+                if (visible) {
+                    cpuVisible++;
+                }
+                if (visible != (gpuKept[d] != 0)) {
+                    if (ambiguous) {
+                        touching++;
+                        continue;
+                    }
+                    std::cerr << "[GPUCullTest] " << views[v].name << ": draw " << d << " is " <<
+                        (visible ? "visible" : "culled") << " on the CPU only" << std::endl;
+                    failures++;
+                }
+            }
+
+            std::cout << "[GPUCullTest] View " << views[v].name << ": GPU " << gpuVisible << " / CPU " << cpuVisible
+                << " of " << drawCount << " draws" << std::endl;
+            // Guards against a scene that tests nothing
+            if (cpuVisible == 0 || (cpuVisible == drawCount && v + 1 < viewCount)) {
+                std::cerr << "[GPUCullTest] " << views[v].name << ": the view keeps " << cpuVisible
+                    << " draws, the scene does not exercise it" << std::endl;
+                failures++;
+            }
+        }
+
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        vkDestroySampler(device, sampler, nullptr);
+        vkDestroyImageView(device, pyramidView, nullptr);
+        vkDestroyImage(device, pyramid, nullptr);
+
+        if (touching > 0) {
+            std::cout << "[GPUCullTest] " << touching << " boxes touching a plane differ, ignored" << std::endl;
+        }
+        if (failures > 0) {
+            std::cerr << "[GPUCullTest] FAILED with " << failures << " mismatches" << std::endl;
+            return 1;
+        }
+        std::cout << "[GPUCullTest] Passed" << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::string shaderPath = argc > 1 ? argv[1] : "assets/shaders/cull.spv";
+    try {
+        return run(shaderPath);
+    } catch (const std::exception& e) {
+        std::cerr << "[GPUCullTest] " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,215 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+// XELightBinner::bin against the binScalar reference, on one thread and on the pool, for random light sets and
+// for lights placed across the near plane, the depth slice boundaries and the tile edges. Built once with SSE
+// and once with XE_LIGHT_BINNER_NO_SSE, every cluster list must match the reference exactly.
+
+#include "renderer/lighting/xe_light_binner.h"
+#include "systems/xe_camera.h"
+#include "utils/xe_thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace xe;
+
+    constexpr float NEAR_CLIP = 0.1f;
+    constexpr float FAR_CLIP = 200.0f;
+
+    struct TestCase {
+        std::string name;
+        std::vector<GPULight> lights;
+        XECamera camera;
+    };
+
+    // Same slice depths as the binner and light_cluster.comp
+    float sliceDepth(uint32_t slice) {
+        return NEAR_CLIP * std::pow(FAR_CLIP / NEAR_CLIP, static_cast<float>(slice) / static_cast<float>(LIGHT_CLUSTER_Z));
+    }
+
+    GPULight pointLight(const glm::vec3& position, float range) {
+        GPULight light{};
+        light.color = glm::vec4(1.0f);
+        light.position = glm::vec4(position, 1.0f);
+        light.param = glm::vec4(range, 0.0f, 0.0f, 32.0f);
+        return light;
+    }
+
+    XECamera createCamera(const glm::vec3& position, const glm::vec3& rotation) {
+        XECamera camera{};
+        camera.setPerspectiveProjection(glm::radians(60.0f), 16.0f / 9.0f, NEAR_CLIP, FAR_CLIP);
+        camera.setViewYXZ(position, rotation);
+        return camera;
+    }
+
+    std::vector<TestCase> createCases() {
+        std::mt19937 rng{1234};
+        std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+        std::uniform_real_distribution<float> zeroOne{0.0f, 1.0f};
+        const XECamera origin = createCamera(glm::vec3{0.0f}, glm::vec3{0.0f});
+        std::vector<TestCase> cases;
+
+        // Counts that are not multiples of 4 exercise the padding lanes
+        for (uint32_t count: {1u, 3u, 250u, 1501u}) {
+            TestCase test{"random " + std::to_string(count), {}, origin};
+            for (uint32_t i = 0; i < count; i++) {
+                test.lights.push_back(pointLight({unit(rng) * 60.0f, unit(rng) * 30.0f, zeroOne(rng) * 150.0f - 5.0f},
+                    0.5f + zeroOne(rng) * 8.0f));
+            }
+            cases.push_back(std::move(test));
+        }
+
+        // Spheres in front of, across and behind the near plane
+        {
+            TestCase test{"near plane", {}, origin};
+            for (uint32_t i = 0; i < 400; i++) {
+                const float range = 0.01f + zeroOne(rng) * 2.0f;
+                const float z = NEAR_CLIP + unit(rng) * range * 1.5f;
+                test.lights.push_back(pointLight({unit(rng) * 0.5f, unit(rng) * 0.3f, z}, range));
+            }
+            // Exactly touching it from behind
+            test.lights.push_back(pointLight({0.0f, 0.0f, NEAR_CLIP - 0.5f}, 0.5f));
+            cases.push_back(std::move(test));
+        }
+
+        // Centered on a slice boundary, or touching it from either side
+        {
+            TestCase test{"slice boundaries", {}, origin};
+            for (uint32_t slice = 0; slice <= LIGHT_CLUSTER_Z; slice++) {
+                const float depth = sliceDepth(slice);
+                const float range = depth * (0.01f + zeroOne(rng) * 0.2f);
+                const glm::vec2 lateral = glm::vec2{unit(rng), unit(rng)} * depth * 0.4f;
+                test.lights.push_back(pointLight(glm::vec3{lateral, depth}, range));
+                test.lights.push_back(pointLight(glm::vec3{lateral, depth - range}, range));
+                test.lights.push_back(pointLight(glm::vec3{lateral, depth + range}, range));
+            }
+            cases.push_back(std::move(test));
+        }
+
+        // On the edges between tiles, at the depth of a random slice
+        {
+            TestCase test{"tile edges", {}, origin};
+            const glm::mat4 projection = origin.getProjection();
+            for (uint32_t i = 0; i < 300; i++) {
+                const uint32_t slice = static_cast<uint32_t>(zeroOne(rng) * LIGHT_CLUSTER_Z) % LIGHT_CLUSTER_Z;
+                const float depth = sliceDepth(slice) * (1.0f + zeroOne(rng));
+                const uint32_t tileX = static_cast<uint32_t>(zeroOne(rng) * LIGHT_CLUSTER_X);
+                const uint32_t tileY = static_cast<uint32_t>(zeroOne(rng) * LIGHT_CLUSTER_Y);
+                const float x = (2.0f * tileX / LIGHT_CLUSTER_X - 1.0f) / projection[0][0] * depth;
+                const float y = (2.0f * tileY / LIGHT_CLUSTER_Y - 1.0f) / projection[1][1] * depth;
+                test.lights.push_back(pointLight({x, y, depth}, depth * 0.02f));
+            }
+            cases.push_back(std::move(test));
+        }
+
+        // Large overlapping spheres, clusters hit the MAX_LIGHTS_PER_CLUSTER cap
+        {
+            TestCase test{"over the cluster cap", {}, origin};
+            for (uint32_t i = 0; i < 1200; i++) {
+                test.lights.push_back(pointLight({unit(rng) * 10.0f, unit(rng) * 5.0f, 5.0f + zeroOne(rng) * 20.0f},
+                    20.0f + zeroOne(rng) * 20.0f));
+            }
+            cases.push_back(std::move(test));
+        }
+
+        // Moved and rotated camera, with directional and spot lights mixed in
+        {
+            TestCase test{"moved camera", {}, createCamera({12.0f, -3.0f, -20.0f}, {0.3f, -0.8f, 0.1f})};
+            for (uint32_t i = 0; i < 800; i++) {
+                GPULight light = pointLight({unit(rng) * 80.0f, unit(rng) * 20.0f, unit(rng) * 80.0f},
+                    0.5f + zeroOne(rng) * 10.0f);
+                const uint32_t kind = i % 10;
+                if (kind == 0) {
+                    light.position.w = 0.0f;
+                    light.direction = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+                } else if (kind < 4) {
+                    light.position.w = 2.0f;
+                    light.direction = glm::vec4(glm::normalize(glm::vec3{unit(rng), -1.0f, unit(rng)}), 0.0f);
+                    light.param.y = 0.9f;
+                    light.param.z = 0.8f;
+                }
+                test.lights.push_back(light);
+            }
+            cases.push_back(std::move(test));
+        }
+
+        return cases;
+    }
+
+    // Clusters whose count or light list differ, the first one is reported
+    uint32_t compare(const XELightBinner& reference, const XELightBinner& binner, const std::string& label) {
+        uint32_t mismatches = 0;
+        for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+            const uint32_t count = reference.getClusterLightCount(cluster);
+            if (binner.getClusterLightCount(cluster) == count &&
+                std::equal(reference.getClusterLights(cluster), reference.getClusterLights(cluster) + count,
+                    binner.getClusterLights(cluster))) {
+                continue;
+            }
+            if (mismatches == 0) {
+                std::cerr << "[LightBinnerTest] " << label << ": cluster " << cluster << " has "
+                    << binner.getClusterLightCount(cluster) << " lights, the reference " << count << std::endl;
+            }
+            mismatches++;
+        }
+        return mismatches;
+    }
+}
+
+int main() {
+#ifdef XE_LIGHT_BINNER_NO_SSE
+    const char* path = "scalar lanes";
+#else
+    const char* path = "SSE";
+#endif
+    XEThreadPool pool{3};
+    XELightBinner reference{};
+    // Reused across cases, as the cluster system does every frame
+    XELightBinner binner{};
+
+    uint32_t failures = 0;
+    for (const TestCase& test: createCases()) {
+        const glm::mat4 projection = test.camera.getProjection();
+        const glm::mat4 view = test.camera.getView();
+        const auto lightCount = static_cast<uint32_t>(test.lights.size());
+        reference.binScalar(test.lights.data(), lightCount, projection, view, NEAR_CLIP, FAR_CLIP);
+
+        uint32_t assigned = 0;
+        for (uint32_t cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+            assigned += reference.getClusterLightCount(cluster);
+        }
+
+        for (XEThreadPool* threadPool: {static_cast<XEThreadPool*>(nullptr), &pool}) {
+            const std::string label = test.name + (threadPool ? " (pool)" : " (one thread)");
+            binner.setThreadPool(threadPool);
+            binner.bin(test.lights.data(), lightCount, projection, view, NEAR_CLIP, FAR_CLIP);
+
+            const uint32_t mismatches = compare(reference, binner, label);
+            std::cout << "[LightBinnerTest] " << path << ", " << label << ": " << lightCount << " lights, "
+                << assigned << " assignments, " << mismatches << " clusters differ" << std::endl;
+            if (mismatches > 0) {
+                failures++;
+            }
+        }
+
+        // A set that lands in no cluster tests nothing
+        if (assigned == 0) {
+            std::cerr << "[LightBinnerTest] " << test.name << ": no light reaches any cluster" << std::endl;
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        std::cerr << "[LightBinnerTest] FAILED, " << failures << " runs differ from the scalar reference" << std::endl;
+        return 1;
+    }
+    std::cout << "[LightBinnerTest] Passed" << std::endl;
+    return 0;
+}
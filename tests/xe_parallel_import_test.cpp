@@ -0,0 +1,293 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+// Imports the same scene with XEModel::Builder serially and on a thread pool, then optimized both ways, and
+// checks that vertices, indices, meshes and material descs are byte-identical. The scene is a glTF written
+// here: nested node transforms (TRS and matrix), a mesh instanced under two nodes, a mesh with two
+// primitives, shared materials and a mesh without one.
+
+#include "renderer/xe_model.h"
+#include "utils/xe_thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace xe;
+
+    struct Primitive {
+        std::vector<float> positions;  // xyz
+        std::vector<float> normals;    // xyz
+        std::vector<float> uvs;        // uv
+        std::vector<uint32_t> indices;
+        int material = -1;
+    };
+
+    void addVertex(Primitive& primitive, float x, float y, float z, float nx, float ny, float nz, float u, float v) {
+        primitive.positions.insert(primitive.positions.end(), {x, y, z});
+        primitive.normals.insert(primitive.normals.end(), {nx, ny, nz});
+        primitive.uvs.insert(primitive.uvs.end(), {u, v});
+    }
+
+    // 24 vertices, one quad per face
+    Primitive createBox(float sx, float sy, float sz, int material) {
+        Primitive box{};
+        box.material = material;
+        const float faces[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        for (const auto& n: faces) {
+            // Two axes spanning the face
+            const float u[3] = {n[1] != 0 || n[2] != 0 ? 1.f : 0.f, n[0] != 0 ? 1.f : 0.f, 0.f};
+            const float w[3] = {n[1] * u[2] - n[2] * u[1], n[2] * u[0] - n[0] * u[2], n[0] * u[1] - n[1] * u[0]};
+            const auto first = static_cast<uint32_t>(box.positions.size() / 3);
+            for (int corner = 0; corner < 4; corner++) {
+                const float a = (corner == 1 || corner == 2) ? 1.f : -1.f;
+                const float b = corner >= 2 ? 1.f : -1.f;
+                addVertex(box,
+                    (n[0] + a * u[0] + b * w[0]) * sx,
+                    (n[1] + a * u[1] + b * w[1]) * sy,
+                    (n[2] + a * u[2] + b * w[2]) * sz,
+                    n[0], n[1], n[2], a * 0.5f + 0.5f, b * 0.5f + 0.5f);
+            }
+            box.indices.insert(box.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+        }
+        return box;
+    }
+
+    // Wavy n x n vertex grid, enough vertices for the welding and reordering to have work
+    Primitive createGrid(uint32_t n, float size, int material) {
+        Primitive grid{};
+        grid.material = material;
+        for (uint32_t y = 0; y < n; y++) {
+            for (uint32_t x = 0; x < n; x++) {
+                const float u = static_cast<float>(x) / (n - 1);
+                const float v = static_cast<float>(y) / (n - 1);
+                addVertex(grid, (u - 0.5f) * size, std::sin(u * 9.f) * std::cos(v * 7.f) * 0.3f, (v - 0.5f) * size,
+                    0.f, 1.f, 0.f, u, v);
+            }
+        }
+        for (uint32_t y = 0; y + 1 < n; y++) {
+            for (uint32_t x = 0; x + 1 < n; x++) {
+                const uint32_t i = y * n + x;
+                grid.indices.insert(grid.indices.end(), {i, i + n, i + 1, i + 1, i + n, i + n + 1});
+            }
+        }
+        return grid;
+    }
+
+    std::string base64(const std::vector<uint8_t>& data) {
+        static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        for (size_t i = 0; i < data.size(); i += 3) {
+            const uint32_t chunk = (data[i] << 16) | (i + 1 < data.size() ? data[i + 1] << 8 : 0) |
+                (i + 2 < data.size() ? data[i + 2] : 0);
+            out += table[(chunk >> 18) & 63];
+            out += table[(chunk >> 12) & 63];
+            out += i + 1 < data.size() ? table[(chunk >> 6) & 63] : '=';
+            out += i + 2 < data.size() ? table[chunk & 63] : '=';
+        }
+        return out;
+    }
+
+    // Every attribute gets its own buffer view and accessor in one embedded buffer
+    class GltfWriter {
+    public:
+        // Returns the accessor index
+        int addAccessor(const void* data, size_t bytes, uint32_t count, const char* type, int componentType,
+            const std::string& bounds = {}) {
+            const size_t offset = buffer.size();
+            buffer.resize(offset + bytes);
+            std::memcpy(buffer.data() + offset, data, bytes);
+            while (buffer.size() % 4 != 0) {
+                buffer.push_back(0);
+            }
+
+            const int view = static_cast<int>(views.size());
+            views.push_back("{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" +
+                std::to_string(bytes) + "}");
+            accessors.push_back("{\"bufferView\":" + std::to_string(view) + ",\"componentType\":" +
+                std::to_string(componentType) + ",\"count\":" + std::to_string(count) + ",\"type\":\"" + type + "\"" +
+                bounds + "}");
+            return static_cast<int>(accessors.size() - 1);
+        }
+
+        std::string addPrimitive(const Primitive& primitive) {
+            const auto vertexCount = static_cast<uint32_t>(primitive.positions.size() / 3);
+            float lo[3] = {1e30f, 1e30f, 1e30f};
+            float hi[3] = {-1e30f, -1e30f, -1e30f};
+            for (uint32_t i = 0; i < vertexCount; i++) {
+                for (int c = 0; c < 3; c++) {
+                    lo[c] = std::min(lo[c], primitive.positions[i * 3 + c]);
+                    hi[c] = std::max(hi[c], primitive.positions[i * 3 + c]);
+                }
+            }
+            std::ostringstream bounds;
+            bounds << ",\"min\":[" << lo[0] << "," << lo[1] << "," << lo[2] << "],\"max\":[" << hi[0] << "," << hi[1]
+                << "," << hi[2] << "]";
+
+            const int position = addAccessor(primitive.positions.data(), primitive.positions.size() * sizeof(float),
+                vertexCount, "VEC3", FLOAT, bounds.str());
+            const int normal = addAccessor(primitive.normals.data(), primitive.normals.size() * sizeof(float),
+                vertexCount, "VEC3", FLOAT);
+            const int uv = addAccessor(primitive.uvs.data(), primitive.uvs.size() * sizeof(float), vertexCount,
+                "VEC2", FLOAT);
+            const int indices = addAccessor(primitive.indices.data(), primitive.indices.size() * sizeof(uint32_t),
+                static_cast<uint32_t>(primitive.indices.size()), "SCALAR", UNSIGNED_INT);
+
+            std::string json = "{\"attributes\":{\"POSITION\":" + std::to_string(position) + ",\"NORMAL\":" +
+                std::to_string(normal) + ",\"TEXCOORD_0\":" + std::to_string(uv) + "},\"indices\":" +
+                std::to_string(indices);
+            if (primitive.material >= 0) {
+                json += ",\"material\":" + std::to_string(primitive.material);
+            }
+            return json + "}";
+        }
+
+        static std::string join(const std::vector<std::string>& items) {
+            std::string out;
+            for (size_t i = 0; i < items.size(); i++) {
+                out += (i > 0 ? "," : "") + items[i];
+            }
+            return out;
+        }
+
+        std::string bufferJson() const {
+            return "{\"byteLength\":" + std::to_string(buffer.size()) +
+                ",\"uri\":\"data:application/octet-stream;base64," + base64(buffer) + "\"}";
+        }
+
+        static constexpr int FLOAT = 5126;
+        static constexpr int UNSIGNED_INT = 5125;
+
+        std::vector<uint8_t> buffer;
+        std::vector<std::string> views;
+        std::vector<std::string> accessors;
+    };
+
+    std::string writeScene(const std::filesystem::path& path) {
+        GltfWriter writer{};
+
+        const std::vector<std::string> meshes{
+            // 0: box, instanced under two nodes
+            "{\"primitives\":[" + writer.addPrimitive(createBox(1.f, 0.5f, 2.f, 0)) + "]}",
+            // 1: two primitives with different materials, imported as two meshes
+            "{\"primitives\":[" + writer.addPrimitive(createBox(0.3f, 0.3f, 0.3f, 1)) + "," +
+                writer.addPrimitive(createGrid(24, 3.f, 2)) + "]}",
+            // 2: grid sharing the box's material
+            "{\"primitives\":[" + writer.addPrimitive(createGrid(48, 8.f, 0)) + "]}",
+            // 3: no material, the engine's default
+            "{\"primitives\":[" + writer.addPrimitive(createGrid(16, 2.f, -1)) + "]}",
+        };
+
+        // root -> a (TRS) -> b (matrix), c (instance of mesh 0)
+        //      -> d -> e (scale) -> f (TRS, instance of mesh 1)
+        const std::vector<std::string> nodes{
+            "{\"name\":\"root\",\"translation\":[1,2,3],\"children\":[1,4]}",
+            "{\"name\":\"a\",\"mesh\":0,\"rotation\":[0,0.3826834,0,0.9238795],\"scale\":[2,1,0.5],"
+                "\"children\":[2,3]}",
+            "{\"name\":\"b\",\"mesh\":1,\"matrix\":[0,1,0,0, -1,0,0,0, 0,0,1,0, 4,0,-2,1]}",
+            "{\"name\":\"c\",\"mesh\":0,\"translation\":[-3,0,5]}",
+            "{\"name\":\"d\",\"mesh\":2,\"translation\":[0,-1,0],\"children\":[5]}",
+            "{\"name\":\"e\",\"mesh\":3,\"scale\":[1.5,1.5,1.5],\"children\":[6]}",
+            "{\"name\":\"f\",\"mesh\":1,\"translation\":[2,0.5,0],\"rotation\":[0.2588190,0,0,0.9659258]}",
+        };
+
+        // Materials refer to images by uri only, the import does not open them
+        const std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+            "\"nodes\":[" + GltfWriter::join(nodes) + "],"
+            "\"meshes\":[" + GltfWriter::join(meshes) + "],"
+            "\"materials\":["
+                "{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0}},\"normalTexture\":{\"index\":1}},"
+                "{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":2}}},"
+                "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[0.5,0.5,0.5,1]}}],"
+            "\"textures\":[{\"source\":0},{\"source\":1},{\"source\":2}],"
+            "\"images\":[{\"uri\":\"metal_albedo.png\"},{\"uri\":\"metal_normal.png\"},{\"uri\":\"wood_albedo.png\"}],"
+            "\"buffers\":[" + writer.bufferJson() + "],"
+            "\"bufferViews\":[" + GltfWriter::join(writer.views) + "],"
+            "\"accessors\":[" + GltfWriter::join(writer.accessors) + "]}";
+
+        std::ofstream file{path, std::ios::binary};
+        file << json;
+        return path.string();
+    }
+
+    template <typename T>
+    bool sameBytes(const std::vector<T>& a, const std::vector<T>& b) {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+    }
+
+    // Reports every array that differs
+    bool compare(const XEModel::Builder& serial, const XEModel::Builder& parallel, const char* stage) {
+        bool identical = true;
+        auto check = [&](bool same, const char* what) {
+            if (!same) {
+                std::cerr << "[ParallelImportTest] " << stage << ": " << what << " differ" << std::endl;
+                identical = false;
+            }
+        };
+
+        check(sameBytes(serial.vertices, parallel.vertices), "vertices");
+        check(sameBytes(serial.indices, parallel.indices), "indices");
+        check(sameBytes(serial.meshes, parallel.meshes), "meshes");
+
+        bool sameMaterials = serial.materialDescs.size() == parallel.materialDescs.size();
+        for (size_t i = 0; sameMaterials && i < serial.materialDescs.size(); i++) {
+            sameMaterials = serial.materialDescs[i].albedoFileName == parallel.materialDescs[i].albedoFileName &&
+                serial.materialDescs[i].normalFileName == parallel.materialDescs[i].normalFileName;
+        }
+        check(sameMaterials, "material descs");
+
+        std::cout << "[ParallelImportTest] " << stage << ": " << serial.meshes.size() << " meshes, "
+            << serial.vertices.size() << " vertices, " << serial.indices.size() << " indices, "
+            << serial.materialDescs.size() << " materials" << (identical ? ", identical" : "") << std::endl;
+        return identical;
+    }
+}
+
+int main() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "xe_parallel_import_test.gltf";
+    const std::string scenePath = writeScene(path);
+    const std::string modelDir = path.parent_path().string() + "/";
+
+    int result = 0;
+    try {
+        XEModel::Builder serial{};
+        serial.modelDir = modelDir;
+        serial.loadModel(scenePath, nullptr);
+
+        XEThreadPool pool{4};
+        XEModel::Builder parallel{};
+        parallel.modelDir = modelDir;
+        parallel.loadModel(scenePath, &pool);
+
+        // A scene that lost its nodes, meshes or materials on the way in tests nothing
+        if (serial.meshes.size() < 8 || serial.materialDescs.size() < 3) {
+            std::cerr << "[ParallelImportTest] Expected 8 meshes and 3 materials, imported " << serial.meshes.size()
+                << " and " << serial.materialDescs.size() << std::endl;
+            result = 1;
+        }
+        if (!compare(serial, parallel, "import")) {
+            result = 1;
+        }
+
+        serial.optimizeMeshes(nullptr);
+        parallel.optimizeMeshes(&pool);
+        if (!compare(serial, parallel, "optimized")) {
+            result = 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[ParallelImportTest] " << e.what() << std::endl;
+        result = 1;
+    }
+
+    std::filesystem::remove(path);
+    std::cout << "[ParallelImportTest] " << (result == 0 ? "Passed" : "FAILED") << std::endl;
+    return result;
+}
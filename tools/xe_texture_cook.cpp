@@ -0,0 +1,119 @@
+//
+// Created by adity on 17-10-2026.
+//
+
+// Offline texture cooker: writes the BC7/BC5 caches XETextureManager loads, next to the source images.
+// CPU only, no window and no Vulkan device, so it runs on headless build machines.
+//
+//   xe_texture_cook [-j threads] [--force] [--albedo] <image>... [--normal <image>...]
+//
+// --albedo / --normal select the format for the images after them (BC7 sRGB / BC5), albedo by default.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "renderer/xe_texture_cache.h"
+#include "utils/xe_thread_pool.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct CookJob {
+        std::string path;
+        xe::XETextureCache::Format format;
+    };
+
+    void printUsage() {
+        std::cout << "usage: xe_texture_cook [-j threads] [--force] [--albedo] <image>... [--normal <image>...]"
+            << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    using namespace xe;
+
+    uint32_t threads = 0;
+    bool force = false;
+    XETextureCache::Format format = XETextureCache::Format::BC7_SRGB;
+    std::vector<CookJob> jobs;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--force") {
+            force = true;
+        } else if (arg == "--albedo") {
+            format = XETextureCache::Format::BC7_SRGB;
+        } else if (arg == "--normal") {
+            format = XETextureCache::Format::BC5_UNORM;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else {
+            jobs.push_back({arg, format});
+        }
+    }
+
+    if (jobs.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    XEThreadPool pool{threads};
+    std::cout << "[Cook] " << jobs.size() << " textures, " << pool.threadCount() << " threads" << std::endl;
+
+    uint32_t cooked = 0, upToDate = 0, failed = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (const CookJob& job: jobs) {
+        XETextureCache::Key key{};
+        if (!XETextureCache::computeKey(job.path, job.format, key)) {
+            std::cerr << "[Cook] Cannot read " << job.path << std::endl;
+            failed++;
+            continue;
+        }
+
+        const std::string cachePath = XETextureCache::cachePathFor(job.path, job.format);
+        XETextureCache existing{};
+        if (!force && existing.open(cachePath, key)) {
+            upToDate++;
+            continue;
+        }
+
+        const auto cookStart = std::chrono::high_resolution_clock::now();
+        try {
+            if (!XETextureCache::cook(job.path, key, cachePath, &pool)) {
+                std::cerr << "[Cook] Cannot write " << cachePath << std::endl;
+                failed++;
+                continue;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "[Cook] " << job.path << ": " << e.what() << std::endl;
+            failed++;
+            continue;
+        }
+
+        // What was written must also be readable, or the engine would cook it again at load
+        XETextureCache result{};
+        if (!result.open(cachePath, key)) {
+            std::cerr << "[Cook] Cannot reopen " << cachePath << std::endl;
+            failed++;
+            continue;
+        }
+        std::cout << "[Cook] " << cachePath << ": " << result.width() << "x" << result.height() << ", "
+            << result.mipCount() << " mips, " << result.dataSize() / 1024 << " KB in "
+            << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - cookStart).count() << " ms" << std::endl;
+        cooked++;
+    }
+
+    std::cout << "[Cook] " << cooked << " cooked, " << upToDate << " up to date, " << failed << " failed in "
+        << std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count() << " s"
+        << std::endl;
+    return failed == 0 ? 0 : 1;
+}